@@ -0,0 +1,94 @@
+/* Author: Masaki Murooka */
+
+/** \file CapabilityMapUtils.h
+    Utilities for capability map, which summarizes orientation coverage of SE3 reachability map for each position.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <differentiable_rmap/RmapCapabilityMap.h>
+
+#include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/SamplingUtils.h>
+
+namespace DiffRmap
+{
+/** \brief Make list of orientations to discretize SO3 for capability map.
+    \param direction_num number of approach directions (i.e., directions of z-axis)
+    \param roll_num number of rotation angles around approach direction
+    \return list of orientations (SO3 samples), whose index is (direction index) * roll_num + (roll index)
+
+    Approach directions are distributed on the unit sphere by the Fibonacci lattice, so that the list is deterministic
+    and nearly uniform.
+*/
+std::vector<Sample<SamplingSpace::SO3>> makeCapabilityOrientationList(int direction_num, int roll_num);
+
+/** \brief Calculate reachable ratios and bitmasks of capability map.
+    \param capability_map_msg capability map message (divide_nums, min, max, direction_num, and roll_num must be set)
+    \param reachable_func function to return whether SE3 sample is reachable (called from multiple threads)
+    \param thread_num number of threads (non-positive for hardware concurrency)
+
+    Position grids are evaluated in parallel. Each grid evaluates reachable_func for all orientations of
+    makeCapabilityOrientationList().
+*/
+void calcCapabilityMap(differentiable_rmap::RmapCapabilityMap & capability_map_msg,
+                       const std::function<bool(const Sample<SamplingSpace::SE3> &)> & reachable_func,
+                       int thread_num = 0);
+
+/** \brief Capability map, which answers capability queries of position by a single lookup of the nearest grid. */
+class CapabilityMap
+{
+public:
+  /** \brief Constructor.
+      \param capability_map_msg capability map message
+  */
+  CapabilityMap(const differentiable_rmap::RmapCapabilityMap & capability_map_msg);
+
+  /** \brief Get index of grid nearest to position (-1 if position is out of range). */
+  int gridIdx(const Eigen::Vector3d & pos) const;
+
+  /** \brief Get ratio of reachable orientations at position (zero if position is out of range). */
+  double reachableRatio(const Eigen::Vector3d & pos) const;
+
+  /** \brief Get whether orientation is reachable at position.
+      \param pos position
+      \param orientation_idx index of orientation in orientationList()
+  */
+  bool isReachable(const Eigen::Vector3d & pos, int orientation_idx) const;
+
+  /** \brief Get whether the nearest discretized orientation is reachable at position of SE3 sample. */
+  bool isReachable(const Sample<SamplingSpace::SE3> & sample) const;
+
+  /** \brief Get index of orientation nearest to given orientation (linear search over orientationList()). */
+  int nearestOrientationIdx(const Sample<SamplingSpace::SO3> & orientation) const;
+
+  /** \brief Get list of discretized orientations. */
+  inline const std::vector<Sample<SamplingSpace::SO3>> & orientationList() const
+  {
+    return orientation_list_;
+  }
+
+  /** \brief Get capability map message. */
+  inline const differentiable_rmap::RmapCapabilityMap & capabilityMapMsg() const
+  {
+    return capability_map_msg_;
+  }
+
+protected:
+  //! Capability map message
+  differentiable_rmap::RmapCapabilityMap capability_map_msg_;
+
+  //! List of discretized orientations
+  std::vector<Sample<SamplingSpace::SO3>> orientation_list_;
+
+  //! Number of division of position grid
+  GridIdxs<SamplingSpace::R3> divide_nums_;
+
+  //! Min/max position of grid
+  GridPos<SamplingSpace::R3> grid_pos_min_;
+  GridPos<SamplingSpace::R3> grid_pos_max_;
+};
+} // namespace DiffRmap
@@ -46,6 +46,18 @@ using GridFuncType = std::function<void(int, const GridPos<SamplingSpaceType> &)
 template<class DivideIdxsType, class DivideNumsType>
 int calcGridIdx(const DivideIdxsType & divide_idxs, const DivideNumsType & divide_nums);
 
+/** \brief Calculate indices of grid divisions from grid index.
+    \tparam DivideIdxsType type of divide_idxs
+    \tparam DivideNumsType type of divide_nums
+    \param[out] divide_idxs indices of grid divisions
+    \param[in] grid_idx grid index
+    \param[in] divide_nums number of grid divisions (number of vertices is divide_nums + 1)
+
+    This is the inverse of calcGridIdx.
+*/
+template<class DivideIdxsType, class DivideNumsType>
+void gridIdxToDivideIdxs(DivideIdxsType & divide_idxs, int grid_idx, const DivideNumsType & divide_nums);
+
 /** \brief Calculate ratios of grid divisions.
     \tparam DivideRatiosType type of divide_ratios
     \tparam DivideIdxsType type of divide_idxs
@@ -73,6 +73,16 @@ int calcGridIdx(const DivideIdxsType & divide_idxs, const DivideNumsType & divid
   return grid_idx;
 }
 
+template<class DivideIdxsType, class DivideNumsType>
+void gridIdxToDivideIdxs(DivideIdxsType & divide_idxs, int grid_idx, const DivideNumsType & divide_nums)
+{
+  for(int i = 0; i < divide_idxs.size(); i++)
+  {
+    divide_idxs[i] = grid_idx % (divide_nums[i] + 1);
+    grid_idx /= (divide_nums[i] + 1);
+  }
+}
+
 template<class DivideRatiosType, class DivideIdxsType, class DivideNumsType>
 void gridDivideIdxsToRatios(DivideRatiosType & divide_ratios,
                             const DivideIdxsType & divide_idxs,
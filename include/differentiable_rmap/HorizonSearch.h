@@ -0,0 +1,125 @@
+/* Author: Masaki Murooka */
+
+/** \file HorizonSearch.h
+    Utilities to search minimum horizon of sequence planning.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <mc_rtc/Configuration.h>
+#include <SpaceVecAlg/SpaceVecAlg>
+
+namespace DiffRmap
+{
+/*! \brief Configuration of minimum horizon search. */
+struct HorizonSearchConfiguration
+{
+  //! Min/max horizon of candidates
+  int min_horizon = 1;
+  int max_horizon = 10;
+
+  //! Stride of horizon candidates (e.g., 2 for motion_len of multi-contact planning)
+  int horizon_stride = 1;
+
+  //! Whether to search by bisection (assuming that the feasibility is monotonic w.r.t. horizon)
+  //! If false, all candidates are evaluated in ascending order.
+  bool bisection = false;
+
+  //! Number of threads (non-positive for hardware concurrency)
+  int thread_num = 0;
+
+  //! Max number of planning iterations of each candidate
+  int max_iter_num = 5000;
+
+  //! Min number of planning iterations before the candidate is determined as stalled
+  int min_iter_num = 500;
+
+  //! Interval of planning iterations to check whether the candidate is stalled or aborted
+  int check_interval = 100;
+
+  //! Threshold of inequality violation to be determined as feasible
+  double violation_thre = 1e-3;
+
+  //! Threshold of target error to be determined as feasible
+  double target_error_thre = 1e-2;
+
+  //! Threshold of relative decrease of error in check_interval to be determined as stalled
+  double stall_ratio = 1e-3;
+
+  //! Target pose
+  sva::PTransformd target_pose = sva::PTransformd::Identity();
+
+  /*! \brief Load mc_rtc configuration. */
+  inline void load(const mc_rtc::Configuration & mc_rtc_config)
+  {
+    mc_rtc_config("min_horizon", min_horizon);
+    mc_rtc_config("max_horizon", max_horizon);
+    mc_rtc_config("horizon_stride", horizon_stride);
+    mc_rtc_config("bisection", bisection);
+    mc_rtc_config("thread_num", thread_num);
+    mc_rtc_config("max_iter_num", max_iter_num);
+    mc_rtc_config("min_iter_num", min_iter_num);
+    mc_rtc_config("check_interval", check_interval);
+    mc_rtc_config("violation_thre", violation_thre);
+    mc_rtc_config("target_error_thre", target_error_thre);
+    mc_rtc_config("stall_ratio", stall_ratio);
+    mc_rtc_config("target_pose", target_pose);
+  }
+};
+
+/*! \brief Result of planning with one horizon candidate. */
+struct HorizonCandidateResult
+{
+  //! Horizon
+  int horizon = 0;
+
+  //! Whether the planning is feasible
+  bool feasible = false;
+
+  //! Whether the planning is aborted because a smaller feasible horizon is found
+  bool aborted = false;
+
+  //! Number of planning iterations
+  int iter_num = 0;
+
+  //! Inequality violation and target error at the end of planning
+  double violation = 0.0;
+  double target_error = 0.0;
+};
+
+/*! \brief Result of minimum horizon search. */
+struct HorizonSearchResult
+{
+  //! Minimum feasible horizon (-1 if no candidate is feasible)
+  int horizon = -1;
+
+  //! List of results of evaluated candidates (in ascending order of horizon)
+  std::vector<HorizonCandidateResult> candidate_result_list;
+};
+
+/** \brief Search minimum feasible horizon by planning with horizon candidates concurrently.
+    \tparam PlanningType type of planning
+    \param create_func function to create configured planning instance with the given horizon
+    \param config configuration of search
+    \return search result
+
+    PlanningType must have setup(), runOnce(bool), ineqViolation() returning the violation of inequalities (i.e., the
+    value of their slack variables) at the current iteration, and targetError() returning the error between the last
+    sample and the target. The candidate is determined as feasible once both values fall below the thresholds. The
+    planning of the candidate is stopped early if the sum of both values stalls (i.e., the violation is converging to
+    non-zero), or if a smaller feasible horizon is found by another thread.
+
+    Since the planning instances are independent, each candidate is evaluated in a worker thread. create_func is
+    called under a mutex, so it does not need to be thread-safe.
+*/
+template<class PlanningType>
+HorizonSearchResult searchMinHorizon(const std::function<std::shared_ptr<PlanningType>(int)> & create_func,
+                                     const HorizonSearchConfiguration & config);
+} // namespace DiffRmap
+
+// See method 3 in https://www.codeproject.com/Articles/48575/How-to-Define-a-Template-Class-in-a-h-File-and-Imp
+#include <differentiable_rmap/HorizonSearch.hpp>
@@ -0,0 +1,176 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <mc_rtc/logging.h>
+
+namespace DiffRmap
+{
+template<class PlanningType>
+HorizonSearchResult searchMinHorizon(const std::function<std::shared_ptr<PlanningType>(int)> & create_func,
+                                     const HorizonSearchConfiguration & config)
+{
+  if(config.horizon_stride <= 0 || config.min_horizon > config.max_horizon)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[searchMinHorizon] Invalid horizon range: min {}, max {}, stride {}", config.min_horizon, config.max_horizon,
+        config.horizon_stride);
+  }
+  if(config.check_interval <= 0 || config.min_iter_num < 0 || config.max_iter_num <= 0
+     || config.min_iter_num > config.max_iter_num)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[searchMinHorizon] Invalid iteration setting: min {}, max {}, check interval {}", config.min_iter_num,
+        config.max_iter_num, config.check_interval);
+  }
+
+  std::vector<int> horizon_list;
+  for(int horizon = config.min_horizon; horizon <= config.max_horizon; horizon += config.horizon_stride)
+  {
+    horizon_list.push_back(horizon);
+  }
+  int candidate_num = static_cast<int>(horizon_list.size());
+  int thread_num = config.thread_num > 0 ? config.thread_num : std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<HorizonCandidateResult> result_list(candidate_num);
+  std::vector<bool> evaluated_flag_list(candidate_num, false);
+  std::atomic<int> best_horizon(std::numeric_limits<int>::max());
+  std::mutex create_mutex;
+
+  // Evaluate one candidate
+  auto evaluateCandidate = [&](int candidate_idx) {
+    HorizonCandidateResult & result = result_list[candidate_idx];
+    result.horizon = horizon_list[candidate_idx];
+
+    std::shared_ptr<PlanningType> planning;
+    {
+      std::lock_guard<std::mutex> lock(create_mutex);
+      planning = create_func(result.horizon);
+    }
+    planning->setup();
+
+    double prev_error = std::numeric_limits<double>::max();
+    for(result.iter_num = 1; result.iter_num <= config.max_iter_num; result.iter_num++)
+    {
+      planning->runOnce(false);
+      result.violation = planning->ineqViolation();
+      result.target_error = planning->targetError();
+
+      if(result.violation <= config.violation_thre && result.target_error <= config.target_error_thre)
+      {
+        result.feasible = true;
+        int current_best_horizon = best_horizon.load();
+        while(result.horizon < current_best_horizon
+              && !best_horizon.compare_exchange_weak(current_best_horizon, result.horizon))
+        {
+        }
+        break;
+      }
+
+      if(result.iter_num % config.check_interval != 0)
+      {
+        continue;
+      }
+      if(result.horizon > best_horizon.load())
+      {
+        result.aborted = true;
+        break;
+      }
+      double error = result.violation + result.target_error;
+      if(result.iter_num >= config.min_iter_num && prev_error - error < config.stall_ratio * prev_error)
+      {
+        break;
+      }
+      prev_error = error;
+    }
+    result.iter_num = std::min(result.iter_num, config.max_iter_num);
+  };
+
+  // Evaluate candidates in worker threads
+  auto evaluateCandidates = [&](const std::vector<int> & candidate_idx_list) {
+    std::atomic<size_t> next_idx(0);
+    auto work = [&]() {
+      for(size_t i = next_idx++; i < candidate_idx_list.size(); i = next_idx++)
+      {
+        evaluateCandidate(candidate_idx_list[i]);
+      }
+    };
+    std::vector<std::thread> thread_list;
+    for(int i = 0; i < std::min(thread_num, static_cast<int>(candidate_idx_list.size())); i++)
+    {
+      thread_list.emplace_back(work);
+    }
+    for(auto & thread : thread_list)
+    {
+      thread.join();
+    }
+    for(int candidate_idx : candidate_idx_list)
+    {
+      evaluated_flag_list[candidate_idx] = true;
+    }
+  };
+
+  if(config.bisection)
+  {
+    // Narrow the interval (lower_idx, upper_idx] which contains the minimum feasible candidate by evaluating
+    // thread_num candidates in the interval at once
+    int lower_idx = -1;
+    int upper_idx = candidate_num;
+    while(upper_idx - lower_idx > 1)
+    {
+      int inner_num = upper_idx - lower_idx - 1;
+      int eval_num = std::min(thread_num, inner_num);
+      std::vector<int> candidate_idx_list(eval_num);
+      for(int i = 0; i < eval_num; i++)
+      {
+        candidate_idx_list[i] = lower_idx + (i + 1) * (inner_num + 1) / (eval_num + 1);
+      }
+      evaluateCandidates(candidate_idx_list);
+
+      for(int candidate_idx : candidate_idx_list)
+      {
+        if(result_list[candidate_idx].feasible)
+        {
+          upper_idx = std::min(upper_idx, candidate_idx);
+        }
+      }
+      for(int candidate_idx : candidate_idx_list)
+      {
+        if(!result_list[candidate_idx].feasible && candidate_idx < upper_idx)
+        {
+          lower_idx = std::max(lower_idx, candidate_idx);
+        }
+      }
+    }
+  }
+  else
+  {
+    std::vector<int> candidate_idx_list(candidate_num);
+    for(int i = 0; i < candidate_num; i++)
+    {
+      candidate_idx_list[i] = i;
+    }
+    evaluateCandidates(candidate_idx_list);
+  }
+
+  HorizonSearchResult search_result;
+  for(int i = 0; i < candidate_num; i++)
+  {
+    if(!evaluated_flag_list[i])
+    {
+      continue;
+    }
+    search_result.candidate_result_list.push_back(result_list[i]);
+    if(result_list[i].feasible && search_result.horizon < 0)
+    {
+      search_result.horizon = result_list[i].horizon;
+    }
+  }
+  return search_result;
+}
+} // namespace DiffRmap
@@ -0,0 +1,43 @@
+/* Author: Masaki Murooka */
+
+/** \file IKUtils.h
+    Inverse kinematics utilities.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <optmotiongen/Problem/IterativeQpProblem.h>
+
+namespace DiffRmap
+{
+/** \brief Run IK with convergence-based early termination.
+    \param problem IK problem
+    \param taskset_list list of tasksets whose error is checked
+    \param rb_arr robot array
+    \param rbc_arr robot configuration array of problem
+    \param aux_rb_arr auxiliary robot array
+    \param max_loop_num maximum number of IK loop
+    \param error_thre threshold of task error [m], [rad]
+    \param check_interval interval of IK loop to check convergence (non-positive for no early termination)
+    \param stagnation_thre threshold of joint position change and task error decrease during check interval [m], [rad]
+    (non-positive for no abort)
+    \return whether IK is solved (i.e., task error of all tasksets is less than error_thre)
+
+    IK is terminated when it is solved, or, if stagnation_thre is positive, when it stagnates (i.e., both the maximum
+    joint position change and the decrease of task error during check interval are less than stagnation_thre). Small
+    joint motion alone is not regarded as stagnation because the task error may still be decreasing slowly. The task
+    error is the maximum error norm of the tasksets. Tasksets are updated with the final configuration when this
+    function returns.
+*/
+bool runIK(OmgCore::IterativeQpProblem & problem,
+           const std::vector<OmgCore::Taskset *> & taskset_list,
+           const OmgCore::RobotArray & rb_arr,
+           const OmgCore::RobotConfigArray & rbc_arr,
+           const OmgCore::AuxRobotArray & aux_rb_arr,
+           int max_loop_num,
+           double error_thre,
+           int check_interval = 0,
+           double stagnation_thre = 0.0);
+} // namespace DiffRmap
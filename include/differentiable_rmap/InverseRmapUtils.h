@@ -0,0 +1,102 @@
+/* Author: Masaki Murooka */
+
+/** \file InverseRmapUtils.h
+    Utilities for inverse reachability map.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <differentiable_rmap/RmapGridSet.h>
+
+#include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/SamplingUtils.h>
+
+namespace DiffRmap
+{
+/** \brief Placement candidate obtained by voting on inverse reachability map.
+    \tparam SamplingSpaceType sampling space
+*/
+template<SamplingSpace SamplingSpaceType>
+struct PlacementCandidate
+{
+  //! Sample of placement
+  Sample<SamplingSpaceType> sample;
+
+  //! Number of target samples which are reachable from placement
+  int vote_num = 0;
+
+  //! Sum of SVM values of target samples which are reachable from placement
+  double score = 0.0;
+};
+
+/** \brief Calculate inverse of sample (i.e., the pose of the origin in the frame of sample).
+    \tparam SamplingSpaceType sampling space
+    \param sample sample
+*/
+template<SamplingSpace SamplingSpaceType>
+Sample<SamplingSpaceType> invertSample(const Sample<SamplingSpaceType> & sample);
+
+/** \brief Get value of grid vertex nearest to sample.
+    \tparam SamplingSpaceType sampling space
+    \param grid_set_msg grid set message
+    \param sample sample
+    \param out_of_range_value value returned if sample is out of range of grid
+*/
+template<SamplingSpace SamplingSpaceType>
+double getNearestGridValue(const differentiable_rmap::RmapGridSet & grid_set_msg,
+                           const Sample<SamplingSpaceType> & sample,
+                           double out_of_range_value);
+
+/** \brief Invert grid set of reachability map into inverse reachability map.
+    \tparam SamplingSpaceType sampling space
+    \param[out] inv_grid_set_msg grid set message of inverse reachability map
+    \param[in] grid_set_msg grid set message of reachability map
+    \param[in] svm_thre threshold of SVM value to be determined as reachable
+
+    The value of inverse reachability map at sample \f$s\f$ is the value of reachability map at the inverse of \f$s\f$.
+    In other words, if the placement (e.g., base pose) is \f$s\f$ in the frame of the reaching pose (e.g., end-effector
+    pose), the reaching pose is \f$s^{-1}\f$ in the frame of the placement. The grid of inverse reachability map has
+    the same number of divisions as that of reachability map, and its range is the bounding box of the inverses of the
+    reachable grid vertices (the rotational range of SO3 and SE3 is not changed). The values are obtained from the
+    nearest grid vertex of reachability map, so the SVM model is not required.
+*/
+template<SamplingSpace SamplingSpaceType>
+void invertGridSet(differentiable_rmap::RmapGridSet & inv_grid_set_msg,
+                   const differentiable_rmap::RmapGridSet & grid_set_msg,
+                   double svm_thre);
+
+/** \brief Vote placement candidates on inverse reachability map.
+    \tparam SamplingSpaceType sampling space
+    \param inv_grid_set_msg grid set message of inverse reachability map
+    \param target_sample_list list of target samples of reaching
+    \param svm_thre threshold of SVM value to be determined as reachable
+    \param candidate_num max number of candidates
+    \return placement candidates in descending order of number of votes (and score for the same number of votes)
+
+    Each reachable grid vertex of inverse reachability map is transformed to the frame of each target sample, and votes
+    for the cell of the placement space containing it (the cell size is the same as the grid of inverse reachability
+    map). Each target votes at most once for each cell, so the cells voted by all targets are the intersection of the
+    inverse reachability maps of the targets.
+*/
+template<SamplingSpace SamplingSpaceType>
+std::vector<PlacementCandidate<SamplingSpaceType>> votePlacement(
+    const differentiable_rmap::RmapGridSet & inv_grid_set_msg,
+    const std::vector<Sample<SamplingSpaceType>> & target_sample_list,
+    double svm_thre,
+    int candidate_num);
+
+/** \brief Load grid set of reachability map from ROS bag, invert it, and dump inverse reachability map to ROS bag.
+    \param grid_bag_path path of ROS bag file of grid set of reachability map
+    \param inv_grid_bag_path path of ROS bag file of grid set of inverse reachability map
+    \param svm_thre threshold of SVM value to be determined as reachable
+
+    See invertGridSet() for details.
+*/
+void invertGridSetBag(const std::string & grid_bag_path, const std::string & inv_grid_bag_path, double svm_thre);
+} // namespace DiffRmap
+
+// See method 3 in https://www.codeproject.com/Articles/48575/How-to-Define-a-Template-Class-in-a-h-File-and-Imp
+#include <differentiable_rmap/InverseRmapUtils.hpp>
@@ -0,0 +1,239 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+namespace DiffRmap
+{
+template<SamplingSpace SamplingSpaceType>
+Sample<SamplingSpaceType> invertSample(const Sample<SamplingSpaceType> & sample)
+{
+  return poseToSample<SamplingSpaceType>(sampleToPose<SamplingSpaceType>(sample).inv());
+}
+
+template<SamplingSpace SamplingSpaceType>
+double getNearestGridValue(const differentiable_rmap::RmapGridSet & grid_set_msg,
+                           const Sample<SamplingSpaceType> & sample,
+                           double out_of_range_value)
+{
+  constexpr int grid_dim = gridDim<SamplingSpaceType>();
+
+  const GridPos<SamplingSpaceType> & grid_pos = sampleToGridPos<SamplingSpaceType>(sample);
+  GridIdxs<SamplingSpaceType> divide_idxs;
+  for(int i = 0; i < grid_dim; i++)
+  {
+    double range = grid_set_msg.max[i] - grid_set_msg.min[i];
+    double ratio = (range > 0 ? (grid_pos[i] - grid_set_msg.min[i]) / range : 0.0);
+    // Allow half a cell outside the range because the value of the boundary vertex represents the cell around it
+    double half_cell_ratio = 0.5 / std::max(grid_set_msg.divide_nums[i], 1);
+    if(ratio < -half_cell_ratio || ratio > 1 + half_cell_ratio)
+    {
+      return out_of_range_value;
+    }
+    divide_idxs[i] = std::clamp(static_cast<int>(std::round(ratio * grid_set_msg.divide_nums[i])), 0,
+                                grid_set_msg.divide_nums[i]);
+  }
+
+  return grid_set_msg.values[calcGridIdx(divide_idxs, grid_set_msg.divide_nums)];
+}
+
+template<SamplingSpace SamplingSpaceType>
+void invertGridSet(differentiable_rmap::RmapGridSet & inv_grid_set_msg,
+                   const differentiable_rmap::RmapGridSet & grid_set_msg,
+                   double svm_thre)
+{
+  constexpr int grid_dim = gridDim<SamplingSpaceType>();
+  using GridPosType = GridPos<SamplingSpaceType>;
+
+  if(grid_set_msg.type != static_cast<int>(SamplingSpaceType))
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[invertGridSet] SamplingSpace does not match with message: {} != {}", grid_set_msg.type,
+        static_cast<int>(SamplingSpaceType));
+  }
+
+  GridIdxs<SamplingSpaceType> divide_nums;
+  GridPosType grid_pos_min;
+  GridPosType grid_pos_max;
+  for(int i = 0; i < grid_dim; i++)
+  {
+    divide_nums[i] = grid_set_msg.divide_nums[i];
+    grid_pos_min[i] = grid_set_msg.min[i];
+    grid_pos_max[i] = grid_set_msg.max[i];
+  }
+  const GridPosType & grid_pos_range = grid_pos_max - grid_pos_min;
+
+  // Calculate bounding box of inverses of reachable grid vertices
+  GridPosType inv_grid_pos_min = GridPosType::Constant(std::numeric_limits<double>::max());
+  GridPosType inv_grid_pos_max = GridPosType::Constant(std::numeric_limits<double>::lowest());
+  GridIdxs<SamplingSpaceType> divide_idxs;
+  GridPosType divide_ratios;
+  int reachable_num = 0;
+  for(int grid_idx = 0; grid_idx < static_cast<int>(grid_set_msg.values.size()); grid_idx++)
+  {
+    if(grid_set_msg.values[grid_idx] <= svm_thre)
+    {
+      continue;
+    }
+    gridIdxToDivideIdxs(divide_idxs, grid_idx, divide_nums);
+    gridDivideIdxsToRatios(divide_ratios, divide_idxs, divide_nums);
+    const GridPosType & inv_grid_pos = sampleToGridPos<SamplingSpaceType>(invertSample<SamplingSpaceType>(
+        gridPosToSample<SamplingSpaceType>(divide_ratios.cwiseProduct(grid_pos_range) + grid_pos_min)));
+    inv_grid_pos_min = inv_grid_pos_min.cwiseMin(inv_grid_pos);
+    inv_grid_pos_max = inv_grid_pos_max.cwiseMax(inv_grid_pos);
+    reachable_num++;
+  }
+  if(reachable_num == 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[invertGridSet] No grid vertex is reachable (svm_thre: {}).",
+                                                     svm_thre);
+  }
+  if constexpr(SamplingSpaceType == SamplingSpace::SO3)
+  {
+    inv_grid_pos_min = grid_pos_min;
+    inv_grid_pos_max = grid_pos_max;
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+  {
+    inv_grid_pos_min.template tail<3>() = grid_pos_min.template tail<3>();
+    inv_grid_pos_max.template tail<3>() = grid_pos_max.template tail<3>();
+  }
+  const GridPosType & inv_grid_pos_range = inv_grid_pos_max - inv_grid_pos_min;
+
+  // Set inverse grid set message
+  inv_grid_set_msg.type = grid_set_msg.type;
+  inv_grid_set_msg.divide_nums = grid_set_msg.divide_nums;
+  inv_grid_set_msg.min.resize(grid_dim);
+  inv_grid_set_msg.max.resize(grid_dim);
+  for(int i = 0; i < grid_dim; i++)
+  {
+    inv_grid_set_msg.min[i] = inv_grid_pos_min[i];
+    inv_grid_set_msg.max[i] = inv_grid_pos_max[i];
+  }
+  double out_of_range_value = *std::min_element(grid_set_msg.values.begin(), grid_set_msg.values.end());
+  inv_grid_set_msg.values.resize(grid_set_msg.values.size());
+  for(int grid_idx = 0; grid_idx < static_cast<int>(inv_grid_set_msg.values.size()); grid_idx++)
+  {
+    gridIdxToDivideIdxs(divide_idxs, grid_idx, divide_nums);
+    gridDivideIdxsToRatios(divide_ratios, divide_idxs, divide_nums);
+    const Sample<SamplingSpaceType> & inv_sample =
+        gridPosToSample<SamplingSpaceType>(divide_ratios.cwiseProduct(inv_grid_pos_range) + inv_grid_pos_min);
+    inv_grid_set_msg.values[grid_idx] = getNearestGridValue<SamplingSpaceType>(
+        grid_set_msg, invertSample<SamplingSpaceType>(inv_sample), out_of_range_value);
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+std::vector<PlacementCandidate<SamplingSpaceType>> votePlacement(
+    const differentiable_rmap::RmapGridSet & inv_grid_set_msg,
+    const std::vector<Sample<SamplingSpaceType>> & target_sample_list,
+    double svm_thre,
+    int candidate_num)
+{
+  constexpr int grid_dim = gridDim<SamplingSpaceType>();
+  using GridPosType = GridPos<SamplingSpaceType>;
+  using GridIdxsType = GridIdxs<SamplingSpaceType>;
+
+  if(inv_grid_set_msg.type != static_cast<int>(SamplingSpaceType))
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[votePlacement] SamplingSpace does not match with message: {} != {}", inv_grid_set_msg.type,
+        static_cast<int>(SamplingSpaceType));
+  }
+
+  GridIdxsType divide_nums;
+  GridPosType grid_pos_min;
+  GridPosType grid_pos_max;
+  for(int i = 0; i < grid_dim; i++)
+  {
+    divide_nums[i] = inv_grid_set_msg.divide_nums[i];
+    grid_pos_min[i] = inv_grid_set_msg.min[i];
+    grid_pos_max[i] = inv_grid_set_msg.max[i];
+  }
+  const GridPosType & grid_pos_range = grid_pos_max - grid_pos_min;
+  GridPosType cell_size = grid_pos_range.cwiseQuotient(divide_nums.template cast<double>().cwiseMax(1.0));
+  cell_size = (cell_size.array() > 0).select(cell_size, 1.0);
+
+  // Collect reachable grid vertices of inverse reachability map
+  std::vector<std::pair<sva::PTransformd, double>> reachable_list;
+  GridIdxsType divide_idxs;
+  GridPosType divide_ratios;
+  for(int grid_idx = 0; grid_idx < static_cast<int>(inv_grid_set_msg.values.size()); grid_idx++)
+  {
+    double value = inv_grid_set_msg.values[grid_idx];
+    if(value <= svm_thre)
+    {
+      continue;
+    }
+    gridIdxToDivideIdxs(divide_idxs, grid_idx, divide_nums);
+    gridDivideIdxsToRatios(divide_ratios, divide_idxs, divide_nums);
+    reachable_list.emplace_back(sampleToPose<SamplingSpaceType>(gridPosToSample<SamplingSpaceType>(
+                                    divide_ratios.cwiseProduct(grid_pos_range) + grid_pos_min)),
+                                value);
+  }
+
+  // Vote
+  struct Vote
+  {
+    int last_target_idx = -1;
+    int vote_num = 0;
+    double score = 0.0;
+  };
+  struct GridIdxsHash
+  {
+    size_t operator()(const GridIdxsType & idxs) const
+    {
+      size_t hash = 0;
+      for(int i = 0; i < idxs.size(); i++)
+      {
+        hash ^= std::hash<int>()(idxs[i]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      }
+      return hash;
+    }
+  };
+  std::unordered_map<GridIdxsType, Vote, GridIdxsHash> vote_map;
+  for(size_t target_idx = 0; target_idx < target_sample_list.size(); target_idx++)
+  {
+    const sva::PTransformd & target_pose = sampleToPose<SamplingSpaceType>(target_sample_list[target_idx]);
+    for(const auto & reachable : reachable_list)
+    {
+      const GridPosType & placement_grid_pos =
+          sampleToGridPos<SamplingSpaceType>(poseToSample<SamplingSpaceType>(reachable.first * target_pose));
+      const GridIdxsType & cell_idxs =
+          placement_grid_pos.cwiseQuotient(cell_size).array().round().matrix().template cast<int>();
+      Vote & vote = vote_map[cell_idxs];
+      if(vote.last_target_idx == static_cast<int>(target_idx))
+      {
+        continue;
+      }
+      vote.last_target_idx = static_cast<int>(target_idx);
+      vote.vote_num++;
+      vote.score += reachable.second;
+    }
+  }
+
+  // Sort candidates
+  std::vector<PlacementCandidate<SamplingSpaceType>> candidate_list;
+  candidate_list.reserve(vote_map.size());
+  for(const auto & vote_kv : vote_map)
+  {
+    PlacementCandidate<SamplingSpaceType> candidate;
+    candidate.sample =
+        gridPosToSample<SamplingSpaceType>(vote_kv.first.template cast<double>().cwiseProduct(cell_size));
+    candidate.vote_num = vote_kv.second.vote_num;
+    candidate.score = vote_kv.second.score;
+    candidate_list.push_back(candidate);
+  }
+  auto compare = [](const PlacementCandidate<SamplingSpaceType> & candidate1,
+                    const PlacementCandidate<SamplingSpaceType> & candidate2) {
+    return candidate1.vote_num != candidate2.vote_num ? candidate1.vote_num > candidate2.vote_num
+                                                      : candidate1.score > candidate2.score;
+  };
+  size_t result_num = std::min(candidate_list.size(), static_cast<size_t>(std::max(candidate_num, 0)));
+  std::partial_sort(candidate_list.begin(), candidate_list.begin() + result_num, candidate_list.end(), compare);
+  candidate_list.resize(result_num);
+
+  return candidate_list;
+}
+} // namespace DiffRmap
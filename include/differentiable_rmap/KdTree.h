@@ -0,0 +1,88 @@
+/* Author: Masaki Murooka */
+
+/** \file KdTree.h
+    KD-tree for nearest neighbor search.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace DiffRmap
+{
+/** \brief KD-tree which supports incremental insertion and k-nearest neighbor search.
+    \tparam N point dimension
+
+    Points are never removed and the tree is not rebalanced. This is sufficient when points are inserted in random
+    order (e.g., random samples in task space).
+*/
+template<int N>
+class KdTree
+{
+public:
+  /*! \brief Type of point. */
+  using PointType = Eigen::Matrix<double, N, 1>;
+
+protected:
+  /*! \brief Node of tree. */
+  struct Node
+  {
+    //! Index of left child node (-1 for no child)
+    int left = -1;
+
+    //! Index of right child node (-1 for no child)
+    int right = -1;
+
+    //! Dimension to split
+    int split_dim = 0;
+  };
+
+public:
+  /** \brief Insert point.
+      \param point point
+      \return index of inserted point
+  */
+  size_t insert(const PointType & point);
+
+  /** \brief Search k-nearest points.
+      \param point query point
+      \param K number of nearest points
+      \return indices of nearest points in order of distance (the number of elements is less than K if the tree has
+      less than K points)
+  */
+  std::vector<size_t> knnSearch(const PointType & point, size_t K) const;
+
+  /** \brief Get point.
+      \param idx index of point
+  */
+  inline const PointType & point(size_t idx) const
+  {
+    return point_list_[idx];
+  }
+
+  /** \brief Get number of points. */
+  inline size_t size() const
+  {
+    return point_list_.size();
+  }
+
+  /** \brief Remove all points. */
+  inline void clear()
+  {
+    point_list_.clear();
+    node_list_.clear();
+  }
+
+protected:
+  //! Point list
+  std::vector<PointType> point_list_;
+
+  //! Node list (same order as point_list_)
+  std::vector<Node> node_list_;
+};
+} // namespace DiffRmap
+
+// See method 3 in https://www.codeproject.com/Articles/48575/How-to-Define-a-Template-Class-in-a-h-File-and-Imp
+#include <differentiable_rmap/KdTree.hpp>
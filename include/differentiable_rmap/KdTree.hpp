@@ -0,0 +1,97 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+namespace DiffRmap
+{
+template<int N>
+size_t KdTree<N>::insert(const PointType & point)
+{
+  int new_idx = static_cast<int>(point_list_.size());
+  point_list_.push_back(point);
+  node_list_.push_back(Node());
+
+  if(new_idx == 0)
+  {
+    return new_idx;
+  }
+
+  // Descend from root to leaf
+  int idx = 0;
+  while(true)
+  {
+    Node & node = node_list_[idx];
+    int & child_idx = point[node.split_dim] < point_list_[idx][node.split_dim] ? node.left : node.right;
+    if(child_idx == -1)
+    {
+      child_idx = new_idx;
+      node_list_[new_idx].split_dim = (node.split_dim + 1) % point.size();
+      break;
+    }
+    idx = child_idx;
+  }
+
+  return new_idx;
+}
+
+template<int N>
+std::vector<size_t> KdTree<N>::knnSearch(const PointType & point, size_t K) const
+{
+  if(K == 0 || point_list_.empty())
+  {
+    return std::vector<size_t>{};
+  }
+
+  // Max-heap of squared distance and index of top-K nearest points
+  std::priority_queue<std::pair<double, size_t>> nearest_heap;
+
+  // Stack of node index and squared distance from query point to splitting plane of ancestor
+  std::vector<std::pair<int, double>> node_stack = {{0, 0.0}};
+  while(!node_stack.empty())
+  {
+    int idx = node_stack.back().first;
+    double plane_dist = node_stack.back().second;
+    node_stack.pop_back();
+
+    if(nearest_heap.size() == K && plane_dist >= nearest_heap.top().first)
+    {
+      continue;
+    }
+
+    double dist = (point_list_[idx] - point).squaredNorm();
+    if(nearest_heap.size() < K)
+    {
+      nearest_heap.emplace(dist, idx);
+    }
+    else if(dist < nearest_heap.top().first)
+    {
+      nearest_heap.pop();
+      nearest_heap.emplace(dist, idx);
+    }
+
+    // Push far side first so that near side is searched first
+    const Node & node = node_list_[idx];
+    double diff = point[node.split_dim] - point_list_[idx][node.split_dim];
+    int near_idx = diff < 0 ? node.left : node.right;
+    int far_idx = diff < 0 ? node.right : node.left;
+    if(far_idx != -1)
+    {
+      node_stack.emplace_back(far_idx, std::max(plane_dist, diff * diff));
+    }
+    if(near_idx != -1)
+    {
+      node_stack.emplace_back(near_idx, plane_dist);
+    }
+  }
+
+  std::vector<size_t> idx_list(nearest_heap.size());
+  for(size_t i = idx_list.size(); i > 0; i--)
+  {
+    idx_list[i - 1] = nearest_heap.top().second;
+    nearest_heap.pop();
+  }
+  return idx_list;
+}
+} // namespace DiffRmap
@@ -0,0 +1,137 @@
+/* Author: Masaki Murooka */
+
+/** \file KinematicChain.h
+    Kinematic chain to calculate body pose only from positions of joints of interest.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <RBDyn/MultiBody.h>
+#include <RBDyn/MultiBodyConfig.h>
+
+namespace DiffRmap
+{
+/*! \brief Type of batch of joint positions in structure-of-arrays layout.
+
+    Each row corresponds to one joint and each column corresponds to one configuration.
+*/
+using JointPosBatch = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+/*! \brief Type of batch of rotation matrices in structure-of-arrays layout.
+
+    Each column stores the elements of one rotation matrix in row-major order.
+*/
+using RotBatch = Eigen::Matrix<double, 9, Eigen::Dynamic, Eigen::RowMajor>;
+
+/*! \brief Type of batch of translations in structure-of-arrays layout. */
+using TransBatch = Eigen::Matrix<double, 3, Eigen::Dynamic, Eigen::RowMajor>;
+
+/** \brief Kinematic chain from root to body over the joints of interest.
+
+    Joints on the path from root to body which are not joints of interest (e.g., fixed joints) are evaluated once in
+    constructor and folded into the constant transforms between the joints of interest. Therefore, the cost of forward
+    kinematics depends only on the number of joints of interest on the path, not on the number of joints of the robot.
+*/
+class KinematicChain
+{
+public:
+  /** \brief Constructor.
+      \param mb multi-body
+      \param mbc multi-body configuration (positions of joints other than joints of interest are taken from this)
+      \param body_name name of body
+      \param joint_name_list list of names of joints of interest
+      \param tip_offset offset of tip pose from body pose
+
+      Joints of interest which are not on the path from root to body are ignored since they do not affect body pose.
+      Joints of interest on the path must be revolute or prismatic.
+  */
+  KinematicChain(const rbd::MultiBody & mb,
+                 const rbd::MultiBodyConfig & mbc,
+                 const std::string & body_name,
+                 const std::vector<std::string> & joint_name_list,
+                 const sva::PTransformd & tip_offset = sva::PTransformd::Identity());
+
+  /** \brief Calculate tip pose.
+      \param joint_pos positions of joints of interest (same order as joint_name_list)
+      \return tip pose (i.e., tip_offset * mbc.bodyPosW[body])
+  */
+  sva::PTransformd calcPose(const Eigen::VectorXd & joint_pos) const;
+
+  /** \brief Calculate batch of tip poses.
+      \param[out] rot_batch batch of rotation matrices (resized to the number of configurations)
+      \param[out] trans_batch batch of translations (resized to the number of configurations)
+      \param[in] joint_pos_batch batch of positions of joints of interest (same row order as joint_name_list)
+
+      Transforms are multiplied element-wise over configurations so that the calculation is vectorized by Eigen.
+  */
+  void calcPoseBatch(RotBatch & rot_batch, TransBatch & trans_batch, const JointPosBatch & joint_pos_batch) const;
+
+  /** \brief Calculate batch of tip poses.
+      \param[out] pose_list list of tip poses (resized to the number of configurations)
+      \param[in] joint_pos_batch batch of positions of joints of interest (same row order as joint_name_list)
+  */
+  void calcPoseBatch(std::vector<sva::PTransformd> & pose_list, const JointPosBatch & joint_pos_batch) const;
+
+  /** \brief Get number of joints of interest on the path from root to body. */
+  inline int chainJointNum() const
+  {
+    return static_cast<int>(segment_list_.size());
+  }
+
+protected:
+  /** \brief Segment of chain, which consists of constant transform followed by one joint of interest.
+
+      The transform of segment from the previous segment is expressed as follows:
+        - rotation: rot_const + rot_sin * sin(q) + rot_cos * cos(q)
+        - translation: trans_const + trans_lin * q
+      where rot_sin and rot_cos are zero for prismatic joint and trans_lin is zero for revolute joint.
+  */
+  struct Segment
+  {
+    //! Index of joint in joint_name_list
+    int joint_idx;
+
+    //! Whether joint is revolute (otherwise prismatic)
+    bool is_revolute;
+
+    //! Coefficients of rotation
+    Eigen::Matrix3d rot_const;
+    Eigen::Matrix3d rot_sin;
+    Eigen::Matrix3d rot_cos;
+
+    //! Coefficients of translation
+    Eigen::Vector3d trans_const;
+    Eigen::Vector3d trans_lin;
+  };
+
+protected:
+  /** \brief Calculate transform of segment. */
+  sva::PTransformd calcSegmentTransform(const Segment & segment, double joint_pos) const;
+
+  /** \brief Calculate batch of transforms of segment.
+      \param[out] rot_batch batch of rotation matrices
+      \param[out] trans_batch batch of translations
+      \param[in] segment segment
+      \param[in] joint_pos_batch batch of positions of joint of segment
+  */
+  void calcSegmentTransformBatch(RotBatch & rot_batch,
+                                 TransBatch & trans_batch,
+                                 const Segment & segment,
+                                 const Eigen::Ref<const Eigen::RowVectorXd> & joint_pos_batch) const;
+
+protected:
+  //! Number of joints of interest
+  int joint_num_ = 0;
+
+  //! List of segments from root to body
+  std::vector<Segment> segment_list_;
+
+  //! Constant transform from the last segment to tip
+  sva::PTransformd tip_transform_ = sva::PTransformd::Identity();
+};
+} // namespace DiffRmap
@@ -0,0 +1,85 @@
+/* Author: Masaki Murooka */
+
+/** \file MallocUtils.h
+    Utilities to check heap allocation.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <mc_rtc/logging.h>
+
+namespace DiffRmap
+{
+#ifdef ENABLE_NO_MALLOC_CHECK
+namespace detail
+{
+/** \brief Whether heap allocation is forbidden in the current thread (defined in MallocHook.cpp).
+
+    The initial-exec TLS model is used so that accessing this from the malloc hook does not allocate.
+*/
+extern __thread bool malloc_forbidden __attribute__((tls_model("initial-exec")));
+} // namespace detail
+#endif
+
+/** \brief Scoped setter of whether heap allocation is allowed in the current thread.
+
+    This is effective only if ENABLE_NO_MALLOC_CHECK CMake option is ON. Otherwise, this does nothing. With the option,
+    malloc and its variants are hooked in MallocHook.cpp, and the process is aborted if heap allocation is done in the
+    scope where it is forbidden. Since the flag is thread-local, the check can be enabled in multiple planning threads
+    at the same time. The hook forwards to the allocator of glibc, so the option is supported only on glibc.
+*/
+class ScopedMallocAllowed
+{
+public:
+  /** \brief Constructor.
+      \param allowed whether heap allocation is allowed in the scope
+  */
+  explicit ScopedMallocAllowed(bool allowed)
+  {
+#ifdef ENABLE_NO_MALLOC_CHECK
+    prev_allowed_ = !detail::malloc_forbidden;
+    detail::malloc_forbidden = !allowed;
+#else
+    (void)allowed;
+#endif
+  }
+
+  /** \brief Destructor. */
+  ~ScopedMallocAllowed()
+  {
+#ifdef ENABLE_NO_MALLOC_CHECK
+    detail::malloc_forbidden = !prev_allowed_;
+#endif
+  }
+
+  ScopedMallocAllowed(const ScopedMallocAllowed &) = delete;
+  ScopedMallocAllowed & operator=(const ScopedMallocAllowed &) = delete;
+
+protected:
+  //! Whether heap allocation is allowed before the scope
+  bool prev_allowed_ = true;
+};
+
+/** \brief Warn that the general QP solver (JRLQP) allocates on the heap in runOnce().
+    \param planner_name name of planner shown in the warning
+    \param realtime whether the real-time execution mode is enabled
+
+    The heap allocation in JRLQP is excluded from the check with ScopedMallocAllowed, since the solver cannot avoid it.
+    Instead of hiding it, a warning is shown if the check is enabled or the real-time execution mode is enabled.
+*/
+inline void warnQpSolverMalloc(const std::string & planner_name, bool realtime)
+{
+#ifdef ENABLE_NO_MALLOC_CHECK
+  bool check_enabled = true;
+#else
+  bool check_enabled = false;
+#endif
+  if(check_enabled || realtime)
+  {
+    mc_rtc::log::warning("[{}] JRLQP QP solver allocates on the heap in runOnce(), so the loop is not allocation-free.",
+                         planner_name);
+  }
+}
+} // namespace DiffRmap
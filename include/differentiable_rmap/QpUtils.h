@@ -0,0 +1,235 @@
+/* Author: Masaki Murooka */
+
+/** \file QpUtils.h
+    Utilities for QP with special structure.
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+
+namespace DiffRmap
+{
+/** \brief Solve QP with diagonal objective, box bounds, and single linear inequality.
+    \tparam N dimension of variable
+    \param obj_diag diagonal elements of objective matrix (must be positive)
+    \param obj_vec objective vector
+    \param ineq_row coefficient row of inequality
+    \param ineq_val right-hand side of inequality
+    \param x_min lower bound of variable
+    \param x_max upper bound of variable
+    \return solution
+
+    The problem is
+    \f{align*}{
+    & \min_{x} \frac{1}{2} x^T \mathrm{diag}(h) x + c^T x \\
+    & \mathrm{s.t.} \quad a^T x \leq b, \ x_{min} \leq x \leq x_{max}
+    \f}
+    which has the same form as the QP in RmapPlanning::runOnce(). For the multiplier \f$\mu \geq 0\f$ of the
+    inequality, the solution is \f$x(\mu) = \mathrm{clamp}(-(c + \mu a) / h, x_{min}, x_{max})\f$ and
+    \f$a^T x(\mu)\f$ is piecewise linear and non-increasing in \f$\mu\f$. Therefore the optimal multiplier is obtained
+    exactly by scanning the (at most 2N) breakpoints where the elements reach the bounds. If the inequality cannot be
+    satisfied in the box, the point in the box that minimizes \f$a^T x\f$ (and then the objective) is returned.
+*/
+template<int N>
+Eigen::Matrix<double, N, 1> solveBoxHalfspaceQp(const Eigen::Matrix<double, N, 1> & obj_diag,
+                                                const Eigen::Matrix<double, N, 1> & obj_vec,
+                                                const Eigen::Matrix<double, N, 1> & ineq_row,
+                                                double ineq_val,
+                                                const Eigen::Matrix<double, N, 1> & x_min,
+                                                const Eigen::Matrix<double, N, 1> & x_max);
+
+/** \brief Solver of QP with block-arrow structure.
+    \tparam CoupledDim dimension of variables coupled with all blocks
+    \tparam BlockDim dimension of variables of each block
+
+    The problem is
+    \f{align*}{
+    & \min_{x, e} \frac{1}{2} x^T \mathrm{diag}(h) x + c^T x + \frac{w}{2} \sum_i e_i^2 \\
+    & \mathrm{s.t.} \quad a_i^T p + b_i^T r_i - e_i \leq d_i, \ x_{min} \leq x \leq x_{max}
+    \f}
+    where \f$x = [p^T, r_1^T, \cdots, r_N^T]^T\f$ is the concatenation of the coupled variables and the variables of
+    each block. This has the same form as the QP in RmapPlanningPlacement::runOnce() (\f$p\f$ is placement, \f$r_i\f$
+    is reaching, and \f$e_i\f$ is the error of reachability inequality). The problem is solved by the primal-dual
+    interior point method with Mehrotra's predictor-corrector. Since each inequality couples only the coupled variables
+    and the variables of one block, the Newton system is reduced by the Schur complement onto the coupled variables
+    (the system of each block is diagonal plus rank one, which is inverted by the Sherman-Morrison formula). Therefore
+    the computational cost of each iteration is proportional to the number of blocks.
+*/
+template<int CoupledDim, int BlockDim>
+class ArrowQpSolver
+{
+  static_assert(CoupledDim > 0 && BlockDim > 0, "Dimensions of ArrowQpSolver must be fixed.");
+
+public:
+  /*! \brief Type of vector of coupled variables. */
+  using CoupledVecType = Eigen::Matrix<double, CoupledDim, 1>;
+
+  /*! \brief Type of matrix of coupled variables. */
+  using CoupledMatType = Eigen::Matrix<double, CoupledDim, CoupledDim>;
+
+  /*! \brief Type of vector of block variables. */
+  using BlockVecType = Eigen::Matrix<double, BlockDim, 1>;
+
+public:
+  /** \brief Setup coefficients and workspace.
+      \param block_num number of blocks
+  */
+  void setup(int block_num);
+
+  /** \brief Solve QP.
+      \return whether the solution converged (i.e., interior point method converged or solution is polished)
+  */
+  bool solve();
+
+  /** \brief Get number of blocks. */
+  inline int blockNum() const
+  {
+    return static_cast<int>(ineq_vec_.size());
+  }
+
+  /** \brief Get dimension of variables (except for inequality errors). */
+  inline int varDim() const
+  {
+    return CoupledDim + blockNum() * BlockDim;
+  }
+
+protected:
+  /** \brief Calculate inequality values (i.e., \f$a_i^T p + b_i^T r_i - d_i\f$).
+      \param x variables
+      \param ineq_val inequality values (output)
+  */
+  void calcIneqValue(const Eigen::VectorXd & x, Eigen::VectorXd & ineq_val) const;
+
+  /** \brief Factorize reduced system \f$(\mathrm{diag}(D) + G^T \mathrm{diag}(\Theta) G) \Delta x = f\f$.
+
+      \f$D\f$ and \f$\Theta\f$ are given by hess_diag_ and ineq_scale_ respectively, and \f$G\f$ is the matrix of
+      inequality coefficients.
+  */
+  void factorizeReducedSystem();
+
+  /** \brief Solve factorized reduced system with the right-hand side rhs_x_ and store the result in dx_. */
+  void solveReducedSystem();
+
+  /** \brief Calculate Newton direction of interior point method.
+      \param comp_tz right-hand side of complementarity of lower bounds
+      \param comp_qv right-hand side of complementarity of upper bounds
+      \param comp_wy right-hand side of complementarity of inequalities
+
+      The result is stored in dx_, de_, dy_, dz_, dv_, and dw_.
+  */
+  void calcNewtonDirection(const Eigen::VectorXd & comp_tz,
+                           const Eigen::VectorXd & comp_qv,
+                           const Eigen::VectorXd & comp_wy);
+
+  /** \brief Calculate step size keeping positivity of slack and dual variables.
+      \param boundary_ratio ratio of step size to the max step size reaching the boundary of positivity
+      \return step size (not greater than 1)
+  */
+  double calcStepSize(double boundary_ratio) const;
+
+  /** \brief Polish solution of interior point method.
+      \return whether polished solution is accepted
+
+      The active set is initialized from the solution of interior point method, and the QP with the active bounds and
+      inequalities fixed is solved exactly. The active set is updated where the KKT conditions are violated, and the
+      polished solution is accepted only if the KKT conditions are satisfied within polish_iter_num_ updates.
+  */
+  bool polishSolution();
+
+public:
+  //! Diagonal elements of objective matrix (must be positive)
+  Eigen::VectorXd obj_diag_;
+
+  //! Objective vector
+  Eigen::VectorXd obj_vec_;
+
+  //! Inequality coefficients of coupled variables (each column corresponds to block)
+  Eigen::Matrix<double, CoupledDim, Eigen::Dynamic> coupled_ineq_mat_;
+
+  //! Inequality coefficients of block variables (each column corresponds to block)
+  Eigen::Matrix<double, BlockDim, Eigen::Dynamic> block_ineq_mat_;
+
+  //! Right-hand side of inequalities
+  Eigen::VectorXd ineq_vec_;
+
+  //! Objective weight of inequality errors
+  double ineq_weight_ = 1e6;
+
+  //! Lower/upper bound of variables (must be strictly feasible, i.e., x_min_ < x_max_)
+  Eigen::VectorXd x_min_;
+  Eigen::VectorXd x_max_;
+
+  //! Maximum number of iterations
+  int max_iter_num_ = 50;
+
+  //! Threshold of residuals and complementarity of interior point method to be determined as converged
+  double convergence_thre_ = 1e-12;
+
+  //! Maximum number of active set updates in polishing solution of interior point method (zero for no polishing)
+  int polish_iter_num_ = 10;
+
+  //! Solution of variables
+  Eigen::VectorXd x_;
+
+  //! Solution of inequality errors
+  Eigen::VectorXd ineq_error_;
+
+  //! Number of iterations in last solve
+  int iter_num_ = 0;
+
+  //! Whether the solution is polished in last solve
+  bool polished_ = false;
+
+protected:
+  //! Dual variables of lower bounds, upper bounds, and inequalities
+  Eigen::VectorXd z_;
+  Eigen::VectorXd v_;
+  Eigen::VectorXd y_;
+
+  //! Slack variables of lower bounds, upper bounds, and inequalities
+  Eigen::VectorXd t_;
+  Eigen::VectorXd q_;
+  Eigen::VectorXd w_;
+
+  //! Residuals of dual feasibility (w.r.t. variables and inequality errors) and primal feasibility
+  Eigen::VectorXd res_x_;
+  Eigen::VectorXd res_e_;
+  Eigen::VectorXd res_g_;
+
+  //! Diagonal elements of reduced Hessian and its inverse
+  Eigen::VectorXd hess_diag_;
+  Eigen::VectorXd hess_diag_inv_;
+
+  //! Weight of inequalities in reduced Hessian
+  Eigen::VectorXd ineq_scale_;
+
+  //! Weight of coupled terms in Schur complement
+  Eigen::VectorXd schur_scale_;
+
+  //! LDLT decomposition of Schur complement
+  Eigen::LDLT<CoupledMatType> schur_ldlt_;
+
+  //! Newton direction
+  Eigen::VectorXd dx_;
+  Eigen::VectorXd de_;
+  Eigen::VectorXd dy_;
+  Eigen::VectorXd dz_;
+  Eigen::VectorXd dv_;
+  Eigen::VectorXd dw_;
+
+  //! Workspace
+  Eigen::VectorXi bound_state_;
+  Eigen::VectorXd x_polished_;
+  Eigen::VectorXd ineq_val_;
+  Eigen::VectorXd rhs_x_;
+  Eigen::VectorXd rhs_g_;
+  Eigen::VectorXd ineq_work_;
+  Eigen::VectorXd comp_tz_;
+  Eigen::VectorXd comp_qv_;
+  Eigen::VectorXd comp_wy_;
+};
+} // namespace DiffRmap
+
+// See method 3 in https://www.codeproject.com/Articles/48575/How-to-Define-a-Template-Class-in-a-h-File-and-Imp
+#include <differentiable_rmap/QpUtils.hpp>
@@ -0,0 +1,406 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <cmath>
+
+namespace DiffRmap
+{
+template<int N>
+Eigen::Matrix<double, N, 1> solveBoxHalfspaceQp(const Eigen::Matrix<double, N, 1> & obj_diag,
+                                                const Eigen::Matrix<double, N, 1> & obj_vec,
+                                                const Eigen::Matrix<double, N, 1> & ineq_row,
+                                                double ineq_val,
+                                                const Eigen::Matrix<double, N, 1> & x_min,
+                                                const Eigen::Matrix<double, N, 1> & x_max)
+{
+  using VecType = Eigen::Matrix<double, N, 1>;
+
+  // Solution for the given multiplier of inequality
+  auto calcSolution = [&](double mu) -> VecType {
+    return (-(obj_vec + mu * ineq_row).array() / obj_diag.array()).max(x_min.array()).min(x_max.array()).matrix();
+  };
+
+  // Return unconstrained solution if inequality is inactive
+  VecType x = calcSolution(0.0);
+  double ineq_pre = ineq_row.dot(x);
+  if(ineq_pre <= ineq_val)
+  {
+    return x;
+  }
+
+  // Calculate multipliers at which elements reach bounds
+  int dim = static_cast<int>(obj_vec.size());
+  Eigen::Matrix<double, N == Eigen::Dynamic ? Eigen::Dynamic : 2 * N, 1> mu_list(2 * dim);
+  int mu_num = 0;
+  for(int i = 0; i < dim; i++)
+  {
+    if(ineq_row[i] == 0)
+    {
+      continue;
+    }
+    for(double bound : {x_min[i], x_max[i]})
+    {
+      double mu = -(obj_diag[i] * bound + obj_vec[i]) / ineq_row[i];
+      if(mu > 0)
+      {
+        mu_list[mu_num++] = mu;
+      }
+    }
+  }
+  std::sort(mu_list.data(), mu_list.data() + mu_num);
+
+  // Find the segment where inequality becomes active and interpolate linearly within it
+  double mu_pre = 0.0;
+  for(int k = 0; k < mu_num; k++)
+  {
+    double mu = mu_list[k];
+    if(mu == mu_pre)
+    {
+      continue;
+    }
+    x = calcSolution(mu);
+    double ineq = ineq_row.dot(x);
+    if(ineq <= ineq_val)
+    {
+      return calcSolution(mu_pre + (ineq_pre - ineq_val) / (ineq_pre - ineq) * (mu - mu_pre));
+    }
+    mu_pre = mu;
+    ineq_pre = ineq;
+  }
+
+  // Inequality is infeasible in the box
+  return x;
+}
+
+
+template<int CoupledDim, int BlockDim>
+void ArrowQpSolver<CoupledDim, BlockDim>::setup(int block_num)
+{
+  int var_dim = CoupledDim + block_num * BlockDim;
+
+  obj_diag_.setOnes(var_dim);
+  obj_vec_.setZero(var_dim);
+  coupled_ineq_mat_.setZero(CoupledDim, block_num);
+  block_ineq_mat_.setZero(BlockDim, block_num);
+  ineq_vec_.setZero(block_num);
+  x_min_.setConstant(var_dim, -1e10);
+  x_max_.setConstant(var_dim, 1e10);
+
+  x_.setZero(var_dim);
+  ineq_error_.setZero(block_num);
+
+  bound_state_.resize(var_dim);
+  for(Eigen::VectorXd * vec : {&z_, &v_, &t_, &q_, &res_x_, &hess_diag_, &hess_diag_inv_, &dx_, &dz_, &dv_,
+                               &x_polished_, &rhs_x_, &comp_tz_, &comp_qv_})
+  {
+    vec->resize(var_dim);
+  }
+  for(Eigen::VectorXd * vec : {&y_, &w_, &res_e_, &res_g_, &ineq_scale_, &schur_scale_, &de_, &dy_, &dw_, &ineq_val_,
+                               &rhs_g_, &ineq_work_, &comp_wy_})
+  {
+    vec->resize(block_num);
+  }
+}
+
+template<int CoupledDim, int BlockDim>
+bool ArrowQpSolver<CoupledDim, BlockDim>::solve()
+{
+  int block_num = blockNum();
+  int comp_num = 2 * varDim() + block_num;
+  polished_ = false;
+
+  // Initialize variables in the interior of bounds
+  x_ = (-obj_vec_.array() / obj_diag_.array())
+           .max(0.9 * x_min_.array() + 0.1 * x_max_.array())
+           .min(0.1 * x_min_.array() + 0.9 * x_max_.array())
+           .matrix();
+  ineq_error_.setZero();
+  t_ = x_ - x_min_;
+  q_ = x_max_ - x_;
+  w_.setOnes();
+  z_.setOnes();
+  v_.setOnes();
+  y_.setOnes();
+
+  for(iter_num_ = 0; iter_num_ < max_iter_num_; iter_num_++)
+  {
+    // Calculate residuals
+    res_x_ = obj_diag_.cwiseProduct(x_) + obj_vec_ - z_ + v_;
+    res_x_.template head<CoupledDim>().noalias() += coupled_ineq_mat_ * y_;
+    for(int i = 0; i < block_num; i++)
+    {
+      res_x_.template segment<BlockDim>(CoupledDim + i * BlockDim) += y_[i] * block_ineq_mat_.col(i);
+    }
+    res_e_ = ineq_weight_ * ineq_error_ - y_;
+    calcIneqValue(x_, res_g_);
+    res_g_ += w_ - ineq_error_;
+    double mu = (t_.dot(z_) + q_.dot(v_) + w_.dot(y_)) / comp_num;
+
+    // Check convergence
+    double res_norm = res_x_.template lpNorm<Eigen::Infinity>();
+    if(block_num > 0)
+    {
+      res_norm = std::max({res_norm, res_e_.template lpNorm<Eigen::Infinity>() / ineq_weight_,
+                           res_g_.template lpNorm<Eigen::Infinity>()});
+    }
+    if(mu <= convergence_thre_ && res_norm <= convergence_thre_)
+    {
+      if(polish_iter_num_ > 0)
+      {
+        polished_ = polishSolution();
+      }
+      return true;
+    }
+
+    // Factorize reduced Newton system
+    hess_diag_ = obj_diag_ + (z_.array() / t_.array() + v_.array() / q_.array()).matrix();
+    ineq_scale_ = (1.0 / ineq_weight_ + w_.array() / y_.array()).inverse().matrix();
+    factorizeReducedSystem();
+
+    // Calculate affine scaling direction (predictor)
+    comp_tz_ = -1 * t_.cwiseProduct(z_);
+    comp_qv_ = -1 * q_.cwiseProduct(v_);
+    comp_wy_ = -1 * w_.cwiseProduct(y_);
+    calcNewtonDirection(comp_tz_, comp_qv_, comp_wy_);
+    double affine_step_size = calcStepSize(1.0);
+    double affine_mu = ((t_ + affine_step_size * dx_).dot(z_ + affine_step_size * dz_)
+                        + (q_ - affine_step_size * dx_).dot(v_ + affine_step_size * dv_)
+                        + (w_ + affine_step_size * dw_).dot(y_ + affine_step_size * dy_))
+                       / comp_num;
+
+    // Calculate centering and second-order correction direction (corrector)
+    double sigma_mu = std::pow(affine_mu / mu, 3) * mu;
+    comp_tz_ = (sigma_mu - t_.array() * z_.array() - dx_.array() * dz_.array()).matrix();
+    comp_qv_ = (sigma_mu - q_.array() * v_.array() + dx_.array() * dv_.array()).matrix();
+    comp_wy_ = (sigma_mu - w_.array() * y_.array() - dw_.array() * dy_.array()).matrix();
+    calcNewtonDirection(comp_tz_, comp_qv_, comp_wy_);
+
+    // Update variables
+    double step_size = calcStepSize(0.995);
+    x_ += step_size * dx_;
+    ineq_error_ += step_size * de_;
+    t_ += step_size * dx_;
+    q_ -= step_size * dx_;
+    w_ += step_size * dw_;
+    z_ += step_size * dz_;
+    v_ += step_size * dv_;
+    y_ += step_size * dy_;
+  }
+
+  // Solution may be polished even if interior point method does not converge due to numerical precision
+  if(polish_iter_num_ > 0)
+  {
+    polished_ = polishSolution();
+  }
+  return polished_;
+}
+
+template<int CoupledDim, int BlockDim>
+void ArrowQpSolver<CoupledDim, BlockDim>::calcIneqValue(const Eigen::VectorXd & x, Eigen::VectorXd & ineq_val) const
+{
+  ineq_val = -1 * ineq_vec_;
+  ineq_val.noalias() += coupled_ineq_mat_.transpose() * x.template head<CoupledDim>();
+  for(int i = 0; i < blockNum(); i++)
+  {
+    ineq_val[i] += block_ineq_mat_.col(i).dot(x.template segment<BlockDim>(CoupledDim + i * BlockDim));
+  }
+}
+
+template<int CoupledDim, int BlockDim>
+void ArrowQpSolver<CoupledDim, BlockDim>::factorizeReducedSystem()
+{
+  // The system of each block is diagonal plus rank one, which is eliminated by the Sherman-Morrison formula
+  hess_diag_inv_ = hess_diag_.cwiseInverse();
+  CoupledMatType schur_mat = hess_diag_.template head<CoupledDim>().asDiagonal();
+  for(int i = 0; i < blockNum(); i++)
+  {
+    int row_idx = CoupledDim + i * BlockDim;
+    double block_quad = block_ineq_mat_.col(i).dot(
+        hess_diag_inv_.template segment<BlockDim>(row_idx).cwiseProduct(block_ineq_mat_.col(i)));
+    schur_scale_[i] = ineq_scale_[i] / (1.0 + ineq_scale_[i] * block_quad);
+    schur_mat.noalias() += schur_scale_[i] * coupled_ineq_mat_.col(i) * coupled_ineq_mat_.col(i).transpose();
+  }
+  schur_ldlt_.compute(schur_mat);
+}
+
+template<int CoupledDim, int BlockDim>
+void ArrowQpSolver<CoupledDim, BlockDim>::solveReducedSystem()
+{
+  int block_num = blockNum();
+
+  // Solve for coupled variables with Schur complement
+  CoupledVecType schur_vec = rhs_x_.template head<CoupledDim>();
+  for(int i = 0; i < block_num; i++)
+  {
+    int row_idx = CoupledDim + i * BlockDim;
+    schur_vec -= schur_scale_[i]
+                 * block_ineq_mat_.col(i).dot(hess_diag_inv_.template segment<BlockDim>(row_idx).cwiseProduct(
+                     rhs_x_.template segment<BlockDim>(row_idx)))
+                 * coupled_ineq_mat_.col(i);
+  }
+  dx_.template head<CoupledDim>() = schur_ldlt_.solve(schur_vec);
+
+  // Solve for block variables
+  for(int i = 0; i < block_num; i++)
+  {
+    int row_idx = CoupledDim + i * BlockDim;
+    const BlockVecType & scaled_rhs = hess_diag_inv_.template segment<BlockDim>(row_idx).cwiseProduct(
+        rhs_x_.template segment<BlockDim>(row_idx)
+        - ineq_scale_[i] * coupled_ineq_mat_.col(i).dot(dx_.template head<CoupledDim>()) * block_ineq_mat_.col(i));
+    dx_.template segment<BlockDim>(row_idx) =
+        scaled_rhs
+        - schur_scale_[i] * block_ineq_mat_.col(i).dot(scaled_rhs)
+              * hess_diag_inv_.template segment<BlockDim>(row_idx).cwiseProduct(block_ineq_mat_.col(i));
+  }
+}
+
+template<int CoupledDim, int BlockDim>
+void ArrowQpSolver<CoupledDim, BlockDim>::calcNewtonDirection(const Eigen::VectorXd & comp_tz,
+                                                              const Eigen::VectorXd & comp_qv,
+                                                              const Eigen::VectorXd & comp_wy)
+{
+  int block_num = blockNum();
+
+  // Solve reduced system for variables
+  rhs_x_ = -1 * res_x_ + (comp_tz.array() / t_.array() - comp_qv.array() / q_.array()).matrix();
+  rhs_g_ = res_g_ + (comp_wy.array() / y_.array()).matrix() + res_e_ / ineq_weight_;
+  ineq_work_ = ineq_scale_.cwiseProduct(rhs_g_);
+  rhs_x_.template head<CoupledDim>().noalias() -= coupled_ineq_mat_ * ineq_work_;
+  for(int i = 0; i < block_num; i++)
+  {
+    rhs_x_.template segment<BlockDim>(CoupledDim + i * BlockDim) -=
+        ineq_scale_[i] * rhs_g_[i] * block_ineq_mat_.col(i);
+  }
+  solveReducedSystem();
+
+  // Recover other directions
+  dy_ = rhs_g_;
+  dy_.noalias() += coupled_ineq_mat_.transpose() * dx_.template head<CoupledDim>();
+  for(int i = 0; i < block_num; i++)
+  {
+    dy_[i] += block_ineq_mat_.col(i).dot(dx_.template segment<BlockDim>(CoupledDim + i * BlockDim));
+  }
+  dy_ = ineq_scale_.cwiseProduct(dy_);
+  de_ = (dy_ - res_e_) / ineq_weight_;
+  dw_ = ((comp_wy - w_.cwiseProduct(dy_)).array() / y_.array()).matrix();
+  dz_ = ((comp_tz - z_.cwiseProduct(dx_)).array() / t_.array()).matrix();
+  dv_ = ((comp_qv + v_.cwiseProduct(dx_)).array() / q_.array()).matrix();
+}
+
+template<int CoupledDim, int BlockDim>
+double ArrowQpSolver<CoupledDim, BlockDim>::calcStepSize(double boundary_ratio) const
+{
+  double step_size = 1.0;
+  auto updateStepSize = [&](const Eigen::VectorXd & val, const Eigen::VectorXd & dval, double sign) {
+    for(int i = 0; i < val.size(); i++)
+    {
+      if(sign * dval[i] < 0)
+      {
+        step_size = std::min(step_size, -boundary_ratio * val[i] / (sign * dval[i]));
+      }
+    }
+  };
+  updateStepSize(t_, dx_, 1.0);
+  updateStepSize(q_, dx_, -1.0);
+  updateStepSize(w_, dw_, 1.0);
+  updateStepSize(z_, dz_, 1.0);
+  updateStepSize(v_, dv_, 1.0);
+  updateStepSize(y_, dy_, 1.0);
+  return step_size;
+}
+
+template<int CoupledDim, int BlockDim>
+bool ArrowQpSolver<CoupledDim, BlockDim>::polishSolution()
+{
+  int var_dim = varDim();
+  int block_num = blockNum();
+
+  // Fixed variables are given a large Hessian so that they are eliminated from the reduced system
+  constexpr double fixed_hess = 1e20;
+  constexpr double x_thre = 1e-12;
+  constexpr double ineq_thre = 1e-12;
+  constexpr double grad_thre = 1e-8;
+
+  // Estimate active set from the ratio of slack and dual variables
+  for(int j = 0; j < var_dim; j++)
+  {
+    bound_state_[j] = t_[j] < z_[j] ? -1 : (q_[j] < v_[j] ? 1 : 0);
+  }
+  ineq_scale_ = (y_.array() > w_.array()).select(ineq_weight_, Eigen::VectorXd::Zero(block_num));
+
+  // Update active set until KKT conditions are satisfied (primal-dual active set method)
+  for(int k = 0; k < polish_iter_num_; k++)
+  {
+    // Solve QP with the active set by one Newton step, which is exact for quadratic function
+    for(int j = 0; j < var_dim; j++)
+    {
+      x_polished_[j] = bound_state_[j] == 0 ? x_[j] : (bound_state_[j] < 0 ? x_min_[j] : x_max_[j]);
+      hess_diag_[j] = bound_state_[j] == 0 ? obj_diag_[j] : fixed_hess;
+    }
+    calcIneqValue(x_polished_, ineq_val_);
+    rhs_x_ = -1 * (obj_diag_.cwiseProduct(x_polished_) + obj_vec_);
+    ineq_work_ = ineq_scale_.cwiseProduct(ineq_val_);
+    rhs_x_.template head<CoupledDim>().noalias() -= coupled_ineq_mat_ * ineq_work_;
+    for(int i = 0; i < block_num; i++)
+    {
+      rhs_x_.template segment<BlockDim>(CoupledDim + i * BlockDim) -=
+          ineq_scale_[i] * ineq_val_[i] * block_ineq_mat_.col(i);
+    }
+    rhs_x_ = (bound_state_.array() == 0).select(rhs_x_, 0.0);
+    factorizeReducedSystem();
+    solveReducedSystem();
+    x_polished_ = (bound_state_.array() == 0).select(x_polished_ + dx_, x_polished_);
+
+    // Calculate inequality errors and gradient
+    calcIneqValue(x_polished_, ineq_val_);
+    rhs_x_ = obj_diag_.cwiseProduct(x_polished_) + obj_vec_;
+    ineq_work_ = ineq_weight_ * ineq_val_.cwiseMax(0.0);
+    rhs_x_.template head<CoupledDim>().noalias() += coupled_ineq_mat_ * ineq_work_;
+    for(int i = 0; i < block_num; i++)
+    {
+      rhs_x_.template segment<BlockDim>(CoupledDim + i * BlockDim) +=
+          ineq_weight_ * std::max(ineq_val_[i], 0.0) * block_ineq_mat_.col(i);
+    }
+
+    // Update active set where KKT conditions are violated
+    bool updated = false;
+    for(int j = 0; j < var_dim; j++)
+    {
+      int new_state = bound_state_[j];
+      if(bound_state_[j] == 0)
+      {
+        // Primal feasibility of free variables
+        new_state = x_polished_[j] < x_min_[j] - x_thre ? -1 : (x_polished_[j] > x_max_[j] + x_thre ? 1 : 0);
+      }
+      else if(bound_state_[j] * rhs_x_[j] > grad_thre)
+      {
+        // Sign of bound multipliers
+        new_state = 0;
+      }
+      if(new_state != bound_state_[j])
+      {
+        bound_state_[j] = new_state;
+        updated = true;
+      }
+    }
+    for(int i = 0; i < block_num; i++)
+    {
+      // Consistency of inequality active set
+      if((ineq_scale_[i] > 0 && ineq_val_[i] < -ineq_thre) || (ineq_scale_[i] == 0 && ineq_val_[i] > ineq_thre))
+      {
+        ineq_scale_[i] = ineq_scale_[i] > 0 ? 0.0 : ineq_weight_;
+        updated = true;
+      }
+    }
+
+    if(!updated)
+    {
+      x_.swap(x_polished_);
+      ineq_error_ = ineq_val_.cwiseMax(0.0);
+      return true;
+    }
+  }
+
+  return false;
+}
+} // namespace DiffRmap
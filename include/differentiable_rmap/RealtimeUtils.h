@@ -0,0 +1,248 @@
+/* Author: Masaki Murooka */
+
+/** \file RealtimeUtils.h
+    Utilities to run planning loop in real time.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mc_rtc/Configuration.h>
+
+namespace DiffRmap
+{
+/*! \brief Configuration of real-time execution of planning loop. */
+struct RealtimeConfiguration
+{
+  //! Whether to run planning loop in dedicated real-time thread (otherwise ros::Rate is used in main thread)
+  bool enabled = false;
+
+  //! List of CPU indices to which the real-time thread is pinned (empty for no pinning)
+  std::vector<int> cpu_list;
+
+  //! SCHED_FIFO priority of the real-time thread (non-positive for default scheduling policy)
+  int priority = 80;
+
+  //! Whether to lock current and future memory of process by mlockall
+  bool lock_memory = true;
+
+  //! Size of stack prefaulted in the real-time thread [byte]
+  int prefault_stack_size = 512 * 1024;
+
+  //! Width of bins of latency histograms [us]
+  double histogram_bin_width = 5.0;
+
+  //! Number of bins of latency histograms (samples beyond the last bin are counted in the last bin)
+  int histogram_bin_num = 200;
+
+  /*! \brief Load mc_rtc configuration. */
+  inline void load(const mc_rtc::Configuration & mc_rtc_config)
+  {
+    mc_rtc_config("enabled", enabled);
+    mc_rtc_config("cpu_list", cpu_list);
+    mc_rtc_config("priority", priority);
+    mc_rtc_config("lock_memory", lock_memory);
+    mc_rtc_config("prefault_stack_size", prefault_stack_size);
+    mc_rtc_config("histogram_bin_width", histogram_bin_width);
+    mc_rtc_config("histogram_bin_num", histogram_bin_num);
+  }
+};
+
+/** \brief Histogram of latency.
+
+    add() and clear() must be called from a single thread (i.e., the real-time thread), and do not allocate heap memory
+    or take lock. The statistics can be read from other threads concurrently because all members are atomic (the read
+    values may be slightly inconsistent with each other while samples are being added).
+*/
+class LatencyHistogram
+{
+public:
+  /** \brief Setup bins.
+      \param bin_width width of bins [us]
+      \param bin_num number of bins
+
+      This must not be called while other methods are called from other threads.
+  */
+  void setup(double bin_width, int bin_num);
+
+  /** \brief Clear samples. */
+  void clear();
+
+  /** \brief Add sample.
+      \param value latency [us]
+  */
+  void add(double value);
+
+  /** \brief Get number of samples. */
+  inline uint64_t count() const
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  /** \brief Get min latency [us]. */
+  inline double min() const
+  {
+    return count() > 0 ? min_.load(std::memory_order_relaxed) : 0.0;
+  }
+
+  /** \brief Get max latency [us]. */
+  inline double max() const
+  {
+    return count() > 0 ? max_.load(std::memory_order_relaxed) : 0.0;
+  }
+
+  /** \brief Get mean latency [us]. */
+  inline double mean() const
+  {
+    uint64_t n = count();
+    return n > 0 ? sum_.load(std::memory_order_relaxed) / n : 0.0;
+  }
+
+  /** \brief Get percentile of latency [us].
+      \param ratio ratio of percentile in [0, 1]
+
+      The upper edge of the bin containing the percentile is returned.
+  */
+  double percentile(double ratio) const;
+
+  /** \brief Dump statistics and non-empty bins to string.
+      \param name name of histogram
+  */
+  std::string dump(const std::string & name) const;
+
+protected:
+  //! Width of bins [us]
+  double bin_width_ = 1.0;
+
+  //! Number of bins
+  int bin_num_ = 0;
+
+  //! Number of samples in each bin
+  std::unique_ptr<std::atomic<uint64_t>[]> bin_count_list_;
+
+  //! Number of samples
+  std::atomic<uint64_t> count_{0};
+
+  //! Sum, min, and max of samples [us]
+  std::atomic<double> sum_{0.0};
+  std::atomic<double> min_{0.0};
+  std::atomic<double> max_{0.0};
+};
+
+/** \brief Loop running at fixed rate in dedicated real-time thread.
+
+    The thread is pinned to the CPUs and scheduled by SCHED_FIFO as configured. Each iteration waits until the
+    absolute deadline by clock_nanosleep so that the period does not drift. The wake-up jitter (i.e., delay of wake-up
+    from the deadline) and the compute time of each iteration are recorded in histograms. If an iteration exceeds the
+    next deadline, it is counted as an overrun and the missed deadlines are skipped.
+*/
+class RealtimeLoop
+{
+public:
+  /** \brief Constructor.
+      \param config real-time configuration
+      \param rate loop rate [Hz]
+  */
+  RealtimeLoop(const RealtimeConfiguration & config, double rate);
+
+  /** \brief Destructor. */
+  ~RealtimeLoop();
+
+  /** \brief Start loop thread.
+      \param func function called in each iteration with iteration index
+  */
+  void start(const std::function<void(int)> & func);
+
+  /** \brief Stop loop thread and wait for it to finish. */
+  void stop();
+
+  /** \brief Request to clear statistics (cleared at the next iteration in the loop thread). */
+  inline void requestClear()
+  {
+    clear_requested_ = true;
+  }
+
+  /** \brief Get number of overruns. */
+  inline uint64_t overrunCount() const
+  {
+    return overrun_count_.load(std::memory_order_relaxed);
+  }
+
+  /** \brief Get histogram of wake-up jitter. */
+  inline const LatencyHistogram & jitterHistogram() const
+  {
+    return jitter_hist_;
+  }
+
+  /** \brief Get histogram of compute time. */
+  inline const LatencyHistogram & computeHistogram() const
+  {
+    return compute_hist_;
+  }
+
+  /** \brief Dump statistics to string. */
+  std::string dumpStatistics() const;
+
+protected:
+  /** \brief Setup CPU affinity, scheduling policy, and stack of the calling thread. */
+  void setupThread() const;
+
+  /** \brief Function of loop thread. */
+  void threadFunc();
+
+protected:
+  //! Real-time configuration
+  RealtimeConfiguration config_;
+
+  //! Period of loop [ns]
+  int64_t period_ns_ = 0;
+
+  //! Function called in each iteration
+  std::function<void(int)> func_;
+
+  //! Histograms of wake-up jitter and compute time
+  LatencyHistogram jitter_hist_;
+  LatencyHistogram compute_hist_;
+
+  //! Number of overruns
+  std::atomic<uint64_t> overrun_count_{0};
+
+  //! Whether the loop thread is running
+  std::atomic<bool> running_{false};
+
+  //! Whether clear of statistics is requested
+  std::atomic<bool> clear_requested_{false};
+
+  //! Loop thread
+  std::thread thread_;
+};
+
+/** \brief Lock current and future memory of process by mlockall.
+    \return whether memory is locked successfully
+*/
+bool lockMemory();
+
+/** \brief Run planning loop in dedicated real-time thread until ROS is shut down.
+    \param config real-time configuration
+    \param rate loop rate [Hz]
+    \param publish_interval step interval to publish
+    \param run_once_func function to run planning once (argument is whether to publish)
+
+    The workspace of planning must be allocated (i.e., setup() must be called) before calling this function, so that
+    it is locked and prefaulted by mlockall. ROS callbacks of the global callback queue are processed in the
+    real-time thread only in the publishing iterations, so that they are serialized with run_once_func as in the
+    loop with ros::Rate. The statistics are provided by the services "latency_statistics" (std_srvs::Trigger, whose
+    success is false if any overrun occurred) and "clear_latency_statistics" (std_srvs::Empty), which are processed in
+    a separate non-real-time thread.
+*/
+void runRealtimeLoop(const RealtimeConfiguration & config,
+                     int rate,
+                     int publish_interval,
+                     const std::function<void(bool)> & run_once_func);
+} // namespace DiffRmap
@@ -14,7 +14,9 @@
 
 #include <optmotiongen/Utils/QpUtils.h>
 
+#include <differentiable_rmap/RealtimeUtils.h>
 #include <differentiable_rmap/RosUtils.h>
+#include <differentiable_rmap/SVMUtils.h>
 #include <differentiable_rmap/SamplingUtils.h>
 
 namespace DiffRmap
@@ -56,12 +58,22 @@ public:
     //! Step interval to publish in runLoop()
     int publish_interval = 20;
 
+    //! Configuration of real-time execution of runLoop()
+    RealtimeConfiguration realtime_config;
+
     //! Threshold of SVM predict value to be determined as reachable
     double svm_thre = 0.0;
 
+    //! Whether SVM is trained with samples canonicalized by rotation around z-axis (only for R3 and SE3)
+    bool yaw_symmetric = false;
+
     //! Limit of configuration update in one step [m], [rad]
     double delta_config_limit = 0.1;
 
+    //! QP solver type ("JRLQP" or specialized solver, i.e., "BoxHalfspace" for RmapPlanning and "Arrow" for
+    //! RmapPlanningPlacement)
+    std::string qp_solver_type = "JRLQP";
+
     //! Initial sample pose
     sva::PTransformd initial_sample_pose = sva::PTransformd::Identity();
 
@@ -82,8 +94,14 @@ public:
     {
       mc_rtc_config("loop_rate", loop_rate);
       mc_rtc_config("publish_interval", publish_interval);
+      if(mc_rtc_config.has("realtime_config"))
+      {
+        realtime_config.load(mc_rtc_config("realtime_config"));
+      }
       mc_rtc_config("svm_thre", svm_thre);
+      mc_rtc_config("yaw_symmetric", yaw_symmetric);
       mc_rtc_config("delta_config_limit", delta_config_limit);
+      mc_rtc_config("qp_solver_type", qp_solver_type);
       mc_rtc_config("initial_sample_pose", initial_sample_pose);
       mc_rtc_config("grid_map_prediction", grid_map_prediction);
       mc_rtc_config("grid_map_margin_ratio", grid_map_margin_ratio);
@@ -161,6 +179,77 @@ public:
   */
   VelType calcSVMGradWithVel(const SampleType & sample) const;
 
+  /** \brief Calculate SVM value and its gradient with local linear surrogate.
+      \param[out] svm_grad gradient of SVM value w.r.t. sample
+      \param[in] sample sample
+      \param[in,out] surrogate surrogate (rebuilt by exact evaluation if the sample is out of trust region)
+      \param[in] tol tolerance of error bound of surrogate value (non-positive for exact evaluation every time)
+      \param[in] trust_radius trust radius of surrogate in input space
+      \return SVM value
+  */
+  double calcSVMValueAndGrad(SampleType & svm_grad,
+                             const SampleType & sample,
+                             SVMSurrogate<SamplingSpaceType> & surrogate,
+                             double tol,
+                             double trust_radius) const;
+
+  /** \brief Calculate SVM value and its gradient w.r.t. vel with local linear surrogate.
+      \param[out] svm_grad gradient of SVM value w.r.t. vel
+      \param[in] sample sample
+      \param[in,out] surrogate surrogate (rebuilt by exact evaluation if the sample is out of trust region)
+      \param[in] tol tolerance of error bound of surrogate value (non-positive for exact evaluation every time)
+      \param[in] trust_radius trust radius of surrogate in input space
+      \return SVM value
+  */
+  double calcSVMValueAndGradWithVel(VelType & svm_grad,
+                                    const SampleType & sample,
+                                    SVMSurrogate<SamplingSpaceType> & surrogate,
+                                    double tol,
+                                    double trust_radius) const;
+
+  /** \brief Calculate SVM value and its gradient w.r.t. input with local linear surrogate.
+      \param[out] input_grad gradient of SVM value w.r.t. input
+      \param[in] input SVM input
+      \param[in,out] surrogate surrogate (rebuilt by exact evaluation if the input is out of trust region)
+      \param[in] tol tolerance of error bound of surrogate value (non-positive for exact evaluation every time)
+      \param[in] trust_radius trust radius of surrogate in input space
+      \return SVM value
+  */
+  double calcSVMValueAndInputGrad(InputType & input_grad,
+                                  const InputType & input,
+                                  SVMSurrogate<SamplingSpaceType> & surrogate,
+                                  double tol,
+                                  double trust_radius) const;
+
+  /** \brief Calculate SVM value of relative sample and its gradients w.r.t. predecessor and successor vels with local
+      linear surrogate.
+      \param[out] pre_vel_grad gradient of SVM value w.r.t. predecessor vel
+      \param[out] suc_vel_grad gradient of SVM value w.r.t. successor vel
+      \param[in] pre_sample predecessor sample
+      \param[in] suc_sample successor sample
+      \param[in,out] surrogate surrogate (rebuilt by exact evaluation if the input is out of trust region)
+      \param[in] tol tolerance of error bound of surrogate value (non-positive for exact evaluation every time)
+      \param[in] trust_radius trust radius of surrogate in input space
+      \return SVM value
+
+      See calcRelSVMValueAndVelGrad() in SVMUtils.h for the fused calculation.
+  */
+  double calcRelSVMValueAndVelGrad(VelType & pre_vel_grad,
+                                   VelType & suc_vel_grad,
+                                   const SampleType & pre_sample,
+                                   const SampleType & suc_sample,
+                                   SVMSurrogate<SamplingSpaceType> & surrogate,
+                                   double tol,
+                                   double trust_radius) const;
+
+  /** \brief Set target pose.
+      \param pose target pose
+  */
+  inline void setTargetPose(const sva::PTransformd & pose)
+  {
+    target_sample_ = poseToSample<SamplingSpaceType>(pose);
+  }
+
 protected:
   /** \brief Setup grid map. */
   void setupGridMap();
@@ -197,6 +286,9 @@ public:
   //! Support vector matrix
   Eigen::Matrix<double, input_dim_, Eigen::Dynamic> svm_sv_mat_;
 
+  //! Upper bound of the spectral norm of Hessian of SVM value w.r.t. input
+  double svm_hessian_bound_ = 0.0;
+
   //! Grid set message
   differentiable_rmap::RmapGridSet::ConstPtr grid_set_msg_;
 
@@ -210,7 +302,7 @@ protected:
   //! QP coefficients
   OmgCore::QpCoeff qp_coeff_;
 
-  //! QP solver
+  //! QP solver (nullptr if BoxHalfspace solver is used)
   std::shared_ptr<OmgCore::QpSolver> qp_solver_;
 
   //! Current sample
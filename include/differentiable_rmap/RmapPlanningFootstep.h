@@ -5,6 +5,9 @@
 #include <sch/CD/CD_Pair.h>
 #include <sch/S_Object/S_Box.h>
 
+#include <std_srvs/Empty.h>
+
+#include <differentiable_rmap/HorizonSearch.h>
 #include <differentiable_rmap/RmapPlanning.h>
 
 namespace DiffRmap
@@ -55,6 +58,12 @@ public:
     //! QP objective weight for SVM inequality error
     double svm_ineq_weight = 1e6;
 
+    //! Tolerance of error bound of local linear surrogate of SVM value (non-positive for exact evaluation every step)
+    double svm_surrogate_tol = 0.0;
+
+    //! Trust radius of local linear surrogate of SVM value in SVM input space
+    double svm_surrogate_radius = 0.1;
+
     //! QP objective weight for collision avoidance inequality error
     double collision_ineq_weight = 1e6;
 
@@ -82,6 +91,8 @@ public:
       mc_rtc_config("alternate_lr", alternate_lr);
       mc_rtc_config("collision_margin", collision_margin);
       mc_rtc_config("svm_ineq_weight", svm_ineq_weight);
+      mc_rtc_config("svm_surrogate_tol", svm_surrogate_tol);
+      mc_rtc_config("svm_surrogate_radius", svm_surrogate_radius);
       mc_rtc_config("collision_ineq_weight", collision_ineq_weight);
       if(mc_rtc_config.has("foot_shape_config"))
       {
@@ -145,6 +156,34 @@ public:
    */
   virtual void runOnce(bool publish) override;
 
+  /** \brief Setup and run planning loop. */
+  virtual void runLoop() override;
+
+  /** \brief Commit the first two footsteps and shift the horizon.
+
+      The start pose is moved to the second footstep, the remaining footsteps are shifted to the front, and the
+      footsteps appended to the tail are warm-started by extrapolating the last stride. Two footsteps are committed at
+      once so that the left and right assignment of each footstep is preserved. The QP coefficients and solver are
+      reused as is, and the local surrogates of SVM value are shifted together with the footsteps.
+
+      This is supposed to be called when the committed footsteps are executed, e.g., via the "shift_horizon" service
+      (std_srvs::Empty) advertised in runLoop().
+      \return whether the horizon is shifted
+   */
+  bool shiftHorizon();
+
+  /** \brief Get violation of inequalities (i.e., max value of their slack variables) in the last runOnce(). */
+  inline double ineqViolation() const
+  {
+    return ineq_violation_;
+  }
+
+  /** \brief Get error between the last footstep and the target. */
+  inline double targetError() const
+  {
+    return sampleError<SamplingSpaceType>(target_sample_, current_sample_seq_.back()).norm();
+  }
+
 protected:
   /** \brief Publish marker array. */
   virtual void publishMarkerArray() const override;
@@ -152,6 +191,9 @@ protected:
   /** \brief Publish current state. */
   virtual void publishCurrentState() const override;
 
+  /** \brief Service callback to commit the first footsteps and shift the horizon. */
+  bool shiftHorizonCallback(std_srvs::Empty::Request & req, std_srvs::Empty::Response & res);
+
   /** \brief Returns whether switching left and right foot alternately is supported. */
   static inline constexpr bool isAlternateSupported()
   {
@@ -166,12 +208,26 @@ protected:
   //! Configuration
   Configuration config_;
 
+  //! Start sample (i.e., predecessor of the first footstep)
+  SampleType start_sample_;
+
   //! Current sample sequence
   std::vector<SampleType> current_sample_seq_;
 
+  //! Violation of inequalities in the last runOnce()
+  double ineq_violation_ = 0.0;
+
+  //! Workspace (allocated in setup() to avoid heap allocation in runOnce())
+  Eigen::VectorXd current_config_;
+  Eigen::VectorXd vel_all_;
+  std::vector<SampleType> extended_sample_seq_;
+
   //! Adjacent regularization matrix
   Eigen::MatrixXd adjacent_reg_mat_;
 
+  //! List of local surrogate of SVM value for each footstep
+  std::vector<SVMSurrogate<SamplingSpaceType>> svm_surrogate_list_;
+
   //! Sch box of foot
   std::shared_ptr<sch::S_Box> foot_sch_;
 
@@ -196,6 +252,7 @@ protected:
   // Separate topics to change the marker colors on the right and left feet
   ros::Publisher current_left_poly_arr_pub_;
   ros::Publisher current_right_poly_arr_pub_;
+  ros::ServiceServer shift_horizon_srv_;
 
 protected:
   // See https://stackoverflow.com/a/6592617
@@ -230,4 +287,15 @@ std::shared_ptr<RmapPlanningBase> createRmapPlanningFootstep(
     SamplingSpace sampling_space,
     const std::string & svm_path = "/tmp/rmap_svm_model.libsvm",
     const std::string & bag_path = "/tmp/rmap_grid_set.bag");
+
+/** \brief Search minimum number of footsteps to reach the target.
+    \param sampling_space sampling space
+    \param svm_path path of SVM model file
+    \param mc_rtc_config mc_rtc configuration of RmapPlanningFootstep (footstep_num is overwritten by candidates)
+    \param search_config configuration of search (horizon is footstep_num)
+*/
+HorizonSearchResult searchMinFootstepNum(SamplingSpace sampling_space,
+                                         const std::string & svm_path,
+                                         const mc_rtc::Configuration & mc_rtc_config,
+                                         const HorizonSearchConfiguration & search_config);
 } // namespace DiffRmap
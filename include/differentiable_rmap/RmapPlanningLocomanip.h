@@ -7,6 +7,8 @@
 
 #include <mc_rtc/constants.h>
 
+#include <std_srvs/Empty.h>
+
 #include <differentiable_rmap/RmapPlanning.h>
 #include <differentiable_rmap/RobotUtils.h>
 
@@ -29,6 +31,9 @@ public:
     //! Step interval to publish in runLoop()
     int publish_interval = 20;
 
+    //! Configuration of real-time execution of runLoop()
+    RealtimeConfiguration realtime_config;
+
     //! Threshold of SVM predict value to be determined as reachable
     double svm_thre = 0.0;
 
@@ -53,6 +58,15 @@ public:
     //! QP objective weight for SVM inequality error
     double svm_ineq_weight = 1e6;
 
+    //! Threshold of sample update to reuse cached SVM inequality rows [m], [rad] (negative for no reuse)
+    double svm_cache_thre = 0.0;
+
+    //! Tolerance of error bound of local linear surrogate of SVM value (non-positive for exact evaluation every step)
+    double svm_surrogate_tol = 0.0;
+
+    //! Trust radius of local linear surrogate of SVM value in SVM input space
+    double svm_surrogate_radius = 0.1;
+
     //! Center of hand arc trajectory [m]
     Eigen::Vector2d hand_traj_center = Eigen::Vector2d::Zero();
 
@@ -74,6 +88,10 @@ public:
     {
       mc_rtc_config("loop_rate", loop_rate);
       mc_rtc_config("publish_interval", publish_interval);
+      if(mc_rtc_config.has("realtime_config"))
+      {
+        realtime_config.load(mc_rtc_config("realtime_config"));
+      }
       mc_rtc_config("svm_thre", svm_thre);
       mc_rtc_config("delta_config_limit", delta_config_limit);
       if(mc_rtc_config.has("initial_sample_pose_list"))
@@ -89,6 +107,9 @@ public:
       mc_rtc_config("reg_weight", reg_weight);
       mc_rtc_config("adjacent_reg_weight", adjacent_reg_weight);
       mc_rtc_config("svm_ineq_weight", svm_ineq_weight);
+      mc_rtc_config("svm_cache_thre", svm_cache_thre);
+      mc_rtc_config("svm_surrogate_tol", svm_surrogate_tol);
+      mc_rtc_config("svm_surrogate_radius", svm_surrogate_radius);
       mc_rtc_config("hand_traj_center", hand_traj_center);
       mc_rtc_config("hand_traj_radius", hand_traj_radius);
       if(mc_rtc_config.has("target_hand_traj_angles"))
@@ -152,6 +173,20 @@ public:
   /** \brief Setup and run planning loop. */
   void runLoop();
 
+  /** \brief Commit the first two footsteps and hand angles, and shift the horizon.
+
+      The start samples and the start angle of hand trajectory are moved to the committed ones, the remaining samples
+      are shifted to the front, and the samples appended to the tail are warm-started by extrapolating the last stride.
+      The QP coefficients and solver are reused as is, and the local surrogates of SVM value are shifted together with
+      the samples. Since the row and column of each SVM inequality are shifted, all SVM inequality rows are
+      recalculated in the next step.
+
+      This is supposed to be called when the committed footsteps and hand angles are executed, e.g., via the
+      "shift_horizon" service (std_srvs::Empty) advertised in runLoop().
+      \return whether the horizon is shifted
+   */
+  bool shiftHorizon();
+
 protected:
   /** \brief Get rmap planning for specified limb. */
   inline std::shared_ptr<RmapPlanning<SamplingSpaceType>> rmapPlanning(Limb limb) const
@@ -165,12 +200,22 @@ protected:
   /** \brief Calculate sample gradient from hand trajectory. */
   SampleType calcSampleGradFromHandTraj(double angle) const;
 
+  /** \brief Set dirty flags of foot samples and hand angles which have moved beyond svm_cache_thre since the SVM
+      inequality rows were calculated. */
+  void updateSvmDirtyFlags();
+
+  /** \brief Clear dirty flags and store samples at which the SVM inequality rows are calculated. */
+  void clearSvmDirtyFlags();
+
   /** \brief Publish marker array. */
   void publishMarkerArray() const;
 
   /** \brief Publish current state. */
   void publishCurrentState() const;
 
+  /** \brief Service callback to commit the first samples and shift the horizon. */
+  bool shiftHorizonCallback(std_srvs::Empty::Request & req, std_srvs::Empty::Response & res);
+
   /** \brief Transform topic callback. */
   void transCallback(const geometry_msgs::TransformStamped::ConstPtr & trans_st_msg);
 
@@ -207,9 +252,33 @@ protected:
   //! Start sample
   std::unordered_map<Limb, Sample<SamplingSpaceType>> start_sample_list_;
 
+  //! Start angle in hand trajectory (initialized with the start of target_hand_traj_angles and moved by shiftHorizon())
+  double start_hand_traj_angle_ = 0.0;
+
   //! Adjacent regularization matrix
   Eigen::MatrixXd adjacent_reg_mat_;
 
+  //! SVM inequality matrix and vector (rows of clean variables are kept from previous steps)
+  Eigen::MatrixXd svm_ineq_mat_;
+  Eigen::VectorXd svm_ineq_vec_;
+
+  //! Foot sample sequence and hand angle sequence at which SVM inequality rows are calculated
+  std::vector<Sample<SamplingSpaceType>> cached_foot_sample_seq_;
+  std::vector<double> cached_hand_traj_angle_seq_;
+
+  //! List of local surrogate of SVM value for each SVM inequality
+  std::vector<SVMSurrogate<SamplingSpaceType>> svm_surrogate_list_;
+
+  //! Dirty flags of foot samples and hand angles (i.e., whether SVM inequality rows involving them are recalculated)
+  std::vector<bool> foot_dirty_flag_list_;
+  std::vector<bool> hand_dirty_flag_list_;
+
+  //! Workspace (allocated in setup() to avoid heap allocation in runOnce())
+  Eigen::VectorXd current_config_;
+  Eigen::VectorXd vel_all_;
+  std::vector<SampleType> extended_foot_sample_seq_;
+  std::vector<double> extended_hand_traj_angle_seq_;
+
   //! Dimensions of configuration, SVM inequality, and collision inequality
   int config_dim_ = 0;
   int svm_ineq_dim_ = 0;
@@ -222,6 +291,7 @@ protected:
   ros::NodeHandle nh_;
 
   ros::Subscriber trans_sub_;
+  ros::ServiceServer shift_horizon_srv_;
   ros::Publisher marker_arr_pub_;
   ros::Publisher current_pose_arr_pub_;
   ros::Publisher current_poly_arr_pub_;
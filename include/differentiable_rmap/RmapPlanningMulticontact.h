@@ -5,6 +5,9 @@
 #include <map>
 #include <unordered_map>
 
+#include <std_srvs/Empty.h>
+
+#include <differentiable_rmap/HorizonSearch.h>
 #include <differentiable_rmap/RmapPlanning.h>
 #include <differentiable_rmap/RobotUtils.h>
 
@@ -27,6 +30,9 @@ public:
     //! Step interval to publish in runLoop()
     int publish_interval = 20;
 
+    //! Configuration of real-time execution of runLoop()
+    RealtimeConfiguration realtime_config;
+
     //! Threshold of SVM predict value to be determined as reachable
     double svm_thre = 0.0;
 
@@ -57,6 +63,15 @@ public:
     //! QP objective weight for SVM inequality error
     double svm_ineq_weight = 1e6;
 
+    //! Threshold of sample update to reuse cached SVM inequality rows [m], [rad] (negative for no reuse)
+    double svm_cache_thre = 0.0;
+
+    //! Tolerance of error bound of local linear surrogate of SVM value (non-positive for exact evaluation every step)
+    double svm_surrogate_tol = 0.0;
+
+    //! Trust radius of local linear surrogate of SVM value in SVM input space
+    double svm_surrogate_radius = 0.1;
+
     //! Lower and upper limit of hand position [m]
     std::pair<Eigen::Vector3d, Eigen::Vector3d> foot_pos_limits = {Eigen::Vector3d(-1e20, -1e20, -1e20),
                                                                    Eigen::Vector3d(1e20, 1e20, 1e20)};
@@ -80,6 +95,10 @@ public:
     {
       mc_rtc_config("loop_rate", loop_rate);
       mc_rtc_config("publish_interval", publish_interval);
+      if(mc_rtc_config.has("realtime_config"))
+      {
+        realtime_config.load(mc_rtc_config("realtime_config"));
+      }
       mc_rtc_config("svm_thre", svm_thre);
       mc_rtc_config("delta_config_limit", delta_config_limit);
 
@@ -96,6 +115,9 @@ public:
       mc_rtc_config("rel_hand_foot_weight", rel_hand_foot_weight);
       mc_rtc_config("start_foot_weight", start_foot_weight);
       mc_rtc_config("svm_ineq_weight", svm_ineq_weight);
+      mc_rtc_config("svm_cache_thre", svm_cache_thre);
+      mc_rtc_config("svm_surrogate_tol", svm_surrogate_tol);
+      mc_rtc_config("svm_surrogate_radius", svm_surrogate_radius);
       mc_rtc_config("foot_pos_limits", foot_pos_limits);
       mc_rtc_config("hand_pos_limits", hand_pos_limits);
       mc_rtc_config("waist_height", waist_height);
@@ -195,6 +217,48 @@ public:
   /** \brief Setup and run planning loop. */
   void runLoop();
 
+  /** \brief Commit the first two footsteps and the first hand contact, and shift the horizon.
+
+      The start foot sample is moved to the third foot, the remaining samples are shifted to the front, and the
+      samples appended to the tail are warm-started by extrapolating the last stride. The QP coefficients and solver
+      are reused as is, and the local surrogates of SVM value are shifted together with the samples. Since the row and
+      column of each SVM inequality are shifted, all SVM inequality rows are recalculated in the next step.
+
+      This is supposed to be called when the committed samples are executed, e.g., via the "shift_horizon" service
+      (std_srvs::Empty) advertised in runLoop().
+      \return whether the horizon is shifted
+   */
+  bool shiftHorizon();
+
+  /** \brief Set target pose of foot.
+      \param pose target pose
+  */
+  inline void setTargetPose(const sva::PTransformd & pose)
+  {
+    target_foot_sample_ = poseToSample<FootSamplingSpaceType>(pose);
+  }
+
+  /** \brief Get violation of inequalities (i.e., max value of their slack variables) in the last runOnce(). */
+  inline double ineqViolation() const
+  {
+    return ineq_violation_;
+  }
+
+  /** \brief Get error between the last foot and the target. */
+  inline double targetError() const
+  {
+    return sampleError<FootSamplingSpaceType>(target_foot_sample_, current_foot_sample_seq_.back()).norm();
+  }
+
+  /** \brief Search minimum motion length to reach the target.
+      \param svm_path_list path list of SVM model file
+      \param mc_rtc_config mc_rtc configuration (motion_len is overwritten by candidates)
+      \param search_config configuration of search (horizon is motion_len, so horizon_stride must be even)
+  */
+  static HorizonSearchResult searchMinMotionLen(const std::unordered_map<Limb, std::string> & svm_path_list,
+                                                const mc_rtc::Configuration & mc_rtc_config,
+                                                const HorizonSearchConfiguration & search_config);
+
 protected:
   /** \brief Get rmap planning for specified limb.
       \tparam limb limb
@@ -205,12 +269,22 @@ protected:
     return std::dynamic_pointer_cast<RmapPlanning<samplingSpaceType<limb>()>>(rmap_planning_list_.at(limb));
   }
 
+  /** \brief Set dirty flags of foot/hand samples which have moved beyond svm_cache_thre since the SVM inequality rows
+      were calculated. */
+  void updateSvmDirtyFlags();
+
+  /** \brief Clear dirty flags and store samples at which the SVM inequality rows are calculated. */
+  void clearSvmDirtyFlags();
+
   /** \brief Publish marker array. */
   void publishMarkerArray() const;
 
   /** \brief Publish current state. */
   void publishCurrentState() const;
 
+  /** \brief Service callback to commit the first samples and shift the horizon. */
+  bool shiftHorizonCallback(std_srvs::Empty::Request & req, std_srvs::Empty::Response & res);
+
   /** \brief Transform topic callback. */
   void transCallback(const geometry_msgs::TransformStamped::ConstPtr & trans_st_msg);
 
@@ -254,10 +328,33 @@ protected:
   //! Adjacent regularization matrix
   Eigen::MatrixXd adjacent_reg_mat_;
 
+  //! SVM inequality matrix and vector (rows of clean variables are kept from previous steps)
+  Eigen::MatrixXd svm_ineq_mat_;
+  Eigen::VectorXd svm_ineq_vec_;
+
+  //! Sample sequences at which SVM inequality rows are calculated
+  std::vector<Sample<FootSamplingSpaceType>> cached_foot_sample_seq_;
+  std::vector<Sample<HandSamplingSpaceType>> cached_hand_sample_seq_;
+
+  //! Lists of local surrogate of SVM value for reachability between foot and from foot to hand
+  std::vector<SVMSurrogate<FootSamplingSpaceType>> foot_svm_surrogate_list_;
+  std::vector<SVMSurrogate<HandSamplingSpaceType>> hand_svm_surrogate_list_;
+
+  //! Dirty flags of foot/hand samples (i.e., whether the SVM inequality rows involving them are recalculated)
+  std::vector<bool> foot_dirty_flag_list_;
+  std::vector<bool> hand_dirty_flag_list_;
+
   //! Number of foot and hand
   int foot_num_ = 0;
   int hand_num_ = 0;
 
+  //! Violation of inequalities in the last runOnce()
+  double ineq_violation_ = 0.0;
+
+  //! Workspace (allocated in setup() to avoid heap allocation in runOnce())
+  Eigen::VectorXd current_config_;
+  Eigen::VectorXd vel_all_;
+
   //! Dimensions of configuration, SVM inequality, and collision inequality
   int config_dim_ = 0;
   int svm_ineq_dim_ = 0;
@@ -270,6 +367,7 @@ protected:
   ros::NodeHandle nh_;
 
   ros::Subscriber trans_sub_;
+  ros::ServiceServer shift_horizon_srv_;
   ros::Publisher marker_arr_pub_;
   ros::Publisher current_pose_arr_pub_;
   ros::Publisher current_poly_arr_pub_;
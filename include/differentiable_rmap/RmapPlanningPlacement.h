@@ -8,6 +8,8 @@
 #include <optmotiongen/Task/BodyTask.h>
 #include <optmotiongen/Utils/RobotUtils.h>
 
+#include <differentiable_rmap/InverseRmapUtils.h>
+#include <differentiable_rmap/QpUtils.h>
 #include <differentiable_rmap/RmapPlanning.h>
 
 namespace DiffRmap
@@ -79,6 +81,13 @@ public:
     //! Threshold of IK [m], [rad]
     double ik_error_thre = 1e-2;
 
+    //! Interval of IK loop to check convergence (non-positive for no early termination)
+    int ik_check_interval = 5;
+
+    //! Threshold of joint position change and task error decrease during ik_check_interval to abort IK as
+    //! stagnation [m], [rad] (non-positive for no abort)
+    double ik_stagnation_thre = 0.0;
+
     //! Duration between adjacent target poses for animation [s]
     double animate_adjacent_duration = 1.0;
 
@@ -91,6 +100,15 @@ public:
     //! Wehther to print computation duration
     bool print_duration = false;
 
+    //! Path of ROS bag file of inverse reachability map (empty for no voting of placement)
+    std::string inv_grid_bag_path = "";
+
+    //! Max number of placement candidates obtained by voting
+    int placement_candidate_num = 10;
+
+    //! Whether to restart from the best placement candidate whenever target is updated
+    bool vote_on_target_update = false;
+
     /*! \brief Load mc_rtc configuration. */
     inline void load(const mc_rtc::Configuration & mc_rtc_config)
     {
@@ -118,10 +136,15 @@ public:
       mc_rtc_config("ik_trial_num", ik_trial_num);
       mc_rtc_config("ik_loop_num", ik_loop_num);
       mc_rtc_config("ik_error_thre", ik_error_thre);
+      mc_rtc_config("ik_check_interval", ik_check_interval);
+      mc_rtc_config("ik_stagnation_thre", ik_stagnation_thre);
       mc_rtc_config("animate_adjacent_duration", animate_adjacent_duration);
       mc_rtc_config("animate_adjacent_divide_num", animate_adjacent_divide_num);
       mc_rtc_config("animate_ik_loop_num", animate_ik_loop_num);
       mc_rtc_config("print_duration", print_duration);
+      mc_rtc_config("inv_grid_bag_path", inv_grid_bag_path);
+      mc_rtc_config("placement_candidate_num", placement_candidate_num);
+      mc_rtc_config("vote_on_target_update", vote_on_target_update);
     }
   };
 
@@ -225,6 +248,19 @@ protected:
   /** \brief Callback to animate. */
   bool animateCallback(std_srvs::Empty::Request & req, std_srvs::Empty::Response & res);
 
+  /** \brief Callback to restart planning from placement candidate. */
+  bool voteCallback(std_srvs::Empty::Request & req, std_srvs::Empty::Response & res);
+
+  /** \brief Restart planning from placement candidate obtained by voting on inverse reachability map.
+      \return whether placement candidate is found
+
+      If the target is updated after the last voting or all candidates have been used, placement is voted again and
+      planning is restarted from the best candidate. Otherwise, planning is restarted from the next candidate (e.g.,
+      when planning is stuck in a local minimum from the previous candidate). The reaching samples are reset to the
+      target samples.
+  */
+  bool restartFromPlacementCandidate();
+
 protected:
   //! Sample of reaching corresponding to identity pose
   static inline const SampleType identity_sample_ = poseToSample<SamplingSpaceType>(sva::PTransformd::Identity());
@@ -249,6 +285,24 @@ protected:
   //! Target sample list of reaching
   std::vector<SampleType> target_reaching_sample_list_;
 
+  //! QP solver exploiting block-arrow structure (nullptr if JRLQP is used)
+  std::shared_ptr<ArrowQpSolver<placement_vel_dim_, vel_dim_>> arrow_qp_solver_;
+
+  //! Velocity of placement and reaching samples obtained by QP (preallocated to avoid heap allocation in runOnce())
+  Eigen::VectorXd vel_all_;
+
+  //! Grid set message of inverse reachability map (nullptr if voting of placement is not used)
+  differentiable_rmap::RmapGridSet::ConstPtr inv_grid_set_msg_;
+
+  //! Placement candidates obtained by voting
+  std::vector<PlacementCandidate<PlacementSamplingSpaceType>> placement_candidate_list_;
+
+  //! Index of placement candidate to be used next
+  size_t placement_candidate_idx_ = 0;
+
+  //! Whether target is updated after the last voting
+  bool target_updated_after_vote_ = true;
+
   //! Robot array for IK (only for visualization)
   OmgCore::RobotArray rb_arr_;
 
@@ -266,6 +320,7 @@ protected:
   ros::Publisher rs_arr_pub_;
   ros::ServiceServer posture_srv_;
   ros::ServiceServer animate_srv_;
+  ros::ServiceServer vote_srv_;
 
 protected:
   // See https://stackoverflow.com/a/6592617
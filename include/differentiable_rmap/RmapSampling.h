@@ -2,14 +2,22 @@
 
 #pragma once
 
+#include <array>
+#include <functional>
+#include <random>
+#include <set>
+
 #include <mc_rtc/Configuration.h>
+#include <mc_rtc/constants.h>
 
 #include <ros/ros.h>
+#include <differentiable_rmap/RmapSamplingState.h>
 #include <sensor_msgs/PointCloud.h>
 
 #include <optmotiongen/Task/CollisionTask.h>
 #include <optmotiongen/Utils/RobotUtils.h>
 
+#include <differentiable_rmap/KinematicChain.h>
 #include <differentiable_rmap/SamplingUtils.h>
 
 namespace DiffRmap
@@ -59,6 +67,36 @@ public:
     //! Weight of collision task
     double collision_task_weight = 1.0;
 
+    //! Whether to publish only new points since last publish as PointCloud2 chunks instead of whole PointCloud
+    bool stream_cloud = false;
+
+    //! Voxel size of downsampled preview cloud in streaming mode [m] (non-positive for no preview)
+    double preview_voxel_size = 0.0;
+
+    //! Number of samples written to one checkpoint chunk (non-positive for no checkpoint)
+    int checkpoint_interval = 0;
+
+    //! Whether to resume sample generation from the last checkpoint chunk
+    bool resume = false;
+
+    //! Index of shard (each shard generates a part of samples with its own random stream seeded by shard index)
+    int shard_idx = 0;
+
+    //! Number of shards
+    int shard_num = 1;
+
+    //! Whether to store samples canonicalized by rotation around z-axis (only for R3 and SE3)
+    bool yaw_symmetric = false;
+
+    //! Whether to sweep joint positions on regular grid instead of random sampling
+    bool joint_grid_sweep = false;
+
+    //! Step of joint positions in joint grid sweep [rad]
+    double joint_pos_step = mc_rtc::constants::toRad(8);
+
+    //! Number of threads in joint grid sweep (non-positive for the number of hardware threads)
+    int thread_num = 0;
+
     /*! \brief Load mc_rtc configuration. */
     inline virtual void load(const mc_rtc::Configuration & mc_rtc_config)
     {
@@ -83,13 +121,56 @@ public:
         }
       }
       mc_rtc_config("collision_task_weight", collision_task_weight);
+      mc_rtc_config("stream_cloud", stream_cloud);
+      mc_rtc_config("preview_voxel_size", preview_voxel_size);
+      mc_rtc_config("checkpoint_interval", checkpoint_interval);
+      mc_rtc_config("resume", resume);
+      mc_rtc_config("shard_idx", shard_idx);
+      mc_rtc_config("shard_num", shard_num);
+      mc_rtc_config("yaw_symmetric", yaw_symmetric);
+      mc_rtc_config("joint_grid_sweep", joint_grid_sweep);
+      if(mc_rtc_config.has("joint_pos_step"))
+      {
+        mc_rtc_config("joint_pos_step", joint_pos_step);
+        joint_pos_step = mc_rtc::constants::toRad(joint_pos_step);
+      }
+      mc_rtc_config("thread_num", thread_num);
     }
   };
 
+  /*! \brief Bounding sphere of collision shape. */
+  struct BoundingSphere
+  {
+    //! Center position in body frame [m]
+    Eigen::Vector3d center = Eigen::Vector3d::Zero();
+
+    //! Radius [m]
+    double radius = 0.0;
+  };
+
+  /*! \brief Worker of joint grid sweep. */
+  struct SweepWorker
+  {
+    //! Robot configuration array (single robot configuration is stored)
+    OmgCore::RobotConfigArray rbc_arr;
+
+    //! Collision task list (sch objects are not shared with other workers since their transformations are updated)
+    std::vector<std::shared_ptr<OmgCore::CollisionTask>> collision_task_list;
+
+    //! Samples generated in the last sweep
+    std::vector<Sample<SamplingSpaceType>> sample_list;
+  };
+
 public:
   /*! \brief Dimension of sample. */
   static constexpr int sample_dim_ = sampleDim<SamplingSpaceType>();
 
+  /*! \brief Margin distance of collision task [m]. */
+  static constexpr double collision_margin_ = 0.05;
+
+  /*! \brief Number of joint grids swept by each worker between publishes in joint grid sweep. */
+  static constexpr int sweep_chunk_size_ = 1000;
+
 public:
   /*! \brief Type of sample vector. */
   using SampleType = Sample<SamplingSpaceType>;
@@ -113,6 +194,12 @@ public:
       \param bag_path path of ROS bag file
       \param sample_num number of samples to be generated
       \param sleep_rate rate of sleep druing sample generation. zero for no sleep
+
+      If shard_num is greater than one, this shard generates its part of sample_num and dumps them to the file whose
+      name has the shard index as suffix. The shard files can be merged by mergeSampleSet().
+
+      If joint_grid_sweep is true, sample_num is ignored and all the collision-free configurations on the joint grid
+      are stored. The shards divide the range of joint grid indices instead of sample_num.
   */
   virtual void run(const std::string & bag_path = "/tmp/rmap_sample_set.bag",
                    int sample_num = 10000,
@@ -139,18 +226,140 @@ protected:
   /** \brief Setup collision tasks. */
   void setupCollisionTask();
 
+  /** \brief Make collision task.
+      \param body_names pair of body names
+      \param sch_objs pair of sch objects
+  */
+  std::shared_ptr<OmgCore::CollisionTask> makeCollisionTask(
+      const OmgCore::Twin<std::string> & body_names,
+      const OmgCore::Twin<std::shared_ptr<sch::S_Object>> & sch_objs);
+
+  /** \brief Setup joint grid and workers of joint grid sweep. */
+  void setupJointGridSweep();
+
+  /** \brief Sweep joint grids in parallel and append collision-free samples in the order of grid index.
+      \param begin_grid_idx first grid index
+      \param end_grid_idx grid index past the last one
+  */
+  void sweepJointGrid(int begin_grid_idx, int end_grid_idx);
+
+  /** \brief Sweep joint grids in worker thread.
+      \param worker worker
+      \param begin_grid_idx first grid index
+      \param end_grid_idx grid index past the last one
+  */
+  void sweepJointGridRange(SweepWorker & worker, int begin_grid_idx, int end_grid_idx);
+
   /** \brief Generate one sample.
+      \param sample_idx index of sample (including samples already written to checkpoint)
       \return true if succeeded to generate sample
   */
   virtual bool sampleOnce(int sample_idx);
 
+  /** \brief Append sample to sample list and cloud.
+      \param sample sample
+      \param reachability reachability of sample
+  */
+  void appendSample(const SampleType & sample, bool reachability);
+
+  /** \brief Seed random engine from random seed and shard index.
+
+      The streams of shards start from different states, but they are not guaranteed to be disjoint because
+      std::mt19937 does not provide jump-ahead. Since the period is 2^19937 - 1, an overlap of streams is practically
+      negligible.
+  */
+  void seedRandomEngine();
+
+  /** \brief Generate random vector whose elements are uniformly distributed in [-1:1].
+      \param dim dimension of vector
+  */
+  Eigen::VectorXd randomVector(int dim);
+
+  /** \brief Generate uniformly distributed random unit quaternion. */
+  Eigen::Quaterniond randomQuaternion();
+
+  /** \brief Check collision of current configuration.
+      \return true if any collision task is violated
+
+      Narrowphase (i.e., update of collision task) is skipped for body pairs whose bounding spheres are separated by
+      more than the collision margin.
+  */
+  bool checkCollision();
+
+  /** \brief Check collision of given configuration.
+      \param rbc_arr robot configuration array
+      \param collision_task_list collision task list
+      \return true if any collision task is violated
+  */
+  bool checkCollision(const OmgCore::RobotConfigArray & rbc_arr,
+                      const std::vector<std::shared_ptr<OmgCore::CollisionTask>> & collision_task_list);
+
   /** \brief Publish ROS message. */
   virtual void publish();
 
+  /** \brief Publish reachable and unreachable clouds. */
+  void publishCloud();
+
   /** \brief Publish collision marker. */
   void publishCollisionMarker(const std::vector<std::shared_ptr<OmgCore::CollisionTask>> & collision_task_list);
 
-  /** \brief Dump generated sample set to ROS bag. */
+  /** \brief Get path of ROS bag file of this shard.
+      \param bag_path path of ROS bag file of sample set
+  */
+  std::string shardBagPath(const std::string & bag_path) const;
+
+  /** \brief Get path of checkpoint chunk.
+      \param bag_path path of ROS bag file of sample set
+      \param chunk_idx index of checkpoint chunk
+  */
+  static std::string checkpointPath(const std::string & bag_path, int chunk_idx);
+
+  /** \brief Write samples since last checkpoint to new checkpoint chunk and remove them from memory.
+      \param bag_path path of ROS bag file of sample set
+      \param sample_num total number of generated samples
+
+      The chunk is written to a temporary file and then renamed so that an interrupted write does not leave a broken
+      chunk. The state of random engine is written together so that the generation can be resumed.
+  */
+  void writeCheckpoint(const std::string & bag_path, int sample_num);
+
+  /** \brief Load state from last checkpoint chunk.
+      \param bag_path path of ROS bag file of sample set
+      \return total number of samples in checkpoint chunks
+
+      loadChunkState() is called with the state of each chunk in order.
+  */
+  int loadCheckpoint(const std::string & bag_path);
+
+  /** \brief Write state of derived class since the previous chunk to state message of new checkpoint chunk.
+      \param state_msg state message
+  */
+  inline virtual void writeChunkState(differentiable_rmap::RmapSamplingState & state_msg) {}
+
+  /** \brief Load state of derived class from state message of checkpoint chunk.
+      \param state_msg state message
+  */
+  inline virtual void loadChunkState(const differentiable_rmap::RmapSamplingState & state_msg) {}
+
+  /** \brief Remove checkpoint chunks.
+      \param bag_path path of ROS bag file of sample set
+  */
+  void removeCheckpoint(const std::string & bag_path);
+
+  /** \brief Call function for each sample in checkpoint chunks and in memory.
+      \param bag_path path of ROS bag file of sample set
+      \param func function called with sample and its reachability
+      \param reverse whether to call function in reverse order of generation
+  */
+  void forEachSample(const std::string & bag_path,
+                     const std::function<void(const SampleType &, bool)> & func,
+                     bool reverse = false) const;
+
+  /** \brief Dump generated sample set to ROS bag.
+
+      Samples in checkpoint chunks are read chunk by chunk and are written to the file with dumpSampleSetStream(), so
+      that neither the sample set message nor its serialized bytes are held in memory.
+  */
   void dumpSampleSet(const std::string & bag_path) const;
 
 protected:
@@ -181,15 +390,46 @@ protected:
   //! Joint position offset to make sample from [-1:1] random value
   Eigen::VectorXd joint_pos_offset_;
 
-  //! Sample list
+  //! Kinematic chain from root to body over sampled joints (used instead of forward kinematics of the whole robot
+  //! when collision is not checked)
+  std::shared_ptr<KinematicChain> kinematic_chain_;
+
+  //! Sample list (only samples since last checkpoint if checkpoint is enabled)
   std::vector<SampleType> sample_list_;
 
   //! Reachability list
   std::vector<bool> reachability_list_;
 
+  //! Number of reachable samples
+  size_t reachable_sample_num_ = 0;
+
+  //! Number of written checkpoint chunks
+  int checkpoint_chunk_num_ = 0;
+
+  //! Random engine (used instead of Eigen's random because its state can be saved)
+  std::mt19937 random_engine_;
+
   //! Collision task list in IK
   std::vector<std::shared_ptr<OmgCore::CollisionTask>> collision_task_list_;
 
+  //! Path prefix of convex files of robot bodies
+  std::string robot_convex_path_;
+
+  //! Body index pair list of collision tasks (same order as collision_task_list_)
+  std::vector<OmgCore::Twin<int>> collision_body_idxs_list_;
+
+  //! Bounding sphere pair list of collision tasks (same order as collision_task_list_)
+  std::vector<OmgCore::Twin<BoundingSphere>> collision_bounding_spheres_list_;
+
+  //! Number of divisions of joint grid (number of vertices is joint_divide_nums_ + 1)
+  Eigen::VectorXi joint_divide_nums_;
+
+  //! Total number of joint grids
+  int joint_grid_num_ = 0;
+
+  //! Workers of joint grid sweep
+  std::vector<SweepWorker> sweep_worker_list_;
+
   //! ROS related members
   ros::NodeHandle nh_;
 
@@ -198,8 +438,21 @@ protected:
   ros::Publisher unreachable_cloud_pub_;
   ros::Publisher collision_marker_pub_;
 
+  ros::Publisher reachable_cloud_chunk_pub_;
+  ros::Publisher unreachable_cloud_chunk_pub_;
+  ros::Publisher reachable_cloud_preview_pub_;
+  ros::Publisher unreachable_cloud_preview_pub_;
+
+  // In streaming mode, these hold only the points since last publish
   sensor_msgs::PointCloud reachable_cloud_msg_;
   sensor_msgs::PointCloud unreachable_cloud_msg_;
+
+  sensor_msgs::PointCloud reachable_cloud_preview_msg_;
+  sensor_msgs::PointCloud unreachable_cloud_preview_msg_;
+
+  //! Occupied voxel indices of preview clouds
+  std::set<std::array<int, 3>> reachable_preview_voxels_;
+  std::set<std::array<int, 3>> unreachable_preview_voxels_;
 };
 
 /** \brief Create RmapSampling instance.
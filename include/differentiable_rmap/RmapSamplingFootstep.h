@@ -127,6 +127,8 @@ protected:
 
   using RmapSamplingIK<SamplingSpaceType>::reachability_list_;
 
+  using RmapSamplingIK<SamplingSpaceType>::random_engine_;
+
   using RmapSamplingIK<SamplingSpaceType>::nh_;
 
   using RmapSamplingIK<SamplingSpaceType>::reachable_cloud_msg_;
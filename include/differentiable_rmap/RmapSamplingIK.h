@@ -5,6 +5,7 @@
 #include <optmotiongen/Problem/IterativeQpProblem.h>
 #include <optmotiongen/Task/BodyTask.h>
 
+#include <differentiable_rmap/KdTree.h>
 #include <differentiable_rmap/RmapSampling.h>
 
 namespace DiffRmap
@@ -37,6 +38,16 @@ public:
     //! Threshold of IK [m], [rad]
     double ik_error_thre = 1e-2;
 
+    //! Interval of IK loop to check convergence (non-positive for no early termination)
+    int ik_check_interval = 5;
+
+    //! Threshold of joint position change and task error decrease during ik_check_interval to abort IK as
+    //! stagnation [m], [rad] (non-positive for no abort)
+    double ik_stagnation_thre = 0.0;
+
+    //! Number of nearest IK solutions in cache to be used as initial configurations (zero for no cache)
+    int ik_seed_neighbor_num = 3;
+
     //! Constraint space of IK (default is same as template parameter SamplingSpaceType)
     std::string ik_constraint_space = "";
 
@@ -59,6 +70,9 @@ public:
       mc_rtc_config("ik_trial_num", ik_trial_num);
       mc_rtc_config("ik_loop_num", ik_loop_num);
       mc_rtc_config("ik_error_thre", ik_error_thre);
+      mc_rtc_config("ik_check_interval", ik_check_interval);
+      mc_rtc_config("ik_stagnation_thre", ik_stagnation_thre);
+      mc_rtc_config("ik_seed_neighbor_num", ik_seed_neighbor_num);
       mc_rtc_config("ik_constraint_space", ik_constraint_space);
       mc_rtc_config("reachable_sample_ratio_limits", reachable_sample_ratio_limits);
     }
@@ -68,10 +82,16 @@ public:
   /*! \brief Dimension of sample. */
   static constexpr int sample_dim_ = sampleDim<SamplingSpaceType>();
 
+  /*! \brief Dimension of SVM input. */
+  static constexpr int input_dim_ = inputDim<SamplingSpaceType>();
+
 public:
   /*! \brief Type of sample vector. */
   using SampleType = Sample<SamplingSpaceType>;
 
+  /*! \brief Type of input vector. */
+  using InputType = Input<SamplingSpaceType>;
+
 public:
   /** \brief Constructor.
       \param rb robot
@@ -115,6 +135,23 @@ protected:
   /** \brief Publish ROS message. */
   virtual void publish() override;
 
+  /** \brief Write joint positions of IK solutions since the previous chunk to state message of checkpoint chunk. */
+  virtual void writeChunkState(differentiable_rmap::RmapSamplingState & state_msg) override;
+
+  /** \brief Add IK solutions in state message of checkpoint chunk to IK solution cache.
+
+      The target pose paired with joint position is recalculated by forward kinematics since it is not stored.
+  */
+  virtual void loadChunkState(const differentiable_rmap::RmapSamplingState & state_msg) override;
+
+  /** \brief Add current joint position to IK solution cache.
+      \param target_pose target pose of IK (must not be canonicalized by yaw since it is paired with joint position)
+  */
+  void addIKSolution(const sva::PTransformd & target_pose);
+
+  /** \brief Get current position of joints in joint_name_list_. */
+  Eigen::VectorXd currentJointPos() const;
+
 protected:
   //! Configuration
   Configuration config_;
@@ -140,8 +177,14 @@ protected:
   //! Body Yaw angle offset to make sample from [-1:1] random value
   double body_yaw_offset_;
 
-  //! Number of reachabe samples
-  size_t reachable_sample_num_ = 0;
+  //! KD-tree of target poses in IK solution cache (the point is SVM input converted from target pose)
+  KdTree<input_dim_> ik_solution_kd_tree_;
+
+  //! Joint position list in IK solution cache (same order as ik_solution_kd_tree_)
+  std::vector<Eigen::VectorXd> ik_solution_joint_pos_list_;
+
+  //! Number of IK solutions in cache which are obtained in setupSampling() or already written to checkpoint
+  size_t checkpointed_ik_solution_num_ = 0;
 
 protected:
   // See https://stackoverflow.com/a/6592617
@@ -157,10 +200,16 @@ protected:
   using RmapSampling<SamplingSpaceType>::joint_pos_coeff_;
   using RmapSampling<SamplingSpaceType>::joint_pos_offset_;
 
+  using RmapSampling<SamplingSpaceType>::kinematic_chain_;
+
   using RmapSampling<SamplingSpaceType>::sample_list_;
 
   using RmapSampling<SamplingSpaceType>::reachability_list_;
 
+  using RmapSampling<SamplingSpaceType>::reachable_sample_num_;
+
+  using RmapSampling<SamplingSpaceType>::random_engine_;
+
   using RmapSampling<SamplingSpaceType>::collision_task_list_;
 
   using RmapSampling<SamplingSpaceType>::nh_;
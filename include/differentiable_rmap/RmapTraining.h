@@ -81,6 +81,9 @@ public:
     //! K (i.e., number of nearest samples) list for evaluation by k-nearest neighbor
     std::vector<size_t> knn_K_list = {1, 3, 5, 7, 9};
 
+    //! Whether to train SVM with samples canonicalized by rotation around z-axis (only for R3 and SE3)
+    bool yaw_symmetric = false;
+
     /*! \brief Load mc_rtc configuration. */
     inline void load(const mc_rtc::Configuration & mc_rtc_config)
     {
@@ -95,6 +98,7 @@ public:
       mc_rtc_config("eval_svm_thre_list", eval_svm_thre_list);
       mc_rtc_config("ocnn_dist_ratio_thre_list", ocnn_dist_ratio_thre_list);
       mc_rtc_config("knn_K_list", knn_K_list);
+      mc_rtc_config("yaw_symmetric", yaw_symmetric);
     }
   };
 
@@ -210,12 +214,24 @@ protected:
   /** \brief Load sample set from ROS bag. */
   void loadSampleSet(const std::string & bag_path);
 
+  /** \brief Setup index of samples sorted by slicing key.
+
+      The slicing key is yaw angle for SE2 and z position for R3 and SE3. The samples in the slice are obtained by a
+      range query on the sorted keys in publishSlicedCloud() instead of scanning all samples.
+  */
+  void setupSliceIndex();
+
   /** \brief Save SVM model. */
   void loadSVM();
 
   /** \brief Train SVM. */
   void trainSVM();
 
+  /** \brief Convert sample to SVM input (canonicalized if yaw_symmetric is true).
+      \param sample sample
+  */
+  InputType sampleToSVMInput(const SampleType & sample) const;
+
   /** \brief Calculate SVM value.
       \param sample sample
   */
@@ -271,6 +287,13 @@ protected:
   //! Whether unreachable samples are contained
   bool contain_unreachable_sample_ = false;
 
+  //! Sample indices sorted by slicing key (yaw angle for SE2, z position for R3 and SE3)
+  std::vector<size_t> slice_sorted_idxs_;
+  //! Slicing keys in ascending order (same order as slice_sorted_idxs_)
+  std::vector<double> slice_sorted_keys_;
+  //! Quaternion coefficients (x, y, z, w) of samples in the same order as slice_sorted_idxs_ (only for SE3)
+  Eigen::Matrix4Xd slice_sorted_quat_mat_;
+
   //! Min/max position of samples
   SampleType sample_min_;
   SampleType sample_max_;
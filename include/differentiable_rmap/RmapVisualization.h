@@ -6,10 +6,13 @@
 
 #include <ros/ros.h>
 #include <std_msgs/Float64.h>
+#include <visualization_msgs/Marker.h>
 #include <differentiable_rmap/RmapGridSet.h>
+#include <differentiable_rmap/RmapGridShard.h>
 
 #include <libsvm/svm.h>
 
+#include <differentiable_rmap/CapabilityMapUtils.h>
 #include <differentiable_rmap/GridUtils.h>
 #include <differentiable_rmap/RosUtils.h>
 #include <differentiable_rmap/SamplingUtils.h>
@@ -39,6 +42,17 @@ public:
       \param load_grid whether to load grid set from file
    */
   virtual void runLoop(const std::string & grid_bag_path = "/tmp/rmap_grid_set.bag", bool load_grid = false) = 0;
+
+  /** \brief Generate one shard of grid set and dump it to ROS bag.
+      \param grid_bag_path path of ROS bag file of grid set (shard index is added to file name)
+      \param shard_idx index of shard
+   */
+  virtual void dumpGridShard(const std::string & grid_bag_path, int shard_idx) = 0;
+
+  /** \brief Generate capability map and dump it to ROS bag.
+      \param capability_bag_path path of ROS bag file of capability map
+   */
+  virtual void dumpCapabilityMap(const std::string & capability_bag_path) = 0;
 };
 
 /** \brief Class to plan in sample space based on differentiable reachability map.
@@ -63,6 +77,27 @@ public:
     //! Grid color
     std::array<double, 4> grid_color = {0.8, 0.0, 0.0, 1.0};
 
+    //! Duration to republish marker array even if there is no change [s] (non-positive for no republish)
+    double keep_alive_duration = 1.0;
+
+    //! Number of shards into which the grid index range is partitioned
+    int grid_shard_num = 1;
+
+    //! Number of grids written to one checkpoint chunk of shard (non-positive for no checkpoint)
+    int grid_checkpoint_interval = 0;
+
+    //! Number of approach directions to discretize orientation of capability map
+    int capability_direction_num = 64;
+
+    //! Number of rotation angles around approach direction to discretize orientation of capability map
+    int capability_roll_num = 8;
+
+    //! Number of threads to generate capability map (non-positive for hardware concurrency)
+    int capability_thread_num = 0;
+
+    //! Whether SVM is trained with samples canonicalized by rotation around z-axis (only for R3 and SE3)
+    bool yaw_symmetric = false;
+
     /*! \brief Load mc_rtc configuration. */
     inline void load(const mc_rtc::Configuration & mc_rtc_config)
     {
@@ -70,6 +105,13 @@ public:
       mc_rtc_config("pos_resolution", pos_resolution);
       mc_rtc_config("rot_resolution", rot_resolution);
       mc_rtc_config("grid_color", grid_color);
+      mc_rtc_config("keep_alive_duration", keep_alive_duration);
+      mc_rtc_config("grid_shard_num", grid_shard_num);
+      mc_rtc_config("grid_checkpoint_interval", grid_checkpoint_interval);
+      mc_rtc_config("capability_direction_num", capability_direction_num);
+      mc_rtc_config("capability_roll_num", capability_roll_num);
+      mc_rtc_config("capability_thread_num", capability_thread_num);
+      mc_rtc_config("yaw_symmetric", yaw_symmetric);
     }
   };
 
@@ -124,6 +166,25 @@ public:
    */
   virtual void runLoop(const std::string & grid_bag_path = "/tmp/rmap_grid_set.bag", bool load_grid = false) override;
 
+  /** \brief Generate one shard of grid set and dump it to ROS bag.
+      \param grid_bag_path path of ROS bag file of grid set (shard index is added to file name)
+      \param shard_idx index of shard
+
+      Shard computes the grid values in its part of the linear grid index range. If grid_checkpoint_interval is
+      positive, values are written to checkpoint chunks during computation, and the computation is resumed from them.
+      Shard is skipped if it has already been dumped with the same grid.
+   */
+  virtual void dumpGridShard(const std::string & grid_bag_path, int shard_idx) override;
+
+  /** \brief Generate capability map and dump it to ROS bag.
+      \param capability_bag_path path of ROS bag file of capability map
+
+      For each position grid (whose resolution is pos_resolution), the SVM value is evaluated for the orientations
+      discretized by makeCapabilityOrientationList(), and the ratio and bitmask of reachable orientations are stored.
+      Position grids are evaluated in parallel. Only SE3 is supported.
+   */
+  virtual void dumpCapabilityMap(const std::string & capability_bag_path) override;
+
 protected:
   /** \brief Load sample set from ROS bag. */
   void loadSampleSet(const std::string & sample_bag_path);
@@ -134,11 +195,52 @@ protected:
   /** \brief Load grid set. */
   void loadGridSet(const std::string & grid_bag_path);
 
-  /** \brief Dump generated grid set to ROS bag. */
+  /** \brief Dump generated grid set to ROS bag.
+
+      If grid_shard_num is greater than one or checkpoint is enabled, shards which are not yet dumped are generated,
+      and then all shards are merged.
+  */
   void dumpGridSet(const std::string & grid_bag_path);
 
-  /** \brief Update origin of slicing. */
-  void updateSliceOrigin();
+  /** \brief Set type, number of division, and min/max position of grid set message.
+      \return total number of grids
+  */
+  int setupGridSetMsg();
+
+  /** \brief Calculate grid values in range of grid index and append them.
+      \param[in] begin_idx first grid index
+      \param[in] end_idx grid index next to the last
+      \param[out] values list to which grid values are appended
+  */
+  void calcGridValues(int begin_idx, int end_idx, std::vector<double> & values) const;
+
+  /** \brief Get path of ROS bag file of grid shard.
+      \param grid_bag_path path of ROS bag file of grid set
+      \param shard_idx index of shard
+  */
+  static std::string gridShardPath(const std::string & grid_bag_path, int shard_idx);
+
+  /** \brief Check whether grid shard message has the same grid as grid set message. */
+  bool isSameGrid(const differentiable_rmap::RmapGridShard & grid_shard_msg) const;
+
+  /** \brief Write grid shard message to ROS bag via temporary file. */
+  void writeGridShard(const std::string & path, int begin_idx, const std::vector<double> & values) const;
+
+  /** \brief Merge grid shards into grid set message.
+      \param grid_bag_path path of ROS bag file of grid set
+  */
+  void mergeGridShards(const std::string & grid_bag_path);
+
+  /** \brief Update origin of slicing.
+      \return whether the origin of slicing is updated
+   */
+  bool updateSliceOrigin();
+
+  /** \brief Make reachable grids marker and list of reachable grid indices from grid set. */
+  void makeGridsMarker();
+
+  /** \brief Make sliced reachable grids marker from list of reachable grid indices. */
+  void makeSlicedGridsMarker();
 
   /** \brief Publish marker array. */
   void publishMarkerArray() const;
@@ -168,6 +270,18 @@ protected:
   //! Origin of slicing
   sva::PTransformd slice_origin_ = sva::PTransformd::Identity();
 
+  //! Reachable grids marker (made once in setup())
+  visualization_msgs::Marker grids_marker_;
+
+  //! Sliced reachable grids marker (remade only when the origin of slicing is updated)
+  visualization_msgs::Marker sliced_grids_marker_;
+
+  //! List of reachable grid indices (same order as grids_marker_.points)
+  std::vector<int> reachable_grid_idxs_;
+
+  //! Time of last publish
+  ros::Time last_publish_time_;
+
   //! ROS related members
   ros::NodeHandle nh_;
 
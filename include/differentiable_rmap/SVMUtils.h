@@ -6,6 +6,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <vector>
+
 #include <libsvm/svm.h>
 
 #include <differentiable_rmap/SamplingUtils.h>
@@ -53,6 +59,7 @@ Input<SamplingSpaceType> svmNodeToEigenVec(const svm_node * input_node);
     \param svm_mo SVM model
     \param svm_coeff_vec support vector coefficients
     \param svm_sv_mat support vector matrix
+    \param yaw_symmetric whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
     \return predicted SVM value
 */
 template<SamplingSpace SamplingSpaceType>
@@ -60,7 +67,8 @@ double calcSVMValue(const Sample<SamplingSpaceType> & sample,
                     const svm_parameter & svm_param,
                     svm_model * svm_mo,
                     const Eigen::VectorXd & svm_coeff_vec,
-                    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat);
+                    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+                    bool yaw_symmetric = false);
 
 /** \brief Calculate gradient of SVM value.
     \tparam SamplingSpaceType sampling space
@@ -69,6 +77,7 @@ double calcSVMValue(const Sample<SamplingSpaceType> & sample,
     \param svm_mo SVM model
     \param svm_coeff_vec support vector coefficients
     \param svm_sv_mat support vector matrix
+    \param yaw_symmetric whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
     \return gradient of predicted SVM value (column vector)
 */
 template<SamplingSpace SamplingSpaceType>
@@ -77,7 +86,175 @@ Sample<SamplingSpaceType> calcSVMGrad(
     const svm_parameter & svm_param,
     svm_model * svm_mo,
     const Eigen::VectorXd & svm_coeff_vec,
-    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat);
+    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+    bool yaw_symmetric = false);
+
+/*! \brief Type of matrix whose columns are samples.
+
+    Unlike SampleBatch in SamplingBatchUtils.h, the elements of each sample are stored contiguously, so the memory of a
+    C-contiguous NumPy array of shape (N, sample_dim) can be mapped without copy.
+*/
+template<SamplingSpace SamplingSpaceType>
+using SampleColumns = Eigen::Matrix<double, sampleDim<SamplingSpaceType>(), Eigen::Dynamic>;
+
+/** \brief Calculate SVM values of batch of samples in parallel.
+    \tparam SamplingSpaceType sampling space
+    \param[out] values predicted SVM values (size is the number of samples)
+    \param[in] samples batch of samples (one sample per column)
+    \param[in] svm_param SVM parameter
+    \param[in] svm_mo SVM model
+    \param[in] svm_coeff_vec support vector coefficients
+    \param[in] svm_sv_mat support vector matrix
+    \param[in] yaw_symmetric whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
+    \param[in] thread_num number of threads (if non-positive, the number of hardware threads is used)
+
+    The result is the same as calcSVMValue() for each sample.
+*/
+template<SamplingSpace SamplingSpaceType>
+void calcSVMValueBatch(Eigen::Ref<Eigen::VectorXd> values,
+                       const Eigen::Ref<const SampleColumns<SamplingSpaceType>> & samples,
+                       const svm_parameter & svm_param,
+                       svm_model * svm_mo,
+                       const Eigen::VectorXd & svm_coeff_vec,
+                       const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+                       bool yaw_symmetric = false,
+                       int thread_num = 0);
+
+/** \brief Calculate gradients of SVM value of batch of samples in parallel.
+    \tparam SamplingSpaceType sampling space
+    \param[out] grads gradients of predicted SVM value (one gradient per column)
+    \param[in] samples batch of samples (one sample per column)
+    \param[in] svm_param SVM parameter
+    \param[in] svm_mo SVM model
+    \param[in] svm_coeff_vec support vector coefficients
+    \param[in] svm_sv_mat support vector matrix
+    \param[in] yaw_symmetric whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
+    \param[in] thread_num number of threads (if non-positive, the number of hardware threads is used)
+
+    The result is the same as calcSVMGrad() for each sample.
+*/
+template<SamplingSpace SamplingSpaceType>
+void calcSVMGradBatch(Eigen::Ref<SampleColumns<SamplingSpaceType>> grads,
+                      const Eigen::Ref<const SampleColumns<SamplingSpaceType>> & samples,
+                      const svm_parameter & svm_param,
+                      svm_model * svm_mo,
+                      const Eigen::VectorXd & svm_coeff_vec,
+                      const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+                      bool yaw_symmetric = false,
+                      int thread_num = 0);
+
+/** \brief Calculate SVM value and its gradient w.r.t. input at once.
+    \tparam SamplingSpaceType sampling space
+    \param[out] input_grad gradient of predicted SVM value w.r.t. input (column vector)
+    \param[in] input SVM input
+    \param[in] svm_param SVM parameter
+    \param[in] svm_mo SVM model
+    \param[in] svm_coeff_vec support vector coefficients
+    \param[in] svm_sv_mat support vector matrix
+    \param[in] yaw_symmetric whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
+    \return predicted SVM value
+
+    If yaw_symmetric is true, the input is canonicalized before prediction, and the gradient is converted to that
+    w.r.t. the original input by canonicalInputGradToInputGrad().
+*/
+template<SamplingSpace SamplingSpaceType>
+double calcSVMValueAndInputGrad(
+    Eigen::Ref<Input<SamplingSpaceType>> input_grad,
+    const Input<SamplingSpaceType> & input,
+    const svm_parameter & svm_param,
+    svm_model * svm_mo,
+    const Eigen::VectorXd & svm_coeff_vec,
+    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+    bool yaw_symmetric = false);
+
+/** \brief Convert gradient w.r.t. canonical input to gradient w.r.t. original input.
+    \tparam SamplingSpaceType sampling space (only R3 and SE3 are supported)
+    \param input original SVM input
+    \param canonical_input_grad gradient w.r.t. canonical input (i.e., canonicalizeInputYaw() of input)
+
+    Canonicalization rotates the input by the yaw angle of position around z-axis. The gradient is rotated back, and
+    its component along the rotation around z-axis is removed because the yaw angle also depends on position.
+*/
+template<SamplingSpace SamplingSpaceType>
+Input<SamplingSpaceType> canonicalInputGradToInputGrad(const Input<SamplingSpaceType> & input,
+                                                       const Input<SamplingSpaceType> & canonical_input_grad);
+
+/** \brief Calculate upper bound of the spectral norm of Hessian of SVM value w.r.t. input.
+    \param svm_param SVM parameter
+    \param svm_coeff_vec support vector coefficients
+
+    The eigenvalues of Hessian of the RBF kernel \f$\exp(-\gamma \|x - s\|^2)\f$ are bounded by \f$2 \gamma\f$ in
+    absolute value, so the bound is \f$2 \gamma \sum_i |\alpha_i|\f$.
+*/
+inline double calcSVMHessianBound(const svm_parameter & svm_param, const Eigen::VectorXd & svm_coeff_vec)
+{
+  return 2 * svm_param.gamma * svm_coeff_vec.cwiseAbs().sum();
+}
+
+/** \brief Local linear surrogate of SVM value.
+    \tparam SamplingSpaceType sampling space
+
+    The surrogate is the first-order Taylor expansion of SVM value w.r.t. input at the last exact evaluation. For the
+    input apart from the expansion point by \f$r\f$, the error of the surrogate value is bounded by \f$H r^2 / 2\f$ and
+    the error of the surrogate gradient is bounded by \f$H r\f$, where \f$H\f$ is given by calcSVMHessianBound().
+*/
+template<SamplingSpace SamplingSpaceType>
+struct SVMSurrogate
+{
+  //! Whether the surrogate is built
+  bool valid = false;
+
+  //! SVM input at the expansion point
+  Input<SamplingSpaceType> input = Input<SamplingSpaceType>::Zero();
+
+  //! SVM value at the expansion point
+  double value = 0.0;
+
+  //! Gradient of SVM value w.r.t. input at the expansion point
+  Input<SamplingSpaceType> input_grad = Input<SamplingSpaceType>::Zero();
+
+  /** \brief Check whether the surrogate can be used for the input.
+      \param new_input SVM input
+      \param hessian_bound upper bound of the spectral norm of Hessian (see calcSVMHessianBound())
+      \param tol tolerance of the error bound of surrogate value
+      \param trust_radius trust radius of surrogate in input space
+  */
+  inline bool isTrusted(const Input<SamplingSpaceType> & new_input,
+                        double hessian_bound,
+                        double tol,
+                        double trust_radius) const
+  {
+    if(!valid)
+    {
+      return false;
+    }
+    double dist_sq = (new_input - input).squaredNorm();
+    return dist_sq <= std::pow(trust_radius, 2) && 0.5 * hessian_bound * dist_sq <= tol;
+  }
+
+  /** \brief Calculate surrogate SVM value.
+      \param new_input SVM input
+  */
+  inline double calcValue(const Input<SamplingSpaceType> & new_input) const
+  {
+    return value + input_grad.dot(new_input - input);
+  }
+};
+
+/** \brief Shift surrogates to the front by the given number and invalidate the vacated surrogates at the back.
+    \param first iterator to the first surrogate
+    \param last iterator past the last surrogate
+    \param shift_num number of shift
+
+    This is used to carry over the surrogates when the sequence of samples is shifted in receding horizon planning.
+*/
+template<class IterType>
+void shiftSVMSurrogates(IterType first, IterType last, int shift_num)
+{
+  IterType middle = (last - first > shift_num) ? first + shift_num : last;
+  IterType new_last = std::move(middle, last, first);
+  std::fill(new_last, last, typename std::iterator_traits<IterType>::value_type());
+}
 
 /*! \brief Type of matrix to represent the linear relation from input to sample. */
 template<SamplingSpace SamplingSpaceType>
@@ -119,6 +296,18 @@ template<SamplingSpace SamplingSpaceType>
 Sample<SamplingSpaceType> midSample(const Sample<SamplingSpaceType> & sample1,
                                     const Sample<SamplingSpaceType> & sample2);
 
+/** \brief Get sample extrapolated from two samples.
+    \tparam SamplingSpaceType sampling space
+    \param pre_sample predecessor sample
+    \param sample current sample
+
+    The relative sample from the current sample to the returned sample is the same as that from the predecessor sample
+    to the current sample.
+*/
+template<SamplingSpace SamplingSpaceType>
+Sample<SamplingSpaceType> extrapolateSample(const Sample<SamplingSpaceType> & pre_sample,
+                                            const Sample<SamplingSpaceType> & sample);
+
 /*! \brief Type of matrix to represent the linear relation from sample to sample. */
 template<SamplingSpace SamplingSpaceType>
 using SampleToSampleMat = Eigen::Matrix<double, sampleDim<SamplingSpaceType>(), sampleDim<SamplingSpaceType>()>;
@@ -134,6 +323,28 @@ template<SamplingSpace SamplingSpaceType>
 SampleToSampleMat<SamplingSpaceType> relSampleToSampleMat(const Sample<SamplingSpaceType> & pre_sample,
                                                           const Sample<SamplingSpaceType> & suc_sample,
                                                           bool wrt_suc);
+
+/** \brief Calculate SVM value of relative sample and its gradients w.r.t. predecessor and successor vels at once.
+    \tparam SamplingSpaceType sampling space
+    \tparam SVMFuncType type of function to calculate SVM value and its gradient w.r.t. input, whose signature is
+    double(Input<SamplingSpaceType> & input_grad, const Input<SamplingSpaceType> & input)
+    \param[out] pre_vel_grad gradient of SVM value w.r.t. predecessor vel (column vector)
+    \param[out] suc_vel_grad gradient of SVM value w.r.t. successor vel (column vector)
+    \param[in] pre_sample predecessor sample
+    \param[in] suc_sample successor sample
+    \param[in] svm_func function to calculate SVM value and its gradient w.r.t. input
+    \return SVM value of relative sample
+
+    The result is the same as the chain of relSample(), sampleToInput(), inputToSampleMat(), relSampleToSampleMat(),
+    and sampleToVelMat(), but the trigonometric functions and rotation matrices are computed only once and the
+    gradients are calculated in closed form without forming the intermediate matrices.
+*/
+template<SamplingSpace SamplingSpaceType, class SVMFuncType>
+double calcRelSVMValueAndVelGrad(Vel<SamplingSpaceType> & pre_vel_grad,
+                                 Vel<SamplingSpaceType> & suc_vel_grad,
+                                 const Sample<SamplingSpaceType> & pre_sample,
+                                 const Sample<SamplingSpaceType> & suc_sample,
+                                 const SVMFuncType & svm_func);
 } // namespace DiffRmap
 
 // See method 3 in https://www.codeproject.com/Articles/48575/How-to-Define-a-Template-Class-in-a-h-File-and-Imp
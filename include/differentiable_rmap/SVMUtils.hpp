@@ -1,7 +1,50 @@
 /* Author: Masaki Murooka */
 
+#include <array>
+
 namespace DiffRmap
 {
+namespace detail
+{
+/** \brief Call function for each chunk of indices in parallel.
+    \tparam FuncType type of function whose signature is void(Eigen::Index begin_idx, Eigen::Index end_idx)
+    \param begin_idx first index
+    \param end_idx index past the last one
+    \param thread_num number of threads (if non-positive, the number of hardware threads is used)
+    \param func function called for each chunk
+*/
+template<class FuncType>
+inline void parallelForChunk(Eigen::Index begin_idx, Eigen::Index end_idx, int thread_num, const FuncType & func)
+{
+  // Each worker takes the next chunk, which is large enough to make the cost of atomic operation negligible
+  constexpr Eigen::Index chunk_size = 256;
+  std::atomic<Eigen::Index> next_idx(begin_idx);
+  auto work = [&]() {
+    for(Eigen::Index idx = next_idx.fetch_add(chunk_size); idx < end_idx; idx = next_idx.fetch_add(chunk_size))
+    {
+      func(idx, std::min(idx + chunk_size, end_idx));
+    }
+  };
+
+  if(thread_num <= 0)
+  {
+    thread_num = std::max(1u, std::thread::hardware_concurrency());
+  }
+  Eigen::Index chunk_num = (end_idx - begin_idx + chunk_size - 1) / chunk_size;
+  std::vector<std::thread> thread_list;
+  // The calling thread also works
+  for(Eigen::Index i = 1; i < std::min(static_cast<Eigen::Index>(thread_num), chunk_num); i++)
+  {
+    thread_list.emplace_back(work);
+  }
+  work();
+  for(auto & thread : thread_list)
+  {
+    thread.join();
+  }
+}
+} // namespace detail
+
 template<SamplingSpace SamplingSpaceType>
 void setSVMPredictionMat(Eigen::Ref<Eigen::VectorXd> svm_coeff_vec,
                          Eigen::Ref<Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic>> svm_sv_mat,
@@ -57,7 +100,8 @@ double calcSVMValue(const Sample<SamplingSpaceType> & sample,
                     const svm_parameter & svm_param,
                     svm_model * svm_mo,
                     const Eigen::VectorXd & svm_coeff_vec,
-                    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat)
+                    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+                    bool yaw_symmetric)
 {
   if(!(svm_mo->param.svm_type == ONE_CLASS || svm_mo->param.svm_type == NU_SVC))
   {
@@ -71,12 +115,16 @@ double calcSVMValue(const Sample<SamplingSpaceType> & sample,
                                                      svm_param.kernel_type);
   }
 
-  return svm_coeff_vec.dot((-svm_param.gamma
-                            * (svm_sv_mat.colwise() - sampleToInput<SamplingSpaceType>(sample)).colwise().squaredNorm())
-                               .array()
-                               .exp()
-                               .matrix())
-         - svm_mo->rho[0];
+  // Loop over support vectors instead of vectorized expression to avoid heap allocation of temporaries
+  const Input<SamplingSpaceType> & orig_input = sampleToInput<SamplingSpaceType>(sample);
+  const Input<SamplingSpaceType> & input =
+      yaw_symmetric ? canonicalizeInputYaw<SamplingSpaceType>(orig_input) : orig_input;
+  double value = 0;
+  for(Eigen::Index i = 0; i < svm_sv_mat.cols(); i++)
+  {
+    value += svm_coeff_vec[i] * std::exp(-svm_param.gamma * (svm_sv_mat.col(i) - input).squaredNorm());
+  }
+  return value - svm_mo->rho[0];
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -85,7 +133,8 @@ Sample<SamplingSpaceType> calcSVMGrad(
     const svm_parameter & svm_param,
     svm_model * svm_mo,
     const Eigen::VectorXd & svm_coeff_vec,
-    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat)
+    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+    bool yaw_symmetric)
 {
   if(!(svm_mo->param.svm_type == ONE_CLASS || svm_mo->param.svm_type == NU_SVC))
   {
@@ -99,12 +148,172 @@ Sample<SamplingSpaceType> calcSVMGrad(
                                                      svm_param.kernel_type);
   }
 
-  Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> sv_mat_minus_input =
-      svm_sv_mat.colwise() - sampleToInput<SamplingSpaceType>(sample);
+  // Loop over support vectors instead of vectorized expression to avoid heap allocation of temporaries
+  const Input<SamplingSpaceType> & orig_input = sampleToInput<SamplingSpaceType>(sample);
+  const Input<SamplingSpaceType> & input =
+      yaw_symmetric ? canonicalizeInputYaw<SamplingSpaceType>(orig_input) : orig_input;
+  Input<SamplingSpaceType> input_grad = Input<SamplingSpaceType>::Zero();
+  for(Eigen::Index i = 0; i < svm_sv_mat.cols(); i++)
+  {
+    const Input<SamplingSpaceType> & sv_minus_input = svm_sv_mat.col(i) - input;
+    input_grad += svm_coeff_vec[i] * std::exp(-svm_param.gamma * sv_minus_input.squaredNorm()) * sv_minus_input;
+  }
+  if(yaw_symmetric)
+  {
+    input_grad = canonicalInputGradToInputGrad<SamplingSpaceType>(orig_input, input_grad);
+  }
+
+  return inputToSampleMat<SamplingSpaceType>(sample) * (2 * svm_param.gamma * input_grad);
+}
+
+template<SamplingSpace SamplingSpaceType>
+void calcSVMValueBatch(Eigen::Ref<Eigen::VectorXd> values,
+                       const Eigen::Ref<const SampleColumns<SamplingSpaceType>> & samples,
+                       const svm_parameter & svm_param,
+                       svm_model * svm_mo,
+                       const Eigen::VectorXd & svm_coeff_vec,
+                       const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+                       bool yaw_symmetric,
+                       int thread_num)
+{
+  if(values.size() != samples.cols())
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[calcSVMValueBatch] Size of values and samples differ: {} != {}",
+                                                     values.size(), samples.cols());
+  }
+  if(samples.cols() == 0)
+  {
+    return;
+  }
+
+  // Calculate the first sample in the calling thread so that the error of unsupported model is not thrown in workers
+  values[0] = calcSVMValue<SamplingSpaceType>(samples.col(0), svm_param, svm_mo, svm_coeff_vec, svm_sv_mat,
+                                              yaw_symmetric);
+  detail::parallelForChunk(1, samples.cols(), thread_num, [&](Eigen::Index begin_idx, Eigen::Index end_idx) {
+    for(Eigen::Index i = begin_idx; i < end_idx; i++)
+    {
+      values[i] = calcSVMValue<SamplingSpaceType>(samples.col(i), svm_param, svm_mo, svm_coeff_vec, svm_sv_mat,
+                                                  yaw_symmetric);
+    }
+  });
+}
+
+template<SamplingSpace SamplingSpaceType>
+void calcSVMGradBatch(Eigen::Ref<SampleColumns<SamplingSpaceType>> grads,
+                      const Eigen::Ref<const SampleColumns<SamplingSpaceType>> & samples,
+                      const svm_parameter & svm_param,
+                      svm_model * svm_mo,
+                      const Eigen::VectorXd & svm_coeff_vec,
+                      const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+                      bool yaw_symmetric,
+                      int thread_num)
+{
+  if(grads.cols() != samples.cols())
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[calcSVMGradBatch] Size of grads and samples differ: {} != {}",
+                                                     grads.cols(), samples.cols());
+  }
+  if(samples.cols() == 0)
+  {
+    return;
+  }
+
+  // Calculate the first sample in the calling thread so that the error of unsupported model is not thrown in workers
+  grads.col(0) =
+      calcSVMGrad<SamplingSpaceType>(samples.col(0), svm_param, svm_mo, svm_coeff_vec, svm_sv_mat, yaw_symmetric);
+  detail::parallelForChunk(1, samples.cols(), thread_num, [&](Eigen::Index begin_idx, Eigen::Index end_idx) {
+    for(Eigen::Index i = begin_idx; i < end_idx; i++)
+    {
+      grads.col(i) =
+          calcSVMGrad<SamplingSpaceType>(samples.col(i), svm_param, svm_mo, svm_coeff_vec, svm_sv_mat, yaw_symmetric);
+    }
+  });
+}
+
+template<SamplingSpace SamplingSpaceType>
+double calcSVMValueAndInputGrad(
+    Eigen::Ref<Input<SamplingSpaceType>> input_grad,
+    const Input<SamplingSpaceType> & input,
+    const svm_parameter & svm_param,
+    svm_model * svm_mo,
+    const Eigen::VectorXd & svm_coeff_vec,
+    const Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> & svm_sv_mat,
+    bool yaw_symmetric)
+{
+  if(!(svm_mo->param.svm_type == ONE_CLASS || svm_mo->param.svm_type == NU_SVC))
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[calcSVMValueAndInputGrad] Only one-class or nu-svc SVM is supported: {}", svm_mo->param.svm_type);
+  }
+
+  if(svm_param.kernel_type != RBF)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[calcSVMValueAndInputGrad] Only RBF kernel is supported: {}",
+                                                     svm_param.kernel_type);
+  }
+
+  // Loop over support vectors instead of vectorized expression to avoid heap allocation of temporaries
+  const Input<SamplingSpaceType> & canonical_input =
+      yaw_symmetric ? canonicalizeInputYaw<SamplingSpaceType>(input) : input;
+  double value = 0;
+  input_grad.setZero();
+  for(Eigen::Index i = 0; i < svm_sv_mat.cols(); i++)
+  {
+    const Input<SamplingSpaceType> & sv_minus_input = svm_sv_mat.col(i) - canonical_input;
+    double weighted_kernel = svm_coeff_vec[i] * std::exp(-svm_param.gamma * sv_minus_input.squaredNorm());
+    value += weighted_kernel;
+    input_grad += weighted_kernel * sv_minus_input;
+  }
+  input_grad *= 2 * svm_param.gamma;
+  if(yaw_symmetric)
+  {
+    input_grad = canonicalInputGradToInputGrad<SamplingSpaceType>(input, input_grad);
+  }
+
+  return value - svm_mo->rho[0];
+}
+
+template<SamplingSpace SamplingSpaceType>
+Input<SamplingSpaceType> canonicalInputGradToInputGrad(const Input<SamplingSpaceType> & input,
+                                                       const Input<SamplingSpaceType> & canonical_input_grad)
+{
+  if constexpr(SamplingSpaceType == SamplingSpace::R3 || SamplingSpaceType == SamplingSpace::SE3)
+  {
+    // Pairs of indices of x and y elements rotated by canonicalization (i.e., position and columns of rotation)
+    constexpr int xy_pair_num = (SamplingSpaceType == SamplingSpace::SE3 ? 4 : 1);
+    constexpr std::array<std::array<int, 2>, 4> xy_idxs_list = {{{0, 1}, {3, 6}, {4, 7}, {5, 8}}};
+
+    double r = input.template head<2>().norm();
+    double cos = r > 0 ? input.x() / r : 1.0;
+    double sin = r > 0 ? input.y() / r : 0.0;
+    const Input<SamplingSpaceType> & canonical_input = canonicalizeInputYaw<SamplingSpaceType>(input);
+
+    // Rotate gradient back, and calculate derivative along rotation of canonical input around z-axis
+    Input<SamplingSpaceType> input_grad = canonical_input_grad;
+    double yaw_deriv = 0.0;
+    for(int i = 0; i < xy_pair_num; i++)
+    {
+      int x_idx = xy_idxs_list[i][0];
+      int y_idx = xy_idxs_list[i][1];
+      input_grad[x_idx] = cos * canonical_input_grad[x_idx] - sin * canonical_input_grad[y_idx];
+      input_grad[y_idx] = sin * canonical_input_grad[x_idx] + cos * canonical_input_grad[y_idx];
+      yaw_deriv += -canonical_input_grad[x_idx] * canonical_input[y_idx]
+                   + canonical_input_grad[y_idx] * canonical_input[x_idx];
+    }
 
-  return inputToSampleMat<SamplingSpaceType>(sample) * 2 * svm_param.gamma * sv_mat_minus_input
-         * svm_coeff_vec.cwiseProduct(
-             (-svm_param.gamma * sv_mat_minus_input.colwise().squaredNorm()).array().exp().matrix().transpose());
+    // Subtract the term of yaw angle, whose gradient w.r.t. position is (-y, x, 0) / r^2
+    if(r > 0)
+    {
+      input_grad[0] += input.y() / (r * r) * yaw_deriv;
+      input_grad[1] -= input.x() / (r * r) * yaw_deriv;
+    }
+    return input_grad;
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[canonicalInputGradToInputGrad] Unsupported SamplingSpace: {}",
+                                                     std::to_string(SamplingSpaceType));
+  }
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -277,6 +486,22 @@ Sample<SamplingSpaceType> midSample(const Sample<SamplingSpaceType> & sample1,
   }
 }
 
+template<SamplingSpace SamplingSpaceType>
+Sample<SamplingSpaceType> extrapolateSample(const Sample<SamplingSpaceType> & pre_sample,
+                                            const Sample<SamplingSpaceType> & sample)
+{
+  if constexpr(SamplingSpaceType == SamplingSpace::R2 || SamplingSpaceType == SamplingSpace::R3)
+  {
+    return 2 * sample - pre_sample;
+  }
+  else
+  {
+    // Apply the displacement from pre_sample to sample again in the same local frame
+    sva::PTransformd pose = sampleToPose<SamplingSpaceType>(sample);
+    return poseToSample<SamplingSpaceType>(pose * sampleToPose<SamplingSpaceType>(pre_sample).inv() * pose);
+  }
+}
+
 template<SamplingSpace SamplingSpaceType>
 SampleToSampleMat<SamplingSpaceType> relSampleToSampleMat(const Sample<SamplingSpaceType> & pre_sample,
                                                           const Sample<SamplingSpaceType> & suc_sample,
@@ -379,4 +604,108 @@ inline SampleToSampleMat<SamplingSpace::SE3> relSampleToSampleMat<SamplingSpace:
 
   return mat;
 }
+
+template<SamplingSpace SamplingSpaceType, class SVMFuncType>
+double calcRelSVMValueAndVelGrad(Vel<SamplingSpaceType> & pre_vel_grad,
+                                 Vel<SamplingSpaceType> & suc_vel_grad,
+                                 const Sample<SamplingSpaceType> & pre_sample,
+                                 const Sample<SamplingSpaceType> & suc_sample,
+                                 const SVMFuncType & svm_func)
+{
+  Input<SamplingSpaceType> input;
+  Input<SamplingSpaceType> input_grad;
+  double value = 0;
+
+  if constexpr(SamplingSpaceType == SamplingSpace::R2 || SamplingSpaceType == SamplingSpace::R3)
+  {
+    input = suc_sample - pre_sample;
+    value = svm_func(input_grad, input);
+
+    suc_vel_grad = input_grad;
+    pre_vel_grad = -input_grad;
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SO2 || SamplingSpaceType == SamplingSpace::SE2)
+  {
+    constexpr int angle_idx = sampleDim<SamplingSpaceType>() - 1;
+    constexpr bool has_pos = (SamplingSpaceType == SamplingSpace::SE2);
+
+    // Relative angle is not wrapped because only its cos and sin are used
+    double rel_angle = suc_sample[angle_idx] - pre_sample[angle_idx];
+    double rel_cos = std::cos(rel_angle);
+    double rel_sin = std::sin(rel_angle);
+    input.template tail<inputDim<SamplingSpace::SO2>()>() << rel_cos, -rel_sin, rel_sin, rel_cos;
+    double cos = 1.0;
+    double sin = 0.0;
+    if constexpr(has_pos)
+    {
+      cos = std::cos(pre_sample.z());
+      sin = std::sin(pre_sample.z());
+      double pos_error_x = suc_sample.x() - pre_sample.x();
+      double pos_error_y = suc_sample.y() - pre_sample.y();
+      input.template head<2>() << cos * pos_error_x + sin * pos_error_y, -sin * pos_error_x + cos * pos_error_y;
+    }
+    value = svm_func(input_grad, input);
+
+    const auto & rot_input_grad = input_grad.template tail<inputDim<SamplingSpace::SO2>()>();
+    double rel_angle_grad =
+        -(rot_input_grad[0] + rot_input_grad[3]) * rel_sin + (rot_input_grad[2] - rot_input_grad[1]) * rel_cos;
+    suc_vel_grad[angle_idx] = rel_angle_grad;
+    pre_vel_grad[angle_idx] = -rel_angle_grad;
+    if constexpr(has_pos)
+    {
+      suc_vel_grad.template head<2>() << cos * input_grad.x() - sin * input_grad.y(),
+          sin * input_grad.x() + cos * input_grad.y();
+      pre_vel_grad.template head<2>() = -suc_vel_grad.template head<2>();
+      // Relative position is rotated by the predecessor angle
+      pre_vel_grad.z() += input_grad.x() * input.y() - input_grad.y() * input.x();
+    }
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SO3 || SamplingSpaceType == SamplingSpace::SE3)
+  {
+    constexpr int pos_dim = (SamplingSpaceType == SamplingSpace::SE3 ? 3 : 0);
+    using RowMajorMatrix3d = Eigen::Matrix<double, 3, 3, Eigen::RowMajor>;
+
+    // Element order of SO3 sample is (x, y, z, w)
+    const auto & pre_quat_sample = pre_sample.template tail<sampleDim<SamplingSpace::SO3>()>();
+    const auto & suc_quat_sample = suc_sample.template tail<sampleDim<SamplingSpace::SO3>()>();
+    Eigen::Quaterniond pre_quat(pre_quat_sample.w(), pre_quat_sample.x(), pre_quat_sample.y(), pre_quat_sample.z());
+    Eigen::Quaterniond suc_quat(suc_quat_sample.w(), suc_quat_sample.x(), suc_quat_sample.y(), suc_quat_sample.z());
+    const Eigen::Matrix3d & rel_rot = (pre_quat.conjugate() * suc_quat).toRotationMatrix();
+    // SO3 input arranges the elements of rotation matrix row by row
+    Eigen::Map<RowMajorMatrix3d>(input.data() + pos_dim) = rel_rot;
+    Eigen::Matrix3d pre_rot;
+    if constexpr(pos_dim > 0)
+    {
+      pre_rot = pre_quat.toRotationMatrix();
+      input.template head<3>().noalias() =
+          pre_rot.transpose() * (suc_sample.template head<3>() - pre_sample.template head<3>());
+    }
+    value = svm_func(input_grad, input);
+
+    // Derivatives of relative rotation are rel_rot * [suc_ang_vel]x and -[pre_ang_vel]x * rel_rot
+    const Eigen::Map<const RowMajorMatrix3d> rot_input_grad(input_grad.data() + pos_dim);
+    Eigen::Matrix3d suc_mat;
+    Eigen::Matrix3d pre_mat;
+    suc_mat.noalias() = rel_rot.transpose() * rot_input_grad;
+    pre_mat.noalias() = rot_input_grad * rel_rot.transpose();
+    suc_vel_grad.template tail<3>() << suc_mat(2, 1) - suc_mat(1, 2), suc_mat(0, 2) - suc_mat(2, 0),
+        suc_mat(1, 0) - suc_mat(0, 1);
+    pre_vel_grad.template tail<3>() << pre_mat(1, 2) - pre_mat(2, 1), pre_mat(2, 0) - pre_mat(0, 2),
+        pre_mat(0, 1) - pre_mat(1, 0);
+    if constexpr(pos_dim > 0)
+    {
+      suc_vel_grad.template head<3>().noalias() = pre_rot * input_grad.template head<3>();
+      pre_vel_grad.template head<3>() = -suc_vel_grad.template head<3>();
+      // Relative position is rotated by the predecessor rotation
+      pre_vel_grad.template tail<3>() += input_grad.template head<3>().cross(input.template head<3>());
+    }
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[calcRelSVMValueAndVelGrad] Unsupported SamplingSpace: {}",
+                                                     std::to_string(SamplingSpaceType));
+  }
+
+  return value;
+}
 } // namespace DiffRmap
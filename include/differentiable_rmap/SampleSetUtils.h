@@ -0,0 +1,73 @@
+/* Author: Masaki Murooka */
+
+/** \file SampleSetUtils.h
+    Utilities for sample set.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace DiffRmap
+{
+/** \brief Function to call sample function for each sample of given reachability.
+
+    The first argument is the reachability of samples to be passed, and the second argument is the sample function,
+    which is called with the pointer to the position of each sample.
+*/
+using ForEachSampleFunc = std::function<void(bool, const std::function<void(const double *)> &)>;
+
+/** \brief Dump sample set to ROS bag by serializing samples directly into the file.
+    \param bag_path path of ROS bag file
+    \param type type of sampling space
+    \param sample_dim dimension of sample
+    \param sample_num number of samples passed by for_each_sample
+    \param min min position of samples
+    \param max max position of samples
+    \param for_each_sample function to call sample function for each sample of given reachability
+
+    for_each_sample is called for the reachable samples first and then for the unreachable samples because libsvm
+    considers the first class to be positive. The samples are written to the file through a fixed-size buffer as they
+    are passed, so that neither RmapSampleSet message nor its serialized bytes are held in memory. The file is the same
+    as the one written by rosbag::Bag with one RmapSampleSet message on /rmap_sample_set topic. Since the length of ROS
+    message is 32-bit, an exception is thrown if the sample set exceeds 4 GB.
+
+    The file is written to a temporary file and then renamed so that an exception does not leave a broken file.
+*/
+void dumpSampleSetStream(const std::string & bag_path,
+                         int type,
+                         size_t sample_dim,
+                         size_t sample_num,
+                         const std::vector<double> & min,
+                         const std::vector<double> & max,
+                         const ForEachSampleFunc & for_each_sample);
+
+/** \brief Merge sample sets in ROS bag files into one ROS bag file.
+    \param input_bag_path_list path list of input ROS bag files of RmapSampleSet message (e.g., shards of sampling)
+    \param output_bag_path path of output ROS bag file
+    \param dedup whether to remove samples whose position is the same as that of another sample
+    \param hash_num_per_pass max number of position hashes held in memory at once for dedup
+    \return number of samples in merged sample set
+
+    Input files are loaded one at a time, and the merged sample set is written with dumpSampleSetStream(). The memory
+    usage is dominated by the largest input file and, if dedup is true, approximately 8 * hash_num_per_pass bytes of
+    position hashes and the positions of duplicated samples. If the number of samples exceeds hash_num_per_pass,
+    hashes are partitioned by their value and the input files are read once for each partition.
+
+    Min/max of merged samples are recomputed, and reachable samples are placed before unreachable samples because
+    libsvm considers the first class to be positive. When duplicated samples have different reachabilities, the
+    reachable one is kept. Positions are compared by 64-bit hash first, and the positions of samples sharing a hash
+    are compared exactly so that hash collisions do not remove distinct samples.
+
+    Input files are read once to check them and calculate min/max, once for each hash partition (only if there are
+    multiple partitions), once more to collect the positions of samples sharing a hash (only if there are such
+    samples), and once for each reachability to write samples (input files without samples of that reachability are
+    skipped).
+*/
+size_t mergeSampleSet(const std::vector<std::string> & input_bag_path_list,
+                      const std::string & output_bag_path,
+                      bool dedup = true,
+                      size_t hash_num_per_pass = 16777216);
+} // namespace DiffRmap
@@ -0,0 +1,87 @@
+/* Author: Masaki Murooka */
+
+/** \file SamplingBatchUtils.h
+    Utilities to convert a batch of samples at once.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/SamplingUtils.h>
+
+namespace DiffRmap
+{
+/*! \brief Type of batch of samples in structure-of-arrays layout.
+
+    Each column corresponds to one sample. The matrix is row-major so that each element of all samples is stored
+    contiguously, which allows the coefficient-wise operations over the samples to be vectorized by Eigen.
+*/
+template<SamplingSpace SamplingSpaceType>
+using SampleBatch = Eigen::Matrix<double, sampleDim<SamplingSpaceType>(), Eigen::Dynamic, Eigen::RowMajor>;
+
+/*! \brief Type of batch of SVM inputs in structure-of-arrays layout. */
+template<SamplingSpace SamplingSpaceType>
+using InputBatch = Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic, Eigen::RowMajor>;
+
+/*! \brief Type of batch of velocities in structure-of-arrays layout. */
+template<SamplingSpace SamplingSpaceType>
+using VelBatch = Eigen::Matrix<double, velDim<SamplingSpaceType>(), Eigen::Dynamic, Eigen::RowMajor>;
+
+/*! \brief Type of batch of grid positions in structure-of-arrays layout. */
+template<SamplingSpace SamplingSpaceType>
+using GridPosBatch = Eigen::Matrix<double, gridDim<SamplingSpaceType>(), Eigen::Dynamic, Eigen::RowMajor>;
+
+/** \brief Convert batch of poses to batch of samples.
+    \tparam SamplingSpaceType sampling space
+    \param[out] sample_batch batch of samples (resized to the number of poses)
+    \param[in] pose_list list of poses
+
+    Since the conversion from rotation matrix to quaternion has branches, each pose is converted by poseToSample().
+*/
+template<SamplingSpace SamplingSpaceType>
+void poseToSampleBatch(SampleBatch<SamplingSpaceType> & sample_batch, const std::vector<sva::PTransformd> & pose_list);
+
+/** \brief Convert batch of samples to batch of SVM inputs. This is equivalent to sampleToInput() for each sample.
+    \tparam SamplingSpaceType sampling space
+    \param[out] input_batch batch of SVM inputs (resized to the number of samples)
+    \param[in] sample_batch batch of samples
+*/
+template<SamplingSpace SamplingSpaceType>
+void sampleToInputBatch(InputBatch<SamplingSpaceType> & input_batch,
+                        const SampleBatch<SamplingSpaceType> & sample_batch);
+
+/** \brief Integrate batch of velocities to batch of samples. This is equivalent to integrateVelToSample() for each
+    sample.
+    \tparam SamplingSpaceType sampling space
+    \param[in,out] sample_batch batch of samples
+    \param[in] vel_batch batch of velocities
+*/
+template<SamplingSpace SamplingSpaceType>
+void integrateVelToSampleBatch(SampleBatch<SamplingSpaceType> & sample_batch,
+                               const VelBatch<SamplingSpaceType> & vel_batch);
+
+/** \brief Get batch of relative samples. This is equivalent to relSample() in SVMUtils.h for each pair of samples.
+    \tparam SamplingSpaceType sampling space
+    \param[out] rel_sample_batch batch of relative samples (resized to the number of samples)
+    \param[in] pre_sample_batch batch of predecessor samples
+    \param[in] suc_sample_batch batch of successor samples
+*/
+template<SamplingSpace SamplingSpaceType>
+void relSampleBatch(SampleBatch<SamplingSpaceType> & rel_sample_batch,
+                    const SampleBatch<SamplingSpaceType> & pre_sample_batch,
+                    const SampleBatch<SamplingSpaceType> & suc_sample_batch);
+
+/** \brief Convert batch of grid positions to batch of samples. This is equivalent to gridPosToSample() for each grid.
+    \tparam SamplingSpaceType sampling space
+    \param[out] sample_batch batch of samples (resized to the number of grid positions)
+    \param[in] grid_pos_batch batch of grid positions
+*/
+template<SamplingSpace SamplingSpaceType>
+void gridPosToSampleBatch(SampleBatch<SamplingSpaceType> & sample_batch,
+                          const GridPosBatch<SamplingSpaceType> & grid_pos_batch);
+} // namespace DiffRmap
+
+// See method 3 in https://www.codeproject.com/Articles/48575/How-to-Define-a-Template-Class-in-a-h-File-and-Imp
+#include <differentiable_rmap/SamplingBatchUtils.hpp>
@@ -0,0 +1,250 @@
+/* Author: Masaki Murooka */
+
+namespace DiffRmap
+{
+namespace detail
+{
+/** \brief Calculate cosine and sine of each element of row.
+    \tparam RowType type of row of angles
+    \param[out] cos cosine of angles
+    \param[out] sin sine of angles
+    \param[in] angle row of angles
+
+    Eigen does not vectorize the trigonometric functions of double, so std::cos and std::sin are called in the same
+    loop to allow the compiler to merge them into sincos.
+*/
+template<class RowType>
+inline void calcCosSinRow(Eigen::Array<double, 1, Eigen::Dynamic> & cos,
+                   Eigen::Array<double, 1, Eigen::Dynamic> & sin,
+                   const RowType & angle)
+{
+  cos.resize(angle.size());
+  sin.resize(angle.size());
+  for(Eigen::Index i = 0; i < angle.size(); i++)
+  {
+    cos[i] = std::cos(angle[i]);
+    sin[i] = std::sin(angle[i]);
+  }
+}
+} // namespace detail
+
+template<SamplingSpace SamplingSpaceType>
+void poseToSampleBatch(SampleBatch<SamplingSpaceType> & sample_batch, const std::vector<sva::PTransformd> & pose_list)
+{
+  sample_batch.resize(sampleDim<SamplingSpaceType>(), static_cast<Eigen::Index>(pose_list.size()));
+  for(size_t i = 0; i < pose_list.size(); i++)
+  {
+    sample_batch.col(i) = poseToSample<SamplingSpaceType>(pose_list[i]);
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+void sampleToInputBatch(InputBatch<SamplingSpaceType> & input_batch,
+                        const SampleBatch<SamplingSpaceType> & sample_batch)
+{
+  input_batch.resize(inputDim<SamplingSpaceType>(), sample_batch.cols());
+
+  if constexpr(SamplingSpaceType == SamplingSpace::R2 || SamplingSpaceType == SamplingSpace::R3)
+  {
+    input_batch = sample_batch;
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SO2 || SamplingSpaceType == SamplingSpace::SE2)
+  {
+    constexpr int angle_idx = sampleDim<SamplingSpaceType>() - 1;
+    constexpr int rot_input_idx = inputDim<SamplingSpaceType>() - inputDim<SamplingSpace::SO2>();
+    if constexpr(SamplingSpaceType == SamplingSpace::SE2)
+    {
+      input_batch.template topRows<2>() = sample_batch.template topRows<2>();
+    }
+    // Element order of SO2 input is (cos, -sin, sin, cos)
+    Eigen::Array<double, 1, Eigen::Dynamic> cos, sin;
+    detail::calcCosSinRow(cos, sin, sample_batch.row(angle_idx));
+    input_batch.row(rot_input_idx).array() = cos;
+    input_batch.row(rot_input_idx + 1).array() = -sin;
+    input_batch.row(rot_input_idx + 2).array() = sin;
+    input_batch.row(rot_input_idx + 3).array() = cos;
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SO3 || SamplingSpaceType == SamplingSpace::SE3)
+  {
+    constexpr int quat_idx = sampleDim<SamplingSpaceType>() - sampleDim<SamplingSpace::SO3>();
+    constexpr int rot_input_idx = inputDim<SamplingSpaceType>() - inputDim<SamplingSpace::SO3>();
+    if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+    {
+      input_batch.template topRows<3>() = sample_batch.template topRows<3>();
+    }
+    // Element order of SO3 sample is (x, y, z, w), and SO3 input arranges the elements of rotation matrix row by row
+    const auto & qx = sample_batch.row(quat_idx).array();
+    const auto & qy = sample_batch.row(quat_idx + 1).array();
+    const auto & qz = sample_batch.row(quat_idx + 2).array();
+    const auto & qw = sample_batch.row(quat_idx + 3).array();
+    input_batch.row(rot_input_idx + 0).array() = 1 - 2 * (qy.square() + qz.square());
+    input_batch.row(rot_input_idx + 1).array() = 2 * (qx * qy - qz * qw);
+    input_batch.row(rot_input_idx + 2).array() = 2 * (qx * qz + qy * qw);
+    input_batch.row(rot_input_idx + 3).array() = 2 * (qx * qy + qz * qw);
+    input_batch.row(rot_input_idx + 4).array() = 1 - 2 * (qx.square() + qz.square());
+    input_batch.row(rot_input_idx + 5).array() = 2 * (qy * qz - qx * qw);
+    input_batch.row(rot_input_idx + 6).array() = 2 * (qx * qz - qy * qw);
+    input_batch.row(rot_input_idx + 7).array() = 2 * (qy * qz + qx * qw);
+    input_batch.row(rot_input_idx + 8).array() = 1 - 2 * (qx.square() + qy.square());
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[sampleToInputBatch] Unsupported SamplingSpace: {}",
+                                                     std::to_string(SamplingSpaceType));
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+void integrateVelToSampleBatch(SampleBatch<SamplingSpaceType> & sample_batch,
+                               const VelBatch<SamplingSpaceType> & vel_batch)
+{
+  using RowArray = Eigen::Array<double, 1, Eigen::Dynamic>;
+
+  if constexpr(SamplingSpaceType == SamplingSpace::SO3 || SamplingSpaceType == SamplingSpace::SE3)
+  {
+    constexpr int quat_idx = sampleDim<SamplingSpaceType>() - sampleDim<SamplingSpace::SO3>();
+    constexpr int ang_vel_idx = velDim<SamplingSpaceType>() - velDim<SamplingSpace::SO3>();
+    if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+    {
+      // Translation velocity is assumed to be represented in world frame
+      sample_batch.template topRows<3>() += vel_batch.template topRows<3>();
+    }
+
+    // Rotation velocity is assumed to be represented in sample frame
+    const auto & wx = vel_batch.row(ang_vel_idx).array();
+    const auto & wy = vel_batch.row(ang_vel_idx + 1).array();
+    const auto & wz = vel_batch.row(ang_vel_idx + 2).array();
+    const RowArray & angle = (wx.square() + wy.square() + wz.square()).sqrt();
+    RowArray dw, half_sin;
+    detail::calcCosSinRow(dw, half_sin, angle / 2);
+    // Coefficient from angular velocity to vector part of quaternion (limit for zero angle is 1/2)
+    const RowArray & coeff = (angle > 0).select(half_sin / angle, 0.5);
+    const RowArray & dx = coeff * wx;
+    const RowArray & dy = coeff * wy;
+    const RowArray & dz = coeff * wz;
+
+    // Element order of SO3 sample is (x, y, z, w)
+    const RowArray qx = sample_batch.row(quat_idx).array();
+    const RowArray qy = sample_batch.row(quat_idx + 1).array();
+    const RowArray qz = sample_batch.row(quat_idx + 2).array();
+    const RowArray qw = sample_batch.row(quat_idx + 3).array();
+    sample_batch.row(quat_idx).array() = qw * dx + qx * dw + qy * dz - qz * dy;
+    sample_batch.row(quat_idx + 1).array() = qw * dy - qx * dz + qy * dw + qz * dx;
+    sample_batch.row(quat_idx + 2).array() = qw * dz + qx * dy - qy * dx + qz * dw;
+    sample_batch.row(quat_idx + 3).array() = qw * dw - qx * dx - qy * dy - qz * dz;
+  }
+  else
+  {
+    static_assert(sampleDim<SamplingSpaceType>() == velDim<SamplingSpaceType>());
+
+    sample_batch += vel_batch;
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+void relSampleBatch(SampleBatch<SamplingSpaceType> & rel_sample_batch,
+                    const SampleBatch<SamplingSpaceType> & pre_sample_batch,
+                    const SampleBatch<SamplingSpaceType> & suc_sample_batch)
+{
+  using RowArray = Eigen::Array<double, 1, Eigen::Dynamic>;
+
+  rel_sample_batch.resize(sampleDim<SamplingSpaceType>(), pre_sample_batch.cols());
+
+  if constexpr(SamplingSpaceType == SamplingSpace::R2 || SamplingSpaceType == SamplingSpace::R3)
+  {
+    rel_sample_batch = suc_sample_batch - pre_sample_batch;
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SO2 || SamplingSpaceType == SamplingSpace::SE2)
+  {
+    constexpr int angle_idx = sampleDim<SamplingSpaceType>() - 1;
+    if constexpr(SamplingSpaceType == SamplingSpace::SE2)
+    {
+      RowArray cos, sin;
+      detail::calcCosSinRow(cos, sin, pre_sample_batch.row(angle_idx));
+      const RowArray & error_x = suc_sample_batch.row(0).array() - pre_sample_batch.row(0).array();
+      const RowArray & error_y = suc_sample_batch.row(1).array() - pre_sample_batch.row(1).array();
+      rel_sample_batch.row(0).array() = cos * error_x + sin * error_y;
+      rel_sample_batch.row(1).array() = -sin * error_x + cos * error_y;
+    }
+    // Range within [-pi, pi]
+    const RowArray & angle_error =
+        suc_sample_batch.row(angle_idx).array() - pre_sample_batch.row(angle_idx).array();
+    rel_sample_batch.row(angle_idx).array() = angle_error - 2 * M_PI * (angle_error / (2 * M_PI)).round();
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SO3 || SamplingSpaceType == SamplingSpace::SE3)
+  {
+    constexpr int quat_idx = sampleDim<SamplingSpaceType>() - sampleDim<SamplingSpace::SO3>();
+
+    // Element order of SO3 sample is (x, y, z, w)
+    const auto & px = pre_sample_batch.row(quat_idx).array();
+    const auto & py = pre_sample_batch.row(quat_idx + 1).array();
+    const auto & pz = pre_sample_batch.row(quat_idx + 2).array();
+    const auto & pw = pre_sample_batch.row(quat_idx + 3).array();
+    const auto & sx = suc_sample_batch.row(quat_idx).array();
+    const auto & sy = suc_sample_batch.row(quat_idx + 1).array();
+    const auto & sz = suc_sample_batch.row(quat_idx + 2).array();
+    const auto & sw = suc_sample_batch.row(quat_idx + 3).array();
+
+    if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+    {
+      // Multiply transposed rotation matrix of predecessor sample to position error
+      const RowArray & ex = suc_sample_batch.row(0).array() - pre_sample_batch.row(0).array();
+      const RowArray & ey = suc_sample_batch.row(1).array() - pre_sample_batch.row(1).array();
+      const RowArray & ez = suc_sample_batch.row(2).array() - pre_sample_batch.row(2).array();
+      rel_sample_batch.row(0).array() = (1 - 2 * (py.square() + pz.square())) * ex + 2 * (px * py + pz * pw) * ey
+                                        + 2 * (px * pz - py * pw) * ez;
+      rel_sample_batch.row(1).array() = 2 * (px * py - pz * pw) * ex + (1 - 2 * (px.square() + pz.square())) * ey
+                                        + 2 * (py * pz + px * pw) * ez;
+      rel_sample_batch.row(2).array() = 2 * (px * pz + py * pw) * ex + 2 * (py * pz - px * pw) * ey
+                                        + (1 - 2 * (px.square() + py.square())) * ez;
+    }
+
+    // Product of conjugate of predecessor quaternion and successor quaternion
+    rel_sample_batch.row(quat_idx).array() = pw * sx - px * sw - py * sz + pz * sy;
+    rel_sample_batch.row(quat_idx + 1).array() = pw * sy + px * sz - py * sw - pz * sx;
+    rel_sample_batch.row(quat_idx + 2).array() = pw * sz - px * sy + py * sx - pz * sw;
+    rel_sample_batch.row(quat_idx + 3).array() = pw * sw + px * sx + py * sy + pz * sz;
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[relSampleBatch] Unsupported SamplingSpace: {}",
+                                                     std::to_string(SamplingSpaceType));
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+void gridPosToSampleBatch(SampleBatch<SamplingSpaceType> & sample_batch,
+                          const GridPosBatch<SamplingSpaceType> & grid_pos_batch)
+{
+  using RowArray = Eigen::Array<double, 1, Eigen::Dynamic>;
+
+  sample_batch.resize(sampleDim<SamplingSpaceType>(), grid_pos_batch.cols());
+
+  if constexpr(SamplingSpaceType == SamplingSpace::SO3 || SamplingSpaceType == SamplingSpace::SE3)
+  {
+    constexpr int quat_idx = sampleDim<SamplingSpaceType>() - sampleDim<SamplingSpace::SO3>();
+    constexpr int rot_grid_idx = gridDim<SamplingSpaceType>() - gridDim<SamplingSpace::SO3>();
+    if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+    {
+      sample_batch.template topRows<3>() = grid_pos_batch.template topRows<3>();
+    }
+
+    // Product of quaternions of rotations around x, y, and z axes in this order
+    RowArray cx, sx, cy, sy, cz, sz;
+    detail::calcCosSinRow(cx, sx, grid_pos_batch.row(rot_grid_idx).array() / 2);
+    detail::calcCosSinRow(cy, sy, grid_pos_batch.row(rot_grid_idx + 1).array() / 2);
+    detail::calcCosSinRow(cz, sz, grid_pos_batch.row(rot_grid_idx + 2).array() / 2);
+    // Element order of SO3 sample is (x, y, z, w)
+    sample_batch.row(quat_idx).array() = sx * cy * cz + cx * sy * sz;
+    sample_batch.row(quat_idx + 1).array() = cx * sy * cz - sx * cy * sz;
+    sample_batch.row(quat_idx + 2).array() = cx * cy * sz + sx * sy * cz;
+    sample_batch.row(quat_idx + 3).array() = cx * cy * cz - sx * sy * sz;
+  }
+  else
+  {
+    static_assert(sampleDim<SamplingSpaceType>() == gridDim<SamplingSpaceType>());
+
+    sample_batch = grid_pos_batch;
+  }
+}
+} // namespace DiffRmap
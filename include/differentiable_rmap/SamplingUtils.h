@@ -95,6 +95,24 @@ Input<SamplingSpaceType> sampleToInput(const Sample<SamplingSpaceType> & sample)
 template<SamplingSpace SamplingSpaceType>
 Sample<SamplingSpaceType> inputToSample(const Input<SamplingSpaceType> & input);
 
+/** \brief Canonicalize sample by rotation around z-axis so that position is on the xz-plane with nonnegative x.
+    \tparam SamplingSpaceType sampling space (only R3 and SE3 are supported)
+    \param sample sample
+
+    If the reachability is symmetric around the z-axis (e.g., the robot has a base yaw joint on the z-axis), the
+    reachability of the sample is the same as that of the canonical sample. Position \f$(x, y, z)\f$ is mapped to
+    \f$(r, 0, z)\f$ where \f$r = \sqrt{x^2 + y^2}\f$, and orientation is rotated by the same angle.
+*/
+template<SamplingSpace SamplingSpaceType>
+Sample<SamplingSpaceType> canonicalizeSampleYaw(const Sample<SamplingSpaceType> & sample);
+
+/** \brief Canonicalize SVM input by rotation around z-axis. This is equivalent to canonicalizeSampleYaw().
+    \tparam SamplingSpaceType sampling space (only R3 and SE3 are supported)
+    \param input SVM input
+*/
+template<SamplingSpace SamplingSpaceType>
+Input<SamplingSpaceType> canonicalizeInputYaw(const Input<SamplingSpaceType> & input);
+
 /** \brief Integrate velocity to sample. (duration is assumed to be one)
     \tparam SamplingSpaceType sampling space
     \param[in,out] sample sample
@@ -351,6 +351,65 @@ inline Sample<SamplingSpace::SE3> inputToSample<SamplingSpace::SE3>(const Input<
   return sample;
 }
 
+template<SamplingSpace SamplingSpaceType>
+Sample<SamplingSpaceType> canonicalizeSampleYaw(const Sample<SamplingSpaceType> & sample)
+{
+  mc_rtc::log::error_and_throw<std::runtime_error>("[canonicalizeSampleYaw] Need to be specialized for {}.",
+                                                   std::to_string(SamplingSpaceType));
+}
+
+template<>
+inline Sample<SamplingSpace::R3> canonicalizeSampleYaw<SamplingSpace::R3>(const Sample<SamplingSpace::R3> & sample)
+{
+  Sample<SamplingSpace::R3> canonical_sample;
+  canonical_sample << sample.head<2>().norm(), 0, sample.z();
+  return canonical_sample;
+}
+
+template<>
+inline Sample<SamplingSpace::SE3> canonicalizeSampleYaw<SamplingSpace::SE3>(const Sample<SamplingSpace::SE3> & sample)
+{
+  // Element order of SO3 sample is (x, y, z, w)
+  const auto & quat_coeffs = sample.tail<sampleDim<SamplingSpace::SO3>()>();
+  Eigen::Quaterniond quat(quat_coeffs.w(), quat_coeffs.x(), quat_coeffs.y(), quat_coeffs.z());
+  double yaw = std::atan2(sample.y(), sample.x());
+  Sample<SamplingSpace::SE3> canonical_sample;
+  canonical_sample << canonicalizeSampleYaw<SamplingSpace::R3>(sample.head<sampleDim<SamplingSpace::R3>()>()),
+      (Eigen::AngleAxisd(-yaw, Eigen::Vector3d::UnitZ()) * quat).coeffs();
+  return canonical_sample;
+}
+
+template<SamplingSpace SamplingSpaceType>
+Input<SamplingSpaceType> canonicalizeInputYaw(const Input<SamplingSpaceType> & input)
+{
+  mc_rtc::log::error_and_throw<std::runtime_error>("[canonicalizeInputYaw] Need to be specialized for {}.",
+                                                   std::to_string(SamplingSpaceType));
+}
+
+template<>
+inline Input<SamplingSpace::R3> canonicalizeInputYaw<SamplingSpace::R3>(const Input<SamplingSpace::R3> & input)
+{
+  return canonicalizeSampleYaw<SamplingSpace::R3>(input);
+}
+
+template<>
+inline Input<SamplingSpace::SE3> canonicalizeInputYaw<SamplingSpace::SE3>(const Input<SamplingSpace::SE3> & input)
+{
+  double r = input.head<2>().norm();
+  double cos = r > 0 ? input.x() / r : 1.0;
+  double sin = r > 0 ? input.y() / r : 0.0;
+  Input<SamplingSpace::SE3> canonical_input = input;
+  canonical_input.head<inputDim<SamplingSpace::R3>()>() =
+      canonicalizeInputYaw<SamplingSpace::R3>(input.head<inputDim<SamplingSpace::R3>()>());
+  // Rotate each column of rotation matrix, whose elements are arranged row by row
+  for(int i = 0; i < 3; i++)
+  {
+    canonical_input[3 + i] = cos * input[3 + i] + sin * input[6 + i];
+    canonical_input[6 + i] = -sin * input[3 + i] + cos * input[6 + i];
+  }
+  return canonical_input;
+}
+
 template<SamplingSpace SamplingSpaceType>
 void integrateVelToSample(Eigen::Ref<Sample<SamplingSpaceType>> sample, const Vel<SamplingSpaceType> & vel)
 {
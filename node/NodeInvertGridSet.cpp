@@ -0,0 +1,31 @@
+/* Author: Masaki Murooka */
+
+#include <iostream>
+
+#include <ros/ros.h>
+
+#include <differentiable_rmap/InverseRmapUtils.h>
+
+using namespace DiffRmap;
+
+
+int main(int argc, char **argv)
+{
+  // Setup ROS
+  // NodeHandle is not created so that this tool can be used without ROS master
+  ros::init(argc, argv, "invert_grid_set", ros::init_options::AnonymousName | ros::init_options::NoRosout);
+
+  if (argc < 3) {
+    std::cerr << "usage: NodeInvertGridSet <grid_bag_path> <inv_grid_bag_path> [<svm_thre>]" << std::endl;
+    return 1;
+  }
+
+  double svm_thre = 0.0;
+  if (argc >= 4) {
+    svm_thre = std::stod(argv[3]);
+  }
+
+  invertGridSetBag(argv[1], argv[2], svm_thre);
+
+  return 0;
+}
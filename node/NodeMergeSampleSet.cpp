@@ -0,0 +1,33 @@
+/* Author: Masaki Murooka */
+
+#include <iostream>
+
+#include <ros/ros.h>
+
+#include <differentiable_rmap/SampleSetUtils.h>
+
+using namespace DiffRmap;
+
+
+int main(int argc, char **argv)
+{
+  // Setup ROS
+  // NodeHandle is not created so that this tool can be used without ROS master
+  ros::init(argc, argv, "merge_sample_set", ros::init_options::AnonymousName | ros::init_options::NoRosout);
+
+  std::vector<std::string> arg_list(argv + 1, argv + argc);
+  bool dedup = true;
+  if (!arg_list.empty() && arg_list[0] == "--no-dedup") {
+    dedup = false;
+    arg_list.erase(arg_list.begin());
+  }
+  if (arg_list.size() < 2) {
+    std::cerr << "usage: NodeMergeSampleSet [--no-dedup] <output_bag_path> <input_bag_path1> [<input_bag_path2> ...]"
+              << std::endl;
+    return 1;
+  }
+
+  mergeSampleSet(std::vector<std::string>(arg_list.begin() + 1, arg_list.end()), arg_list[0], dedup);
+
+  return 0;
+}
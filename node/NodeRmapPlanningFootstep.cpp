@@ -26,10 +26,37 @@ int main(int argc, char **argv)
       svm_path,
       bag_path);
 
+  mc_rtc::Configuration mc_rtc_config;
   if (pnh.hasParam("config_path")) {
     std::string config_path;
     pnh.getParam("config_path", config_path);
-    rmap_planning->configure(mc_rtc::Configuration(config_path));
+    mc_rtc_config.load(config_path);
+    rmap_planning->configure(mc_rtc_config);
+  }
+
+  bool search_horizon = false;
+  pnh.param<bool>("search_horizon", search_horizon, search_horizon);
+  if (search_horizon) {
+    HorizonSearchConfiguration search_config;
+    if (mc_rtc_config.has("horizon_search")) {
+      search_config.load(mc_rtc_config("horizon_search"));
+    }
+    HorizonSearchResult search_result = searchMinFootstepNum(sampling_space, svm_path, mc_rtc_config, search_config);
+    for (const auto & candidate_result : search_result.candidate_result_list) {
+      ROS_INFO_STREAM("footstep_num: " << candidate_result.horizon
+                      << ", feasible: " << candidate_result.feasible
+                      << ", aborted: " << candidate_result.aborted
+                      << ", iter_num: " << candidate_result.iter_num
+                      << ", violation: " << candidate_result.violation
+                      << ", target_error: " << candidate_result.target_error);
+    }
+    if (search_result.horizon > 0) {
+      ROS_INFO_STREAM("Minimum footstep_num: " << search_result.horizon);
+      mc_rtc_config.add("footstep_num", search_result.horizon);
+      rmap_planning->configure(mc_rtc_config);
+    } else {
+      ROS_WARN("No feasible footstep_num is found. Use footstep_num in configuration.");
+    }
   }
 
   rmap_planning->runLoop();
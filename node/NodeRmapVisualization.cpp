@@ -38,6 +38,22 @@ int main(int argc, char **argv)
   bool load_grid = false;
   pnh.param<bool>("load_grid", load_grid, load_grid);
 
+  // Only generate the specified shard of grid set and exit (used to distribute grid generation to processes)
+  int grid_shard_idx = -1;
+  pnh.param<int>("grid_shard_idx", grid_shard_idx, grid_shard_idx);
+  if (grid_shard_idx >= 0) {
+    rmap_visualization->dumpGridShard(grid_bag_path, grid_shard_idx);
+    return 0;
+  }
+
+  // Only generate capability map and exit
+  std::string capability_bag_path = "";
+  pnh.param<std::string>("capability_bag_path", capability_bag_path, capability_bag_path);
+  if (!capability_bag_path.empty()) {
+    rmap_visualization->dumpCapabilityMap(capability_bag_path);
+    return 0;
+  }
+
   rmap_visualization->runLoop(grid_bag_path, load_grid);
 
   bool keep_alive = true;
@@ -0,0 +1,211 @@
+/* Author: Masaki Murooka */
+
+#include <memory>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <differentiable_rmap/SVMUtils.h>
+
+namespace py = pybind11;
+using namespace DiffRmap;
+
+namespace
+{
+/*! \brief Type of NumPy array of samples. */
+using SampleArray = py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+/** \brief SVM model of reachability map evaluated from Python. */
+class PySVMModelBase
+{
+public:
+  /** \brief Destructor. */
+  virtual ~PySVMModelBase() = default;
+
+  /** \brief Get sampling space. */
+  virtual SamplingSpace samplingSpace() const = 0;
+
+  /** \brief Get sample dimension. */
+  virtual int sampleDim() const = 0;
+
+  /** \brief Get number of support vectors. */
+  virtual int svNum() const = 0;
+
+  /** \brief Calculate SVM values of samples.
+      \param samples array of samples of shape (N, sample_dim)
+      \param thread_num number of threads (if non-positive, the number of hardware threads is used)
+      \return array of SVM values of shape (N,)
+  */
+  virtual py::array_t<double> calcValue(const SampleArray & samples, int thread_num) const = 0;
+
+  /** \brief Calculate gradients of SVM value of samples.
+      \param samples array of samples of shape (N, sample_dim)
+      \param thread_num number of threads (if non-positive, the number of hardware threads is used)
+      \return array of gradients of shape (N, sample_dim)
+  */
+  virtual py::array_t<double> calcGrad(const SampleArray & samples, int thread_num) const = 0;
+};
+
+/** \brief SVM model of reachability map evaluated from Python.
+    \tparam SamplingSpaceType sampling space
+*/
+template<SamplingSpace SamplingSpaceType>
+class PySVMModel : public PySVMModelBase
+{
+public:
+  /** \brief Constructor.
+      \param svm_path path of SVM model file
+      \param yaw_symmetric whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
+  */
+  PySVMModel(const std::string & svm_path, bool yaw_symmetric) : yaw_symmetric_(yaw_symmetric)
+  {
+    svm_mo_ = svm_load_model(svm_path.c_str());
+    if(!svm_mo_)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>("[PySVMModel] Failed to load SVM model from {}", svm_path);
+    }
+
+    int num_sv = svm_mo_->l;
+    svm_coeff_vec_.resize(num_sv);
+    svm_sv_mat_.resize(inputDim<SamplingSpaceType>(), num_sv);
+    setSVMPredictionMat<SamplingSpaceType>(svm_coeff_vec_, svm_sv_mat_, svm_mo_);
+  }
+
+  /** \brief Destructor. */
+  ~PySVMModel() override
+  {
+    svm_free_and_destroy_model(&svm_mo_);
+  }
+
+  SamplingSpace samplingSpace() const override
+  {
+    return SamplingSpaceType;
+  }
+
+  int sampleDim() const override
+  {
+    return DiffRmap::sampleDim<SamplingSpaceType>();
+  }
+
+  int svNum() const override
+  {
+    return static_cast<int>(svm_coeff_vec_.size());
+  }
+
+  py::array_t<double> calcValue(const SampleArray & samples, int thread_num) const override
+  {
+    const Eigen::Map<const SampleColumns<SamplingSpaceType>> & sample_mat = mapSamples(samples);
+    py::array_t<double> values(sample_mat.cols());
+    Eigen::Map<Eigen::VectorXd> value_vec(values.mutable_data(), sample_mat.cols());
+    {
+      py::gil_scoped_release release;
+      calcSVMValueBatch<SamplingSpaceType>(value_vec, sample_mat, svm_mo_->param, svm_mo_, svm_coeff_vec_,
+                                           svm_sv_mat_, yaw_symmetric_, thread_num);
+    }
+    return values;
+  }
+
+  py::array_t<double> calcGrad(const SampleArray & samples, int thread_num) const override
+  {
+    const Eigen::Map<const SampleColumns<SamplingSpaceType>> & sample_mat = mapSamples(samples);
+    py::array_t<double> grads({sample_mat.cols(), sample_mat.rows()});
+    Eigen::Map<SampleColumns<SamplingSpaceType>> grad_mat(grads.mutable_data(), sample_mat.rows(), sample_mat.cols());
+    {
+      py::gil_scoped_release release;
+      calcSVMGradBatch<SamplingSpaceType>(grad_mat, sample_mat, svm_mo_->param, svm_mo_, svm_coeff_vec_,
+                                          svm_sv_mat_, yaw_symmetric_, thread_num);
+    }
+    return grads;
+  }
+
+protected:
+  /** \brief Map NumPy array of samples to Eigen matrix without copy.
+      \param samples array of samples of shape (N, sample_dim)
+
+      The C-contiguous array of shape (N, sample_dim) has the same memory layout as the column-major matrix of shape
+      (sample_dim, N).
+  */
+  Eigen::Map<const SampleColumns<SamplingSpaceType>> mapSamples(const SampleArray & samples) const
+  {
+    if(samples.ndim() != 2 || samples.shape(1) != DiffRmap::sampleDim<SamplingSpaceType>())
+    {
+      throw py::value_error("[PySVMModel] Shape of samples must be (N, " + std::to_string(sampleDim()) + ")");
+    }
+    return Eigen::Map<const SampleColumns<SamplingSpaceType>>(samples.data(), samples.shape(1), samples.shape(0));
+  }
+
+protected:
+  //! SVM model
+  svm_model * svm_mo_ = nullptr;
+
+  //! Support vector coefficients
+  Eigen::VectorXd svm_coeff_vec_;
+
+  //! Support vector matrix
+  Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> svm_sv_mat_;
+
+  //! Whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
+  bool yaw_symmetric_;
+};
+
+/** \brief Load SVM model.
+    \param svm_path path of SVM model file
+    \param sampling_space_str sampling space name (e.g., "SE3")
+    \param yaw_symmetric whether SVM is trained with the inputs canonicalized by canonicalizeInputYaw()
+*/
+std::unique_ptr<PySVMModelBase> loadSVMModel(const std::string & svm_path,
+                                             const std::string & sampling_space_str,
+                                             bool yaw_symmetric)
+{
+  SamplingSpace sampling_space = strToSamplingSpace(sampling_space_str);
+  if(sampling_space == SamplingSpace::R2)
+  {
+    return std::make_unique<PySVMModel<SamplingSpace::R2>>(svm_path, yaw_symmetric);
+  }
+  else if(sampling_space == SamplingSpace::SO2)
+  {
+    return std::make_unique<PySVMModel<SamplingSpace::SO2>>(svm_path, yaw_symmetric);
+  }
+  else if(sampling_space == SamplingSpace::SE2)
+  {
+    return std::make_unique<PySVMModel<SamplingSpace::SE2>>(svm_path, yaw_symmetric);
+  }
+  else if(sampling_space == SamplingSpace::R3)
+  {
+    return std::make_unique<PySVMModel<SamplingSpace::R3>>(svm_path, yaw_symmetric);
+  }
+  else if(sampling_space == SamplingSpace::SO3)
+  {
+    return std::make_unique<PySVMModel<SamplingSpace::SO3>>(svm_path, yaw_symmetric);
+  }
+  else if(sampling_space == SamplingSpace::SE3)
+  {
+    return std::make_unique<PySVMModel<SamplingSpace::SE3>>(svm_path, yaw_symmetric);
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[loadSVMModel] Unsupported SamplingSpace: {}",
+                                                     sampling_space_str);
+  }
+}
+} // namespace
+
+PYBIND11_MODULE(pydiffrmap, m)
+{
+  m.doc() = "Python bindings of differentiable reachability map";
+
+  py::class_<PySVMModelBase>(m, "SVMModel")
+      .def_property_readonly("sampling_space",
+                             [](const PySVMModelBase & model) { return std::to_string(model.samplingSpace()); })
+      .def_property_readonly("sample_dim", &PySVMModelBase::sampleDim)
+      .def_property_readonly("sv_num", &PySVMModelBase::svNum)
+      .def("calc_value", &PySVMModelBase::calcValue, py::arg("samples"), py::arg("thread_num") = 0,
+           "Calculate SVM values of samples of shape (N, sample_dim). The array is not copied if it is C-contiguous "
+           "float64.")
+      .def("calc_grad", &PySVMModelBase::calcGrad, py::arg("samples"), py::arg("thread_num") = 0,
+           "Calculate gradients of SVM value of samples of shape (N, sample_dim). The array is not copied if it is "
+           "C-contiguous float64.");
+
+  m.def("load_svm_model", &loadSVMModel, py::arg("svm_path"), py::arg("sampling_space"),
+        py::arg("yaw_symmetric") = false, "Load SVM model trained by rmap_training.");
+}
@@ -0,0 +1,215 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include <mc_rtc/logging.h>
+
+#include <differentiable_rmap/CapabilityMapUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Get total number of position grids of capability map message. */
+int calcTotalGridNum(const differentiable_rmap::RmapCapabilityMap & capability_map_msg)
+{
+  int total_grid_num = 1;
+  for(int divide_num : capability_map_msg.divide_nums)
+  {
+    total_grid_num *= (divide_num + 1);
+  }
+  return total_grid_num;
+}
+
+/** \brief Check size of grid of capability map message. */
+void checkGridSize(const differentiable_rmap::RmapCapabilityMap & capability_map_msg, const std::string & func_name)
+{
+  constexpr int grid_dim = gridDim<SamplingSpace::R3>();
+  if(capability_map_msg.divide_nums.size() != grid_dim || capability_map_msg.min.size() != grid_dim
+     || capability_map_msg.max.size() != grid_dim)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[{}] Dimension of grid must be {}: divide_nums {}, min {}, max {}", func_name, grid_dim,
+        capability_map_msg.divide_nums.size(), capability_map_msg.min.size(), capability_map_msg.max.size());
+  }
+  if(capability_map_msg.direction_num <= 0 || capability_map_msg.roll_num <= 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[{}] Invalid orientation discretization: direction_num {}, roll_num {}", func_name,
+        capability_map_msg.direction_num, capability_map_msg.roll_num);
+  }
+}
+} // namespace
+
+std::vector<Sample<SamplingSpace::SO3>> DiffRmap::makeCapabilityOrientationList(int direction_num, int roll_num)
+{
+  std::vector<Sample<SamplingSpace::SO3>> orientation_list;
+  orientation_list.reserve(direction_num * roll_num);
+
+  const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+  for(int direction_idx = 0; direction_idx < direction_num; direction_idx++)
+  {
+    double z = 1.0 - 2.0 * (direction_idx + 0.5) / direction_num;
+    double r = std::sqrt(std::max(1.0 - z * z, 0.0));
+    double phi = golden_angle * direction_idx;
+    const Eigen::Vector3d direction(r * std::cos(phi), r * std::sin(phi), z);
+    const Eigen::Quaterniond & direction_quat = Eigen::Quaterniond::FromTwoVectors(Eigen::Vector3d::UnitZ(), direction);
+    for(int roll_idx = 0; roll_idx < roll_num; roll_idx++)
+    {
+      Eigen::Quaterniond quat =
+          direction_quat * Eigen::AngleAxisd(2 * M_PI * roll_idx / roll_num, Eigen::Vector3d::UnitZ());
+      // Element order is (x, y, z, w)
+      orientation_list.push_back(quat.normalized().coeffs());
+    }
+  }
+
+  return orientation_list;
+}
+
+void DiffRmap::calcCapabilityMap(differentiable_rmap::RmapCapabilityMap & capability_map_msg,
+                                 const std::function<bool(const Sample<SamplingSpace::SE3> &)> & reachable_func,
+                                 int thread_num)
+{
+  checkGridSize(capability_map_msg, "calcCapabilityMap");
+
+  const std::vector<Sample<SamplingSpace::SO3>> & orientation_list =
+      makeCapabilityOrientationList(capability_map_msg.direction_num, capability_map_msg.roll_num);
+  int orientation_num = static_cast<int>(orientation_list.size());
+  int total_grid_num = calcTotalGridNum(capability_map_msg);
+
+  capability_map_msg.mask_word_num = (orientation_num + 63) / 64;
+  capability_map_msg.reachable_ratios.assign(total_grid_num, 0.0);
+  capability_map_msg.masks.assign(static_cast<size_t>(total_grid_num) * capability_map_msg.mask_word_num, 0);
+
+  GridIdxs<SamplingSpace::R3> divide_nums(capability_map_msg.divide_nums.data());
+  GridPos<SamplingSpace::R3> grid_pos_min(capability_map_msg.min.data());
+  GridPos<SamplingSpace::R3> grid_pos_max(capability_map_msg.max.data());
+  const GridPos<SamplingSpace::R3> & grid_pos_range = grid_pos_max - grid_pos_min;
+
+  // Each worker takes the next grid, and writes only the elements of the grid
+  std::atomic<int> next_grid_idx(0);
+  auto work = [&]() {
+    GridIdxs<SamplingSpace::R3> divide_idxs;
+    GridPos<SamplingSpace::R3> divide_ratios;
+    Sample<SamplingSpace::SE3> sample;
+    for(int grid_idx = next_grid_idx++; grid_idx < total_grid_num; grid_idx = next_grid_idx++)
+    {
+      gridIdxToDivideIdxs(divide_idxs, grid_idx, divide_nums);
+      gridDivideIdxsToRatios(divide_ratios, divide_idxs, divide_nums);
+      sample.head<3>() = divide_ratios.cwiseProduct(grid_pos_range) + grid_pos_min;
+
+      uint64_t * masks = &capability_map_msg.masks[static_cast<size_t>(grid_idx) * capability_map_msg.mask_word_num];
+      int reachable_num = 0;
+      for(int orientation_idx = 0; orientation_idx < orientation_num; orientation_idx++)
+      {
+        sample.tail<4>() = orientation_list[orientation_idx];
+        if(reachable_func(sample))
+        {
+          masks[orientation_idx / 64] |= (uint64_t(1) << (orientation_idx % 64));
+          reachable_num++;
+        }
+      }
+      capability_map_msg.reachable_ratios[grid_idx] = static_cast<double>(reachable_num) / orientation_num;
+    }
+  };
+
+  if(thread_num <= 0)
+  {
+    thread_num = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::vector<std::thread> thread_list;
+  for(int i = 0; i < std::min(thread_num, total_grid_num); i++)
+  {
+    thread_list.emplace_back(work);
+  }
+  for(auto & thread : thread_list)
+  {
+    thread.join();
+  }
+}
+
+CapabilityMap::CapabilityMap(const differentiable_rmap::RmapCapabilityMap & capability_map_msg)
+: capability_map_msg_(capability_map_msg)
+{
+  checkGridSize(capability_map_msg_, "CapabilityMap");
+
+  orientation_list_ = makeCapabilityOrientationList(capability_map_msg_.direction_num, capability_map_msg_.roll_num);
+  int total_grid_num = calcTotalGridNum(capability_map_msg_);
+  if(capability_map_msg_.mask_word_num != (static_cast<int>(orientation_list_.size()) + 63) / 64
+     || capability_map_msg_.reachable_ratios.size() != static_cast<size_t>(total_grid_num)
+     || capability_map_msg_.masks.size() != static_cast<size_t>(total_grid_num) * capability_map_msg_.mask_word_num)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[CapabilityMap] Inconsistent size of message: mask_word_num {}, reachable_ratios {}, masks {}",
+        capability_map_msg_.mask_word_num, capability_map_msg_.reachable_ratios.size(),
+        capability_map_msg_.masks.size());
+  }
+
+  for(int i = 0; i < gridDim<SamplingSpace::R3>(); i++)
+  {
+    divide_nums_[i] = capability_map_msg_.divide_nums[i];
+    grid_pos_min_[i] = capability_map_msg_.min[i];
+    grid_pos_max_[i] = capability_map_msg_.max[i];
+  }
+}
+
+int CapabilityMap::gridIdx(const Eigen::Vector3d & pos) const
+{
+  GridIdxs<SamplingSpace::R3> divide_idxs;
+  for(int i = 0; i < gridDim<SamplingSpace::R3>(); i++)
+  {
+    double range = grid_pos_max_[i] - grid_pos_min_[i];
+    double ratio = (range > 0 ? (pos[i] - grid_pos_min_[i]) / range : 0.0);
+    // Allow half a cell outside the range because the boundary grid represents the cell around it
+    double half_cell_ratio = 0.5 / std::max(divide_nums_[i], 1);
+    if(ratio < -half_cell_ratio || ratio > 1 + half_cell_ratio)
+    {
+      return -1;
+    }
+    divide_idxs[i] = std::clamp(static_cast<int>(std::round(ratio * divide_nums_[i])), 0, divide_nums_[i]);
+  }
+  return calcGridIdx(divide_idxs, divide_nums_);
+}
+
+double CapabilityMap::reachableRatio(const Eigen::Vector3d & pos) const
+{
+  int grid_idx = gridIdx(pos);
+  return grid_idx >= 0 ? capability_map_msg_.reachable_ratios[grid_idx] : 0.0;
+}
+
+bool CapabilityMap::isReachable(const Eigen::Vector3d & pos, int orientation_idx) const
+{
+  int grid_idx = gridIdx(pos);
+  if(grid_idx < 0 || orientation_idx < 0 || orientation_idx >= static_cast<int>(orientation_list_.size()))
+  {
+    return false;
+  }
+  uint64_t mask = capability_map_msg_.masks[static_cast<size_t>(grid_idx) * capability_map_msg_.mask_word_num
+                                            + orientation_idx / 64];
+  return (mask >> (orientation_idx % 64)) & 1;
+}
+
+bool CapabilityMap::isReachable(const Sample<SamplingSpace::SE3> & sample) const
+{
+  return isReachable(sample.head<3>(), nearestOrientationIdx(sample.tail<4>()));
+}
+
+int CapabilityMap::nearestOrientationIdx(const Sample<SamplingSpace::SO3> & orientation) const
+{
+  // Absolute value of inner product of quaternions is larger for closer orientations
+  int nearest_idx = -1;
+  double max_abs_dot = -1.0;
+  for(int orientation_idx = 0; orientation_idx < static_cast<int>(orientation_list_.size()); orientation_idx++)
+  {
+    double abs_dot = std::abs(orientation_list_[orientation_idx].dot(orientation));
+    if(abs_dot > max_abs_dot)
+    {
+      max_abs_dot = abs_dot;
+      nearest_idx = orientation_idx;
+    }
+  }
+  return nearest_idx;
+}
@@ -0,0 +1,92 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <cmath>
+
+#include <differentiable_rmap/IKUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Get joint position of all robots as vector. */
+Eigen::VectorXd getJointPos(const OmgCore::RobotConfigArray & rbc_arr)
+{
+  std::vector<double> joint_pos;
+  for(const auto & rbc : rbc_arr)
+  {
+    for(const auto & q : rbc->q)
+    {
+      joint_pos.insert(joint_pos.end(), q.begin(), q.end());
+    }
+  }
+  return Eigen::Map<Eigen::VectorXd>(joint_pos.data(), joint_pos.size());
+}
+
+/** \brief Update tasksets and calculate maximum task error norm of tasksets. */
+double updateTasksetAndCalcError(const std::vector<OmgCore::Taskset *> & taskset_list,
+                                 const OmgCore::RobotArray & rb_arr,
+                                 const OmgCore::RobotConfigArray & rbc_arr,
+                                 const OmgCore::AuxRobotArray & aux_rb_arr)
+{
+  double max_error_sq = 0.0;
+  for(const auto & taskset : taskset_list)
+  {
+    taskset->update(rb_arr, rbc_arr, aux_rb_arr);
+    max_error_sq = std::max(max_error_sq, taskset->errorSquaredNorm(false));
+  }
+  return std::sqrt(max_error_sq);
+}
+} // namespace
+
+bool DiffRmap::runIK(OmgCore::IterativeQpProblem & problem,
+                     const std::vector<OmgCore::Taskset *> & taskset_list,
+                     const OmgCore::RobotArray & rb_arr,
+                     const OmgCore::RobotConfigArray & rbc_arr,
+                     const OmgCore::AuxRobotArray & aux_rb_arr,
+                     int max_loop_num,
+                     double error_thre,
+                     int check_interval,
+                     double stagnation_thre)
+{
+  if(check_interval <= 0)
+  {
+    problem.run(max_loop_num);
+    return updateTasksetAndCalcError(taskset_list, rb_arr, rbc_arr, aux_rb_arr) < error_thre;
+  }
+
+  int loop_idx = 0;
+  Eigen::VectorXd prev_joint_pos = getJointPos(rbc_arr);
+  double prev_error = updateTasksetAndCalcError(taskset_list, rb_arr, rbc_arr, aux_rb_arr);
+  while(true)
+  {
+    int loop_num = std::min(check_interval, max_loop_num - loop_idx);
+    problem.run(loop_num);
+    loop_idx += loop_num;
+
+    // Terminate if solved or the maximum number of loops is reached
+    double error = updateTasksetAndCalcError(taskset_list, rb_arr, rbc_arr, aux_rb_arr);
+    if(error < error_thre)
+    {
+      return true;
+    }
+    if(loop_idx >= max_loop_num)
+    {
+      return false;
+    }
+
+    // Abort if joint position is no longer changed and task error is no longer decreased
+    if(stagnation_thre <= 0)
+    {
+      continue;
+    }
+    Eigen::VectorXd joint_pos = getJointPos(rbc_arr);
+    if(joint_pos.size() > 0 && (joint_pos - prev_joint_pos).cwiseAbs().maxCoeff() < stagnation_thre
+       && prev_error - error < stagnation_thre)
+    {
+      return false;
+    }
+    prev_joint_pos = joint_pos;
+    prev_error = error;
+  }
+}
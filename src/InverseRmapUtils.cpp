@@ -0,0 +1,53 @@
+/* Author: Masaki Murooka */
+
+#include <ros/console.h>
+
+#include <differentiable_rmap/InverseRmapUtils.h>
+#include <differentiable_rmap/RosUtils.h>
+
+using namespace DiffRmap;
+
+void DiffRmap::invertGridSetBag(const std::string & grid_bag_path,
+                                const std::string & inv_grid_bag_path,
+                                double svm_thre)
+{
+  ROS_INFO_STREAM("Load grid set from " << grid_bag_path);
+  differentiable_rmap::RmapGridSet::ConstPtr grid_set_msg = loadBag<differentiable_rmap::RmapGridSet>(grid_bag_path);
+
+  differentiable_rmap::RmapGridSet inv_grid_set_msg;
+  SamplingSpace sampling_space = static_cast<SamplingSpace>(grid_set_msg->type);
+  if(sampling_space == SamplingSpace::R2)
+  {
+    invertGridSet<SamplingSpace::R2>(inv_grid_set_msg, *grid_set_msg, svm_thre);
+  }
+  else if(sampling_space == SamplingSpace::SO2)
+  {
+    invertGridSet<SamplingSpace::SO2>(inv_grid_set_msg, *grid_set_msg, svm_thre);
+  }
+  else if(sampling_space == SamplingSpace::SE2)
+  {
+    invertGridSet<SamplingSpace::SE2>(inv_grid_set_msg, *grid_set_msg, svm_thre);
+  }
+  else if(sampling_space == SamplingSpace::R3)
+  {
+    invertGridSet<SamplingSpace::R3>(inv_grid_set_msg, *grid_set_msg, svm_thre);
+  }
+  else if(sampling_space == SamplingSpace::SO3)
+  {
+    invertGridSet<SamplingSpace::SO3>(inv_grid_set_msg, *grid_set_msg, svm_thre);
+  }
+  else if(sampling_space == SamplingSpace::SE3)
+  {
+    invertGridSet<SamplingSpace::SE3>(inv_grid_set_msg, *grid_set_msg, svm_thre);
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[invertGridSetBag] Unsupported SamplingSpace: {}",
+                                                     grid_set_msg->type);
+  }
+
+  // Dump to ROS bag
+  rosbag::Bag bag(inv_grid_bag_path, rosbag::bagmode::Write);
+  bag.write("/rmap_grid_set", ros::Time::now(), inv_grid_set_msg);
+  ROS_INFO_STREAM("Dump inverse grid set to " << inv_grid_bag_path);
+}
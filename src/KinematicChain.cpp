@@ -0,0 +1,297 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <cmath>
+
+#include <mc_rtc/logging.h>
+
+#include <differentiable_rmap/KinematicChain.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Set batch of transforms to constant transform. */
+void setConstantBatch(RotBatch & rot_batch, TransBatch & trans_batch, const sva::PTransformd & transform)
+{
+  for(int i = 0; i < 3; i++)
+  {
+    for(int j = 0; j < 3; j++)
+    {
+      rot_batch.row(3 * i + j).setConstant(transform.rotation()(i, j));
+    }
+    trans_batch.row(i).setConstant(transform.translation()[i]);
+  }
+}
+
+/** \brief Multiply batch of transforms from left (i.e., X = L * X) in the same way as sva::PTransformd.
+    \param[in,out] rot_batch batch of rotation matrices of X
+    \param[in,out] trans_batch batch of translations of X
+    \param[out] work_rot_batch workspace (same size as rot_batch)
+    \param[in] lhs_rot_batch batch of rotation matrices of L
+    \param[in] lhs_trans_batch batch of translations of L
+*/
+void multiplyBatch(RotBatch & rot_batch,
+                   TransBatch & trans_batch,
+                   RotBatch & work_rot_batch,
+                   const RotBatch & lhs_rot_batch,
+                   const TransBatch & lhs_trans_batch)
+{
+  // p = p + E^T p_L
+  for(int i = 0; i < 3; i++)
+  {
+    trans_batch.row(i).array() += rot_batch.row(i).array() * lhs_trans_batch.row(0).array()
+                                  + rot_batch.row(3 + i).array() * lhs_trans_batch.row(1).array()
+                                  + rot_batch.row(6 + i).array() * lhs_trans_batch.row(2).array();
+  }
+
+  // E = E_L E
+  work_rot_batch.resize(9, rot_batch.cols());
+  for(int i = 0; i < 3; i++)
+  {
+    for(int j = 0; j < 3; j++)
+    {
+      work_rot_batch.row(3 * i + j).array() = lhs_rot_batch.row(3 * i).array() * rot_batch.row(j).array()
+                                              + lhs_rot_batch.row(3 * i + 1).array() * rot_batch.row(3 + j).array()
+                                              + lhs_rot_batch.row(3 * i + 2).array() * rot_batch.row(6 + j).array();
+    }
+  }
+  rot_batch.swap(work_rot_batch);
+}
+
+/** \brief Multiply batch of transforms from left by constant transform (i.e., X = L * X). */
+void multiplyConstantBatch(RotBatch & rot_batch,
+                           TransBatch & trans_batch,
+                           RotBatch & work_rot_batch,
+                           const sva::PTransformd & lhs_transform)
+{
+  const Eigen::Matrix3d & lhs_rot = lhs_transform.rotation();
+  const Eigen::Vector3d & lhs_trans = lhs_transform.translation();
+
+  // p = p + E^T p_L
+  for(int i = 0; i < 3; i++)
+  {
+    trans_batch.row(i) += lhs_trans[0] * rot_batch.row(i) + lhs_trans[1] * rot_batch.row(3 + i)
+                          + lhs_trans[2] * rot_batch.row(6 + i);
+  }
+
+  // E = E_L E
+  work_rot_batch.resize(9, rot_batch.cols());
+  for(int i = 0; i < 3; i++)
+  {
+    for(int j = 0; j < 3; j++)
+    {
+      work_rot_batch.row(3 * i + j) = lhs_rot(i, 0) * rot_batch.row(j) + lhs_rot(i, 1) * rot_batch.row(3 + j)
+                                      + lhs_rot(i, 2) * rot_batch.row(6 + j);
+    }
+  }
+  rot_batch.swap(work_rot_batch);
+}
+} // namespace
+
+KinematicChain::KinematicChain(const rbd::MultiBody & mb,
+                               const rbd::MultiBodyConfig & mbc,
+                               const std::string & body_name,
+                               const std::vector<std::string> & joint_name_list,
+                               const sva::PTransformd & tip_offset)
+: joint_num_(static_cast<int>(joint_name_list.size()))
+{
+  // Get joints on the path from root to body (index of joint is the same as index of its successor body)
+  std::vector<int> path_joint_idx_list;
+  for(int body_idx = mb.bodyIndexByName(body_name); body_idx != -1; body_idx = mb.parent(body_idx))
+  {
+    path_joint_idx_list.push_back(body_idx);
+  }
+  std::reverse(path_joint_idx_list.begin(), path_joint_idx_list.end());
+
+  // Constant transform accumulated since the last joint of interest
+  sva::PTransformd const_transform = sva::PTransformd::Identity();
+  for(int joint_idx : path_joint_idx_list)
+  {
+    const auto & joint = mb.joint(joint_idx);
+    auto joint_name_iter = std::find(joint_name_list.begin(), joint_name_list.end(), joint.name());
+
+    // Fold joint which is not joint of interest into constant transform
+    if(joint_name_iter == joint_name_list.end())
+    {
+      const_transform = joint.pose(mbc.q[joint_idx]) * mb.transform(joint_idx) * const_transform;
+      continue;
+    }
+
+    if(joint.type() != rbd::Joint::Rev && joint.type() != rbd::Joint::Prism)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>(
+          "[KinematicChain] Joint of interest must be revolute or prismatic: {}", joint.name());
+    }
+
+    // The transform of segment is affine in (sin(q), cos(q)) for revolute joint and in q for prismatic joint, so the
+    // coefficients are identified from the transforms at several joint positions
+    const sva::PTransformd pre_transform = mb.transform(joint_idx) * const_transform;
+    auto calcTransform = [&](double joint_pos) { return joint.pose(std::vector<double>{joint_pos}) * pre_transform; };
+    Segment segment;
+    segment.joint_idx = static_cast<int>(joint_name_iter - joint_name_list.begin());
+    segment.is_revolute = (joint.type() == rbd::Joint::Rev);
+    if(segment.is_revolute)
+    {
+      const sva::PTransformd transform_zero = calcTransform(0);
+      const sva::PTransformd transform_half_pi = calcTransform(M_PI / 2);
+      const sva::PTransformd transform_pi = calcTransform(M_PI);
+      segment.rot_const = (transform_zero.rotation() + transform_pi.rotation()) / 2;
+      segment.rot_sin = transform_half_pi.rotation() - segment.rot_const;
+      segment.rot_cos = (transform_zero.rotation() - transform_pi.rotation()) / 2;
+      segment.trans_const = transform_zero.translation();
+      segment.trans_lin.setZero();
+    }
+    else
+    {
+      const sva::PTransformd transform_zero = calcTransform(0);
+      const sva::PTransformd transform_one = calcTransform(1);
+      segment.rot_const = transform_zero.rotation();
+      segment.rot_sin.setZero();
+      segment.rot_cos.setZero();
+      segment.trans_const = transform_zero.translation();
+      segment.trans_lin = transform_one.translation() - transform_zero.translation();
+    }
+    segment_list_.push_back(segment);
+
+    const_transform = sva::PTransformd::Identity();
+  }
+
+  tip_transform_ = tip_offset * const_transform;
+}
+
+sva::PTransformd KinematicChain::calcPose(const Eigen::VectorXd & joint_pos) const
+{
+  if(joint_pos.size() != joint_num_)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[KinematicChain::calcPose] Dimension of joint position is inconsistent: {} != {}", joint_pos.size(),
+        joint_num_);
+  }
+
+  sva::PTransformd pose = sva::PTransformd::Identity();
+  for(const auto & segment : segment_list_)
+  {
+    pose = calcSegmentTransform(segment, joint_pos[segment.joint_idx]) * pose;
+  }
+  return tip_transform_ * pose;
+}
+
+void KinematicChain::calcPoseBatch(RotBatch & rot_batch,
+                                   TransBatch & trans_batch,
+                                   const JointPosBatch & joint_pos_batch) const
+{
+  if(joint_pos_batch.rows() != joint_num_)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[KinematicChain::calcPoseBatch] Dimension of joint position is inconsistent: {} != {}",
+        joint_pos_batch.rows(), joint_num_);
+  }
+
+  Eigen::Index batch_size = joint_pos_batch.cols();
+  rot_batch.resize(9, batch_size);
+  trans_batch.resize(3, batch_size);
+  RotBatch work_rot_batch(9, batch_size);
+
+  if(segment_list_.empty())
+  {
+    setConstantBatch(rot_batch, trans_batch, tip_transform_);
+    return;
+  }
+
+  RotBatch segment_rot_batch(9, batch_size);
+  TransBatch segment_trans_batch(3, batch_size);
+  for(size_t i = 0; i < segment_list_.size(); i++)
+  {
+    const auto & segment = segment_list_[i];
+    if(i == 0)
+    {
+      calcSegmentTransformBatch(rot_batch, trans_batch, segment, joint_pos_batch.row(segment.joint_idx));
+    }
+    else
+    {
+      calcSegmentTransformBatch(segment_rot_batch, segment_trans_batch, segment,
+                                joint_pos_batch.row(segment.joint_idx));
+      multiplyBatch(rot_batch, trans_batch, work_rot_batch, segment_rot_batch, segment_trans_batch);
+    }
+  }
+  multiplyConstantBatch(rot_batch, trans_batch, work_rot_batch, tip_transform_);
+}
+
+void KinematicChain::calcPoseBatch(std::vector<sva::PTransformd> & pose_list,
+                                   const JointPosBatch & joint_pos_batch) const
+{
+  RotBatch rot_batch;
+  TransBatch trans_batch;
+  calcPoseBatch(rot_batch, trans_batch, joint_pos_batch);
+
+  pose_list.resize(joint_pos_batch.cols());
+  for(size_t i = 0; i < pose_list.size(); i++)
+  {
+    for(int j = 0; j < 3; j++)
+    {
+      for(int k = 0; k < 3; k++)
+      {
+        pose_list[i].rotation()(j, k) = rot_batch(3 * j + k, i);
+      }
+    }
+    pose_list[i].translation() = trans_batch.col(i);
+  }
+}
+
+sva::PTransformd KinematicChain::calcSegmentTransform(const Segment & segment, double joint_pos) const
+{
+  if(segment.is_revolute)
+  {
+    return sva::PTransformd(
+        Eigen::Matrix3d(segment.rot_const + std::sin(joint_pos) * segment.rot_sin
+                        + std::cos(joint_pos) * segment.rot_cos),
+        segment.trans_const);
+  }
+  else
+  {
+    return sva::PTransformd(segment.rot_const, segment.trans_const + joint_pos * segment.trans_lin);
+  }
+}
+
+void KinematicChain::calcSegmentTransformBatch(RotBatch & rot_batch,
+                                               TransBatch & trans_batch,
+                                               const Segment & segment,
+                                               const Eigen::Ref<const Eigen::RowVectorXd> & joint_pos_batch) const
+{
+  Eigen::Index batch_size = joint_pos_batch.size();
+  rot_batch.resize(9, batch_size);
+  trans_batch.resize(3, batch_size);
+
+  if(segment.is_revolute)
+  {
+    // Scalar loop is used so that the compiler can fuse sin and cos into sincos
+    Eigen::Array<double, 1, Eigen::Dynamic> sin(batch_size);
+    Eigen::Array<double, 1, Eigen::Dynamic> cos(batch_size);
+    for(Eigen::Index i = 0; i < batch_size; i++)
+    {
+      sin[i] = std::sin(joint_pos_batch[i]);
+      cos[i] = std::cos(joint_pos_batch[i]);
+    }
+    for(int i = 0; i < 3; i++)
+    {
+      for(int j = 0; j < 3; j++)
+      {
+        rot_batch.row(3 * i + j).array() =
+            segment.rot_const(i, j) + segment.rot_sin(i, j) * sin + segment.rot_cos(i, j) * cos;
+      }
+      trans_batch.row(i).setConstant(segment.trans_const[i]);
+    }
+  }
+  else
+  {
+    for(int i = 0; i < 3; i++)
+    {
+      for(int j = 0; j < 3; j++)
+      {
+        rot_batch.row(3 * i + j).setConstant(segment.rot_const(i, j));
+      }
+      trans_batch.row(i).array() = segment.trans_const[i] + segment.trans_lin[i] * joint_pos_batch.array();
+    }
+  }
+}
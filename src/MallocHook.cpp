@@ -0,0 +1,86 @@
+/* Author: Masaki Murooka */
+
+// This file is compiled only if ENABLE_NO_MALLOC_CHECK CMake option is ON
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include <differentiable_rmap/MallocUtils.h>
+
+extern "C"
+{
+  void * __libc_malloc(size_t size);
+  void * __libc_calloc(size_t num, size_t size);
+  void * __libc_realloc(void * ptr, size_t size);
+  void * __libc_memalign(size_t alignment, size_t size);
+}
+
+__thread bool DiffRmap::detail::malloc_forbidden __attribute__((tls_model("initial-exec"))) = false;
+
+namespace
+{
+/** \brief Abort if heap allocation is forbidden in the current thread. */
+inline void checkMallocAllowed()
+{
+  if(DiffRmap::detail::malloc_forbidden)
+  {
+    // Message is written without heap allocation
+    DiffRmap::detail::malloc_forbidden = false;
+    static const char msg[] = "[ScopedMallocAllowed] Heap allocation is done in the scope where it is forbidden.\n";
+    ssize_t ret = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    (void)ret;
+    std::abort();
+  }
+}
+} // namespace
+
+extern "C"
+{
+  void * malloc(size_t size)
+  {
+    checkMallocAllowed();
+    return __libc_malloc(size);
+  }
+
+  void * calloc(size_t num, size_t size)
+  {
+    checkMallocAllowed();
+    return __libc_calloc(num, size);
+  }
+
+  void * realloc(void * ptr, size_t size)
+  {
+    checkMallocAllowed();
+    return __libc_realloc(ptr, size);
+  }
+
+  void * memalign(size_t alignment, size_t size)
+  {
+    checkMallocAllowed();
+    return __libc_memalign(alignment, size);
+  }
+
+  void * aligned_alloc(size_t alignment, size_t size)
+  {
+    checkMallocAllowed();
+    return __libc_memalign(alignment, size);
+  }
+
+  int posix_memalign(void ** ptr, size_t alignment, size_t size)
+  {
+    checkMallocAllowed();
+    if(alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+      return EINVAL;
+    }
+    void * new_ptr = __libc_memalign(alignment, size);
+    if(!new_ptr)
+    {
+      return ENOMEM;
+    }
+    *ptr = new_ptr;
+    return 0;
+  }
+}
@@ -0,0 +1,341 @@
+/* Author: Masaki Murooka */
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <mc_rtc/logging.h>
+
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+#include <std_srvs/Empty.h>
+#include <std_srvs/Trigger.h>
+
+#include <differentiable_rmap/RealtimeUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Convert timespec to nanoseconds. */
+inline int64_t timespecToNs(const struct timespec & ts)
+{
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/** \brief Convert nanoseconds to timespec. */
+inline struct timespec nsToTimespec(int64_t ns)
+{
+  struct timespec ts;
+  ts.tv_sec = ns / 1000000000;
+  ts.tv_nsec = ns % 1000000000;
+  return ts;
+}
+
+/** \brief Get current time of monotonic clock [ns]. */
+inline int64_t nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return timespecToNs(ts);
+}
+} // namespace
+
+void LatencyHistogram::setup(double bin_width, int bin_num)
+{
+  if(bin_width <= 0 || bin_num <= 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[LatencyHistogram::setup] Invalid bins: width {}, num {}",
+                                                     bin_width, bin_num);
+  }
+
+  bin_width_ = bin_width;
+  bin_num_ = bin_num;
+  bin_count_list_ = std::make_unique<std::atomic<uint64_t>[]>(bin_num_);
+  clear();
+}
+
+void LatencyHistogram::clear()
+{
+  for(int i = 0; i < bin_num_; i++)
+  {
+    bin_count_list_[i].store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0.0, std::memory_order_relaxed);
+  min_.store(0.0, std::memory_order_relaxed);
+  max_.store(0.0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::add(double value)
+{
+  int bin_idx = std::clamp(static_cast<int>(value / bin_width_), 0, bin_num_ - 1);
+  bin_count_list_[bin_idx].fetch_add(1, std::memory_order_relaxed);
+
+  // Since add() is called from a single thread, load and store do not need to be atomic as a whole
+  if(count() == 0)
+  {
+    min_.store(value, std::memory_order_relaxed);
+    max_.store(value, std::memory_order_relaxed);
+  }
+  else
+  {
+    min_.store(std::min(min_.load(std::memory_order_relaxed), value), std::memory_order_relaxed);
+    max_.store(std::max(max_.load(std::memory_order_relaxed), value), std::memory_order_relaxed);
+  }
+  sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::percentile(double ratio) const
+{
+  uint64_t n = count();
+  if(n == 0)
+  {
+    return 0.0;
+  }
+
+  uint64_t accum_count = 0;
+  for(int i = 0; i < bin_num_; i++)
+  {
+    accum_count += bin_count_list_[i].load(std::memory_order_relaxed);
+    if(accum_count >= ratio * n)
+    {
+      return (i + 1) * bin_width_;
+    }
+  }
+  return bin_num_ * bin_width_;
+}
+
+std::string LatencyHistogram::dump(const std::string & name) const
+{
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1);
+  ss << name << " [us]: count " << count() << ", min " << min() << ", mean " << mean() << ", max " << max()
+     << ", p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999) << std::endl;
+  for(int i = 0; i < bin_num_; i++)
+  {
+    uint64_t bin_count = bin_count_list_[i].load(std::memory_order_relaxed);
+    if(bin_count == 0)
+    {
+      continue;
+    }
+    ss << "  [" << i * bin_width_ << ", ";
+    if(i == bin_num_ - 1)
+    {
+      ss << "inf";
+    }
+    else
+    {
+      ss << (i + 1) * bin_width_;
+    }
+    ss << "): " << bin_count << std::endl;
+  }
+  return ss.str();
+}
+
+RealtimeLoop::RealtimeLoop(const RealtimeConfiguration & config, double rate)
+: config_(config)
+{
+  if(rate <= 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[RealtimeLoop] Invalid rate: {}", rate);
+  }
+  period_ns_ = static_cast<int64_t>(1e9 / rate);
+  for(int cpu_idx : config_.cpu_list)
+  {
+    if(cpu_idx < 0 || cpu_idx >= CPU_SETSIZE)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>("[RealtimeLoop] Invalid CPU index: {}", cpu_idx);
+    }
+  }
+
+  jitter_hist_.setup(config_.histogram_bin_width, config_.histogram_bin_num);
+  compute_hist_.setup(config_.histogram_bin_width, config_.histogram_bin_num);
+}
+
+RealtimeLoop::~RealtimeLoop()
+{
+  stop();
+}
+
+void RealtimeLoop::start(const std::function<void(int)> & func)
+{
+  if(running_)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[RealtimeLoop::start] Loop thread is already running.");
+  }
+
+  func_ = func;
+  running_ = true;
+  thread_ = std::thread(&RealtimeLoop::threadFunc, this);
+}
+
+void RealtimeLoop::stop()
+{
+  running_ = false;
+  if(thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+std::string RealtimeLoop::dumpStatistics() const
+{
+  std::ostringstream ss;
+  ss << "period: " << period_ns_ / 1e3 << " [us], overrun: " << overrunCount() << std::endl;
+  ss << jitter_hist_.dump("wake-up jitter");
+  ss << compute_hist_.dump("compute time");
+  return ss.str();
+}
+
+void RealtimeLoop::setupThread() const
+{
+  pthread_t thread = pthread_self();
+
+  // Set CPU affinity
+  if(!config_.cpu_list.empty())
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for(int cpu_idx : config_.cpu_list)
+    {
+      CPU_SET(cpu_idx, &cpu_set);
+    }
+    int ret = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpu_set);
+    if(ret != 0)
+    {
+      ROS_WARN_STREAM("[RealtimeLoop] Failed to set CPU affinity: " << std::strerror(ret));
+    }
+  }
+
+  // Set scheduling policy
+  if(config_.priority > 0)
+  {
+    struct sched_param param;
+    param.sched_priority = config_.priority;
+    int ret = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    if(ret != 0)
+    {
+      ROS_WARN_STREAM("[RealtimeLoop] Failed to set SCHED_FIFO priority " << config_.priority << ": "
+                                                                          << std::strerror(ret));
+    }
+  }
+
+  // Prefault stack
+  if(config_.prefault_stack_size > 0)
+  {
+    volatile unsigned char * stack = static_cast<unsigned char *>(alloca(config_.prefault_stack_size));
+    for(int i = 0; i < config_.prefault_stack_size; i += 4096)
+    {
+      stack[i] = 0;
+    }
+  }
+}
+
+void RealtimeLoop::threadFunc()
+{
+  setupThread();
+
+  int64_t deadline_ns = nowNs() + period_ns_;
+  int loop_idx = 0;
+  while(running_)
+  {
+    struct timespec deadline_ts = nsToTimespec(deadline_ns);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline_ts, nullptr) == EINTR)
+    {
+    }
+
+    int64_t wakeup_ns = nowNs();
+    if(clear_requested_.exchange(false))
+    {
+      jitter_hist_.clear();
+      compute_hist_.clear();
+      overrun_count_ = 0;
+    }
+
+    func_(loop_idx);
+
+    int64_t end_ns = nowNs();
+    jitter_hist_.add((wakeup_ns - deadline_ns) / 1e3);
+    compute_hist_.add((end_ns - wakeup_ns) / 1e3);
+
+    // Skip missed deadlines
+    deadline_ns += period_ns_;
+    if(end_ns > deadline_ns)
+    {
+      overrun_count_.fetch_add(1, std::memory_order_relaxed);
+      deadline_ns += ((end_ns - deadline_ns) / period_ns_ + 1) * period_ns_;
+    }
+
+    loop_idx++;
+  }
+}
+
+bool DiffRmap::lockMemory()
+{
+  if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+  {
+    ROS_WARN_STREAM("[lockMemory] Failed to lock memory: " << std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void DiffRmap::runRealtimeLoop(const RealtimeConfiguration & config,
+                               int rate,
+                               int publish_interval,
+                               const std::function<void(bool)> & run_once_func)
+{
+  if(config.lock_memory)
+  {
+    lockMemory();
+  }
+
+  RealtimeLoop realtime_loop(config, rate);
+
+  // Process services of statistics in a separate thread
+  ros::CallbackQueue stats_queue;
+  ros::NodeHandle nh;
+  nh.setCallbackQueue(&stats_queue);
+  ros::ServiceServer stats_srv = nh.advertiseService<std_srvs::Trigger::Request, std_srvs::Trigger::Response>(
+      "latency_statistics", [&](std_srvs::Trigger::Request & req, std_srvs::Trigger::Response & res) {
+        res.success = (realtime_loop.overrunCount() == 0);
+        res.message = realtime_loop.dumpStatistics();
+        return true;
+      });
+  ros::ServiceServer clear_stats_srv = nh.advertiseService<std_srvs::Empty::Request, std_srvs::Empty::Response>(
+      "clear_latency_statistics", [&](std_srvs::Empty::Request & req, std_srvs::Empty::Response & res) {
+        realtime_loop.requestClear();
+        return true;
+      });
+  ros::AsyncSpinner stats_spinner(1, &stats_queue);
+  stats_spinner.start();
+
+  realtime_loop.start([&](int loop_idx) {
+    bool publish = (loop_idx % publish_interval == 0);
+    run_once_func(publish);
+    if(publish)
+    {
+      ros::spinOnce();
+    }
+  });
+
+  ros::Rate rate_main(10);
+  while(ros::ok())
+  {
+    rate_main.sleep();
+  }
+
+  realtime_loop.stop();
+  stats_spinner.stop();
+  ROS_INFO_STREAM("[runRealtimeLoop] Latency statistics:\n" << realtime_loop.dumpStatistics());
+}
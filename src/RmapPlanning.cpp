@@ -11,6 +11,8 @@
 #include <optmotiongen/Utils/RosUtils.h>
 
 #include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/MallocUtils.h>
+#include <differentiable_rmap/QpUtils.h>
 #include <differentiable_rmap/RmapPlanning.h>
 #include <differentiable_rmap/SVMUtils.h>
 #include <differentiable_rmap/libsvm_hotfix.h>
@@ -75,7 +77,20 @@ void RmapPlanning<SamplingSpaceType>::setup()
   qp_coeff_.x_min_.setConstant(-config_.delta_config_limit);
   qp_coeff_.x_max_.setConstant(config_.delta_config_limit);
 
-  qp_solver_ = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+  if(config_.qp_solver_type == "JRLQP")
+  {
+    qp_solver_ = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+    warnQpSolverMalloc("RmapPlanning", config_.realtime_config.enabled);
+  }
+  else if(config_.qp_solver_type == "BoxHalfspace")
+  {
+    qp_solver_ = nullptr;
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[RmapPlanning] Invalid qp_solver_type: {}",
+                                                     config_.qp_solver_type);
+  }
 
   current_sample_ = poseToSample<SamplingSpaceType>(config_.initial_sample_pose);
 }
@@ -83,15 +98,33 @@ void RmapPlanning<SamplingSpaceType>::setup()
 template<SamplingSpace SamplingSpaceType>
 void RmapPlanning<SamplingSpaceType>::runOnce(bool publish)
 {
+  // Forbid heap allocation except for publishing (effective only if ENABLE_NO_MALLOC_CHECK CMake option is ON)
+  ScopedMallocAllowed malloc_allowed(publish);
+
   // Set QP coefficients
-  qp_coeff_.obj_vec_ = sampleError<SamplingSpaceType>(target_sample_, current_sample_);
-  double lambda = qp_coeff_.obj_vec_.squaredNorm() + 1e-3;
-  qp_coeff_.obj_mat_.diagonal().setConstant(1.0 + lambda);
-  qp_coeff_.ineq_mat_ = -1 * calcSVMGradWithVel(current_sample_).transpose();
-  qp_coeff_.ineq_vec_ << calcSVMValue(current_sample_) - config_.svm_thre;
+  const VelType & obj_vec = sampleError<SamplingSpaceType>(target_sample_, current_sample_);
+  double lambda = obj_vec.squaredNorm() + 1e-3;
+  const VelType & ineq_row = -1 * calcSVMGradWithVel(current_sample_);
+  double ineq_val = calcSVMValue(current_sample_) - config_.svm_thre;
 
   // Solve QP
-  const VelType & vel = qp_solver_->solve(qp_coeff_);
+  VelType vel;
+  if(qp_solver_)
+  {
+    qp_coeff_.obj_vec_ = obj_vec;
+    qp_coeff_.obj_mat_.diagonal().setConstant(1.0 + lambda);
+    qp_coeff_.ineq_mat_ = ineq_row.transpose();
+    qp_coeff_.ineq_vec_ << ineq_val;
+    // JRLQP allocates on the heap internally, so it is excluded from the check (warned in setup())
+    ScopedMallocAllowed solver_malloc_allowed(true);
+    vel = qp_solver_->solve(qp_coeff_);
+  }
+  else
+  {
+    vel = solveBoxHalfspaceQp<vel_dim_>(VelType::Constant(1.0 + lambda), obj_vec, ineq_row, ineq_val,
+                                        VelType::Constant(-config_.delta_config_limit),
+                                        VelType::Constant(config_.delta_config_limit));
+  }
 
   // Integrate
   integrateVelToSample<SamplingSpaceType>(current_sample_, vel);
@@ -115,6 +148,13 @@ void RmapPlanning<SamplingSpaceType>::runLoop()
 {
   setup();
 
+  if(config_.realtime_config.enabled)
+  {
+    runRealtimeLoop(config_.realtime_config, config_.loop_rate, config_.publish_interval,
+                    [this](bool publish) { runOnce(publish); });
+    return;
+  }
+
   ros::Rate rate(config_.loop_rate);
   int loop_idx = 0;
   while(ros::ok())
@@ -130,13 +170,15 @@ void RmapPlanning<SamplingSpaceType>::runLoop()
 template<SamplingSpace SamplingSpaceType>
 double RmapPlanning<SamplingSpaceType>::calcSVMValue(const SampleType & sample) const
 {
-  return DiffRmap::calcSVMValue<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_);
+  return DiffRmap::calcSVMValue<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_,
+                                                   config_.yaw_symmetric);
 }
 
 template<SamplingSpace SamplingSpaceType>
 Sample<SamplingSpaceType> RmapPlanning<SamplingSpaceType>::calcSVMGrad(const SampleType & sample) const
 {
-  return DiffRmap::calcSVMGrad<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_);
+  return DiffRmap::calcSVMGrad<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_,
+                                                  config_.yaw_symmetric);
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -145,6 +187,67 @@ Vel<SamplingSpaceType> RmapPlanning<SamplingSpaceType>::calcSVMGradWithVel(const
   return sampleToVelMat<SamplingSpaceType>(sample) * calcSVMGrad(sample);
 }
 
+template<SamplingSpace SamplingSpaceType>
+double RmapPlanning<SamplingSpaceType>::calcSVMValueAndGrad(SampleType & svm_grad,
+                                                            const SampleType & sample,
+                                                            SVMSurrogate<SamplingSpaceType> & surrogate,
+                                                            double tol,
+                                                            double trust_radius) const
+{
+  InputType input_grad;
+  double svm_value =
+      calcSVMValueAndInputGrad(input_grad, sampleToInput<SamplingSpaceType>(sample), surrogate, tol, trust_radius);
+  svm_grad = inputToSampleMat<SamplingSpaceType>(sample) * input_grad;
+  return svm_value;
+}
+
+template<SamplingSpace SamplingSpaceType>
+double RmapPlanning<SamplingSpaceType>::calcSVMValueAndGradWithVel(VelType & svm_grad,
+                                                                   const SampleType & sample,
+                                                                   SVMSurrogate<SamplingSpaceType> & surrogate,
+                                                                   double tol,
+                                                                   double trust_radius) const
+{
+  SampleType svm_sample_grad;
+  double svm_value = calcSVMValueAndGrad(svm_sample_grad, sample, surrogate, tol, trust_radius);
+  svm_grad = sampleToVelMat<SamplingSpaceType>(sample) * svm_sample_grad;
+  return svm_value;
+}
+
+template<SamplingSpace SamplingSpaceType>
+double RmapPlanning<SamplingSpaceType>::calcSVMValueAndInputGrad(InputType & input_grad,
+                                                                 const InputType & input,
+                                                                 SVMSurrogate<SamplingSpaceType> & surrogate,
+                                                                 double tol,
+                                                                 double trust_radius) const
+{
+  if(tol <= 0 || !surrogate.isTrusted(input, svm_hessian_bound_, tol, trust_radius))
+  {
+    surrogate.value = DiffRmap::calcSVMValueAndInputGrad<SamplingSpaceType>(
+        surrogate.input_grad, input, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_, config_.yaw_symmetric);
+    surrogate.input = input;
+    surrogate.valid = true;
+  }
+
+  input_grad = surrogate.input_grad;
+  return surrogate.calcValue(input);
+}
+
+template<SamplingSpace SamplingSpaceType>
+double RmapPlanning<SamplingSpaceType>::calcRelSVMValueAndVelGrad(VelType & pre_vel_grad,
+                                                                  VelType & suc_vel_grad,
+                                                                  const SampleType & pre_sample,
+                                                                  const SampleType & suc_sample,
+                                                                  SVMSurrogate<SamplingSpaceType> & surrogate,
+                                                                  double tol,
+                                                                  double trust_radius) const
+{
+  return DiffRmap::calcRelSVMValueAndVelGrad<SamplingSpaceType>(
+      pre_vel_grad, suc_vel_grad, pre_sample, suc_sample, [&](InputType & input_grad, const InputType & input) {
+        return calcSVMValueAndInputGrad(input_grad, input, surrogate, tol, trust_radius);
+      });
+}
+
 template<SamplingSpace SamplingSpaceType>
 void RmapPlanning<SamplingSpaceType>::setupGridMap()
 {
@@ -167,6 +270,7 @@ void RmapPlanning<SamplingSpaceType>::loadSVM(const std::string & svm_path)
   svm_coeff_vec_.resize(num_sv);
   svm_sv_mat_.resize(input_dim_, num_sv);
   setSVMPredictionMat<SamplingSpaceType>(svm_coeff_vec_, svm_sv_mat_, svm_mo_);
+  svm_hessian_bound_ = calcSVMHessianBound(svm_mo_->param, svm_coeff_vec_);
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -14,6 +14,7 @@
 #include <optmotiongen/Utils/RosUtils.h>
 
 #include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/MallocUtils.h>
 #include <differentiable_rmap/RmapPlanningFootstep.h>
 #include <differentiable_rmap/SVMUtils.h>
 #include <differentiable_rmap/libsvm_hotfix.h>
@@ -22,6 +23,17 @@ using namespace DiffRmap;
 
 namespace
 {
+/** \brief Mirror SE2 input w.r.t. xz plane, which corresponds to negating y and yaw of sample.
+    \param input SE2 input
+*/
+Input<SamplingSpace::SE2> mirrorInput(const Input<SamplingSpace::SE2> & input)
+{
+  // Element order of SE2 input is (x, y, cos, -sin, sin, cos)
+  Input<SamplingSpace::SE2> mirrored_input;
+  mirrored_input << input[0], -input[1], input[2], input[4], input[3], input[5];
+  return mirrored_input;
+}
+
 /** \brief Calculate Jacobian about the position w.r.t. sample.
     \tparam SamplingSpaceType sampling space
     \param sample sample
@@ -96,8 +108,10 @@ void RmapPlanningFootstep<SamplingSpaceType>::setup()
   qp_coeff_.x_max_.tail(svm_ineq_dim + collision_ineq_dim).setConstant(1e10);
 
   qp_solver_ = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+  warnQpSolverMalloc("RmapPlanningFootstep", config_.realtime_config.enabled);
 
   // Setup current sample sequence
+  start_sample_ = identity_sample_;
   current_sample_seq_.resize(config_.footstep_num);
   sva::PTransformd accum_initial_sample_pose = sva::PTransformd::Identity();
   for(int i = 0; i < config_.footstep_num; i++)
@@ -143,6 +157,15 @@ void RmapPlanningFootstep<SamplingSpaceType>::setup()
   }
   // ROS_INFO_STREAM("adjacent_reg_mat_:\n" << adjacent_reg_mat_);
 
+  // Setup local surrogate of SVM value
+  svm_surrogate_list_.assign(config_.footstep_num, SVMSurrogate<SamplingSpaceType>());
+
+  // Setup workspace
+  current_config_.setZero(config_dim);
+  vel_all_.setZero(config_dim + svm_ineq_dim + collision_ineq_dim);
+  extended_sample_seq_.clear();
+  extended_sample_seq_.reserve(config_.footstep_num + 3);
+
   // Setup collision
   foot_sch_ = std::make_shared<sch::S_Box>(config_.foot_shape_config.scale.x(), config_.foot_shape_config.scale.y(),
                                            config_.foot_shape_config.scale.z());
@@ -164,6 +187,9 @@ void RmapPlanningFootstep<SamplingSpaceType>::setup()
 template<SamplingSpace SamplingSpaceType>
 void RmapPlanningFootstep<SamplingSpaceType>::runOnce(bool publish)
 {
+  // Forbid heap allocation except for publishing (effective only if ENABLE_NO_MALLOC_CHECK CMake option is ON)
+  ScopedMallocAllowed malloc_allowed(publish);
+
   int config_dim = config_.footstep_num * vel_dim_;
   int svm_ineq_dim = config_.footstep_num;
   int collision_ineq_dim = config_.obst_shape_config_list.size() * config_.footstep_num;
@@ -183,15 +209,16 @@ void RmapPlanningFootstep<SamplingSpaceType>::runOnce(bool publish)
       .tail(collision_ineq_dim)
       .setConstant(config_.collision_ineq_weight);
   qp_coeff_.obj_vec_.template segment<vel_dim_>(config_dim - vel_dim_) = sample_error;
-  Eigen::VectorXd current_config(config_dim);
   for(int i = 0; i < config_.footstep_num; i++)
   {
     // The implementation of adjacent regularization is not strict because the error between samples is not a simple
     // subtraction
-    current_config.template segment<vel_dim_>(i * vel_dim_) =
+    current_config_.template segment<vel_dim_>(i * vel_dim_) =
         sampleError<SamplingSpaceType>(identity_sample_, current_sample_seq_[i]);
   }
-  qp_coeff_.obj_vec_.head(config_dim) += adjacent_reg_mat_ * current_config;
+  qp_coeff_.obj_vec_.head(config_dim).noalias() += adjacent_reg_mat_ * current_config_;
+  qp_coeff_.obj_vec_.template head<vel_dim_>() -=
+      config_.adjacent_reg_weight * sampleError<SamplingSpaceType>(identity_sample_, start_sample_);
   qp_coeff_.obj_mat_.topLeftCorner(config_dim, config_dim) += adjacent_reg_mat_;
 
   // Set QP inequality matrices of reachability
@@ -199,43 +226,32 @@ void RmapPlanningFootstep<SamplingSpaceType>::runOnce(bool publish)
   qp_coeff_.ineq_vec_.setZero();
   for(int i = 0; i < config_.footstep_num; i++)
   {
-    const SampleType & pre_sample =
-        i == 0 ? poseToSample<SamplingSpaceType>(sva::PTransformd::Identity()) : current_sample_seq_[i - 1];
+    const SampleType & pre_sample = i == 0 ? start_sample_ : current_sample_seq_[i - 1];
     const SampleType & suc_sample = current_sample_seq_[i];
-    SampleType rel_sample = relSample<SamplingSpaceType>(pre_sample, suc_sample);
-    if constexpr(isAlternateSupported())
-    {
-      if(config_.alternate_lr && (i % 2 == 1))
-      {
-        rel_sample.template tail<2>() *= -1;
-      }
-    }
-    const SampleType & svm_grad = this->calcSVMGrad(rel_sample);
-    SampleToSampleMat<SamplingSpaceType> rel_sample_mat_suc =
-        relSampleToSampleMat<SamplingSpaceType>(pre_sample, suc_sample, true);
-    if constexpr(isAlternateSupported())
-    {
-      if(config_.alternate_lr && (i % 2 == 1))
-      {
-        rel_sample_mat_suc.template bottomRows<2>() *= -1;
-      }
-    }
-    qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, i * vel_dim_) =
-        -1 * svm_grad.transpose() * rel_sample_mat_suc * sampleToVelMat<SamplingSpaceType>(suc_sample).transpose();
-    qp_coeff_.ineq_vec_.template segment<1>(i) << this->calcSVMValue(rel_sample) - config_.svm_thre;
-    if(i > 0)
-    {
-      SampleToSampleMat<SamplingSpaceType> rel_sample_mat_pre =
-          relSampleToSampleMat<SamplingSpaceType>(pre_sample, suc_sample, false);
+    auto svm_func = [&](InputType & input_grad, const InputType & input) {
       if constexpr(isAlternateSupported())
       {
         if(config_.alternate_lr && (i % 2 == 1))
         {
-          rel_sample_mat_pre.template bottomRows<2>() *= -1;
+          // Mirroring of input is symmetric and orthogonal, so it is also applied to the gradient
+          double svm_value = this->calcSVMValueAndInputGrad(input_grad, mirrorInput(input), svm_surrogate_list_[i],
+                                                            config_.svm_surrogate_tol, config_.svm_surrogate_radius);
+          input_grad = mirrorInput(input_grad);
+          return svm_value;
         }
       }
-      qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, (i - 1) * vel_dim_) =
-          -1 * svm_grad.transpose() * rel_sample_mat_pre * sampleToVelMat<SamplingSpaceType>(pre_sample).transpose();
+      return this->calcSVMValueAndInputGrad(input_grad, input, svm_surrogate_list_[i], config_.svm_surrogate_tol,
+                                            config_.svm_surrogate_radius);
+    };
+    VelType pre_vel_grad;
+    VelType suc_vel_grad;
+    double svm_value =
+        calcRelSVMValueAndVelGrad<SamplingSpaceType>(pre_vel_grad, suc_vel_grad, pre_sample, suc_sample, svm_func);
+    qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, i * vel_dim_) = -1 * suc_vel_grad.transpose();
+    qp_coeff_.ineq_vec_.template segment<1>(i) << svm_value - config_.svm_thre;
+    if(i > 0)
+    {
+      qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, (i - 1) * vel_dim_) = -1 * pre_vel_grad.transpose();
     }
   }
   qp_coeff_.ineq_mat_.rightCols(svm_ineq_dim + collision_ineq_dim).diagonal().head(svm_ineq_dim).setConstant(-1);
@@ -274,6 +290,7 @@ void RmapPlanningFootstep<SamplingSpaceType>::runOnce(bool publish)
     }
   }
   qp_coeff_.ineq_mat_.rightCols(svm_ineq_dim + collision_ineq_dim).diagonal().tail(collision_ineq_dim).setConstant(-1);
+  ineq_violation_ = std::max(0.0, -1 * qp_coeff_.ineq_vec_.minCoeff());
 
   // ROS_INFO_STREAM("qp_coeff_.obj_mat_:\n" << qp_coeff_.obj_mat_);
   // ROS_INFO_STREAM("qp_coeff_.obj_vec_:\n" << qp_coeff_.obj_vec_.transpose());
@@ -281,16 +298,20 @@ void RmapPlanningFootstep<SamplingSpaceType>::runOnce(bool publish)
   // ROS_INFO_STREAM("qp_coeff_.ineq_vec_:\n" << qp_coeff_.ineq_vec_.transpose());
 
   // Solve QP
-  Eigen::VectorXd vel_all = qp_solver_->solve(qp_coeff_);
+  {
+    // JRLQP allocates on the heap internally, so it is excluded from the check (warned in setup())
+    ScopedMallocAllowed solver_malloc_allowed(true);
+    vel_all_ = qp_solver_->solve(qp_coeff_);
+  }
   if(qp_solver_->solve_failed_)
   {
-    vel_all.setZero();
+    vel_all_.setZero();
   }
 
   // Integrate
   for(int i = 0; i < config_.footstep_num; i++)
   {
-    integrateVelToSample<SamplingSpaceType>(current_sample_seq_[i], vel_all.template segment<vel_dim_>(i * vel_dim_));
+    integrateVelToSample<SamplingSpaceType>(current_sample_seq_[i], vel_all_.template segment<vel_dim_>(i * vel_dim_));
   }
 
   if(publish)
@@ -301,6 +322,56 @@ void RmapPlanningFootstep<SamplingSpaceType>::runOnce(bool publish)
   }
 }
 
+template<SamplingSpace SamplingSpaceType>
+void RmapPlanningFootstep<SamplingSpaceType>::runLoop()
+{
+  // The service is advertised only here so that the instances in searchMinFootstepNum() do not conflict
+  shift_horizon_srv_ =
+      nh_.advertiseService("shift_horizon", &RmapPlanningFootstep<SamplingSpaceType>::shiftHorizonCallback, this);
+
+  RmapPlanning<SamplingSpaceType>::runLoop();
+}
+
+template<SamplingSpace SamplingSpaceType>
+bool RmapPlanningFootstep<SamplingSpaceType>::shiftHorizon()
+{
+  constexpr int shift_num = 2;
+  if(config_.footstep_num < shift_num)
+  {
+    ROS_WARN_STREAM("[RmapPlanningFootstep::shiftHorizon] Number of footsteps must be at least "
+                    << shift_num << ": " << config_.footstep_num);
+    return false;
+  }
+
+  // Extend sequence by extrapolating the last stride (the start sample is placed at the front)
+  std::vector<SampleType> & extended_sample_seq = extended_sample_seq_;
+  extended_sample_seq.clear();
+  extended_sample_seq.push_back(start_sample_);
+  extended_sample_seq.insert(extended_sample_seq.end(), current_sample_seq_.begin(), current_sample_seq_.end());
+  for(int i = 0; i < shift_num; i++)
+  {
+    int idx = extended_sample_seq.size();
+    extended_sample_seq.push_back(idx < 2 * shift_num ? extended_sample_seq[idx - shift_num]
+                                                      : extrapolateSample<SamplingSpaceType>(
+                                                            extended_sample_seq[idx - 2 * shift_num],
+                                                            extended_sample_seq[idx - shift_num]));
+  }
+
+  // Shift sequence
+  start_sample_ = extended_sample_seq[shift_num];
+  std::copy(extended_sample_seq.begin() + shift_num + 1, extended_sample_seq.end(), current_sample_seq_.begin());
+  shiftSVMSurrogates(svm_surrogate_list_.begin(), svm_surrogate_list_.end(), shift_num);
+
+  return true;
+}
+
+template<SamplingSpace SamplingSpaceType>
+bool RmapPlanningFootstep<SamplingSpaceType>::shiftHorizonCallback(std_srvs::Empty::Request & req,
+                                                                   std_srvs::Empty::Response & res)
+{
+  return shiftHorizon();
+}
+
 template<SamplingSpace SamplingSpaceType>
 void RmapPlanningFootstep<SamplingSpaceType>::publishMarkerArray() const
 {
@@ -336,17 +407,16 @@ void RmapPlanningFootstep<SamplingSpaceType>::publishMarkerArray() const
     {
       grids_marker.ns = "reachable_grids_" + std::to_string(i);
       grids_marker.id = marker_arr_msg.markers.size();
-      grids_marker.pose = OmgCore::toPoseMsg(i == 0 ? sva::PTransformd::Identity()
-                                                    : sampleToPose<SamplingSpaceType>(current_sample_seq_[i - 1]));
+      grids_marker.pose =
+          OmgCore::toPoseMsg(sampleToPose<SamplingSpaceType>(i == 0 ? start_sample_ : current_sample_seq_[i - 1]));
       if constexpr(isAlternateSupported())
       {
         grids_marker.color =
             OmgCore::toColorRGBAMsg((config_.alternate_lr && (i % 2 == 1)) ? std::array<double, 4>{0.0, 0.8, 0.0, 0.3}
                                                                            : std::array<double, 4>{0.8, 0.0, 0.0, 0.3});
       }
-      SampleType slice_sample = i == 0
-                                    ? current_sample_seq_[i]
-                                    : relSample<SamplingSpaceType>(current_sample_seq_[i - 1], current_sample_seq_[i]);
+      SampleType slice_sample =
+          relSample<SamplingSpaceType>(i == 0 ? start_sample_ : current_sample_seq_[i - 1], current_sample_seq_[i]);
       if constexpr(isAlternateSupported())
       {
         if(config_.alternate_lr && (i % 2 == 1))
@@ -453,8 +523,8 @@ void RmapPlanningFootstep<SamplingSpaceType>::publishCurrentState() const
   pose_arr_msg.poses.resize(config_.footstep_num + 1);
   for(int i = 0; i < config_.footstep_num + 1; i++)
   {
-    pose_arr_msg.poses[i] = OmgCore::toPoseMsg(i == 0 ? sva::PTransformd::Identity()
-                                                      : sampleToPose<SamplingSpaceType>(current_sample_seq_[i - 1]));
+    pose_arr_msg.poses[i] =
+        OmgCore::toPoseMsg(sampleToPose<SamplingSpaceType>(i == 0 ? start_sample_ : current_sample_seq_[i - 1]));
   }
   current_pose_arr_pub_.publish(pose_arr_msg);
 
@@ -472,8 +542,7 @@ void RmapPlanningFootstep<SamplingSpaceType>::publishCurrentState() const
   for(int i = 0; i < config_.footstep_num + 1; i++)
   {
     poly_arr_msg.polygons[i].header = header_msg;
-    sva::PTransformd foot_pose =
-        i == 0 ? sva::PTransformd::Identity() : sampleToPose<SamplingSpaceType>(current_sample_seq_[i - 1]);
+    sva::PTransformd foot_pose = sampleToPose<SamplingSpaceType>(i == 0 ? start_sample_ : current_sample_seq_[i - 1]);
     poly_arr_msg.polygons[i].polygon.points.resize(config_.foot_vertices.size());
     for(size_t j = 0; j < config_.foot_vertices.size(); j++)
     {
@@ -541,6 +610,64 @@ std::shared_ptr<RmapPlanningBase> DiffRmap::createRmapPlanningFootstep(SamplingS
   }
 }
 
+namespace
+{
+template<SamplingSpace SamplingSpaceType>
+HorizonSearchResult searchMinFootstepNumImpl(const std::string & svm_path,
+                                             const mc_rtc::Configuration & mc_rtc_config,
+                                             const HorizonSearchConfiguration & search_config)
+{
+  return searchMinHorizon<RmapPlanningFootstep<SamplingSpaceType>>(
+      [&](int footstep_num) {
+        // Grid set is not loaded because it is used only for visualization
+        auto rmap_planning = std::make_shared<RmapPlanningFootstep<SamplingSpaceType>>(svm_path, "");
+        mc_rtc::Configuration candidate_config;
+        candidate_config.load(mc_rtc_config);
+        candidate_config.add("footstep_num", footstep_num);
+        rmap_planning->configure(candidate_config);
+        rmap_planning->setTargetPose(search_config.target_pose);
+        return rmap_planning;
+      },
+      search_config);
+}
+} // namespace
+
+HorizonSearchResult DiffRmap::searchMinFootstepNum(SamplingSpace sampling_space,
+                                                   const std::string & svm_path,
+                                                   const mc_rtc::Configuration & mc_rtc_config,
+                                                   const HorizonSearchConfiguration & search_config)
+{
+  if(sampling_space == SamplingSpace::R2)
+  {
+    return searchMinFootstepNumImpl<SamplingSpace::R2>(svm_path, mc_rtc_config, search_config);
+  }
+  else if(sampling_space == SamplingSpace::SO2)
+  {
+    return searchMinFootstepNumImpl<SamplingSpace::SO2>(svm_path, mc_rtc_config, search_config);
+  }
+  else if(sampling_space == SamplingSpace::SE2)
+  {
+    return searchMinFootstepNumImpl<SamplingSpace::SE2>(svm_path, mc_rtc_config, search_config);
+  }
+  else if(sampling_space == SamplingSpace::R3)
+  {
+    return searchMinFootstepNumImpl<SamplingSpace::R3>(svm_path, mc_rtc_config, search_config);
+  }
+  else if(sampling_space == SamplingSpace::SO3)
+  {
+    return searchMinFootstepNumImpl<SamplingSpace::SO3>(svm_path, mc_rtc_config, search_config);
+  }
+  else if(sampling_space == SamplingSpace::SE3)
+  {
+    return searchMinFootstepNumImpl<SamplingSpace::SE3>(svm_path, mc_rtc_config, search_config);
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[searchMinFootstepNum] Unsupported SamplingSpace: {}",
+                                                     std::to_string(sampling_space));
+  }
+}
+
 // Declare template specialized class
 // See https://stackoverflow.com/a/8752879
 template class RmapPlanningFootstep<SamplingSpace::R2>;
@@ -12,6 +12,7 @@
 #include <optmotiongen/Utils/RosUtils.h>
 
 #include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/MallocUtils.h>
 #include <differentiable_rmap/RmapPlanningLocomanip.h>
 #include <differentiable_rmap/SVMUtils.h>
 #include <differentiable_rmap/libsvm_hotfix.h>
@@ -65,6 +66,7 @@ void RmapPlanningLocomanip::setup()
   qp_coeff_.x_max_.tail(svm_ineq_dim_ + collision_ineq_dim_).setConstant(1e10);
 
   qp_solver_ = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+  warnQpSolverMalloc("RmapPlanningLocomanip", config_.realtime_config.enabled);
 
   // Setup start sample list
   for(const Limb & limb : Limbs::all)
@@ -74,7 +76,8 @@ void RmapPlanningLocomanip::setup()
                                                                          : sva::PTransformd::Identity()));
   }
   //// Overwrite based on hand trajectory for left hand
-  start_sample_list_.at(Limb::LeftHand) = calcSampleFromHandTraj(config_.target_hand_traj_angles.first);
+  start_hand_traj_angle_ = config_.target_hand_traj_angles.first;
+  start_sample_list_.at(Limb::LeftHand) = calcSampleFromHandTraj(start_hand_traj_angle_);
 
   // Setup current sample sequence
   current_foot_sample_seq_.resize(config_.motion_len);
@@ -82,7 +85,7 @@ void RmapPlanningLocomanip::setup()
   {
     current_foot_sample_seq_[i] = start_sample_list_.at(i % 2 == 0 ? Limb::LeftFoot : Limb::RightFoot);
   }
-  current_hand_traj_angle_seq_.assign(config_.motion_len, config_.target_hand_traj_angles.first);
+  current_hand_traj_angle_seq_.assign(config_.motion_len, start_hand_traj_angle_);
   current_hand_sample_seq_.assign(config_.motion_len, start_sample_list_.at(Limb::LeftHand));
 
   // Setup adjacent regularization
@@ -115,10 +118,32 @@ void RmapPlanningLocomanip::setup()
     }
   }
   // ROS_INFO_STREAM("adjacent_reg_mat_:\n" << adjacent_reg_mat_);
+
+  // Setup cache of SVM inequality
+  svm_ineq_mat_.setZero(svm_ineq_dim_, config_dim_);
+  svm_ineq_vec_.setZero(svm_ineq_dim_);
+  cached_foot_sample_seq_ = current_foot_sample_seq_;
+  cached_hand_traj_angle_seq_ = current_hand_traj_angle_seq_;
+  foot_dirty_flag_list_.assign(config_.motion_len, true);
+  hand_dirty_flag_list_.assign(config_.motion_len, true);
+
+  // Setup local surrogate of SVM value
+  svm_surrogate_list_.assign(svm_ineq_dim_, SVMSurrogate<SamplingSpaceType>());
+
+  // Setup workspace
+  current_config_.setZero(config_dim_);
+  vel_all_.setZero(config_dim_ + svm_ineq_dim_ + collision_ineq_dim_);
+  extended_foot_sample_seq_.clear();
+  extended_foot_sample_seq_.reserve(config_.motion_len + 4);
+  extended_hand_traj_angle_seq_.clear();
+  extended_hand_traj_angle_seq_.reserve(config_.motion_len + 3);
 }
 
 void RmapPlanningLocomanip::runOnce(bool publish)
 {
+  // Forbid heap allocation except for publishing (effective only if ENABLE_NO_MALLOC_CHECK CMake option is ON)
+  ScopedMallocAllowed malloc_allowed(publish);
+
   // Set QP objective matrices
   qp_coeff_.obj_mat_.setZero();
   qp_coeff_.obj_vec_.setZero();
@@ -133,46 +158,50 @@ void RmapPlanningLocomanip::runOnce(bool publish)
   // qp_coeff_.obj_mat_.diagonal().tail(svm_ineq_dim_ + collision_ineq_dim_).tail(
   //     collision_ineq_dim_).setConstant(config_.collision_ineq_weight);
   qp_coeff_.obj_vec_(config_dim_ - 1) = target_hand_traj_angle_error;
-  Eigen::VectorXd current_config(config_dim_);
   // This implementation of adjacent regularization is not exact because the error between samples is not a simple
   // subtraction
   for(int i = 0; i < config_.motion_len; i++)
   {
-    current_config.template segment<vel_dim_>(i * vel_dim_) =
+    current_config_.template segment<vel_dim_>(i * vel_dim_) =
         sampleError<SamplingSpaceType>(identity_sample_, current_foot_sample_seq_[i]);
-    current_config(hand_start_config_idx_ + i) = current_hand_traj_angle_seq_[i];
+    current_config_(hand_start_config_idx_ + i) = current_hand_traj_angle_seq_[i];
   }
-  // ROS_INFO_STREAM("current_config:\n" << current_config.transpose());
-  qp_coeff_.obj_vec_.head(config_dim_) += adjacent_reg_mat_ * current_config;
+  // ROS_INFO_STREAM("current_config_:\n" << current_config_.transpose());
+  qp_coeff_.obj_vec_.head(config_dim_).noalias() += adjacent_reg_mat_ * current_config_;
   qp_coeff_.obj_vec_.head(vel_dim_) -=
       config_.adjacent_reg_weight
       * sampleError<SamplingSpaceType>(identity_sample_, start_sample_list_.at(Limb::LeftFoot));
-  qp_coeff_.obj_vec_(hand_start_config_idx_) -= config_.adjacent_reg_weight * config_.target_hand_traj_angles.first;
+  qp_coeff_.obj_vec_(hand_start_config_idx_) -= config_.adjacent_reg_weight * start_hand_traj_angle_;
   qp_coeff_.obj_mat_.topLeftCorner(config_dim_, config_dim_) += adjacent_reg_mat_;
 
   // Set QP inequality matrices of reachability
-  qp_coeff_.ineq_mat_.setZero();
-  qp_coeff_.ineq_vec_.setZero();
+  // The SVM inequality rows whose variables are not updated beyond svm_cache_thre are reused from the previous step
+  updateSvmDirtyFlags();
   //// Set for reachability between foot
   for(int i = 0; i < config_.motion_len; i++)
   {
+    if(!((i > 0 && foot_dirty_flag_list_[i - 1]) || foot_dirty_flag_list_[i]))
+    {
+      continue;
+    }
+
     const SampleType & pre_foot_sample =
         i == 0 ? start_sample_list_.at(Limb::RightFoot) : current_foot_sample_seq_[i - 1];
     const SampleType & suc_foot_sample = current_foot_sample_seq_[i];
     std::shared_ptr<RmapPlanning<SamplingSpaceType>> rmap_planning =
         rmapPlanning(i % 2 == 0 ? Limb::LeftFoot : Limb::RightFoot);
 
-    const SampleType & rel_sample = relSample<SamplingSpaceType>(pre_foot_sample, suc_foot_sample);
-    const VelType & rel_svm_grad = rmap_planning->calcSVMGradWithVel(rel_sample);
+    VelType pre_svm_grad;
+    VelType suc_svm_grad;
+    double rel_svm_value = rmap_planning->calcRelSVMValueAndVelGrad(
+        pre_svm_grad, suc_svm_grad, pre_foot_sample, suc_foot_sample, svm_surrogate_list_[i],
+        config_.svm_surrogate_tol, config_.svm_surrogate_radius);
     if(i > 0)
     {
-      qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, (i - 1) * vel_dim_) =
-          -1 * rel_svm_grad.transpose()
-          * relSampleToSampleMat<SamplingSpaceType>(pre_foot_sample, suc_foot_sample, false);
+      svm_ineq_mat_.template block<1, vel_dim_>(i, (i - 1) * vel_dim_) = -1 * pre_svm_grad.transpose();
     }
-    qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, i * vel_dim_) =
-        -1 * rel_svm_grad.transpose() * relSampleToSampleMat<SamplingSpaceType>(pre_foot_sample, suc_foot_sample, true);
-    qp_coeff_.ineq_vec_.template segment<1>(i) << rmap_planning->calcSVMValue(rel_sample) - config_.svm_thre;
+    svm_ineq_mat_.template block<1, vel_dim_>(i, i * vel_dim_) = -1 * suc_svm_grad.transpose();
+    svm_ineq_vec_.template segment<1>(i) << rel_svm_value - config_.svm_thre;
   }
   //// Set for reachability from foot to hand
   for(int i = 0; i < config_.motion_len; i++)
@@ -185,13 +214,17 @@ void RmapPlanningLocomanip::runOnce(bool publish)
         i == 0 ? start_sample_list_.at(Limb::LeftHand) : current_hand_sample_seq_[i - 1];
     const SampleType & suc_hand_sample = current_hand_sample_seq_[i];
     std::shared_ptr<RmapPlanning<SamplingSpaceType>> rmap_planning = rmapPlanning(Limb::LeftHand);
+    bool pre_foot_dirty = i > 0 && foot_dirty_flag_list_[i - 1];
 
-    if(i > 0)
+    if(i > 0 && (pre_foot_dirty || hand_dirty_flag_list_[i - 1] || hand_dirty_flag_list_[i]))
     {
       const SampleType & mid_hand_sample = midSample<SamplingSpaceType>(pre_hand_sample, suc_hand_sample);
       const SampleType & rel_sample = relSample<SamplingSpaceType>(pre_foot_sample, mid_hand_sample);
-      const VelType & rel_svm_grad = rmap_planning->calcSVMGradWithVel(rel_sample);
-      qp_coeff_.ineq_mat_.template block<1, vel_dim_>(start_ineq_idx + 0, (i - 1) * vel_dim_) =
+      VelType rel_svm_grad;
+      double rel_svm_value = rmap_planning->calcSVMValueAndGradWithVel(
+          rel_svm_grad, rel_sample, svm_surrogate_list_[start_ineq_idx + 0], config_.svm_surrogate_tol,
+          config_.svm_surrogate_radius);
+      svm_ineq_mat_.template block<1, vel_dim_>(start_ineq_idx + 0, (i - 1) * vel_dim_) =
           -1 * rel_svm_grad.transpose()
           * relSampleToSampleMat<SamplingSpaceType>(pre_foot_sample, mid_hand_sample, false);
       double mid_hand_ineq_mat =
@@ -199,32 +232,39 @@ void RmapPlanningLocomanip::runOnce(bool publish)
           * rel_svm_grad.transpose().dot(relSampleToSampleMat<SamplingSpaceType>(pre_foot_sample, mid_hand_sample, true)
                                          * calcSampleGradFromHandTraj(current_hand_traj_angle_seq_[i]))
           / 2;
-      qp_coeff_.ineq_mat_(start_ineq_idx + 0, hand_start_config_idx_ + (i - 1)) = mid_hand_ineq_mat;
-      qp_coeff_.ineq_mat_(start_ineq_idx + 0, hand_start_config_idx_ + i) = mid_hand_ineq_mat;
-      qp_coeff_.ineq_vec_.template segment<1>(start_ineq_idx + 0)
-          << rmap_planning->calcSVMValue(rel_sample) - config_.svm_thre;
+      svm_ineq_mat_(start_ineq_idx + 0, hand_start_config_idx_ + (i - 1)) = mid_hand_ineq_mat;
+      svm_ineq_mat_(start_ineq_idx + 0, hand_start_config_idx_ + i) = mid_hand_ineq_mat;
+      svm_ineq_vec_.template segment<1>(start_ineq_idx + 0) << rel_svm_value - config_.svm_thre;
     }
 
+    if(pre_foot_dirty || foot_dirty_flag_list_[i] || hand_dirty_flag_list_[i])
     {
       const SampleType & mid_foot_sample = midSample<SamplingSpaceType>(pre_foot_sample, suc_foot_sample);
       const SampleType & rel_sample = relSample<SamplingSpaceType>(mid_foot_sample, suc_hand_sample);
-      const VelType & rel_svm_grad = rmap_planning->calcSVMGradWithVel(rel_sample);
-      Eigen::MatrixXd mid_foot_ineq_mat =
+      VelType rel_svm_grad;
+      double rel_svm_value = rmap_planning->calcSVMValueAndGradWithVel(
+          rel_svm_grad, rel_sample, svm_surrogate_list_[start_ineq_idx + 1], config_.svm_surrogate_tol,
+          config_.svm_surrogate_radius);
+      Eigen::Matrix<double, 1, vel_dim_> mid_foot_ineq_mat =
           -1 * rel_svm_grad.transpose()
           * relSampleToSampleMat<SamplingSpaceType>(mid_foot_sample, suc_hand_sample, false) / 2;
       if(i > 0)
       {
-        qp_coeff_.ineq_mat_.template block<1, vel_dim_>(start_ineq_idx + 1, (i - 1) * vel_dim_) = mid_foot_ineq_mat;
+        svm_ineq_mat_.template block<1, vel_dim_>(start_ineq_idx + 1, (i - 1) * vel_dim_) = mid_foot_ineq_mat;
       }
-      qp_coeff_.ineq_mat_.template block<1, vel_dim_>(start_ineq_idx + 1, i * vel_dim_) = mid_foot_ineq_mat;
-      qp_coeff_.ineq_mat_(start_ineq_idx + 1, hand_start_config_idx_ + i) =
+      svm_ineq_mat_.template block<1, vel_dim_>(start_ineq_idx + 1, i * vel_dim_) = mid_foot_ineq_mat;
+      svm_ineq_mat_(start_ineq_idx + 1, hand_start_config_idx_ + i) =
           -1 * rel_svm_grad.transpose()
           * relSampleToSampleMat<SamplingSpaceType>(mid_foot_sample, suc_hand_sample, true)
           * calcSampleGradFromHandTraj(current_hand_traj_angle_seq_[i]);
-      qp_coeff_.ineq_vec_.template segment<1>(start_ineq_idx + 1)
-          << rmap_planning->calcSVMValue(rel_sample) - config_.svm_thre;
+      svm_ineq_vec_.template segment<1>(start_ineq_idx + 1) << rel_svm_value - config_.svm_thre;
     }
   }
+  clearSvmDirtyFlags();
+  qp_coeff_.ineq_mat_.setZero();
+  qp_coeff_.ineq_vec_.setZero();
+  qp_coeff_.ineq_mat_.topLeftCorner(svm_ineq_dim_, config_dim_) = svm_ineq_mat_;
+  qp_coeff_.ineq_vec_.head(svm_ineq_dim_) = svm_ineq_vec_;
   qp_coeff_.ineq_mat_.rightCols(svm_ineq_dim_ + collision_ineq_dim_).diagonal().head(svm_ineq_dim_).setConstant(-1);
 
   // ROS_INFO_STREAM("qp_coeff_.obj_mat_:\n" << qp_coeff_.obj_mat_);
@@ -233,19 +273,23 @@ void RmapPlanningLocomanip::runOnce(bool publish)
   // ROS_INFO_STREAM("qp_coeff_.ineq_vec_:\n" << qp_coeff_.ineq_vec_.transpose());
 
   // Solve QP
-  Eigen::VectorXd vel_all = qp_solver_->solve(qp_coeff_);
+  {
+    // JRLQP allocates on the heap internally, so it is excluded from the check (warned in setup())
+    ScopedMallocAllowed solver_malloc_allowed(true);
+    vel_all_ = qp_solver_->solve(qp_coeff_);
+  }
   if(qp_solver_->solve_failed_)
   {
-    vel_all.setZero();
+    vel_all_.setZero();
   }
 
   // Integrate
   for(int i = 0; i < config_.motion_len; i++)
   {
     integrateVelToSample<SamplingSpaceType>(current_foot_sample_seq_[i],
-                                            vel_all.template segment<vel_dim_>(i * vel_dim_));
+                                            vel_all_.template segment<vel_dim_>(i * vel_dim_));
 
-    current_hand_traj_angle_seq_[i] += vel_all(hand_start_config_idx_ + i);
+    current_hand_traj_angle_seq_[i] += vel_all_(hand_start_config_idx_ + i);
     current_hand_sample_seq_[i] = calcSampleFromHandTraj(current_hand_traj_angle_seq_[i]);
   }
 
@@ -259,8 +303,18 @@ void RmapPlanningLocomanip::runOnce(bool publish)
 
 void RmapPlanningLocomanip::runLoop()
 {
+  // Setup ROS
+  shift_horizon_srv_ = nh_.advertiseService("shift_horizon", &RmapPlanningLocomanip::shiftHorizonCallback, this);
+
   setup();
 
+  if(config_.realtime_config.enabled)
+  {
+    runRealtimeLoop(config_.realtime_config, config_.loop_rate, config_.publish_interval,
+                    [this](bool publish) { runOnce(publish); });
+    return;
+  }
+
   ros::Rate rate(config_.loop_rate);
   int loop_idx = 0;
   while(ros::ok())
@@ -273,6 +327,99 @@ void RmapPlanningLocomanip::runLoop()
   }
 }
 
+bool RmapPlanningLocomanip::shiftHorizon()
+{
+  // Two footsteps are committed at once so that the left and right assignment is preserved
+  constexpr int shift_num = 2;
+  if(config_.motion_len < shift_num)
+  {
+    ROS_WARN_STREAM("[RmapPlanningLocomanip::shiftHorizon] motion_len must be at least " << shift_num << ": "
+                                                                                         << config_.motion_len);
+    return false;
+  }
+
+  // Extend sequences by extrapolating the last stride (the start samples and angle are placed at the front)
+  std::vector<SampleType> & extended_foot_sample_seq = extended_foot_sample_seq_;
+  extended_foot_sample_seq.clear();
+  extended_foot_sample_seq.push_back(start_sample_list_.at(Limb::LeftFoot));
+  extended_foot_sample_seq.push_back(start_sample_list_.at(Limb::RightFoot));
+  extended_foot_sample_seq.insert(extended_foot_sample_seq.end(), current_foot_sample_seq_.begin(),
+                                  current_foot_sample_seq_.end());
+  std::vector<double> & extended_hand_traj_angle_seq = extended_hand_traj_angle_seq_;
+  extended_hand_traj_angle_seq.clear();
+  extended_hand_traj_angle_seq.push_back(start_hand_traj_angle_);
+  extended_hand_traj_angle_seq.insert(extended_hand_traj_angle_seq.end(), current_hand_traj_angle_seq_.begin(),
+                                      current_hand_traj_angle_seq_.end());
+  for(int i = 0; i < shift_num; i++)
+  {
+    int foot_idx = extended_foot_sample_seq.size();
+    extended_foot_sample_seq.push_back(extrapolateSample<SamplingSpaceType>(
+        extended_foot_sample_seq[foot_idx - 2 * shift_num], extended_foot_sample_seq[foot_idx - shift_num]));
+    int hand_idx = extended_hand_traj_angle_seq.size();
+    extended_hand_traj_angle_seq.push_back(2 * extended_hand_traj_angle_seq[hand_idx - 1]
+                                           - extended_hand_traj_angle_seq[hand_idx - 2]);
+  }
+
+  // Shift sequences
+  start_sample_list_.at(Limb::LeftFoot) = extended_foot_sample_seq[shift_num];
+  start_sample_list_.at(Limb::RightFoot) = extended_foot_sample_seq[shift_num + 1];
+  std::copy(extended_foot_sample_seq.begin() + 2 * shift_num, extended_foot_sample_seq.end(),
+            current_foot_sample_seq_.begin());
+  start_hand_traj_angle_ = extended_hand_traj_angle_seq[shift_num];
+  start_sample_list_.at(Limb::LeftHand) = calcSampleFromHandTraj(start_hand_traj_angle_);
+  for(int i = 0; i < config_.motion_len; i++)
+  {
+    current_hand_traj_angle_seq_[i] = extended_hand_traj_angle_seq[shift_num + 1 + i];
+    current_hand_sample_seq_[i] = calcSampleFromHandTraj(current_hand_traj_angle_seq_[i]);
+  }
+
+  // Shift local surrogates of SVM value (two SVM inequalities are associated with each hand angle)
+  auto hand_surrogate_begin = svm_surrogate_list_.begin() + config_.motion_len;
+  shiftSVMSurrogates(svm_surrogate_list_.begin(), hand_surrogate_begin, shift_num);
+  shiftSVMSurrogates(hand_surrogate_begin, svm_surrogate_list_.end(), 2 * shift_num);
+
+  // Recalculate all SVM inequality rows
+  foot_dirty_flag_list_.assign(config_.motion_len, true);
+  hand_dirty_flag_list_.assign(config_.motion_len, true);
+
+  return true;
+}
+
+void RmapPlanningLocomanip::updateSvmDirtyFlags()
+{
+  for(int i = 0; i < config_.motion_len; i++)
+  {
+    if(config_.svm_cache_thre < 0
+       || sampleError<SamplingSpaceType>(cached_foot_sample_seq_[i], current_foot_sample_seq_[i]).norm()
+              > config_.svm_cache_thre)
+    {
+      foot_dirty_flag_list_[i] = true;
+    }
+    if(config_.svm_cache_thre < 0
+       || std::abs(current_hand_traj_angle_seq_[i] - cached_hand_traj_angle_seq_[i]) > config_.svm_cache_thre)
+    {
+      hand_dirty_flag_list_[i] = true;
+    }
+  }
+}
+
+void RmapPlanningLocomanip::clearSvmDirtyFlags()
+{
+  for(int i = 0; i < config_.motion_len; i++)
+  {
+    if(foot_dirty_flag_list_[i])
+    {
+      cached_foot_sample_seq_[i] = current_foot_sample_seq_[i];
+      foot_dirty_flag_list_[i] = false;
+    }
+    if(hand_dirty_flag_list_[i])
+    {
+      cached_hand_traj_angle_seq_[i] = current_hand_traj_angle_seq_[i];
+      hand_dirty_flag_list_[i] = false;
+    }
+  }
+}
+
 RmapPlanningLocomanip::SampleType RmapPlanningLocomanip::calcSampleFromHandTraj(double angle) const
 {
   SampleType sample;
@@ -322,7 +469,7 @@ void RmapPlanningLocomanip::publishMarkerArray() const
     {
       double ratio = static_cast<double>(i) / (points_num - 1);
       Eigen::Vector3d pos = sampleToCloudPos<SamplingSpaceType>(calcSampleFromHandTraj(
-          (1 - ratio) * config_.target_hand_traj_angles.first + ratio * config_.target_hand_traj_angles.second));
+          (1 - ratio) * start_hand_traj_angle_ + ratio * config_.target_hand_traj_angles.second));
       pos.z() = config_.hand_marker_height;
       traj_marker.points[i] = OmgCore::toPointMsg(pos);
     }
@@ -518,6 +665,11 @@ void RmapPlanningLocomanip::publishCurrentState() const
   current_cloud_pub_.publish(cloud_msg);
 }
 
+bool RmapPlanningLocomanip::shiftHorizonCallback(std_srvs::Empty::Request & req, std_srvs::Empty::Response & res)
+{
+  return shiftHorizon();
+}
+
 void RmapPlanningLocomanip::transCallback(const geometry_msgs::TransformStamped::ConstPtr & trans_st_msg)
 {
   if(trans_st_msg->child_frame_id == "target")
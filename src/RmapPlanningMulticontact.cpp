@@ -12,6 +12,7 @@
 #include <optmotiongen/Utils/RosUtils.h>
 
 #include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/MallocUtils.h>
 #include <differentiable_rmap/RmapPlanningMulticontact.h>
 #include <differentiable_rmap/SVMUtils.h>
 #include <differentiable_rmap/libsvm_hotfix.h>
@@ -128,6 +129,7 @@ void RmapPlanningMulticontact::setup()
   qp_coeff_.x_max_.tail(svm_ineq_dim_ + collision_ineq_dim_).setConstant(1e10);
 
   qp_solver_ = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+  warnQpSolverMalloc("RmapPlanningMulticontact", config_.realtime_config.enabled);
 
   // Setup current sample sequence
   current_foot_sample_seq_.resize(foot_num_);
@@ -173,10 +175,29 @@ void RmapPlanningMulticontact::setup()
     adjacent_reg_mat_(hand_config_idx, foot_config_idx) -= config_.rel_hand_foot_weight;
   }
   // ROS_INFO_STREAM("adjacent_reg_mat_:\n" << adjacent_reg_mat_);
+
+  // Setup cache of SVM inequality
+  svm_ineq_mat_.setZero(svm_ineq_dim_, config_dim_);
+  svm_ineq_vec_.setZero(svm_ineq_dim_);
+  cached_foot_sample_seq_ = current_foot_sample_seq_;
+  cached_hand_sample_seq_ = current_hand_sample_seq_;
+  foot_dirty_flag_list_.assign(foot_num_, true);
+  hand_dirty_flag_list_.assign(hand_num_, true);
+
+  // Setup local surrogate of SVM value
+  foot_svm_surrogate_list_.assign(foot_num_ - 1, SVMSurrogate<FootSamplingSpaceType>());
+  hand_svm_surrogate_list_.assign(4 * hand_num_ - 1, SVMSurrogate<HandSamplingSpaceType>());
+
+  // Setup workspace
+  current_config_.setZero(config_dim_);
+  vel_all_.setZero(config_dim_ + svm_ineq_dim_ + collision_ineq_dim_);
 }
 
 void RmapPlanningMulticontact::runOnce(bool publish)
 {
+  // Forbid heap allocation except for publishing (effective only if ENABLE_NO_MALLOC_CHECK CMake option is ON)
+  ScopedMallocAllowed malloc_allowed(publish);
+
   // Set QP objective matrices
   qp_coeff_.obj_mat_.setZero();
   qp_coeff_.obj_vec_.setZero();
@@ -196,21 +217,20 @@ void RmapPlanningMulticontact::runOnce(bool publish)
   //     collision_ineq_dim_).setConstant(config_.collision_ineq_weight);
   qp_coeff_.obj_vec_.template head<foot_vel_dim_>() = config_.start_foot_weight * start_sample_error;
   qp_coeff_.obj_vec_.template segment<foot_vel_dim_>((foot_num_ - 1) * foot_vel_dim_) = target_sample_error;
-  Eigen::VectorXd current_config(config_dim_);
   // This implementation of adjacent regularization is not exact because the error between samples is not a simple
   // subtraction
   for(int i = 0; i < foot_num_; i++)
   {
-    current_config.template segment<foot_vel_dim_>(i * foot_vel_dim_) =
+    current_config_.template segment<foot_vel_dim_>(i * foot_vel_dim_) =
         sampleError<FootSamplingSpaceType>(identity_foot_sample_, current_foot_sample_seq_[i]);
   }
   for(int i = 0; i < hand_num_; i++)
   {
-    current_config.template segment<hand_vel_dim_>(hand_start_config_idx_ + i * hand_vel_dim_) =
+    current_config_.template segment<hand_vel_dim_>(hand_start_config_idx_ + i * hand_vel_dim_) =
         sampleError<HandSamplingSpaceType>(identity_hand_sample_, current_hand_sample_seq_[i]);
   }
-  // ROS_INFO_STREAM("current_config:\n" << current_config.transpose());
-  qp_coeff_.obj_vec_.head(config_dim_) += adjacent_reg_mat_ * current_config;
+  // ROS_INFO_STREAM("current_config_:\n" << current_config_.transpose());
+  qp_coeff_.obj_vec_.head(config_dim_).noalias() += adjacent_reg_mat_ * current_config_;
   qp_coeff_.obj_mat_.topLeftCorner(config_dim_, config_dim_) += adjacent_reg_mat_;
 
   // Set QP equality matrices of hand contact
@@ -223,25 +243,29 @@ void RmapPlanningMulticontact::runOnce(bool publish)
   }
 
   // Set QP inequality matrices of reachability
-  qp_coeff_.ineq_mat_.setZero();
-  qp_coeff_.ineq_vec_.setZero();
+  // The SVM inequality rows whose variables are not updated beyond svm_cache_thre are reused from the previous step
+  updateSvmDirtyFlags();
   //// Set for reachability between foot
   for(int i = 0; i < foot_num_ - 1; i++)
   {
+    if(!(foot_dirty_flag_list_[i] || foot_dirty_flag_list_[i + 1]))
+    {
+      continue;
+    }
+
     const FootSampleType & pre_foot_sample = current_foot_sample_seq_[i];
     const FootSampleType & suc_foot_sample = current_foot_sample_seq_[i + 1];
     std::shared_ptr<RmapPlanning<FootSamplingSpaceType>> rmap_planning =
         i % 2 == 0 ? rmapPlanning<Limb::RightFoot>() : rmapPlanning<Limb::LeftFoot>();
 
-    const FootSampleType & rel_sample = relSample<FootSamplingSpaceType>(pre_foot_sample, suc_foot_sample);
-    const FootVelType & rel_svm_grad = rmap_planning->calcSVMGradWithVel(rel_sample);
-    qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(i, i * foot_vel_dim_) =
-        -1 * rel_svm_grad.transpose()
-        * relSampleToSampleMat<FootSamplingSpaceType>(pre_foot_sample, suc_foot_sample, false);
-    qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(i, (i + 1) * foot_vel_dim_) =
-        -1 * rel_svm_grad.transpose()
-        * relSampleToSampleMat<FootSamplingSpaceType>(pre_foot_sample, suc_foot_sample, true);
-    qp_coeff_.ineq_vec_.template segment<1>(i) << rmap_planning->calcSVMValue(rel_sample) - config_.svm_thre;
+    FootVelType pre_svm_grad;
+    FootVelType suc_svm_grad;
+    double rel_svm_value = rmap_planning->calcRelSVMValueAndVelGrad(
+        pre_svm_grad, suc_svm_grad, pre_foot_sample, suc_foot_sample, foot_svm_surrogate_list_[i],
+        config_.svm_surrogate_tol, config_.svm_surrogate_radius);
+    svm_ineq_mat_.template block<1, foot_vel_dim_>(i, i * foot_vel_dim_) = -1 * pre_svm_grad.transpose();
+    svm_ineq_mat_.template block<1, foot_vel_dim_>(i, (i + 1) * foot_vel_dim_) = -1 * suc_svm_grad.transpose();
+    svm_ineq_vec_.template segment<1>(i) << rel_svm_value - config_.svm_thre;
   }
   //// Set for reachability from foot to hand
   for(int i = 0; i < hand_num_; i++)
@@ -252,66 +276,88 @@ void RmapPlanningMulticontact::runOnce(bool publish)
     const FootSampleType & suc2_foot_sample = current_foot_sample_seq_[2 * i + 2];
     const HandSampleType & hand_sample = current_hand_sample_seq_[i];
     std::shared_ptr<RmapPlanning<HandSamplingSpaceType>> rmap_planning = rmapPlanning<Limb::LeftHand>();
+    bool hand_dirty = hand_dirty_flag_list_[i];
 
-    if(i != 0)
+    if(i != 0 && (hand_dirty || foot_dirty_flag_list_[2 * i - 1] || foot_dirty_flag_list_[2 * i]))
     {
       const FootSampleType & pre2_foot_sample = current_foot_sample_seq_[2 * i - 1];
       const FootSampleType & pre12_foot_sample = midSample<FootSamplingSpaceType>(pre1_foot_sample, pre2_foot_sample);
       const HandSampleType & pre12_rel_sample =
           relSampleHandFromFoot(pre12_foot_sample, hand_sample, config_.waist_height);
-      const HandVelType & pre12_rel_svm_grad = rmap_planning->calcSVMGradWithVel(pre12_rel_sample);
+      HandVelType pre12_rel_svm_grad;
+      double pre12_rel_svm_value = rmap_planning->calcSVMValueAndGradWithVel(
+          pre12_rel_svm_grad, pre12_rel_sample, hand_svm_surrogate_list_[4 * i - 1], config_.svm_surrogate_tol,
+          config_.svm_surrogate_radius);
       // The implementation of gradient of mean sample is not exact because the mean of two samples is not a simple
       // arithmetic mean
-      Eigen::MatrixXd pre12_foot_ineq_mat =
+      Eigen::Matrix<double, 1, foot_vel_dim_> pre12_foot_ineq_mat =
           -1 * pre12_rel_svm_grad.transpose() * relSampleGradHandFromFoot(pre12_foot_sample, hand_sample, false) / 2;
-      qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 0, (2 * i - 1) * foot_vel_dim_) =
+      svm_ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 0, (2 * i - 1) * foot_vel_dim_) =
           pre12_foot_ineq_mat;
-      qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 0, (2 * i) * foot_vel_dim_) =
+      svm_ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 0, (2 * i) * foot_vel_dim_) =
           pre12_foot_ineq_mat;
-      qp_coeff_.ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 0,
-                                                           hand_start_config_idx_ + i * hand_vel_dim_) =
+      svm_ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 0, hand_start_config_idx_ + i * hand_vel_dim_) =
           -1 * pre12_rel_svm_grad.transpose() * relSampleGradHandFromFoot(pre12_foot_sample, hand_sample, true);
-      qp_coeff_.ineq_vec_.template segment<1>(start_ineq_idx + 0)
-          << rmap_planning->calcSVMValue(pre12_rel_sample) - config_.svm_thre;
+      svm_ineq_vec_.template segment<1>(start_ineq_idx + 0) << pre12_rel_svm_value - config_.svm_thre;
+    }
+
+    if(hand_dirty || foot_dirty_flag_list_[2 * i])
+    {
+      const HandSampleType & pre1_rel_sample =
+          relSampleHandFromFoot(pre1_foot_sample, hand_sample, config_.waist_height);
+      HandVelType pre1_rel_svm_grad;
+      double pre1_rel_svm_value = rmap_planning->calcSVMValueAndGradWithVel(
+          pre1_rel_svm_grad, pre1_rel_sample, hand_svm_surrogate_list_[4 * i], config_.svm_surrogate_tol,
+          config_.svm_surrogate_radius);
+      svm_ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 1, (2 * i) * foot_vel_dim_) =
+          -1 * pre1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(pre1_foot_sample, hand_sample, false);
+      svm_ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 1, hand_start_config_idx_ + i * hand_vel_dim_) =
+          -1 * pre1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(pre1_foot_sample, hand_sample, true);
+      svm_ineq_vec_.template segment<1>(start_ineq_idx + 1) << pre1_rel_svm_value - config_.svm_thre;
+    }
+
+    if(hand_dirty || foot_dirty_flag_list_[2 * i + 1])
+    {
+      const HandSampleType & suc1_rel_sample =
+          relSampleHandFromFoot(suc1_foot_sample, hand_sample, config_.waist_height);
+      HandVelType suc1_rel_svm_grad;
+      double suc1_rel_svm_value = rmap_planning->calcSVMValueAndGradWithVel(
+          suc1_rel_svm_grad, suc1_rel_sample, hand_svm_surrogate_list_[4 * i + 1], config_.svm_surrogate_tol,
+          config_.svm_surrogate_radius);
+      svm_ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 2, (2 * i + 1) * foot_vel_dim_) =
+          -1 * suc1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc1_foot_sample, hand_sample, false);
+      svm_ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 2, hand_start_config_idx_ + i * hand_vel_dim_) =
+          -1 * suc1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc1_foot_sample, hand_sample, true);
+      svm_ineq_vec_.template segment<1>(start_ineq_idx + 2) << suc1_rel_svm_value - config_.svm_thre;
     }
 
-    const HandSampleType & pre1_rel_sample = relSampleHandFromFoot(pre1_foot_sample, hand_sample, config_.waist_height);
-    const HandVelType & pre1_rel_svm_grad = rmap_planning->calcSVMGradWithVel(pre1_rel_sample);
-    qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 1, (2 * i) * foot_vel_dim_) =
-        -1 * pre1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(pre1_foot_sample, hand_sample, false);
-    qp_coeff_.ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 1,
-                                                         hand_start_config_idx_ + i * hand_vel_dim_) =
-        -1 * pre1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(pre1_foot_sample, hand_sample, true);
-    qp_coeff_.ineq_vec_.template segment<1>(start_ineq_idx + 1)
-        << rmap_planning->calcSVMValue(pre1_rel_sample) - config_.svm_thre;
-
-    const HandSampleType & suc1_rel_sample = relSampleHandFromFoot(suc1_foot_sample, hand_sample, config_.waist_height);
-    const HandVelType & suc1_rel_svm_grad = rmap_planning->calcSVMGradWithVel(suc1_rel_sample);
-    qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 2, (2 * i + 1) * foot_vel_dim_) =
-        -1 * suc1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc1_foot_sample, hand_sample, false);
-    qp_coeff_.ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 2,
-                                                         hand_start_config_idx_ + i * hand_vel_dim_) =
-        -1 * suc1_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc1_foot_sample, hand_sample, true);
-    qp_coeff_.ineq_vec_.template segment<1>(start_ineq_idx + 2)
-        << rmap_planning->calcSVMValue(suc1_rel_sample) - config_.svm_thre;
-
-    const FootSampleType & suc12_foot_sample = midSample<FootSamplingSpaceType>(suc1_foot_sample, suc2_foot_sample);
-    const HandSampleType & suc12_rel_sample =
-        relSampleHandFromFoot(suc12_foot_sample, hand_sample, config_.waist_height);
-    const HandVelType & suc12_rel_svm_grad = rmap_planning->calcSVMGradWithVel(suc12_rel_sample);
-    Eigen::MatrixXd suc12_foot_ineq_mat =
-        -1 * suc12_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc12_foot_sample, hand_sample, false) / 2;
-    qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 3, (2 * i + 1) * foot_vel_dim_) =
-        suc12_foot_ineq_mat;
-    qp_coeff_.ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 3, (2 * i + 2) * foot_vel_dim_) =
-        suc12_foot_ineq_mat;
-    qp_coeff_.ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 3,
-                                                         hand_start_config_idx_ + i * hand_vel_dim_) =
-        -1 * suc12_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc12_foot_sample, hand_sample, true);
-    qp_coeff_.ineq_vec_.template segment<1>(start_ineq_idx + 3)
-        << rmap_planning->calcSVMValue(suc12_rel_sample) - config_.svm_thre;
+    if(hand_dirty || foot_dirty_flag_list_[2 * i + 1] || foot_dirty_flag_list_[2 * i + 2])
+    {
+      const FootSampleType & suc12_foot_sample = midSample<FootSamplingSpaceType>(suc1_foot_sample, suc2_foot_sample);
+      const HandSampleType & suc12_rel_sample =
+          relSampleHandFromFoot(suc12_foot_sample, hand_sample, config_.waist_height);
+      HandVelType suc12_rel_svm_grad;
+      double suc12_rel_svm_value = rmap_planning->calcSVMValueAndGradWithVel(
+          suc12_rel_svm_grad, suc12_rel_sample, hand_svm_surrogate_list_[4 * i + 2], config_.svm_surrogate_tol,
+          config_.svm_surrogate_radius);
+      Eigen::Matrix<double, 1, foot_vel_dim_> suc12_foot_ineq_mat =
+          -1 * suc12_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc12_foot_sample, hand_sample, false) / 2;
+      svm_ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 3, (2 * i + 1) * foot_vel_dim_) =
+          suc12_foot_ineq_mat;
+      svm_ineq_mat_.template block<1, foot_vel_dim_>(start_ineq_idx + 3, (2 * i + 2) * foot_vel_dim_) =
+          suc12_foot_ineq_mat;
+      svm_ineq_mat_.template block<1, hand_vel_dim_>(start_ineq_idx + 3, hand_start_config_idx_ + i * hand_vel_dim_) =
+          -1 * suc12_rel_svm_grad.transpose() * relSampleGradHandFromFoot(suc12_foot_sample, hand_sample, true);
+      svm_ineq_vec_.template segment<1>(start_ineq_idx + 3) << suc12_rel_svm_value - config_.svm_thre;
+    }
   }
+  clearSvmDirtyFlags();
+  qp_coeff_.ineq_mat_.setZero();
+  qp_coeff_.ineq_vec_.setZero();
+  qp_coeff_.ineq_mat_.topLeftCorner(svm_ineq_dim_, config_dim_) = svm_ineq_mat_;
+  qp_coeff_.ineq_vec_.head(svm_ineq_dim_) = svm_ineq_vec_;
   qp_coeff_.ineq_mat_.rightCols(svm_ineq_dim_ + collision_ineq_dim_).diagonal().head(svm_ineq_dim_).setConstant(-1);
+  ineq_violation_ = std::max(0.0, -1 * qp_coeff_.ineq_vec_.minCoeff());
 
   // Set QP variables limit
   for(int i = 0; i < foot_num_; i++)
@@ -339,23 +385,27 @@ void RmapPlanningMulticontact::runOnce(bool publish)
   // ROS_INFO_STREAM("qp_coeff_.x_max_:\n" << qp_coeff_.x_max_.transpose());
 
   // Solve QP
-  Eigen::VectorXd vel_all = qp_solver_->solve(qp_coeff_);
+  {
+    // JRLQP allocates on the heap internally, so it is excluded from the check (warned in setup())
+    ScopedMallocAllowed solver_malloc_allowed(true);
+    vel_all_ = qp_solver_->solve(qp_coeff_);
+  }
   if(qp_solver_->solve_failed_)
   {
-    vel_all.setZero();
+    vel_all_.setZero();
   }
 
   // Integrate
   for(int i = 0; i < foot_num_; i++)
   {
     integrateVelToSample<FootSamplingSpaceType>(current_foot_sample_seq_[i],
-                                                vel_all.template segment<foot_vel_dim_>(i * foot_vel_dim_));
+                                                vel_all_.template segment<foot_vel_dim_>(i * foot_vel_dim_));
   }
   for(int i = 0; i < hand_num_; i++)
   {
     integrateVelToSample<HandSamplingSpaceType>(
         current_hand_sample_seq_[i],
-        vel_all.template segment<hand_vel_dim_>(hand_start_config_idx_ + i * hand_vel_dim_));
+        vel_all_.template segment<hand_vel_dim_>(hand_start_config_idx_ + i * hand_vel_dim_));
   }
 
   if(publish)
@@ -368,8 +418,18 @@ void RmapPlanningMulticontact::runOnce(bool publish)
 
 void RmapPlanningMulticontact::runLoop()
 {
+  // The service is advertised only here so that the instances in searchMinMotionLen() do not conflict
+  shift_horizon_srv_ = nh_.advertiseService("shift_horizon", &RmapPlanningMulticontact::shiftHorizonCallback, this);
+
   setup();
 
+  if(config_.realtime_config.enabled)
+  {
+    runRealtimeLoop(config_.realtime_config, config_.loop_rate, config_.publish_interval,
+                    [this](bool publish) { runOnce(publish); });
+    return;
+  }
+
   ros::Rate rate(config_.loop_rate);
   int loop_idx = 0;
   while(ros::ok())
@@ -382,6 +442,136 @@ void RmapPlanningMulticontact::runLoop()
   }
 }
 
+bool RmapPlanningMulticontact::shiftHorizon()
+{
+  // Two footsteps and one hand contact are committed at once so that the left and right assignment is preserved
+  constexpr int foot_shift_num = 2;
+  constexpr int hand_shift_num = 1;
+
+  // Shift foot sequence and extrapolate the last stride
+  // The samples at the tail are kept as is if there is no sample to extrapolate from
+  for(int i = 0; i < foot_num_; i++)
+  {
+    if(i + foot_shift_num < foot_num_)
+    {
+      current_foot_sample_seq_[i] = current_foot_sample_seq_[i + foot_shift_num];
+    }
+    else if(i >= 2 * foot_shift_num)
+    {
+      current_foot_sample_seq_[i] = extrapolateSample<FootSamplingSpaceType>(
+          current_foot_sample_seq_[i - 2 * foot_shift_num], current_foot_sample_seq_[i - foot_shift_num]);
+    }
+    else if(i >= foot_shift_num)
+    {
+      current_foot_sample_seq_[i] = current_foot_sample_seq_[i - foot_shift_num];
+    }
+  }
+  start_foot_sample_ = current_foot_sample_seq_.front();
+
+  // Shift hand sequence and extrapolate the last stride
+  for(int i = 0; i < hand_num_; i++)
+  {
+    if(i + hand_shift_num < hand_num_)
+    {
+      current_hand_sample_seq_[i] = current_hand_sample_seq_[i + hand_shift_num];
+    }
+    else if(i >= 2 * hand_shift_num)
+    {
+      current_hand_sample_seq_[i] = extrapolateSample<HandSamplingSpaceType>(
+          current_hand_sample_seq_[i - 2 * hand_shift_num], current_hand_sample_seq_[i - hand_shift_num]);
+    }
+    else if(i >= hand_shift_num)
+    {
+      current_hand_sample_seq_[i] = current_hand_sample_seq_[i - hand_shift_num];
+    }
+  }
+
+  // Shift local surrogates of SVM value (four SVM inequalities are associated with each hand)
+  shiftSVMSurrogates(foot_svm_surrogate_list_.begin(), foot_svm_surrogate_list_.end(), foot_shift_num);
+  shiftSVMSurrogates(hand_svm_surrogate_list_.begin(), hand_svm_surrogate_list_.end(), 4 * hand_shift_num);
+
+  // Recalculate all SVM inequality rows
+  foot_dirty_flag_list_.assign(foot_num_, true);
+  hand_dirty_flag_list_.assign(hand_num_, true);
+
+  return true;
+}
+
+HorizonSearchResult RmapPlanningMulticontact::searchMinMotionLen(
+    const std::unordered_map<Limb, std::string> & svm_path_list,
+    const mc_rtc::Configuration & mc_rtc_config,
+    const HorizonSearchConfiguration & search_config)
+{
+  if(search_config.min_horizon % 2 != 0 || search_config.horizon_stride % 2 != 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapPlanningMulticontact::searchMinMotionLen] min_horizon and horizon_stride must be multiples of 2, but are "
+        "{} and {}",
+        search_config.min_horizon, search_config.horizon_stride);
+  }
+
+  // Grid set is not loaded because it is used only for visualization
+  std::unordered_map<Limb, std::string> bag_path_list;
+  for(const auto & svm_path_kv : svm_path_list)
+  {
+    bag_path_list.emplace(svm_path_kv.first, "");
+  }
+
+  return searchMinHorizon<RmapPlanningMulticontact>(
+      [&](int motion_len) {
+        auto rmap_planning = std::make_shared<RmapPlanningMulticontact>(svm_path_list, bag_path_list);
+        mc_rtc::Configuration candidate_config;
+        candidate_config.load(mc_rtc_config);
+        candidate_config.add("motion_len", motion_len);
+        rmap_planning->configure(candidate_config);
+        rmap_planning->setTargetPose(search_config.target_pose);
+        return rmap_planning;
+      },
+      search_config);
+}
+
+void RmapPlanningMulticontact::updateSvmDirtyFlags()
+{
+  for(int i = 0; i < foot_num_; i++)
+  {
+    if(config_.svm_cache_thre < 0
+       || sampleError<FootSamplingSpaceType>(cached_foot_sample_seq_[i], current_foot_sample_seq_[i]).norm()
+              > config_.svm_cache_thre)
+    {
+      foot_dirty_flag_list_[i] = true;
+    }
+  }
+  for(int i = 0; i < hand_num_; i++)
+  {
+    if(config_.svm_cache_thre < 0
+       || sampleError<HandSamplingSpaceType>(cached_hand_sample_seq_[i], current_hand_sample_seq_[i]).norm()
+              > config_.svm_cache_thre)
+    {
+      hand_dirty_flag_list_[i] = true;
+    }
+  }
+}
+
+void RmapPlanningMulticontact::clearSvmDirtyFlags()
+{
+  for(int i = 0; i < foot_num_; i++)
+  {
+    if(foot_dirty_flag_list_[i])
+    {
+      cached_foot_sample_seq_[i] = current_foot_sample_seq_[i];
+      foot_dirty_flag_list_[i] = false;
+    }
+  }
+  for(int i = 0; i < hand_num_; i++)
+  {
+    if(hand_dirty_flag_list_[i])
+    {
+      cached_hand_sample_seq_[i] = current_hand_sample_seq_[i];
+      hand_dirty_flag_list_[i] = false;
+    }
+  }
+}
+
 void RmapPlanningMulticontact::publishMarkerArray() const
 {
   std_msgs::Header header_msg;
@@ -556,6 +746,11 @@ void RmapPlanningMulticontact::publishCurrentState() const
   current_cloud_pub_.publish(cloud_msg);
 }
 
+bool RmapPlanningMulticontact::shiftHorizonCallback(std_srvs::Empty::Request & req, std_srvs::Empty::Response & res)
+{
+  return shiftHorizon();
+}
+
 void RmapPlanningMulticontact::transCallback(const geometry_msgs::TransformStamped::ConstPtr & trans_st_msg)
 {
   if(trans_st_msg->child_frame_id == "target")
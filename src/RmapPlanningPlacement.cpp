@@ -13,6 +13,8 @@
 #include <optmotiongen/Utils/RosUtils.h>
 
 #include <differentiable_rmap/GridUtils.h>
+#include <differentiable_rmap/IKUtils.h>
+#include <differentiable_rmap/MallocUtils.h>
 #include <differentiable_rmap/RmapPlanningPlacement.h>
 #include <differentiable_rmap/SVMUtils.h>
 #include <differentiable_rmap/libsvm_hotfix.h>
@@ -55,6 +57,7 @@ RmapPlanningPlacement<SamplingSpaceType>::RmapPlanningPlacement(const std::strin
   posture_srv_ =
       nh_.advertiseService("generate_posture", &RmapPlanningPlacement<SamplingSpaceType>::postureCallback, this);
   animate_srv_ = nh_.advertiseService("animate", &RmapPlanningPlacement<SamplingSpaceType>::animateCallback, this);
+  vote_srv_ = nh_.advertiseService("vote_placement", &RmapPlanningPlacement<SamplingSpaceType>::voteCallback, this);
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -91,27 +94,72 @@ void RmapPlanningPlacement<SamplingSpaceType>::setup(const std::shared_ptr<OmgCo
   }
 
   // Setup QP coefficients and solver
-  int config_dim = placement_vel_dim_ + config_.reaching_num * vel_dim_;
-  int svm_ineq_dim = config_.reaching_num;
-  int collision_ineq_dim = 0;
-  // Introduce variables for inequality constraint errors
-  qp_coeff_.setup(config_dim + svm_ineq_dim + collision_ineq_dim, 0, svm_ineq_dim + collision_ineq_dim);
-  qp_coeff_.x_min_.head(config_dim).setConstant(-config_.delta_config_limit);
-  qp_coeff_.x_max_.head(config_dim).setConstant(config_.delta_config_limit);
-  qp_coeff_.x_min_.tail(svm_ineq_dim + collision_ineq_dim).setConstant(-1e10);
-  qp_coeff_.x_max_.tail(svm_ineq_dim + collision_ineq_dim).setConstant(1e10);
+  if(config_.qp_solver_type == "JRLQP")
+  {
+    int config_dim = placement_vel_dim_ + config_.reaching_num * vel_dim_;
+    int svm_ineq_dim = config_.reaching_num;
+    int collision_ineq_dim = 0;
+    // Introduce variables for inequality constraint errors
+    qp_coeff_.setup(config_dim + svm_ineq_dim + collision_ineq_dim, 0, svm_ineq_dim + collision_ineq_dim);
+    qp_coeff_.x_min_.head(config_dim).setConstant(-config_.delta_config_limit);
+    qp_coeff_.x_max_.head(config_dim).setConstant(config_.delta_config_limit);
+    qp_coeff_.x_min_.tail(svm_ineq_dim + collision_ineq_dim).setConstant(-1e10);
+    qp_coeff_.x_max_.tail(svm_ineq_dim + collision_ineq_dim).setConstant(1e10);
+
+    qp_solver_ = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+    warnQpSolverMalloc("RmapPlanningPlacement", config_.realtime_config.enabled);
+    arrow_qp_solver_ = nullptr;
+  }
+  else if(config_.qp_solver_type == "Arrow")
+  {
+    // Inequality constraint errors are handled inside the solver
+    arrow_qp_solver_ = std::make_shared<ArrowQpSolver<placement_vel_dim_, vel_dim_>>();
+    arrow_qp_solver_->setup(config_.reaching_num);
+    arrow_qp_solver_->x_min_.setConstant(-config_.delta_config_limit);
+    arrow_qp_solver_->x_max_.setConstant(config_.delta_config_limit);
+
+    qp_solver_ = nullptr;
+  }
+  else
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[RmapPlanningPlacement] Invalid qp_solver_type: {}",
+                                                     config_.qp_solver_type);
+  }
 
-  qp_solver_ = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+  vel_all_.setZero(placement_vel_dim_ + config_.reaching_num * vel_dim_);
 
   // Setup current and target samples
   current_placement_sample_ = identity_placement_sample_;
   current_reaching_sample_list_.assign(config_.reaching_num, identity_sample_);
   target_reaching_sample_list_.assign(config_.reaching_num, identity_sample_);
+
+  // Setup inverse reachability map
+  if(config_.inv_grid_bag_path.empty())
+  {
+    inv_grid_set_msg_ = nullptr;
+  }
+  else
+  {
+    ROS_INFO_STREAM("Load inverse grid set from " << config_.inv_grid_bag_path);
+    inv_grid_set_msg_ = loadBag<differentiable_rmap::RmapGridSet>(config_.inv_grid_bag_path);
+    if(inv_grid_set_msg_->type != static_cast<int>(PlacementSamplingSpaceType))
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>(
+          "[RmapPlanningPlacement] SamplingSpace of inverse grid set does not match: {} != {}", inv_grid_set_msg_->type,
+          static_cast<int>(PlacementSamplingSpaceType));
+    }
+  }
+  placement_candidate_list_.clear();
+  placement_candidate_idx_ = 0;
+  target_updated_after_vote_ = true;
 }
 
 template<SamplingSpace SamplingSpaceType>
 void RmapPlanningPlacement<SamplingSpaceType>::runOnce(bool publish)
 {
+  // Forbid heap allocation except for publishing and printing (effective only if ENABLE_NO_MALLOC_CHECK is ON)
+  ScopedMallocAllowed malloc_allowed(publish || config_.print_duration);
+
   int config_dim = placement_vel_dim_ + config_.reaching_num * vel_dim_;
   int svm_ineq_dim = config_.reaching_num;
   int collision_ineq_dim = 0;
@@ -120,26 +168,46 @@ void RmapPlanningPlacement<SamplingSpaceType>::runOnce(bool publish)
   {
     auto start_time = std::chrono::system_clock::now();
 
-    qp_coeff_.obj_mat_.setZero();
-    qp_coeff_.obj_vec_.setZero();
-    qp_coeff_.obj_mat_.diagonal().template head<placement_vel_dim_>() = config_.placement_weight_vec;
-    qp_coeff_.obj_vec_.template head<placement_vel_dim_>() = config_.placement_weight_vec.cwiseProduct(
-        sampleError<SamplingSpaceType>(target_placement_sample_, current_placement_sample_));
-    for(int i = 0; i < config_.reaching_num; i++)
+    if(qp_solver_)
     {
-      int row_idx = placement_vel_dim_ + i * vel_dim_;
-      qp_coeff_.obj_mat_.diagonal().template segment<vel_dim_>(row_idx).setConstant(1.0);
-      qp_coeff_.obj_vec_.template segment<vel_dim_>(row_idx) =
-          sampleError<SamplingSpaceType>(target_reaching_sample_list_[i], current_reaching_sample_list_[i]);
+      qp_coeff_.obj_mat_.setZero();
+      qp_coeff_.obj_vec_.setZero();
+      qp_coeff_.obj_mat_.diagonal().template head<placement_vel_dim_>() = config_.placement_weight_vec;
+      qp_coeff_.obj_vec_.template head<placement_vel_dim_>() = config_.placement_weight_vec.cwiseProduct(
+          sampleError<SamplingSpaceType>(target_placement_sample_, current_placement_sample_));
+      for(int i = 0; i < config_.reaching_num; i++)
+      {
+        int row_idx = placement_vel_dim_ + i * vel_dim_;
+        qp_coeff_.obj_mat_.diagonal().template segment<vel_dim_>(row_idx).setConstant(1.0);
+        qp_coeff_.obj_vec_.template segment<vel_dim_>(row_idx) =
+            sampleError<SamplingSpaceType>(target_reaching_sample_list_[i], current_reaching_sample_list_[i]);
+      }
+      qp_coeff_.obj_mat_.diagonal().head(config_dim).array() +=
+          qp_coeff_.obj_vec_.head(config_dim).squaredNorm() + config_.reg_weight;
+      qp_coeff_.obj_mat_.diagonal()
+          .tail(svm_ineq_dim + collision_ineq_dim)
+          .head(svm_ineq_dim)
+          .setConstant(config_.svm_ineq_weight);
+      // qp_coeff_.obj_mat_.diagonal().tail(svm_ineq_dim + collision_ineq_dim).tail(
+      //     collision_ineq_dim).setConstant(config_.collision_ineq_weight);
+    }
+    else
+    {
+      Eigen::VectorXd & obj_diag = arrow_qp_solver_->obj_diag_;
+      Eigen::VectorXd & obj_vec = arrow_qp_solver_->obj_vec_;
+      obj_diag.template head<placement_vel_dim_>() = config_.placement_weight_vec;
+      obj_vec.template head<placement_vel_dim_>() = config_.placement_weight_vec.cwiseProduct(
+          sampleError<SamplingSpaceType>(target_placement_sample_, current_placement_sample_));
+      for(int i = 0; i < config_.reaching_num; i++)
+      {
+        int row_idx = placement_vel_dim_ + i * vel_dim_;
+        obj_diag.template segment<vel_dim_>(row_idx).setConstant(1.0);
+        obj_vec.template segment<vel_dim_>(row_idx) =
+            sampleError<SamplingSpaceType>(target_reaching_sample_list_[i], current_reaching_sample_list_[i]);
+      }
+      obj_diag.array() += obj_vec.squaredNorm() + config_.reg_weight;
+      arrow_qp_solver_->ineq_weight_ = config_.svm_ineq_weight;
     }
-    qp_coeff_.obj_mat_.diagonal().head(config_dim).array() +=
-        qp_coeff_.obj_vec_.head(config_dim).squaredNorm() + config_.reg_weight;
-    qp_coeff_.obj_mat_.diagonal()
-        .tail(svm_ineq_dim + collision_ineq_dim)
-        .head(svm_ineq_dim)
-        .setConstant(config_.svm_ineq_weight);
-    // qp_coeff_.obj_mat_.diagonal().tail(svm_ineq_dim + collision_ineq_dim).tail(
-    //     collision_ineq_dim).setConstant(config_.collision_ineq_weight);
 
     double duration =
         1e3
@@ -156,25 +224,42 @@ void RmapPlanningPlacement<SamplingSpaceType>::runOnce(bool publish)
   {
     auto start_time = std::chrono::system_clock::now();
 
-    qp_coeff_.ineq_mat_.setZero();
-    qp_coeff_.ineq_vec_.setZero();
+    if(qp_solver_)
+    {
+      qp_coeff_.ineq_mat_.setZero();
+      qp_coeff_.ineq_vec_.setZero();
+    }
     for(int i = 0; i < config_.reaching_num; i++)
     {
       const PlacementSampleType & pre_sample = current_placement_sample_;
       const SampleType & suc_sample = current_reaching_sample_list_[i];
-      const SampleType & rel_sample = relSample<SamplingSpaceType>(pre_sample, suc_sample);
-      const SampleType & svm_grad = this->calcSVMGrad(rel_sample);
-      const SampleToSampleMat<SamplingSpaceType> & rel_sample_mat_pre =
-          relSampleToSampleMat<SamplingSpaceType>(pre_sample, suc_sample, false);
-      const SampleToSampleMat<SamplingSpaceType> & rel_sample_mat_suc =
-          relSampleToSampleMat<SamplingSpaceType>(pre_sample, suc_sample, true);
-      qp_coeff_.ineq_mat_.template block<1, placement_vel_dim_>(i, 0) =
-          -1 * svm_grad.transpose() * rel_sample_mat_pre * sampleToVelMat<SamplingSpaceType>(pre_sample).transpose();
-      qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, placement_vel_dim_ + i * vel_dim_) =
-          -1 * svm_grad.transpose() * rel_sample_mat_suc * sampleToVelMat<SamplingSpaceType>(suc_sample).transpose();
-      qp_coeff_.ineq_vec_.template segment<1>(i) << this->calcSVMValue(rel_sample) - config_.svm_thre;
+      // Surrogate is not carried over, so SVM is evaluated exactly
+      SVMSurrogate<SamplingSpaceType> svm_surrogate;
+      PlacementVelType placement_ineq_coeff;
+      VelType reaching_ineq_coeff;
+      double ineq_value = this->calcRelSVMValueAndVelGrad(placement_ineq_coeff, reaching_ineq_coeff, pre_sample,
+                                                          suc_sample, svm_surrogate, 0.0, 0.0)
+                          - config_.svm_thre;
+      placement_ineq_coeff *= -1;
+      reaching_ineq_coeff *= -1;
+      if(qp_solver_)
+      {
+        qp_coeff_.ineq_mat_.template block<1, placement_vel_dim_>(i, 0) = placement_ineq_coeff.transpose();
+        qp_coeff_.ineq_mat_.template block<1, vel_dim_>(i, placement_vel_dim_ + i * vel_dim_) =
+            reaching_ineq_coeff.transpose();
+        qp_coeff_.ineq_vec_.template segment<1>(i) << ineq_value;
+      }
+      else
+      {
+        arrow_qp_solver_->coupled_ineq_mat_.col(i) = placement_ineq_coeff;
+        arrow_qp_solver_->block_ineq_mat_.col(i) = reaching_ineq_coeff;
+        arrow_qp_solver_->ineq_vec_[i] = ineq_value;
+      }
+    }
+    if(qp_solver_)
+    {
+      qp_coeff_.ineq_mat_.rightCols(svm_ineq_dim + collision_ineq_dim).diagonal().head(svm_ineq_dim).setConstant(-1);
     }
-    qp_coeff_.ineq_mat_.rightCols(svm_ineq_dim + collision_ineq_dim).diagonal().head(svm_ineq_dim).setConstant(-1);
 
     double duration =
         1e3
@@ -192,14 +277,31 @@ void RmapPlanningPlacement<SamplingSpaceType>::runOnce(bool publish)
   // ROS_INFO_STREAM("qp_coeff_.ineq_vec_:\n" << qp_coeff_.ineq_vec_.transpose());
 
   // Solve QP
-  Eigen::VectorXd vel_all;
   {
     auto start_time = std::chrono::system_clock::now();
 
-    vel_all = qp_solver_->solve(qp_coeff_);
-    if(qp_solver_->solve_failed_)
+    if(qp_solver_)
+    {
+      {
+        // JRLQP allocates on the heap internally, so it is excluded from the check (warned in setup())
+        ScopedMallocAllowed solver_malloc_allowed(true);
+        vel_all_ = qp_solver_->solve(qp_coeff_).head(config_dim);
+      }
+      if(qp_solver_->solve_failed_)
+      {
+        vel_all_.setZero();
+      }
+    }
+    else
     {
-      vel_all.setZero();
+      if(arrow_qp_solver_->solve())
+      {
+        vel_all_ = arrow_qp_solver_->x_;
+      }
+      else
+      {
+        vel_all_.setZero();
+      }
     }
 
     double duration =
@@ -217,11 +319,11 @@ void RmapPlanningPlacement<SamplingSpaceType>::runOnce(bool publish)
     auto start_time = std::chrono::system_clock::now();
 
     integrateVelToSample<PlacementSamplingSpaceType>(current_placement_sample_,
-                                                     vel_all.template head<placement_vel_dim_>());
+                                                     vel_all_.template head<placement_vel_dim_>());
     for(int i = 0; i < config_.reaching_num; i++)
     {
       integrateVelToSample<SamplingSpaceType>(current_reaching_sample_list_[i],
-                                              vel_all.template segment<vel_dim_>(placement_vel_dim_ + i * vel_dim_));
+                                              vel_all_.template segment<vel_dim_>(placement_vel_dim_ + i * vel_dim_));
     }
 
     double duration =
@@ -258,6 +360,13 @@ void RmapPlanningPlacement<SamplingSpaceType>::runLoop(const std::shared_ptr<Omg
 {
   setup(rb);
 
+  if(config_.realtime_config.enabled)
+  {
+    runRealtimeLoop(config_.realtime_config, config_.loop_rate, config_.publish_interval,
+                    [this](bool publish) { runOnce(publish); });
+    return;
+  }
+
   ros::Rate rate(config_.loop_rate);
   int loop_idx = 0;
   while(ros::ok())
@@ -382,6 +491,12 @@ void RmapPlanningPlacement<SamplingSpaceType>::transCallback(
                                        .translation());
       target_reaching_sample_list_[i] = poseToSample<SamplingSpaceType>(target_pose);
     }
+
+    target_updated_after_vote_ = true;
+    if(config_.vote_on_target_update && inv_grid_set_msg_)
+    {
+      restartFromPlacementCandidate();
+    }
   }
 }
 
@@ -468,8 +583,8 @@ bool RmapPlanningPlacement<SamplingSpaceType>::postureCallback(std_srvs::Empty::
       rbd::forwardKinematics(*rb, *rbc);
 
       // Solve IK
-      problem_->run(config_.ik_loop_num);
-      taskset_.update(rb_arr_, problem_->rbcArr(), aux_rb_arr);
+      bool ik_trial_solved = runIK(*problem_, {&taskset_}, rb_arr_, problem_->rbcArr(), aux_rb_arr, config_.ik_loop_num,
+                                   config_.ik_error_thre, config_.ik_check_interval, config_.ik_stagnation_thre);
 
       if(taskset_.errorSquaredNorm(false) < best_error)
       {
@@ -477,7 +592,7 @@ bool RmapPlanningPlacement<SamplingSpaceType>::postureCallback(std_srvs::Empty::
         best_error_vec = body_task_->weight().cwiseProduct(body_task_->value());
         best_rbc = std::make_shared<rbd::MultiBodyConfig>(*rbc);
       }
-      if(taskset_.errorSquaredNorm(false) < std::pow(config_.ik_error_thre, 2))
+      if(ik_trial_solved)
       {
         ik_solved = true;
         break;
@@ -621,6 +736,60 @@ bool RmapPlanningPlacement<SamplingSpaceType>::animateCallback(std_srvs::Empty::
   return true;
 }
 
+template<SamplingSpace SamplingSpaceType>
+bool RmapPlanningPlacement<SamplingSpaceType>::voteCallback(std_srvs::Empty::Request & req,
+                                                            std_srvs::Empty::Response & res)
+{
+  if(!inv_grid_set_msg_)
+  {
+    ROS_ERROR_STREAM("[voteCallback] Inverse reachability map is not loaded. Set inv_grid_bag_path.");
+    return false;
+  }
+
+  return restartFromPlacementCandidate();
+}
+
+template<SamplingSpace SamplingSpaceType>
+bool RmapPlanningPlacement<SamplingSpaceType>::restartFromPlacementCandidate()
+{
+  // Vote placement
+  if(target_updated_after_vote_ || placement_candidate_idx_ >= placement_candidate_list_.size())
+  {
+    auto start_time = std::chrono::system_clock::now();
+
+    placement_candidate_list_ = votePlacement<PlacementSamplingSpaceType>(
+        *inv_grid_set_msg_, target_reaching_sample_list_, config_.svm_thre, config_.placement_candidate_num);
+    placement_candidate_idx_ = 0;
+    target_updated_after_vote_ = false;
+
+    double duration =
+        1e3
+        * std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::system_clock::now() - start_time)
+              .count();
+    if(config_.print_duration)
+    {
+      ROS_INFO_STREAM("Duration for voting placement: " << duration << " [ms]");
+    }
+  }
+  if(placement_candidate_list_.empty())
+  {
+    ROS_WARN_STREAM("[restartFromPlacementCandidate] No placement candidate is found.");
+    return false;
+  }
+
+  // Restart from placement candidate
+  const auto & placement_candidate = placement_candidate_list_[placement_candidate_idx_];
+  ROS_INFO_STREAM("Restart from placement candidate " << placement_candidate_idx_ << " / "
+                                                      << placement_candidate_list_.size() << " (vote: "
+                                                      << placement_candidate.vote_num << " / " << config_.reaching_num
+                                                      << ", score: " << placement_candidate.score << ")");
+  current_placement_sample_ = placement_candidate.sample;
+  current_reaching_sample_list_ = target_reaching_sample_list_;
+  placement_candidate_idx_++;
+
+  return true;
+}
+
 std::shared_ptr<RmapPlanningBase> DiffRmap::createRmapPlanningPlacement(SamplingSpace sampling_space,
                                                                         const std::string & svm_path,
                                                                         const std::string & bag_path)
@@ -1,18 +1,27 @@
 /* Author: Masaki Murooka */
 
 #include <chrono>
-#include <stdlib.h>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <thread>
 
 #include <optmotiongen_msgs/RobotStateArray.h>
 #include <visualization_msgs/MarkerArray.h>
 #include <differentiable_rmap/RmapSampleSet.h>
 #include <rosbag/bag.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud_conversion.h>
 
 #include <sch/S_Polyhedron/S_Polyhedron.h>
 
 #include <optmotiongen/Utils/RosUtils.h>
 
+#include <differentiable_rmap/GridUtils.h>
 #include <differentiable_rmap/RmapSampling.h>
+#include <differentiable_rmap/SampleSetUtils.h>
+#include <differentiable_rmap/RosUtils.h>
 
 using namespace DiffRmap;
 
@@ -28,6 +37,10 @@ RmapSampling<SamplingSpaceType>::RmapSampling(const std::shared_ptr<OmgCore::Rob
   rs_arr_pub_ = nh_.advertise<optmotiongen_msgs::RobotStateArray>("robot_state_arr", 1, true);
   reachable_cloud_pub_ = nh_.advertise<sensor_msgs::PointCloud>("reachable_cloud", 1, true);
   unreachable_cloud_pub_ = nh_.advertise<sensor_msgs::PointCloud>("unreachable_cloud", 1, true);
+  reachable_cloud_chunk_pub_ = nh_.advertise<sensor_msgs::PointCloud2>("reachable_cloud_chunk", 100);
+  unreachable_cloud_chunk_pub_ = nh_.advertise<sensor_msgs::PointCloud2>("unreachable_cloud_chunk", 100);
+  reachable_cloud_preview_pub_ = nh_.advertise<sensor_msgs::PointCloud>("reachable_cloud_preview", 1, true);
+  unreachable_cloud_preview_pub_ = nh_.advertise<sensor_msgs::PointCloud>("unreachable_cloud_preview", 1, true);
   collision_marker_pub_ = nh_.advertise<visualization_msgs::MarkerArray>("collision_marker", 1, true);
 }
 
@@ -53,31 +66,82 @@ void RmapSampling<SamplingSpaceType>::configure(const mc_rtc::Configuration & mc
 template<SamplingSpace SamplingSpaceType>
 void RmapSampling<SamplingSpaceType>::run(const std::string & bag_path, int sample_num, double sleep_rate)
 {
+  // Check shard
+  if(config_.shard_num < 1 || config_.shard_idx < 0 || config_.shard_idx >= config_.shard_num)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[RmapSampling::run] Invalid shard: shard_idx {}, shard_num {}",
+                                                     config_.shard_idx, config_.shard_num);
+  }
+  std::string shard_bag_path = shardBagPath(bag_path);
+
   setup();
 
-  sample_list_.resize(sample_num);
-  reachability_list_.resize(sample_num);
+  // In joint grid sweep, each loop corresponds to one joint grid instead of one sample
+  int loop_num = config_.joint_grid_sweep ? joint_grid_num_ : sample_num;
+  int shard_loop_begin_idx =
+      config_.shard_idx * (loop_num / config_.shard_num) + std::min(config_.shard_idx, loop_num % config_.shard_num);
+  int shard_loop_num = loop_num / config_.shard_num + (config_.shard_idx < loop_num % config_.shard_num ? 1 : 0);
+
+  sample_list_.clear();
+  reachability_list_.clear();
+  reachable_sample_num_ = 0;
   reachable_cloud_msg_.points.clear();
   unreachable_cloud_msg_.points.clear();
+  reachable_cloud_preview_msg_.points.clear();
+  unreachable_cloud_preview_msg_.points.clear();
+  reachable_preview_voxels_.clear();
+  unreachable_preview_voxels_.clear();
+
+  // Setup checkpoint
+  // This must be called after setup() because the state of random engine is overwritten
+  int loop_idx = 0;
+  checkpoint_chunk_num_ = 0;
+  if(config_.checkpoint_interval > 0)
+  {
+    if(config_.resume)
+    {
+      loop_idx = loadCheckpoint(shard_bag_path);
+    }
+    else
+    {
+      removeCheckpoint(shard_bag_path);
+    }
+  }
 
   auto start_time = std::chrono::system_clock::now();
 
   ros::Rate rate(sleep_rate > 0 ? sleep_rate : 1000);
-  int loop_idx = 0;
   while(ros::ok())
   {
-    if(loop_idx == sample_num)
+    if(loop_idx == shard_loop_num)
     {
       break;
     }
 
-    // Sample once
-    while(!sampleOnce(loop_idx))
-      ;
-
-    if(loop_idx % config_.publish_loop_interval == 0)
+    if(config_.joint_grid_sweep)
     {
+      // Sweep chunk of joint grids
+      int sweep_num =
+          std::min(sweep_chunk_size_ * static_cast<int>(sweep_worker_list_.size()), shard_loop_num - loop_idx);
+      sweepJointGrid(shard_loop_begin_idx + loop_idx, shard_loop_begin_idx + loop_idx + sweep_num);
       publish();
+      loop_idx += sweep_num;
+    }
+    else
+    {
+      // Sample once
+      while(!sampleOnce(loop_idx))
+        ;
+      if(reachability_list_.back())
+      {
+        reachable_sample_num_++;
+      }
+
+      if(loop_idx % config_.publish_loop_interval == 0)
+      {
+        publish();
+      }
+      loop_idx++;
     }
 
     if(sleep_rate > 0)
@@ -85,7 +149,12 @@ void RmapSampling<SamplingSpaceType>::run(const std::string & bag_path, int samp
       rate.sleep();
     }
     ros::spinOnce();
-    loop_idx++;
+
+    // Write checkpoint
+    if(config_.checkpoint_interval > 0 && static_cast<int>(sample_list_.size()) >= config_.checkpoint_interval)
+    {
+      writeCheckpoint(shard_bag_path, loop_idx);
+    }
   }
 
   double duration =
@@ -93,8 +162,35 @@ void RmapSampling<SamplingSpaceType>::run(const std::string & bag_path, int samp
       * std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::system_clock::now() - start_time).count();
   ROS_INFO_STREAM("Sample generation duration: " << duration << " [ms]");
 
+  // Publish remaining points
+  if(config_.stream_cloud)
+  {
+    publishCloud();
+  }
+
+  // Write remaining samples to checkpoint
+  if(config_.checkpoint_interval > 0)
+  {
+    if(!sample_list_.empty())
+    {
+      writeCheckpoint(shard_bag_path, loop_idx);
+    }
+    if(loop_idx < shard_loop_num)
+    {
+      ROS_WARN_STREAM("Sample generation is interrupted at " << loop_idx << " / " << shard_loop_num
+                                                             << " loops. Set resume to continue from checkpoint.");
+      return;
+    }
+  }
+
   // Dump sample set
-  dumpSampleSet(bag_path);
+  dumpSampleSet(shard_bag_path);
+
+  // Remove checkpoint after the sample set is successfully dumped
+  if(config_.checkpoint_interval > 0)
+  {
+    removeCheckpoint(shard_bag_path);
+  }
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -102,13 +198,17 @@ void RmapSampling<SamplingSpaceType>::setup()
 {
   setupSampling();
   setupCollisionTask();
+  if(config_.joint_grid_sweep)
+  {
+    setupJointGridSweep();
+  }
 }
 
 template<SamplingSpace SamplingSpaceType>
 void RmapSampling<SamplingSpaceType>::setupSampling()
 {
-  // Eigen's random seed can be set by srand
-  srand(config_.random_seed);
+  // Set random seed
+  seedRandomEngine();
 
   // Set robot root pose
   rb_arr_[0]->rootPose(config_.root_pose);
@@ -128,6 +228,10 @@ void RmapSampling<SamplingSpaceType>::setupSampling()
       joint_pos_offset_[i] = (upper_joint_pos + lower_joint_pos) / 2;
     }
   }
+
+  // Fixed transforms and unsampled joints are folded into kinematic chain
+  kinematic_chain_ = std::make_shared<KinematicChain>(*rb_arr_[0], *rbc_arr_[0], body_name_, joint_name_list_,
+                                                      config_.body_pose_offset);
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -135,21 +239,199 @@ void RmapSampling<SamplingSpaceType>::setupCollisionTask()
 {
   // Since robot_convex_path needs to resolve the ROS package path, it is obtained by rosparam instead of mc_rtc
   // configuration
-  std::string robot_convex_path;
-  nh_.getParam("robot_convex_path", robot_convex_path);
+  nh_.getParam("robot_convex_path", robot_convex_path_);
 
   collision_task_list_.clear();
+  collision_body_idxs_list_.clear();
+  collision_bounding_spheres_list_.clear();
   for(const auto & body_names : config_.collision_body_names_list)
   {
     OmgCore::Twin<std::shared_ptr<sch::S_Object>> sch_objs;
+    OmgCore::Twin<int> body_idxs;
+    OmgCore::Twin<BoundingSphere> bounding_spheres;
     for(auto i : {0, 1})
     {
-      sch_objs[i] = OmgCore::loadSchPolyhedron(robot_convex_path + body_names[i] + "_mesh-ch.txt");
+      sch_objs[i] = OmgCore::loadSchPolyhedron(robot_convex_path_ + body_names[i] + "_mesh-ch.txt");
+      body_idxs[i] = rb_arr_[0]->bodyIndexByName(body_names[i]);
+
+      // Calculate bounding sphere from convex vertices (center is the center of axis-aligned bounding box)
+      const auto & vertices =
+          std::dynamic_pointer_cast<sch::S_Polyhedron>(sch_objs[i])->getPolyhedronAlgorithm()->vertexes_;
+      Eigen::Vector3d vertex_min = Eigen::Vector3d::Constant(1e10);
+      Eigen::Vector3d vertex_max = Eigen::Vector3d::Constant(-1e10);
+      for(const auto & vertex : vertices)
+      {
+        const auto & coord = vertex->getCoordinates();
+        vertex_min = vertex_min.cwiseMin(Eigen::Vector3d(coord[0], coord[1], coord[2]));
+        vertex_max = vertex_max.cwiseMax(Eigen::Vector3d(coord[0], coord[1], coord[2]));
+      }
+      bounding_spheres[i].center = (vertex_min + vertex_max) / 2;
+      for(const auto & vertex : vertices)
+      {
+        const auto & coord = vertex->getCoordinates();
+        bounding_spheres[i].radius =
+            std::max(bounding_spheres[i].radius,
+                     (Eigen::Vector3d(coord[0], coord[1], coord[2]) - bounding_spheres[i].center).norm());
+      }
+    }
+    collision_task_list_.push_back(makeCollisionTask(body_names, sch_objs));
+    collision_body_idxs_list_.push_back(body_idxs);
+    collision_bounding_spheres_list_.push_back(bounding_spheres);
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+std::shared_ptr<OmgCore::CollisionTask> RmapSampling<SamplingSpaceType>::makeCollisionTask(
+    const OmgCore::Twin<std::string> & body_names,
+    const OmgCore::Twin<std::shared_ptr<sch::S_Object>> & sch_objs)
+{
+  auto task = std::make_shared<OmgCore::CollisionTask>(
+      std::make_shared<OmgCore::CollisionFunc>(rb_arr_, OmgCore::Twin<int>{0, 0}, body_names, sch_objs),
+      collision_margin_);
+  task->setWeight(config_.collision_task_weight);
+  return task;
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::setupJointGridSweep()
+{
+  if(config_.joint_pos_step <= 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapSampling::setupJointGridSweep] joint_pos_step must be positive: {}", config_.joint_pos_step);
+  }
+
+  // Divide joint range so that the step does not exceed joint_pos_step
+  int joint_num = static_cast<int>(joint_name_list_.size());
+  joint_divide_nums_.resize(joint_num);
+  double joint_grid_num = 1;
+  for(int i = 0; i < joint_num; i++)
+  {
+    joint_divide_nums_[i] = static_cast<int>(std::ceil(2 * joint_pos_coeff_[i] / config_.joint_pos_step));
+    joint_grid_num *= joint_divide_nums_[i] + 1;
+  }
+  if(joint_grid_num > std::numeric_limits<int>::max())
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapSampling::setupJointGridSweep] Number of joint grids is too large: {}. Increase joint_pos_step.",
+        joint_grid_num);
+  }
+  joint_grid_num_ = static_cast<int>(joint_grid_num);
+  ROS_INFO_STREAM("Sweep " << joint_grid_num_ << " joint grids");
+
+  // Each worker has its own robot configuration and collision tasks
+  int thread_num = config_.thread_num > 0 ? config_.thread_num : std::max(1u, std::thread::hardware_concurrency());
+  sweep_worker_list_.resize(thread_num);
+  for(auto & worker : sweep_worker_list_)
+  {
+    worker.rbc_arr = OmgCore::RobotConfigArray(rb_arr_);
+    worker.rbc_arr[0]->q = rbc_arr_[0]->q;
+    worker.collision_task_list.clear();
+    for(const auto & body_names : config_.collision_body_names_list)
+    {
+      OmgCore::Twin<std::shared_ptr<sch::S_Object>> sch_objs;
+      for(auto i : {0, 1})
+      {
+        sch_objs[i] = OmgCore::loadSchPolyhedron(robot_convex_path_ + body_names[i] + "_mesh-ch.txt");
+      }
+      worker.collision_task_list.push_back(makeCollisionTask(body_names, sch_objs));
+    }
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::sweepJointGrid(int begin_grid_idx, int end_grid_idx)
+{
+  // Partition grid index range into contiguous ranges so that the samples are appended in the order of grid index
+  // regardless of the number of workers
+  int worker_num = static_cast<int>(sweep_worker_list_.size());
+  int64_t grid_num = end_grid_idx - begin_grid_idx;
+  std::vector<std::thread> thread_list;
+  for(int i = 0; i < worker_num; i++)
+  {
+    thread_list.emplace_back(&RmapSampling::sweepJointGridRange, this, std::ref(sweep_worker_list_[i]),
+                             begin_grid_idx + static_cast<int>(grid_num * i / worker_num),
+                             begin_grid_idx + static_cast<int>(grid_num * (i + 1) / worker_num));
+  }
+  for(auto & thread : thread_list)
+  {
+    thread.join();
+  }
+
+  for(auto & worker : sweep_worker_list_)
+  {
+    for(const SampleType & sample : worker.sample_list)
+    {
+      appendSample(sample, true);
+      reachable_sample_num_++;
+    }
+  }
+
+  // Show last configuration in publish
+  rbc_arr_[0]->q = sweep_worker_list_.back().rbc_arr[0]->q;
+  rbd::forwardKinematics(*rb_arr_[0], *rbc_arr_[0]);
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::sweepJointGridRange(SweepWorker & worker, int begin_grid_idx, int end_grid_idx)
+{
+  const auto & rb = rb_arr_[0];
+  const auto & rbc = worker.rbc_arr[0];
+  worker.sample_list.clear();
+  if(begin_grid_idx == end_grid_idx)
+  {
+    return;
+  }
+
+  // Make joint positions of grids
+  int joint_num = static_cast<int>(joint_name_list_.size());
+  JointPosBatch joint_pos_batch(joint_num, end_grid_idx - begin_grid_idx);
+  Eigen::VectorXi divide_idxs(joint_num);
+  Eigen::VectorXd divide_ratios(joint_num);
+  gridIdxToDivideIdxs(divide_idxs, begin_grid_idx, joint_divide_nums_);
+  for(int i = 0; i < joint_pos_batch.cols(); i++)
+  {
+    gridDivideIdxsToRatios(divide_ratios, divide_idxs, joint_divide_nums_);
+    joint_pos_batch.col(i) =
+        (joint_pos_coeff_.array() * (2 * divide_ratios.array() - 1) + joint_pos_offset_.array()).matrix();
+
+    // Increment indices as mixed-radix counter in the same order as calcGridIdx()
+    updateGridDivideIdxs(divide_idxs, joint_divide_nums_, {});
+  }
+
+  // Set last configuration to be shown in publish
+  for(int i = 0; i < joint_num; i++)
+  {
+    rbc->q[joint_idx_list_[i]][0] = joint_pos_batch(i, joint_pos_batch.cols() - 1);
+  }
+
+  // Calculate body poses of all grids at once with kinematic chain if collision is not checked
+  if(worker.collision_task_list.empty())
+  {
+    std::vector<sva::PTransformd> body_pose_list;
+    kinematic_chain_->calcPoseBatch(body_pose_list, joint_pos_batch);
+    for(const auto & body_pose : body_pose_list)
+    {
+      worker.sample_list.push_back(poseToSample<SamplingSpaceType>(body_pose));
+    }
+    return;
+  }
+
+  for(int i = 0; i < joint_pos_batch.cols(); i++)
+  {
+    // Set configuration of grid
+    for(int j = 0; j < joint_num; j++)
+    {
+      rbc->q[joint_idx_list_[j]][0] = joint_pos_batch(j, i);
+    }
+    rbd::forwardKinematics(*rb, *rbc);
+
+    // Append collision-free sample
+    if(!checkCollision(worker.rbc_arr, worker.collision_task_list))
+    {
+      const auto & body_pose = config_.body_pose_offset * rbc->bodyPosW[body_idx_];
+      worker.sample_list.push_back(poseToSample<SamplingSpaceType>(body_pose));
     }
-    auto task = std::make_shared<OmgCore::CollisionTask>(
-        std::make_shared<OmgCore::CollisionFunc>(rb_arr_, OmgCore::Twin<int>{0, 0}, body_names, sch_objs), 0.05);
-    task->setWeight(config_.collision_task_weight);
-    collision_task_list_.push_back(task);
   }
 }
 
@@ -161,38 +443,117 @@ bool RmapSampling<SamplingSpaceType>::sampleOnce(int sample_idx)
 
   // Set random configuration
   Eigen::VectorXd joint_pos =
-      joint_pos_coeff_.cwiseProduct(Eigen::VectorXd::Random(joint_name_list_.size())) + joint_pos_offset_;
+      joint_pos_coeff_.cwiseProduct(randomVector(static_cast<int>(joint_name_list_.size()))) + joint_pos_offset_;
   for(size_t i = 0; i < joint_name_list_.size(); i++)
   {
     rbc->q[joint_idx_list_[i]][0] = joint_pos[i];
   }
-  rbd::forwardKinematics(*rb, *rbc);
 
-  // Check collision task
-  bool has_collision = false;
-  for(const auto & task : collision_task_list_)
+  // Forward kinematics of the whole robot is required only for collision check
+  if(collision_task_list_.empty())
   {
-    task->update(rb_arr_, rbc_arr_, aux_rb_arr_);
-    if(task->value().cwiseMax(0).squaredNorm() > 1e-6)
-    {
-      has_collision = true;
-      break;
-    }
+    appendSample(poseToSample<SamplingSpaceType>(kinematic_chain_->calcPose(joint_pos)), true);
+    return true;
   }
+  rbd::forwardKinematics(*rb, *rbc);
+
+  // Check collision task
+  bool has_collision = checkCollision();
 
   // Append new sample to sample list
   if(!has_collision)
   {
     const auto & body_pose = config_.body_pose_offset * rbc->bodyPosW[body_idx_];
-    const SampleType & sample = poseToSample<SamplingSpaceType>(body_pose);
-    sample_list_[sample_idx] = sample;
-    reachability_list_[sample_idx] = true;
-    reachable_cloud_msg_.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
+    appendSample(poseToSample<SamplingSpaceType>(body_pose), true);
   }
 
   return !has_collision;
 }
 
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::appendSample(const SampleType & sample, bool reachability)
+{
+  sample_list_.push_back(config_.yaw_symmetric ? canonicalizeSampleYaw<SamplingSpaceType>(sample) : sample);
+  reachability_list_.push_back(reachability);
+  (reachability ? reachable_cloud_msg_ : unreachable_cloud_msg_)
+      .points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample_list_.back())));
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::seedRandomEngine()
+{
+  // Mix shard index into seed so that each shard starts from a different state of random engine
+  std::seed_seq seed_seq{static_cast<uint32_t>(config_.random_seed), static_cast<uint32_t>(config_.shard_idx)};
+  random_engine_.seed(seed_seq);
+}
+
+template<SamplingSpace SamplingSpaceType>
+Eigen::VectorXd RmapSampling<SamplingSpaceType>::randomVector(int dim)
+{
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  Eigen::VectorXd vec(dim);
+  for(int i = 0; i < dim; i++)
+  {
+    vec[i] = dist(random_engine_);
+  }
+  return vec;
+}
+
+template<SamplingSpace SamplingSpaceType>
+Eigen::Quaterniond RmapSampling<SamplingSpaceType>::randomQuaternion()
+{
+  // Same formulation as Eigen::Quaterniond::UnitRandom()
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  double u1 = dist(random_engine_);
+  double u2 = 2 * M_PI * dist(random_engine_);
+  double u3 = 2 * M_PI * dist(random_engine_);
+  double a = std::sqrt(1 - u1);
+  double b = std::sqrt(u1);
+  return Eigen::Quaterniond(a * std::sin(u2), a * std::cos(u2), b * std::sin(u3), b * std::cos(u3));
+}
+
+template<SamplingSpace SamplingSpaceType>
+bool RmapSampling<SamplingSpaceType>::checkCollision()
+{
+  return checkCollision(rbc_arr_, collision_task_list_);
+}
+
+template<SamplingSpace SamplingSpaceType>
+bool RmapSampling<SamplingSpaceType>::checkCollision(
+    const OmgCore::RobotConfigArray & rbc_arr,
+    const std::vector<std::shared_ptr<OmgCore::CollisionTask>> & collision_task_list)
+{
+  const auto & rbc = rbc_arr[0];
+
+  for(size_t i = 0; i < collision_task_list.size(); i++)
+  {
+    // Broadphase with bounding spheres
+    const auto & body_idxs = collision_body_idxs_list_[i];
+    const auto & bounding_spheres = collision_bounding_spheres_list_[i];
+    OmgCore::Twin<Eigen::Vector3d> sphere_centers;
+    for(auto j : {0, 1})
+    {
+      sphere_centers[j] = (sva::PTransformd(bounding_spheres[j].center) * rbc->bodyPosW[body_idxs[j]]).translation();
+    }
+    double sphere_dist =
+        (sphere_centers[0] - sphere_centers[1]).norm() - bounding_spheres[0].radius - bounding_spheres[1].radius;
+    if(sphere_dist > collision_margin_)
+    {
+      continue;
+    }
+
+    // Narrowphase with collision task
+    const auto & task = collision_task_list[i];
+    task->update(rb_arr_, rbc_arr, aux_rb_arr_);
+    if(task->value().cwiseMax(0).squaredNorm() > 1e-6)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 template<SamplingSpace SamplingSpaceType>
 void RmapSampling<SamplingSpaceType>::publish()
 {
@@ -200,18 +561,69 @@ void RmapSampling<SamplingSpaceType>::publish()
   rs_arr_pub_.publish(rb_arr_.makeRobotStateArrayMsg(rbc_arr_));
 
   // Publish cloud
-  const auto & time_now = ros::Time::now();
-  reachable_cloud_msg_.header.frame_id = "world";
-  reachable_cloud_msg_.header.stamp = time_now;
-  reachable_cloud_pub_.publish(reachable_cloud_msg_);
-  unreachable_cloud_msg_.header.frame_id = "world";
-  unreachable_cloud_msg_.header.stamp = time_now;
-  unreachable_cloud_pub_.publish(unreachable_cloud_msg_);
+  publishCloud();
 
   // Publish collision marker
   publishCollisionMarker(collision_task_list_);
 }
 
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::publishCloud()
+{
+  const auto & time_now = ros::Time::now();
+  for(auto reachability : {true, false})
+  {
+    sensor_msgs::PointCloud & cloud_msg = reachability ? reachable_cloud_msg_ : unreachable_cloud_msg_;
+    cloud_msg.header.frame_id = "world";
+    cloud_msg.header.stamp = time_now;
+
+    if(!config_.stream_cloud)
+    {
+      // Publish all points
+      (reachability ? reachable_cloud_pub_ : unreachable_cloud_pub_).publish(cloud_msg);
+      continue;
+    }
+
+    // Publish only new points since last publish
+    if(!cloud_msg.points.empty())
+    {
+      sensor_msgs::PointCloud2 cloud_chunk_msg;
+      sensor_msgs::convertPointCloudToPointCloud2(cloud_msg, cloud_chunk_msg);
+      (reachability ? reachable_cloud_chunk_pub_ : unreachable_cloud_chunk_pub_).publish(cloud_chunk_msg);
+    }
+
+    // Update and publish downsampled preview
+    if(config_.preview_voxel_size > 0)
+    {
+      sensor_msgs::PointCloud & preview_msg =
+          reachability ? reachable_cloud_preview_msg_ : unreachable_cloud_preview_msg_;
+      std::set<std::array<int, 3>> & preview_voxels =
+          reachability ? reachable_preview_voxels_ : unreachable_preview_voxels_;
+      bool preview_updated = false;
+      for(const auto & point : cloud_msg.points)
+      {
+        std::array<int, 3> voxel = {static_cast<int>(std::floor(point.x / config_.preview_voxel_size)),
+                                    static_cast<int>(std::floor(point.y / config_.preview_voxel_size)),
+                                    static_cast<int>(std::floor(point.z / config_.preview_voxel_size))};
+        if(preview_voxels.insert(voxel).second)
+        {
+          preview_msg.points.push_back(OmgCore::toPoint32Msg(
+              config_.preview_voxel_size * (Eigen::Vector3d(voxel[0], voxel[1], voxel[2]).array() + 0.5).matrix()));
+          preview_updated = true;
+        }
+      }
+      if(preview_updated)
+      {
+        preview_msg.header = cloud_msg.header;
+        (reachability ? reachable_cloud_preview_pub_ : unreachable_cloud_preview_pub_).publish(preview_msg);
+      }
+    }
+
+    // Clear published points so that they are not held twice (they are also stored in sample_list_)
+    cloud_msg.points.clear();
+  }
+}
+
 template<SamplingSpace SamplingSpaceType>
 void RmapSampling<SamplingSpaceType>::publishCollisionMarker(
     const std::vector<std::shared_ptr<OmgCore::CollisionTask>> & collision_task_list)
@@ -257,61 +669,191 @@ void RmapSampling<SamplingSpaceType>::publishCollisionMarker(
 }
 
 template<SamplingSpace SamplingSpaceType>
-void RmapSampling<SamplingSpaceType>::dumpSampleSet(const std::string & bag_path) const
+std::string RmapSampling<SamplingSpaceType>::shardBagPath(const std::string & bag_path) const
 {
-  differentiable_rmap::RmapSampleSet sample_set_msg;
-  sample_set_msg.type = static_cast<size_t>(SamplingSpaceType);
-  sample_set_msg.samples.resize(sample_list_.size());
+  if(config_.shard_num == 1)
+  {
+    return bag_path;
+  }
 
-  SampleType sample_min = SampleType::Constant(1e10);
-  SampleType sample_max = SampleType::Constant(-1e10);
+  // Insert shard index before extension (e.g., /tmp/rmap_sample_set_shard0.bag)
+  std::string shard_suffix = "_shard" + std::to_string(config_.shard_idx);
+  const std::string ext = ".bag";
+  if(bag_path.size() >= ext.size() && bag_path.compare(bag_path.size() - ext.size(), ext.size(), ext) == 0)
+  {
+    return bag_path.substr(0, bag_path.size() - ext.size()) + shard_suffix + ext;
+  }
+  return bag_path + shard_suffix;
+}
 
-  // Since libsvm considers the first class to be positive,
-  // add the reachable sample from the beginning and the unreachable sample from the end.
-  size_t reachable_idx = 0;
-  size_t unreachable_idx = 0;
+template<SamplingSpace SamplingSpaceType>
+std::string RmapSampling<SamplingSpaceType>::checkpointPath(const std::string & bag_path, int chunk_idx)
+{
+  return bag_path + ".chunk" + std::to_string(chunk_idx);
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::writeCheckpoint(const std::string & bag_path, int sample_num)
+{
+  const auto & time_now = ros::Time::now();
+
+  differentiable_rmap::RmapSampleSet chunk_msg;
+  chunk_msg.type = static_cast<size_t>(SamplingSpaceType);
+  chunk_msg.samples.resize(sample_list_.size());
   for(size_t i = 0; i < sample_list_.size(); i++)
   {
-    const SampleType & sample = sample_list_[i];
+    chunk_msg.samples[i].position.assign(sample_list_[i].data(), sample_list_[i].data() + sample_dim_);
+    chunk_msg.samples[i].is_reachable = reachability_list_[i];
+  }
 
-    // Get msg_idx according to sample reachability
-    size_t msg_idx;
-    if(reachability_list_[i])
+  differentiable_rmap::RmapSamplingState state_msg;
+  state_msg.type = static_cast<size_t>(SamplingSpaceType);
+  state_msg.sample_num = sample_num;
+  state_msg.reachable_sample_num = reachable_sample_num_;
+  std::ostringstream random_engine_ss;
+  random_engine_ss << random_engine_;
+  state_msg.random_engine_state = random_engine_ss.str();
+  writeChunkState(state_msg);
+
+  // Write to temporary file and rename it
+  std::string chunk_path = checkpointPath(bag_path, checkpoint_chunk_num_);
+  std::string tmp_chunk_path = chunk_path + ".tmp";
+  {
+    rosbag::Bag bag(tmp_chunk_path, rosbag::bagmode::Write);
+    bag.write("/rmap_sample_chunk", time_now, chunk_msg);
+    bag.write("/rmap_sampling_state", time_now, state_msg);
+  }
+  if(std::rename(tmp_chunk_path.c_str(), chunk_path.c_str()) != 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[RmapSampling::writeCheckpoint] Failed to rename {} to {}",
+                                                     tmp_chunk_path, chunk_path);
+  }
+  checkpoint_chunk_num_++;
+
+  sample_list_.clear();
+  reachability_list_.clear();
+}
+
+template<SamplingSpace SamplingSpaceType>
+int RmapSampling<SamplingSpaceType>::loadCheckpoint(const std::string & bag_path)
+{
+  checkpoint_chunk_num_ = 0;
+  while(std::ifstream(checkpointPath(bag_path, checkpoint_chunk_num_)).good())
+  {
+    checkpoint_chunk_num_++;
+  }
+  if(checkpoint_chunk_num_ == 0)
+  {
+    ROS_WARN_STREAM("[RmapSampling::loadCheckpoint] Checkpoint is not found. Start from the beginning.");
+    return 0;
+  }
+
+  differentiable_rmap::RmapSamplingState::ConstPtr state_msg;
+  for(int chunk_idx = 0; chunk_idx < checkpoint_chunk_num_; chunk_idx++)
+  {
+    state_msg = loadBag<differentiable_rmap::RmapSamplingState>(checkpointPath(bag_path, chunk_idx));
+    if(state_msg->type != static_cast<size_t>(SamplingSpaceType))
     {
-      msg_idx = reachable_idx;
-      reachable_idx++;
+      mc_rtc::log::error_and_throw<std::runtime_error>(
+          "[RmapSampling::loadCheckpoint] SamplingSpace does not match with message: {} != {}", state_msg->type,
+          static_cast<size_t>(SamplingSpaceType));
     }
-    else
+    loadChunkState(*state_msg);
+  }
+  std::istringstream random_engine_ss(state_msg->random_engine_state);
+  random_engine_ss >> random_engine_;
+  reachable_sample_num_ = state_msg->reachable_sample_num;
+
+  ROS_INFO_STREAM("Resume sample generation from " << state_msg->sample_num << " samples in "
+                                                   << checkpoint_chunk_num_ << " checkpoint chunks");
+  return state_msg->sample_num;
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::removeCheckpoint(const std::string & bag_path)
+{
+  // Remove all consecutive chunks, not only the ones written in this run, so that stale chunks are not merged
+  for(int chunk_idx = 0; std::remove(checkpointPath(bag_path, chunk_idx).c_str()) == 0; chunk_idx++)
+    ;
+  checkpoint_chunk_num_ = 0;
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::forEachSample(const std::string & bag_path,
+                                                    const std::function<void(const SampleType &, bool)> & func,
+                                                    bool reverse) const
+{
+  auto forEachChunkSample = [&](int chunk_idx) {
+    differentiable_rmap::RmapSampleSet::ConstPtr chunk_msg =
+        loadBag<differentiable_rmap::RmapSampleSet>(checkpointPath(bag_path, chunk_idx));
+    if(chunk_msg->type != static_cast<size_t>(SamplingSpaceType))
     {
-      msg_idx = sample_list_.size() - 1 - unreachable_idx;
-      unreachable_idx++;
+      mc_rtc::log::error_and_throw<std::runtime_error>(
+          "[RmapSampling::forEachSample] SamplingSpace does not match with message: {} != {}", chunk_msg->type,
+          static_cast<size_t>(SamplingSpaceType));
     }
-
-    // Set sample to message
-    sample_set_msg.samples[msg_idx].position.resize(sample_dim_);
-    for(int j = 0; j < sample_dim_; j++)
+    for(size_t i = 0; i < chunk_msg->samples.size(); i++)
     {
-      sample_set_msg.samples[msg_idx].position[j] = sample[j];
+      const auto & sample_msg = chunk_msg->samples[reverse ? chunk_msg->samples.size() - 1 - i : i];
+      func(Eigen::Map<const SampleType>(sample_msg.position.data()), sample_msg.is_reachable);
     }
-    sample_set_msg.samples[msg_idx].is_reachable = reachability_list_[i];
+  };
+  auto forEachMemorySample = [&]() {
+    for(size_t i = 0; i < sample_list_.size(); i++)
+    {
+      size_t sample_idx = reverse ? sample_list_.size() - 1 - i : i;
+      func(sample_list_[sample_idx], reachability_list_[sample_idx]);
+    }
+  };
 
-    // Update min/max samples
-    sample_min = sample_min.cwiseMin(sample);
-    sample_max = sample_max.cwiseMax(sample);
+  if(reverse)
+  {
+    forEachMemorySample();
+    for(int chunk_idx = checkpoint_chunk_num_ - 1; chunk_idx >= 0; chunk_idx--)
+    {
+      forEachChunkSample(chunk_idx);
+    }
   }
-
-  // Set min/max samples to message
-  sample_set_msg.min.resize(sample_dim_);
-  sample_set_msg.max.resize(sample_dim_);
-  for(int i = 0; i < sample_dim_; i++)
+  else
   {
-    sample_set_msg.min[i] = sample_min[i];
-    sample_set_msg.max[i] = sample_max[i];
+    for(int chunk_idx = 0; chunk_idx < checkpoint_chunk_num_; chunk_idx++)
+    {
+      forEachChunkSample(chunk_idx);
+    }
+    forEachMemorySample();
   }
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSampling<SamplingSpaceType>::dumpSampleSet(const std::string & bag_path) const
+{
+  // Count samples and calculate min/max samples
+  size_t sample_num = 0;
+  SampleType sample_min = SampleType::Constant(1e10);
+  SampleType sample_max = SampleType::Constant(-1e10);
+  forEachSample(bag_path, [&](const SampleType & sample, bool) {
+    sample_num++;
+    sample_min = sample_min.cwiseMin(sample);
+    sample_max = sample_max.cwiseMax(sample);
+  });
 
-  // Dump to ROS bag
-  rosbag::Bag bag(bag_path, rosbag::bagmode::Write);
-  bag.write("/rmap_sample_set", ros::Time::now(), sample_set_msg);
+  // Dump to ROS bag while reading samples
+  // Since libsvm considers the first class to be positive,
+  // add the reachable sample from the beginning and the unreachable sample from the end (i.e., in reverse order).
+  dumpSampleSetStream(bag_path, static_cast<int>(SamplingSpaceType), sample_dim_, sample_num,
+                      std::vector<double>(sample_min.data(), sample_min.data() + sample_dim_),
+                      std::vector<double>(sample_max.data(), sample_max.data() + sample_dim_),
+                      [&](bool reachability, const std::function<void(const double *)> & sample_func) {
+                        forEachSample(
+                            bag_path,
+                            [&](const SampleType & sample, bool sample_reachability) {
+                              if(sample_reachability == reachability)
+                              {
+                                sample_func(sample.data());
+                              }
+                            },
+                            !reachability);
+                      });
   ROS_INFO_STREAM("Dump sample set to " << bag_path);
 }
 
@@ -5,6 +5,7 @@
 
 #include <optmotiongen/Utils/RosUtils.h>
 
+#include <differentiable_rmap/IKUtils.h>
 #include <differentiable_rmap/RmapSamplingFootstep.h>
 
 using namespace DiffRmap;
@@ -29,8 +30,8 @@ void RmapSamplingFootstep<SamplingSpaceType>::configure(const mc_rtc::Configurat
 template<SamplingSpace SamplingSpaceType>
 void RmapSamplingFootstep<SamplingSpaceType>::setupSampling()
 {
-  // Eigen's random seed can be set by srand
-  srand(config_.random_seed);
+  // Set random seed
+  this->seedRandomEngine();
 
   // Setup task
   support_foot_body_task_ =
@@ -76,7 +77,7 @@ bool RmapSamplingFootstep<SamplingSpaceType>::sampleOnce(int sample_idx)
 {
   // Set IK target of foot
   support_foot_body_task_->target() = sva::PTransformd::Identity();
-  const FootstepPos & footstep_pos = footstep_pos_coeff_.cwiseProduct(FootstepPos::Random()) + footstep_pos_offset_;
+  const FootstepPos & footstep_pos = footstep_pos_coeff_.cwiseProduct(this->randomVector(3)) + footstep_pos_offset_;
   swing_foot_body_task_->target().translation().head<2>() = footstep_pos.head<2>();
   swing_foot_body_task_->target().translation().z() = 0;
   swing_foot_body_task_->target().rotation() =
@@ -113,37 +114,22 @@ bool RmapSamplingFootstep<SamplingSpaceType>::sampleOnce(int sample_idx)
     }
     rbd::forwardKinematics(*rb, *rbc);
 
-    // Solve IK
-    problem_->run(config_.ik_loop_num);
-
-    // Check task error
+    // Solve IK and check task error
+    std::vector<OmgCore::Taskset *> taskset_ptr_list;
     for(auto & taskset : taskset_list_)
     {
-      taskset.update(rb_arr_, rbc_arr_, aux_rb_arr_);
-      if(taskset.errorSquaredNorm(false) > std::pow(config_.ik_error_thre, 2))
-      {
-        reachability = false;
-        break;
-      }
+      taskset_ptr_list.push_back(&taskset);
     }
-    if(!reachability)
+    if(!runIK(*problem_, taskset_ptr_list, rb_arr_, rbc_arr_, aux_rb_arr_, config_.ik_loop_num, config_.ik_error_thre,
+              config_.ik_check_interval, config_.ik_stagnation_thre))
     {
+      reachability = false;
       break;
     }
   }
 
   // Append new sample to sample list
-  const SampleType & sample = poseToSample<SamplingSpaceType>(swing_foot_body_task_->target());
-  sample_list_[sample_idx] = sample;
-  reachability_list_[sample_idx] = reachability;
-  if(reachability)
-  {
-    reachable_cloud_msg_.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
-  }
-  else
-  {
-    unreachable_cloud_msg_.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
-  }
+  this->appendSample(poseToSample<SamplingSpaceType>(swing_foot_body_task_->target()), reachability);
 
   return true;
 }
@@ -4,6 +4,7 @@
 
 #include <optmotiongen/Utils/RosUtils.h>
 
+#include <differentiable_rmap/IKUtils.h>
 #include <differentiable_rmap/RmapSamplingIK.h>
 
 using namespace DiffRmap;
@@ -53,6 +54,12 @@ void RmapSamplingIK<SamplingSpaceType>::configure(const mc_rtc::Configuration &
 {
   RmapSampling<SamplingSpaceType>::configure(mc_rtc_config);
   config_.load(mc_rtc_config);
+
+  if(config_.joint_grid_sweep)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapSamplingIK::configure] joint_grid_sweep is supported only in sampling with forward kinematics.");
+  }
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -65,8 +72,8 @@ void RmapSamplingIK<SamplingSpaceType>::setup()
 template<SamplingSpace SamplingSpaceType>
 void RmapSamplingIK<SamplingSpaceType>::setupSampling()
 {
-  // Eigen's random seed can be set by srand
-  srand(config_.random_seed);
+  // Set random seed
+  this->seedRandomEngine();
 
   // Set robot root pose
   rb_arr_[0]->rootPose(config_.root_pose);
@@ -119,31 +126,45 @@ void RmapSamplingIK<SamplingSpaceType>::setupSampling()
   }
 
   // Get upper and lower position of bounding box in configuration space
-  sample_list_.resize(config_.bbox_sample_num);
-  reachability_list_.resize(config_.bbox_sample_num);
+  // Only collision-free samples are appended to sample_list_
+  sample_list_.clear();
+  reachability_list_.clear();
 
-  RmapSampling<SamplingSpaceType>::setupSampling();
-  for(int i = 0; i < config_.bbox_sample_num; i++)
-  {
-    RmapSampling<SamplingSpaceType>::sampleOnce(i);
-  }
+  ik_solution_kd_tree_.clear();
+  ik_solution_joint_pos_list_.clear();
 
+  RmapSampling<SamplingSpaceType>::setupSampling();
   Eigen::Vector3d upper_body_pos = Eigen::Vector3d::Constant(-1e10);
   Eigen::Vector3d lower_body_pos = Eigen::Vector3d::Constant(1e10);
-  for(const SampleType & sample : sample_list_)
+  for(int i = 0; i < config_.bbox_sample_num; i++)
   {
-    const Eigen::Vector3d & cloud_pos = sampleToCloudPos<SamplingSpaceType>(sample);
+    if(!RmapSampling<SamplingSpaceType>::sampleOnce(i))
+    {
+      continue;
+    }
+
+    // Since the sample in sample_list_ is canonicalized by yaw if yaw_symmetric is true, the raw body pose is
+    // recalculated from the current configuration
+    const sva::PTransformd & body_pose = kinematic_chain_->calcPose(currentJointPos());
+    const Eigen::Vector3d & cloud_pos = sampleToCloudPos<SamplingSpaceType>(poseToSample<SamplingSpaceType>(body_pose));
     upper_body_pos = upper_body_pos.cwiseMax(cloud_pos);
     lower_body_pos = lower_body_pos.cwiseMin(cloud_pos);
+
+    // Collision-free samples generated by forward kinematics are exact IK solutions
+    if(config_.ik_seed_neighbor_num > 0)
+    {
+      addIKSolution(body_pose);
+    }
   }
 
+  // IK solutions obtained here are not written to checkpoint since they are obtained again on resume
+  checkpointed_ik_solution_num_ = ik_solution_joint_pos_list_.size();
+
   // Calculate coefficient and offset to make random position
   body_pos_coeff_ = config_.bbox_padding_rate * (upper_body_pos - lower_body_pos) / 2;
   body_pos_offset_ = (upper_body_pos + lower_body_pos) / 2;
   body_yaw_coeff_ = (config_.body_yaw_limits.second - config_.body_yaw_limits.first) / 2;
   body_yaw_offset_ = (config_.body_yaw_limits.second + config_.body_yaw_limits.first) / 2;
-
-  reachable_sample_num_ = 0;
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -154,27 +175,46 @@ bool RmapSamplingIK<SamplingSpaceType>::sampleOnce(int sample_idx)
                || SamplingSpaceType == SamplingSpace::SE2)
   {
     body_task_->target().translation().head<2>() =
-        body_pos_coeff_.head<2>().cwiseProduct(Eigen::Vector2d::Random()) + body_pos_offset_.head<2>();
+        body_pos_coeff_.head<2>().cwiseProduct(this->randomVector(2)) + body_pos_offset_.head<2>();
     body_task_->target().translation().z() = 0;
     body_task_->target().rotation() =
-        Eigen::AngleAxisd(body_yaw_coeff_ * Eigen::Matrix<double, 1, 1>::Random()[0] + body_yaw_offset_,
-                          Eigen::Vector3d::UnitZ())
+        Eigen::AngleAxisd(body_yaw_coeff_ * this->randomVector(1)[0] + body_yaw_offset_, Eigen::Vector3d::UnitZ())
             .toRotationMatrix();
   }
   else
   {
-    body_task_->target().translation() = body_pos_coeff_.cwiseProduct(Eigen::Vector3d::Random()) + body_pos_offset_;
-    body_task_->target().rotation() = Eigen::Quaterniond::UnitRandom().toRotationMatrix();
+    body_task_->target().translation() = body_pos_coeff_.cwiseProduct(this->randomVector(3)) + body_pos_offset_;
+    body_task_->target().rotation() = this->randomQuaternion().toRotationMatrix();
   }
 
   bool reachability = false;
 
+  // Get initial configurations from nearest IK solutions in cache
+  // At least one trial is left for zero configuration
+  std::vector<size_t> seed_idx_list;
+  int seed_num = std::max(0, std::min(config_.ik_seed_neighbor_num, config_.ik_trial_num - 1));
+  if(seed_num > 0)
+  {
+    seed_idx_list = ik_solution_kd_tree_.knnSearch(
+        sampleToInput<SamplingSpaceType>(poseToSample<SamplingSpaceType>(body_task_->target())), seed_num);
+  }
+
   for(int i = 0; i < config_.ik_trial_num; i++)
   {
     const auto & rb = rb_arr_[0];
     const auto & rbc = rbc_arr_[0];
 
-    if(i == 0)
+    if(i < static_cast<int>(seed_idx_list.size()))
+    {
+      // Set configuration of nearest IK solution
+      rbc->zero(*rb);
+      const Eigen::VectorXd & joint_pos = ik_solution_joint_pos_list_[seed_idx_list[i]];
+      for(size_t j = 0; j < joint_name_list_.size(); j++)
+      {
+        rbc->q[joint_idx_list_[j]][0] = joint_pos[j];
+      }
+    }
+    else if(i == static_cast<int>(seed_idx_list.size()))
     {
       // Set zero configuration
       rbc->zero(*rb);
@@ -183,7 +223,8 @@ bool RmapSamplingIK<SamplingSpaceType>::sampleOnce(int sample_idx)
     {
       // Set random configuration
       Eigen::VectorXd joint_pos =
-          joint_pos_coeff_.cwiseProduct(Eigen::VectorXd::Random(joint_name_list_.size())) + joint_pos_offset_;
+          joint_pos_coeff_.cwiseProduct(this->randomVector(static_cast<int>(joint_name_list_.size())))
+          + joint_pos_offset_;
       for(size_t j = 0; j < joint_name_list_.size(); j++)
       {
         rbc->q[joint_idx_list_[j]][0] = joint_pos[j];
@@ -192,10 +233,8 @@ bool RmapSamplingIK<SamplingSpaceType>::sampleOnce(int sample_idx)
     rbd::forwardKinematics(*rb, *rbc);
 
     // Solve IK
-    problem_->run(config_.ik_loop_num);
-    taskset_.update(rb_arr_, rbc_arr_, aux_rb_arr_);
-
-    if(taskset_.errorSquaredNorm(false) < std::pow(config_.ik_error_thre, 2))
+    if(runIK(*problem_, {&taskset_}, rb_arr_, rbc_arr_, aux_rb_arr_, config_.ik_loop_num, config_.ik_error_thre,
+             config_.ik_check_interval, config_.ik_stagnation_thre))
     {
       reachability = true;
       break;
@@ -214,17 +253,10 @@ bool RmapSamplingIK<SamplingSpaceType>::sampleOnce(int sample_idx)
   }
 
   // Append new sample to sample list
-  const SampleType & sample = poseToSample<SamplingSpaceType>(body_task_->target());
-  sample_list_[sample_idx] = sample;
-  reachability_list_[sample_idx] = reachability;
-  if(reachability)
-  {
-    reachable_sample_num_++;
-    reachable_cloud_msg_.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
-  }
-  else
+  this->appendSample(poseToSample<SamplingSpaceType>(body_task_->target()), reachability);
+  if(reachability && config_.ik_seed_neighbor_num > 0)
   {
-    unreachable_cloud_msg_.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
+    addIKSolution(body_task_->target());
   }
 
   return true;
@@ -237,15 +269,7 @@ void RmapSamplingIK<SamplingSpaceType>::publish()
   rs_arr_pub_.publish(rb_arr_.makeRobotStateArrayMsg(rbc_arr_));
 
   // Publish cloud
-  {
-    const auto & time_now = ros::Time::now();
-    reachable_cloud_msg_.header.frame_id = "world";
-    reachable_cloud_msg_.header.stamp = time_now;
-    reachable_cloud_pub_.publish(reachable_cloud_msg_);
-    unreachable_cloud_msg_.header.frame_id = "world";
-    unreachable_cloud_msg_.header.stamp = time_now;
-    unreachable_cloud_pub_.publish(unreachable_cloud_msg_);
-  }
+  this->publishCloud();
 
   // Publish collision marker
   std::vector<std::shared_ptr<OmgCore::CollisionTask>> collision_task_list = collision_task_list_;
@@ -259,6 +283,65 @@ void RmapSamplingIK<SamplingSpaceType>::publish()
   this->publishCollisionMarker(collision_task_list);
 }
 
+template<SamplingSpace SamplingSpaceType>
+void RmapSamplingIK<SamplingSpaceType>::writeChunkState(differentiable_rmap::RmapSamplingState & state_msg)
+{
+  state_msg.ik_solution_joint_pos.clear();
+  for(size_t i = checkpointed_ik_solution_num_; i < ik_solution_joint_pos_list_.size(); i++)
+  {
+    const Eigen::VectorXd & joint_pos = ik_solution_joint_pos_list_[i];
+    state_msg.ik_solution_joint_pos.insert(state_msg.ik_solution_joint_pos.end(), joint_pos.data(),
+                                           joint_pos.data() + joint_pos.size());
+  }
+  checkpointed_ik_solution_num_ = ik_solution_joint_pos_list_.size();
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSamplingIK<SamplingSpaceType>::loadChunkState(const differentiable_rmap::RmapSamplingState & state_msg)
+{
+  if(state_msg.ik_solution_joint_pos.empty())
+  {
+    return;
+  }
+
+  int joint_num = static_cast<int>(joint_name_list_.size());
+  if(state_msg.ik_solution_joint_pos.size() % joint_num != 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapSamplingIK::loadChunkState] Size of joint positions of IK solutions is inconsistent: {} % {} != 0",
+        state_msg.ik_solution_joint_pos.size(), joint_num);
+  }
+
+  for(size_t i = 0; i < state_msg.ik_solution_joint_pos.size(); i += joint_num)
+  {
+    const Eigen::VectorXd & joint_pos =
+        Eigen::Map<const Eigen::VectorXd>(state_msg.ik_solution_joint_pos.data() + i, joint_num);
+    ik_solution_kd_tree_.insert(
+        sampleToInput<SamplingSpaceType>(poseToSample<SamplingSpaceType>(kinematic_chain_->calcPose(joint_pos))));
+    ik_solution_joint_pos_list_.push_back(joint_pos);
+  }
+  checkpointed_ik_solution_num_ = ik_solution_joint_pos_list_.size();
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapSamplingIK<SamplingSpaceType>::addIKSolution(const sva::PTransformd & target_pose)
+{
+  ik_solution_kd_tree_.insert(sampleToInput<SamplingSpaceType>(poseToSample<SamplingSpaceType>(target_pose)));
+  ik_solution_joint_pos_list_.push_back(currentJointPos());
+}
+
+template<SamplingSpace SamplingSpaceType>
+Eigen::VectorXd RmapSamplingIK<SamplingSpaceType>::currentJointPos() const
+{
+  const auto & rbc = rbc_arr_[0];
+  Eigen::VectorXd joint_pos(joint_name_list_.size());
+  for(size_t j = 0; j < joint_name_list_.size(); j++)
+  {
+    joint_pos[j] = rbc->q[joint_idx_list_[j]][0];
+  }
+  return joint_pos;
+}
+
 std::shared_ptr<RmapSamplingBase> DiffRmap::createRmapSamplingIK(SamplingSpace sampling_space,
                                                                  const std::shared_ptr<OmgCore::Robot> & rb,
                                                                  const std::string & body_name,
@@ -1,7 +1,9 @@
 /* Author: Masaki Murooka */
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
+#include <numeric>
 
 #include <mc_rtc/constants.h>
 
@@ -15,6 +17,7 @@
 #include <differentiable_rmap/EvalUtils.h>
 #include <differentiable_rmap/RmapTraining.h>
 #include <differentiable_rmap/SVMUtils.h>
+#include <differentiable_rmap/SamplingBatchUtils.h>
 #include <differentiable_rmap/libsvm_hotfix.h>
 
 using namespace DiffRmap;
@@ -366,6 +369,9 @@ void RmapTraining<SamplingSpaceType>::loadSampleSet(const std::string & bag_path
     }
   }
 
+  // Setup index for slicing
+  setupSliceIndex();
+
   // Publish cloud
   {
     std_msgs::Header header_msg;
@@ -399,12 +405,22 @@ void RmapTraining<SamplingSpaceType>::loadSampleSet(const std::string & bag_path
     svm_prob_.y = new double[svm_prob_.l];
     svm_prob_.x = new svm_node *[svm_prob_.l];
 
+    // Convert all samples to SVM inputs at once
+    SampleBatch<SamplingSpaceType> sample_batch(sample_dim_, sample_list_.size());
+    for(size_t i = 0; i < sample_list_.size(); i++)
+    {
+      sample_batch.col(i) = sample_list_[i];
+    }
+    InputBatch<SamplingSpaceType> input_batch;
+    sampleToInputBatch<SamplingSpaceType>(input_batch, sample_batch);
+
     all_input_nodes_ = new svm_node[(input_dim_ + 1) * svm_prob_.l];
     for(size_t i = 0; i < sample_list_.size(); i++)
     {
-      const SampleType & sample = sample_list_[i];
+      const InputType & input = input_batch.col(i);
       size_t idx = (input_dim_ + 1) * i;
-      setInputNode<SamplingSpaceType>(&(all_input_nodes_[idx]), sampleToInput<SamplingSpaceType>(sample));
+      setInputNode<SamplingSpaceType>(&(all_input_nodes_[idx]),
+                                      config_.yaw_symmetric ? canonicalizeInputYaw<SamplingSpaceType>(input) : input);
       svm_prob_.x[i] = &all_input_nodes_[idx];
       svm_prob_.y[i] = reachability_list_[i] ? 1 : -1;
     }
@@ -422,6 +438,51 @@ void RmapTraining<SamplingSpaceType>::loadSampleSet(const std::string & bag_path
   }
 }
 
+template<SamplingSpace SamplingSpaceType>
+void RmapTraining<SamplingSpaceType>::setupSliceIndex()
+{
+  size_t sample_num = sample_list_.size();
+  slice_sorted_idxs_.resize(sample_num);
+  std::iota(slice_sorted_idxs_.begin(), slice_sorted_idxs_.end(), 0);
+
+  if constexpr(SamplingSpaceType == SamplingSpace::SE2 || SamplingSpaceType == SamplingSpace::R3
+               || SamplingSpaceType == SamplingSpace::SE3)
+  {
+    // Calculate slicing key
+    std::vector<double> key_list(sample_num);
+    for(size_t i = 0; i < sample_num; i++)
+    {
+      double key = sample_list_[i].z();
+      if constexpr(SamplingSpaceType == SamplingSpace::SE2)
+      {
+        // Normalize to [-pi, pi] so that the wrap-around can be handled by at most two ranges
+        key = std::atan2(std::sin(key), std::cos(key));
+      }
+      key_list[i] = key;
+    }
+
+    // Sort by slicing key
+    std::sort(slice_sorted_idxs_.begin(), slice_sorted_idxs_.end(),
+              [&](size_t idx1, size_t idx2) { return key_list[idx1] < key_list[idx2]; });
+    slice_sorted_keys_.resize(sample_num);
+    for(size_t i = 0; i < sample_num; i++)
+    {
+      slice_sorted_keys_[i] = key_list[slice_sorted_idxs_[i]];
+    }
+  }
+
+  if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+  {
+    // Store quaternions contiguously so that orientation can be checked by a matrix-vector product
+    slice_sorted_quat_mat_.resize(4, sample_num);
+    for(size_t i = 0; i < sample_num; i++)
+    {
+      slice_sorted_quat_mat_.col(i) =
+          sample_list_[slice_sorted_idxs_[i]].template tail<sampleDim<SamplingSpace::SO3>()>().normalized();
+    }
+  }
+}
+
 template<SamplingSpace SamplingSpaceType>
 void RmapTraining<SamplingSpaceType>::loadSVM()
 {
@@ -491,16 +552,25 @@ void RmapTraining<SamplingSpaceType>::trainSVM()
   train_updated_ = true;
 }
 
+template<SamplingSpace SamplingSpaceType>
+Input<SamplingSpaceType> RmapTraining<SamplingSpaceType>::sampleToSVMInput(const SampleType & sample) const
+{
+  const InputType & input = sampleToInput<SamplingSpaceType>(sample);
+  return config_.yaw_symmetric ? canonicalizeInputYaw<SamplingSpaceType>(input) : input;
+}
+
 template<SamplingSpace SamplingSpaceType>
 double RmapTraining<SamplingSpaceType>::calcSVMValue(const SampleType & sample) const
 {
-  return DiffRmap::calcSVMValue<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_);
+  return DiffRmap::calcSVMValue<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_,
+                                                   config_.yaw_symmetric);
 }
 
 template<SamplingSpace SamplingSpaceType>
 Sample<SamplingSpaceType> RmapTraining<SamplingSpaceType>::calcSVMGrad(const SampleType & sample) const
 {
-  return DiffRmap::calcSVMGrad<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_);
+  return DiffRmap::calcSVMGrad<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_,
+                                                  config_.yaw_symmetric);
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -574,7 +644,7 @@ void RmapTraining<SamplingSpaceType>::predictOnSlicePlane()
       double svm_value;
       if constexpr(use_libsvm_prediction_)
       {
-        setInputNodeOnlyValue<SamplingSpaceType>(input_node, sampleToInput<SamplingSpaceType>(sample));
+        setInputNodeOnlyValue<SamplingSpaceType>(input_node, sampleToSVMInput(sample));
         svm_predict_values(svm_mo_, input_node, &svm_value);
       }
       else
@@ -622,49 +692,93 @@ void RmapTraining<SamplingSpaceType>::publishSlicedCloud() const
   sensor_msgs::PointCloud unreachable_cloud_msg;
   reachable_cloud_msg.header = header_msg;
   unreachable_cloud_msg.header = header_msg;
-  for(size_t i = 0; i < sample_list_.size(); i++)
-  {
-    const SampleType & sample = sample_list_[i];
 
-    if constexpr(SamplingSpaceType == SamplingSpace::SE2)
+  // Get ranges of sorted samples whose slicing key is within threshold
+  std::vector<std::pair<size_t, size_t>> range_list;
+  auto addRange = [&](double key_min, double key_max) {
+    size_t begin_idx =
+        std::lower_bound(slice_sorted_keys_.begin(), slice_sorted_keys_.end(), key_min) - slice_sorted_keys_.begin();
+    size_t end_idx =
+        std::upper_bound(slice_sorted_keys_.begin(), slice_sorted_keys_.end(), key_max) - slice_sorted_keys_.begin();
+    if(begin_idx < end_idx)
     {
-      double origin_theta = calcYawAngle(slice_origin_.rotation().transpose());
-      double theta_diff = sample.z() - origin_theta;
-      theta_diff = std::fabs(std::atan2(std::sin(theta_diff), std::cos(theta_diff)));
-      if(theta_diff > mc_rtc::constants::toRad(config_.slice_se2_theta_thre))
-      {
-        continue;
-      }
+      range_list.emplace_back(begin_idx, end_idx);
     }
-    else if constexpr(SamplingSpaceType == SamplingSpace::R3)
+  };
+  if constexpr(SamplingSpaceType == SamplingSpace::SE2)
+  {
+    double origin_theta = calcYawAngle(slice_origin_.rotation().transpose());
+    double theta_thre = mc_rtc::constants::toRad(config_.slice_se2_theta_thre);
+    if(theta_thre >= M_PI)
     {
-      double origin_z = slice_origin_.translation().z();
-      if(std::fabs(sample.z() - origin_z) > config_.slice_r3_z_thre)
-      {
-        continue;
-      }
+      range_list.emplace_back(0, slice_sorted_idxs_.size());
     }
-    else if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+    else
     {
-      double origin_z = slice_origin_.translation().z();
-      Eigen::Quaterniond origin_quat(slice_origin_.rotation().transpose());
-      Sample<SamplingSpace::SO3> sample_so3 = sample.template tail<sampleDim<SamplingSpace::SO3>()>();
-      Eigen::Quaterniond sample_quat(sample_so3.w(), sample_so3.x(), sample_so3.y(), sample_so3.z());
-      double theta_diff = std::fabs(Eigen::AngleAxisd(origin_quat.inverse() * sample_quat).angle());
-      if(std::fabs(sample.z() - origin_z) > config_.slice_se3_z_thre
-         || theta_diff > mc_rtc::constants::toRad(config_.slice_se3_theta_thre))
+      // Keys are in [-pi, pi], so the wrapped part of the range is added separately
+      addRange(origin_theta - theta_thre, origin_theta + theta_thre);
+      if(origin_theta - theta_thre < -M_PI)
       {
-        continue;
+        addRange(origin_theta - theta_thre + 2 * M_PI, M_PI);
+      }
+      else if(origin_theta + theta_thre > M_PI)
+      {
+        addRange(-M_PI, origin_theta + theta_thre - 2 * M_PI);
       }
     }
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::R3)
+  {
+    double origin_z = slice_origin_.translation().z();
+    addRange(origin_z - config_.slice_r3_z_thre, origin_z + config_.slice_r3_z_thre);
+  }
+  else if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+  {
+    double origin_z = slice_origin_.translation().z();
+    addRange(origin_z - config_.slice_se3_z_thre, origin_z + config_.slice_se3_z_thre);
+  }
+  else
+  {
+    range_list.emplace_back(0, slice_sorted_idxs_.size());
+  }
+
+  for(const auto & range : range_list)
+  {
+    size_t range_size = range.second - range.first;
 
-    if(reachability_list_[i])
+    // Check orientation of samples in range
+    // The angle between quaternions q1 and q2 is less than theta iff |q1.dot(q2)| >= cos(theta / 2)
+    Eigen::Array<bool, Eigen::Dynamic, 1> in_slice;
+    if constexpr(SamplingSpaceType == SamplingSpace::SE3)
     {
-      reachable_cloud_msg.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
+      Eigen::Quaterniond origin_quat(slice_origin_.rotation().transpose());
+      double cos_half_thre = std::cos(0.5 * mc_rtc::constants::toRad(config_.slice_se3_theta_thre));
+      in_slice = (slice_sorted_quat_mat_.middleCols(range.first, range_size).transpose() * origin_quat.coeffs())
+                     .array()
+                     .abs()
+                 >= cos_half_thre;
     }
-    else
+
+    for(size_t i = 0; i < range_size; i++)
     {
-      unreachable_cloud_msg.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
+      if constexpr(SamplingSpaceType == SamplingSpace::SE3)
+      {
+        if(!in_slice[i])
+        {
+          continue;
+        }
+      }
+
+      size_t sample_idx = slice_sorted_idxs_[range.first + i];
+      const SampleType & sample = sample_list_[sample_idx];
+      if(reachability_list_[sample_idx])
+      {
+        reachable_cloud_msg.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
+      }
+      else
+      {
+        unreachable_cloud_msg.points.push_back(OmgCore::toPoint32Msg(sampleToCloudPos<SamplingSpaceType>(sample)));
+      }
     }
   }
   sliced_reachable_cloud_pub_.publish(reachable_cloud_msg);
@@ -757,7 +871,7 @@ void RmapTraining<SamplingSpaceType>::testCalcSVMValue(double & svm_value_libsvm
                                                        const SampleType & sample) const
 {
   svm_node input_node[input_dim_ + 1];
-  setInputNode<SamplingSpaceType>(input_node, sampleToInput<SamplingSpaceType>(sample));
+  setInputNode<SamplingSpaceType>(input_node, sampleToSVMInput(sample));
   svm_predict_values(svm_mo_, input_node, &svm_value_libsvm);
 
   svm_value_eigen = calcSVMValue(sample);
@@ -1,6 +1,9 @@
 /* Author: Masaki Murooka */
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <fstream>
 
 #include <mc_rtc/constants.h>
 
@@ -11,6 +14,7 @@
 
 #include <differentiable_rmap/RmapVisualization.h>
 #include <differentiable_rmap/SVMUtils.h>
+#include <differentiable_rmap/SamplingBatchUtils.h>
 #include <differentiable_rmap/libsvm_hotfix.h>
 
 using namespace DiffRmap;
@@ -59,14 +63,32 @@ void RmapVisualization<SamplingSpaceType>::setup(const std::string & grid_bag_pa
   {
     dumpGridSet(grid_bag_path);
   }
+
+  // Make markers, which are reused until the origin of slicing is updated
+  makeGridsMarker();
+  makeSlicedGridsMarker();
+
+  publishMarkerArray();
+  last_publish_time_ = ros::Time::now();
 }
 
 template<SamplingSpace SamplingSpaceType>
 void RmapVisualization<SamplingSpaceType>::runOnce()
 {
-  updateSliceOrigin();
+  bool slice_updated = updateSliceOrigin();
+  if(slice_updated)
+  {
+    makeSlicedGridsMarker();
+  }
 
-  publishMarkerArray();
+  // Publish only when the marker is changed, or when keep alive duration is elapsed
+  const ros::Time & now = ros::Time::now();
+  if(slice_updated
+     || (config_.keep_alive_duration > 0 && (now - last_publish_time_).toSec() >= config_.keep_alive_duration))
+  {
+    publishMarkerArray();
+    last_publish_time_ = now;
+  }
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -139,6 +161,183 @@ void RmapVisualization<SamplingSpaceType>::loadGridSet(const std::string & grid_
 
 template<SamplingSpace SamplingSpaceType>
 void RmapVisualization<SamplingSpaceType>::dumpGridSet(const std::string & grid_bag_path)
+{
+  if(config_.grid_shard_num == 1 && config_.grid_checkpoint_interval <= 0)
+  {
+    // Calculate all grid values in this process
+    int total_grid_num = setupGridSetMsg();
+    grid_set_msg_.values.clear();
+    grid_set_msg_.values.reserve(total_grid_num);
+    calcGridValues(0, total_grid_num, grid_set_msg_.values);
+  }
+  else
+  {
+    // Generate remaining shards and merge all shards
+    // Shards can also be generated by other processes in advance
+    for(int shard_idx = 0; shard_idx < config_.grid_shard_num; shard_idx++)
+    {
+      dumpGridShard(grid_bag_path, shard_idx);
+      if(!ros::ok())
+      {
+        mc_rtc::log::error_and_throw<std::runtime_error>(
+            "[RmapVisualization::dumpGridSet] Grid generation is interrupted. Run again to resume from checkpoint.");
+      }
+    }
+    mergeGridShards(grid_bag_path);
+  }
+
+  // Dump to ROS bag
+  rosbag::Bag bag(grid_bag_path, rosbag::bagmode::Write);
+  bag.write("/rmap_grid_set", ros::Time::now(), grid_set_msg_);
+  ROS_INFO_STREAM("Dump grid set to " << grid_bag_path);
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapVisualization<SamplingSpaceType>::dumpGridShard(const std::string & grid_bag_path, int shard_idx)
+{
+  if(shard_idx < 0 || shard_idx >= config_.grid_shard_num)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapVisualization::dumpGridShard] Invalid shard index: {} (grid_shard_num is {})", shard_idx,
+        config_.grid_shard_num);
+  }
+
+  // Set range of grid index
+  int total_grid_num = setupGridSetMsg();
+  int shard_begin_idx = static_cast<int>(static_cast<int64_t>(total_grid_num) * shard_idx / config_.grid_shard_num);
+  int shard_end_idx = static_cast<int>(static_cast<int64_t>(total_grid_num) * (shard_idx + 1) / config_.grid_shard_num);
+
+  // Skip if shard is already dumped
+  std::string shard_path = gridShardPath(grid_bag_path, shard_idx);
+  if(std::ifstream(shard_path).good())
+  {
+    differentiable_rmap::RmapGridShard::ConstPtr grid_shard_msg =
+        loadBag<differentiable_rmap::RmapGridShard>(shard_path);
+    if(isSameGrid(*grid_shard_msg) && grid_shard_msg->begin_idx == shard_begin_idx
+       && grid_shard_msg->end_idx == shard_end_idx)
+    {
+      ROS_INFO_STREAM("Skip grid shard " << shard_idx << " which is already dumped to " << shard_path);
+      return;
+    }
+    ROS_WARN_STREAM("Grid shard " << shard_idx << " in " << shard_path << " is inconsistent. Generate it again.");
+  }
+
+  // Load checkpoint chunks
+  std::vector<double> values;
+  int chunk_num = 0;
+  while(std::ifstream(shard_path + ".chunk" + std::to_string(chunk_num)).good())
+  {
+    std::string chunk_path = shard_path + ".chunk" + std::to_string(chunk_num);
+    differentiable_rmap::RmapGridShard::ConstPtr grid_chunk_msg =
+        loadBag<differentiable_rmap::RmapGridShard>(chunk_path);
+    if(!isSameGrid(*grid_chunk_msg)
+       || grid_chunk_msg->begin_idx != shard_begin_idx + static_cast<int>(values.size())
+       || grid_chunk_msg->end_idx != grid_chunk_msg->begin_idx + static_cast<int>(grid_chunk_msg->values.size()))
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>(
+          "[RmapVisualization::dumpGridShard] Checkpoint chunk {} is inconsistent. Remove it to generate shard again.",
+          chunk_path);
+    }
+    values.insert(values.end(), grid_chunk_msg->values.begin(), grid_chunk_msg->values.end());
+    chunk_num++;
+  }
+  if(chunk_num > 0)
+  {
+    ROS_INFO_STREAM("Resume grid shard " << shard_idx << " from " << values.size() << " / "
+                                         << shard_end_idx - shard_begin_idx << " grids");
+  }
+
+  // Calculate grid values
+  ROS_INFO_STREAM("Generate grid shard " << shard_idx << " / " << config_.grid_shard_num << " (grid index range ["
+                                         << shard_begin_idx << ", " << shard_end_idx << "))");
+  int chunk_size =
+      config_.grid_checkpoint_interval > 0 ? config_.grid_checkpoint_interval : shard_end_idx - shard_begin_idx;
+  while(shard_begin_idx + static_cast<int>(values.size()) < shard_end_idx && ros::ok())
+  {
+    int begin_idx = shard_begin_idx + static_cast<int>(values.size());
+    int end_idx = std::min(begin_idx + chunk_size, shard_end_idx);
+    calcGridValues(begin_idx, end_idx, values);
+
+    if(config_.grid_checkpoint_interval > 0)
+    {
+      writeGridShard(shard_path + ".chunk" + std::to_string(chunk_num), begin_idx,
+                     std::vector<double>(values.end() - (end_idx - begin_idx), values.end()));
+      chunk_num++;
+    }
+  }
+  if(shard_begin_idx + static_cast<int>(values.size()) < shard_end_idx)
+  {
+    ROS_WARN_STREAM("Grid shard " << shard_idx << " is interrupted. Run again to resume from checkpoint.");
+    return;
+  }
+
+  // Dump shard and remove checkpoint chunks
+  writeGridShard(shard_path, shard_begin_idx, values);
+  for(int i = 0; i < chunk_num; i++)
+  {
+    std::remove((shard_path + ".chunk" + std::to_string(i)).c_str());
+  }
+  ROS_INFO_STREAM("Dump grid shard " << shard_idx << " to " << shard_path);
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapVisualization<SamplingSpaceType>::dumpCapabilityMap(const std::string & capability_bag_path)
+{
+  if constexpr(SamplingSpaceType != SamplingSpace::SE3)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapVisualization::dumpCapabilityMap] Capability map is supported only for SE3: {}",
+        std::to_string(SamplingSpaceType));
+  }
+  else
+  {
+    // Set grid of position
+    const Eigen::Vector3d & pos_min = sample_min_.template head<3>();
+    const Eigen::Vector3d & pos_max = sample_max_.template head<3>();
+    differentiable_rmap::RmapCapabilityMap capability_map_msg;
+    capability_map_msg.divide_nums.resize(3);
+    capability_map_msg.min.resize(3);
+    capability_map_msg.max.resize(3);
+    for(int i = 0; i < 3; i++)
+    {
+      capability_map_msg.divide_nums[i] =
+          std::max(static_cast<int>(std::ceil((pos_max[i] - pos_min[i]) / config_.pos_resolution)), 1);
+      capability_map_msg.min[i] = pos_min[i];
+      capability_map_msg.max[i] = pos_max[i];
+    }
+    capability_map_msg.direction_num = config_.capability_direction_num;
+    capability_map_msg.roll_num = config_.capability_roll_num;
+
+    // Calculate capability map
+    ROS_INFO_STREAM("Generate capability map (position grid num: "
+                    << (capability_map_msg.divide_nums[0] + 1) * (capability_map_msg.divide_nums[1] + 1)
+                           * (capability_map_msg.divide_nums[2] + 1)
+                    << ", orientation num: " << config_.capability_direction_num * config_.capability_roll_num
+                    << ")");
+    auto start_time = std::chrono::system_clock::now();
+    calcCapabilityMap(
+        capability_map_msg,
+        [&](const SampleType & sample) {
+          return calcSVMValue<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_,
+                                                 config_.yaw_symmetric)
+                 > config_.svm_thre;
+        },
+        config_.capability_thread_num);
+    double duration =
+        1e3
+        * std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::system_clock::now() - start_time)
+              .count();
+    ROS_INFO_STREAM("Capability map duration: " << duration << " [ms]");
+
+    // Dump to ROS bag
+    rosbag::Bag bag(capability_bag_path, rosbag::bagmode::Write);
+    bag.write("/rmap_capability_map", ros::Time::now(), capability_map_msg);
+    ROS_INFO_STREAM("Dump capability map to " << capability_bag_path);
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+int RmapVisualization<SamplingSpaceType>::setupGridSetMsg()
 {
   // Set number of division
   const GridPosType & grid_pos_range = getGridPosRange<SamplingSpaceType>(sample_min_, sample_max_);
@@ -178,39 +377,153 @@ void RmapVisualization<SamplingSpaceType>::dumpGridSet(const std::string & grid_
     grid_set_msg_.max[i] = grid_pos_max[i];
     total_grid_num *= (divide_nums[i] + 1);
   }
-  grid_set_msg_.values.resize(total_grid_num);
+
+  return total_grid_num;
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapVisualization<SamplingSpaceType>::calcGridValues(int begin_idx,
+                                                          int end_idx,
+                                                          std::vector<double> & values) const
+{
+  GridIdxs<SamplingSpaceType> divide_nums;
+  GridPosType grid_pos_min;
+  GridPosType grid_pos_max;
+  for(int i = 0; i < grid_dim_; i++)
+  {
+    divide_nums[i] = grid_set_msg_.divide_nums[i];
+    grid_pos_min[i] = grid_set_msg_.min[i];
+    grid_pos_max[i] = grid_set_msg_.max[i];
+  }
+  const GridPosType & grid_pos_range = grid_pos_max - grid_pos_min;
 
   // Set grid value
-  ROS_INFO_STREAM("Total grid num is " << total_grid_num);
+  int grid_num = end_idx - begin_idx;
+  ROS_INFO_STREAM("Grid num is " << grid_num);
   auto start_time = std::chrono::system_clock::now();
-  loopGrid<SamplingSpaceType>(
-      divide_nums, grid_pos_min, grid_pos_range, [&](int grid_idx, const GridPosType & grid_pos) {
-        if(total_grid_num > 1e3 && grid_idx % static_cast<int>(total_grid_num / 100.0) == 0)
-        {
-          ROS_INFO_STREAM("Loop grid " << grid_idx << " / " << total_grid_num
-                                       << ", grid_pos: " << grid_pos.transpose());
-        }
-        grid_set_msg_.values[grid_idx] = calcSVMValue<SamplingSpaceType>(
-            gridPosToSample<SamplingSpaceType>(grid_pos), svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_);
-      });
+  GridIdxs<SamplingSpaceType> divide_idxs;
+  GridPosType divide_ratios;
+  // Grid positions are converted to samples chunk by chunk to bound the memory of batch
+  constexpr int chunk_size = 4096;
+  GridPosBatch<SamplingSpaceType> grid_pos_batch;
+  SampleBatch<SamplingSpaceType> sample_batch;
+  for(int chunk_begin_idx = begin_idx; chunk_begin_idx < end_idx; chunk_begin_idx += chunk_size)
+  {
+    int chunk_end_idx = std::min(chunk_begin_idx + chunk_size, end_idx);
+    grid_pos_batch.resize(grid_dim_, chunk_end_idx - chunk_begin_idx);
+    for(int grid_idx = chunk_begin_idx; grid_idx < chunk_end_idx; grid_idx++)
+    {
+      gridIdxToDivideIdxs(divide_idxs, grid_idx, divide_nums);
+      gridDivideIdxsToRatios(divide_ratios, divide_idxs, divide_nums);
+      const GridPosType & grid_pos = divide_ratios.cwiseProduct(grid_pos_range) + grid_pos_min;
+      if(grid_num > 1e3 && (grid_idx - begin_idx) % static_cast<int>(grid_num / 100.0) == 0)
+      {
+        ROS_INFO_STREAM("Loop grid " << grid_idx - begin_idx << " / " << grid_num
+                                     << ", grid_pos: " << grid_pos.transpose());
+      }
+      grid_pos_batch.col(grid_idx - chunk_begin_idx) = grid_pos;
+    }
+
+    gridPosToSampleBatch<SamplingSpaceType>(sample_batch, grid_pos_batch);
+    for(int i = 0; i < sample_batch.cols(); i++)
+    {
+      const SampleType & sample = sample_batch.col(i);
+      values.push_back(calcSVMValue<SamplingSpaceType>(sample, svm_mo_->param, svm_mo_, svm_coeff_vec_, svm_sv_mat_,
+                                                       config_.yaw_symmetric));
+    }
+  }
   double duration =
       1e3
       * std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::system_clock::now() - start_time).count();
-  ROS_INFO_STREAM("SVM predict duration: " << duration << " [ms] (predict-one: " << duration / total_grid_num
+  ROS_INFO_STREAM("SVM predict duration: " << duration << " [ms] (predict-one: " << duration / grid_num
                                            << " [ms])");
+}
 
-  // Dump to ROS bag
-  rosbag::Bag bag(grid_bag_path, rosbag::bagmode::Write);
-  bag.write("/rmap_grid_set", ros::Time::now(), grid_set_msg_);
-  ROS_INFO_STREAM("Dump grid set to " << grid_bag_path);
+template<SamplingSpace SamplingSpaceType>
+std::string RmapVisualization<SamplingSpaceType>::gridShardPath(const std::string & grid_bag_path, int shard_idx)
+{
+  // Insert shard index before extension (e.g., /tmp/rmap_grid_set_shard0.bag)
+  std::string shard_suffix = "_shard" + std::to_string(shard_idx);
+  const std::string ext = ".bag";
+  if(grid_bag_path.size() >= ext.size()
+     && grid_bag_path.compare(grid_bag_path.size() - ext.size(), ext.size(), ext) == 0)
+  {
+    return grid_bag_path.substr(0, grid_bag_path.size() - ext.size()) + shard_suffix + ext;
+  }
+  return grid_bag_path + shard_suffix;
+}
+
+template<SamplingSpace SamplingSpaceType>
+bool RmapVisualization<SamplingSpaceType>::isSameGrid(const differentiable_rmap::RmapGridShard & grid_shard_msg) const
+{
+  return grid_shard_msg.type == grid_set_msg_.type && grid_shard_msg.divide_nums == grid_set_msg_.divide_nums
+         && grid_shard_msg.min == grid_set_msg_.min && grid_shard_msg.max == grid_set_msg_.max;
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapVisualization<SamplingSpaceType>::writeGridShard(const std::string & path,
+                                                          int begin_idx,
+                                                          const std::vector<double> & values) const
+{
+  differentiable_rmap::RmapGridShard grid_shard_msg;
+  grid_shard_msg.type = grid_set_msg_.type;
+  grid_shard_msg.begin_idx = begin_idx;
+  grid_shard_msg.end_idx = begin_idx + static_cast<int>(values.size());
+  grid_shard_msg.values = values;
+  grid_shard_msg.divide_nums = grid_set_msg_.divide_nums;
+  grid_shard_msg.min = grid_set_msg_.min;
+  grid_shard_msg.max = grid_set_msg_.max;
+
+  // Write to temporary file and rename it so that an interrupted write does not leave a broken file
+  std::string tmp_path = path + ".tmp";
+  {
+    rosbag::Bag bag(tmp_path, rosbag::bagmode::Write);
+    bag.write("/rmap_grid_shard", ros::Time::now(), grid_shard_msg);
+  }
+  if(std::rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[RmapVisualization::writeGridShard] Failed to rename {} to {}",
+                                                     tmp_path, path);
+  }
 }
 
 template<SamplingSpace SamplingSpaceType>
-void RmapVisualization<SamplingSpaceType>::updateSliceOrigin()
+void RmapVisualization<SamplingSpaceType>::mergeGridShards(const std::string & grid_bag_path)
+{
+  int total_grid_num = setupGridSetMsg();
+  grid_set_msg_.values.resize(total_grid_num);
+
+  int next_idx = 0;
+  for(int shard_idx = 0; shard_idx < config_.grid_shard_num; shard_idx++)
+  {
+    std::string shard_path = gridShardPath(grid_bag_path, shard_idx);
+    ROS_INFO_STREAM("Load grid shard from " << shard_path);
+    differentiable_rmap::RmapGridShard::ConstPtr grid_shard_msg =
+        loadBag<differentiable_rmap::RmapGridShard>(shard_path);
+    if(!isSameGrid(*grid_shard_msg) || grid_shard_msg->begin_idx != next_idx
+       || grid_shard_msg->end_idx != grid_shard_msg->begin_idx + static_cast<int>(grid_shard_msg->values.size()))
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>(
+          "[RmapVisualization::mergeGridShards] Grid shard {} is inconsistent. Remove it to generate shard again.",
+          shard_path);
+    }
+    std::copy(grid_shard_msg->values.begin(), grid_shard_msg->values.end(),
+              grid_set_msg_.values.begin() + grid_shard_msg->begin_idx);
+    next_idx = grid_shard_msg->end_idx;
+  }
+  if(next_idx != total_grid_num)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[RmapVisualization::mergeGridShards] Grid shards do not cover all grids: {} != {}", next_idx, total_grid_num);
+  }
+}
+
+template<SamplingSpace SamplingSpaceType>
+bool RmapVisualization<SamplingSpaceType>::updateSliceOrigin()
 {
   if(!(slice_roll_manager_->hasNewValue() || slice_pitch_manager_->hasNewValue() || slice_yaw_manager_->hasNewValue()))
   {
-    return;
+    return false;
   }
 
   slice_origin_.rotation() = (Eigen::AngleAxisd(slice_roll_manager_->value(), Eigen::Vector3d::UnitX())
@@ -222,6 +535,87 @@ void RmapVisualization<SamplingSpaceType>::updateSliceOrigin()
   slice_roll_manager_->update();
   slice_pitch_manager_->update();
   slice_yaw_manager_->update();
+
+  return true;
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapVisualization<SamplingSpaceType>::makeGridsMarker()
+{
+  const GridPos<SamplingSpaceType> & grid_pos_min = getGridPosMin<SamplingSpaceType>(sample_min_);
+  const GridPos<SamplingSpaceType> & grid_pos_range = getGridPosRange<SamplingSpaceType>(sample_min_, sample_max_);
+
+  grids_marker_ = visualization_msgs::Marker();
+  grids_marker_.header.frame_id = "world";
+  grids_marker_.ns = "reachable_grids";
+  grids_marker_.type = visualization_msgs::Marker::CUBE_LIST;
+  grids_marker_.color = OmgCore::toColorRGBAMsg(config_.grid_color);
+  grids_marker_.scale =
+      OmgCore::toVector3Msg(calcGridCubeScale<SamplingSpaceType>(grid_set_msg_.divide_nums, sample_max_ - sample_min_));
+  grids_marker_.pose = OmgCore::toPoseMsg(sva::PTransformd::Identity());
+
+  reachable_grid_idxs_.clear();
+  loopGrid<SamplingSpaceType>(
+      grid_set_msg_.divide_nums, grid_pos_min, grid_pos_range, [&](int grid_idx, const GridPosType & grid_pos) {
+        if(grid_set_msg_.values[grid_idx] > config_.svm_thre)
+        {
+          reachable_grid_idxs_.push_back(grid_idx);
+          grids_marker_.points.push_back(
+              OmgCore::toPointMsg(sampleToCloudPos<SamplingSpaceType>(gridPosToSample<SamplingSpaceType>(grid_pos))));
+        }
+      });
+  ROS_INFO_STREAM("Reachable grid num is " << reachable_grid_idxs_.size() << " / " << grid_set_msg_.values.size());
+}
+
+template<SamplingSpace SamplingSpaceType>
+void RmapVisualization<SamplingSpaceType>::makeSlicedGridsMarker()
+{
+  const GridPos<SamplingSpaceType> & grid_pos_min = getGridPosMin<SamplingSpaceType>(sample_min_);
+  const GridPos<SamplingSpaceType> & grid_pos_range = getGridPosRange<SamplingSpaceType>(sample_min_, sample_max_);
+
+  sliced_grids_marker_ = grids_marker_;
+  sliced_grids_marker_.ns = "reachable_grids_sliced";
+  sliced_grids_marker_.points.clear();
+
+  const SampleType & slice_sample = poseToSample<SamplingSpaceType>(slice_origin_);
+  GridIdxs<SamplingSpaceType> slice_divide_idxs;
+  gridDivideRatiosToIdxs(slice_divide_idxs,
+                         (sampleToGridPos<SamplingSpaceType>(slice_sample) - grid_pos_min).array()
+                             / grid_pos_range.array(),
+                         grid_set_msg_.divide_nums);
+  // Dimensions fixed to the origin of slicing (the others are spanned by the sliced marker)
+  std::vector<int> slice_fixed_dims = {};
+  if(SamplingSpaceType == SamplingSpace::SE2)
+  {
+    slice_fixed_dims = {2};
+  }
+  else if(SamplingSpaceType == SamplingSpace::SE3)
+  {
+    slice_fixed_dims = {3, 4, 5};
+  }
+
+  // Filter the precomputed reachable grids instead of looping all grids
+  GridIdxs<SamplingSpaceType> divide_idxs;
+  for(size_t i = 0; i < reachable_grid_idxs_.size(); i++)
+  {
+    if(!slice_fixed_dims.empty())
+    {
+      gridIdxToDivideIdxs(divide_idxs, reachable_grid_idxs_[i], grid_set_msg_.divide_nums);
+      if(!std::all_of(slice_fixed_dims.begin(), slice_fixed_dims.end(),
+                      [&](int dim) { return divide_idxs[dim] == slice_divide_idxs[dim]; }))
+      {
+        continue;
+      }
+    }
+
+    geometry_msgs::Point point = grids_marker_.points[i];
+    if(SamplingSpaceType == SamplingSpace::R2 || SamplingSpaceType == SamplingSpace::SO2
+       || SamplingSpaceType == SamplingSpace::SE2)
+    {
+      point.z = 0;
+    }
+    sliced_grids_marker_.points.push_back(point);
+  }
 }
 
 template<SamplingSpace SamplingSpaceType>
@@ -241,76 +635,15 @@ void RmapVisualization<SamplingSpaceType>::publishMarkerArray() const
   del_marker.id = marker_arr_msg.markers.size();
   marker_arr_msg.markers.push_back(del_marker);
 
-  const GridPos<SamplingSpaceType> & grid_pos_min = getGridPosMin<SamplingSpaceType>(sample_min_);
-  const GridPos<SamplingSpaceType> & grid_pos_range = getGridPosRange<SamplingSpaceType>(sample_min_, sample_max_);
-
   // Reachable grids marker
-  {
-    visualization_msgs::Marker grids_marker;
-    grids_marker.header = header_msg;
-    grids_marker.ns = "reachable_grids";
-    grids_marker.id = marker_arr_msg.markers.size();
-    grids_marker.type = visualization_msgs::Marker::CUBE_LIST;
-    grids_marker.color = OmgCore::toColorRGBAMsg(config_.grid_color);
-    grids_marker.scale = OmgCore::toVector3Msg(
-        calcGridCubeScale<SamplingSpaceType>(grid_set_msg_.divide_nums, sample_max_ - sample_min_));
-    grids_marker.pose = OmgCore::toPoseMsg(sva::PTransformd::Identity());
-    loopGrid<SamplingSpaceType>(
-        grid_set_msg_.divide_nums, grid_pos_min, grid_pos_range, [&](int grid_idx, const GridPosType & grid_pos) {
-          if(grid_set_msg_.values[grid_idx] > config_.svm_thre)
-          {
-            grids_marker.points.push_back(
-                OmgCore::toPointMsg(sampleToCloudPos<SamplingSpaceType>(gridPosToSample<SamplingSpaceType>(grid_pos))));
-          }
-        });
-    marker_arr_msg.markers.push_back(grids_marker);
-  }
+  marker_arr_msg.markers.push_back(grids_marker_);
+  marker_arr_msg.markers.back().header = header_msg;
+  marker_arr_msg.markers.back().id = marker_arr_msg.markers.size() - 1;
 
   // Sliced reachable grids marker
-  {
-    visualization_msgs::Marker grids_marker;
-    grids_marker.header = header_msg;
-    grids_marker.ns = "reachable_grids_sliced";
-    grids_marker.id = marker_arr_msg.markers.size();
-    grids_marker.type = visualization_msgs::Marker::CUBE_LIST;
-    grids_marker.color = OmgCore::toColorRGBAMsg(config_.grid_color);
-    grids_marker.scale = OmgCore::toVector3Msg(
-        calcGridCubeScale<SamplingSpaceType>(grid_set_msg_.divide_nums, sample_max_ - sample_min_));
-    grids_marker.pose = OmgCore::toPoseMsg(sva::PTransformd::Identity());
-
-    const SampleType & slice_sample = poseToSample<SamplingSpaceType>(slice_origin_);
-    GridIdxs<SamplingSpaceType> slice_divide_idxs;
-    gridDivideRatiosToIdxs(slice_divide_idxs,
-                           (sampleToGridPos<SamplingSpaceType>(slice_sample) - grid_pos_min).array()
-                               / grid_pos_range.array(),
-                           grid_set_msg_.divide_nums);
-    std::vector<int> slice_update_dims = {};
-    if(SamplingSpaceType == SamplingSpace::R2 || SamplingSpaceType == SamplingSpace::SE2)
-    {
-      slice_update_dims = {0, 1};
-    }
-    else if(SamplingSpaceType == SamplingSpace::R3 || SamplingSpaceType == SamplingSpace::SE3)
-    {
-      slice_update_dims = {0, 1, 2};
-    }
-
-    loopGrid<SamplingSpaceType>(
-        grid_set_msg_.divide_nums, grid_pos_min, grid_pos_range,
-        [&](int grid_idx, const GridPosType & grid_pos) {
-          if(grid_set_msg_.values[grid_idx] > config_.svm_thre)
-          {
-            Eigen::Vector3d pos = sampleToCloudPos<SamplingSpaceType>(gridPosToSample<SamplingSpaceType>(grid_pos));
-            if(SamplingSpaceType == SamplingSpace::R2 || SamplingSpaceType == SamplingSpace::SO2
-               || SamplingSpaceType == SamplingSpace::SE2)
-            {
-              pos.z() = 0;
-            }
-            grids_marker.points.push_back(OmgCore::toPointMsg(pos));
-          }
-        },
-        slice_update_dims, slice_divide_idxs);
-    marker_arr_msg.markers.push_back(grids_marker);
-  }
+  marker_arr_msg.markers.push_back(sliced_grids_marker_);
+  marker_arr_msg.markers.back().header = header_msg;
+  marker_arr_msg.markers.back().id = marker_arr_msg.markers.size() - 1;
 
   marker_arr_pub_.publish(marker_arr_msg);
 }
@@ -0,0 +1,603 @@
+/* Author: Masaki Murooka */
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <ros/console.h>
+#include <ros/serialization.h>
+
+#include <differentiable_rmap/RmapSampleSet.h>
+
+#include <differentiable_rmap/RosUtils.h>
+#include <differentiable_rmap/SampleSetUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Calculate 64-bit FNV-1a hash of sample position. */
+uint64_t calcPositionHash(const std::vector<double> & position)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for(double value : position)
+  {
+    // Treat -0.0 as 0.0
+    if(value == 0.0)
+    {
+      value = 0.0;
+    }
+    unsigned char bytes[sizeof(double)];
+    std::memcpy(bytes, &value, sizeof(double));
+    for(unsigned char byte : bytes)
+    {
+      hash ^= byte;
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+/** \brief Stream of ROS serialization which writes serialized bytes to file through fixed-size buffer. */
+class FileOStream
+{
+public:
+  /** \brief Constructor.
+      \param ofs output file stream
+  */
+  FileOStream(std::ofstream & ofs) : ofs_(ofs), buffer_(1 << 20) {}
+
+  /** \brief Serialize value. */
+  template<typename T>
+  inline void next(const T & value)
+  {
+    ros::serialization::serialize(*this, value);
+  }
+
+  /** \brief Get pointer to buffer to be written and advance stream.
+      \param len length of bytes to be written
+
+      The returned pointer is valid until the next call.
+  */
+  uint8_t * advance(uint32_t len)
+  {
+    if(buffer_pos_ + len > buffer_.size())
+    {
+      flush();
+      if(len > buffer_.size())
+      {
+        buffer_.resize(len);
+      }
+    }
+    uint8_t * ptr = buffer_.data() + buffer_pos_;
+    buffer_pos_ += len;
+    length_ += len;
+    return ptr;
+  }
+
+  /** \brief Write buffered bytes to file. */
+  void flush()
+  {
+    ofs_.write(reinterpret_cast<const char *>(buffer_.data()), buffer_pos_);
+    buffer_pos_ = 0;
+  }
+
+  /** \brief Get length of written bytes. */
+  inline uint64_t length() const
+  {
+    return length_;
+  }
+
+protected:
+  //! Output file stream
+  std::ofstream & ofs_;
+
+  //! Buffer
+  std::vector<uint8_t> buffer_;
+
+  //! Length of buffered bytes
+  size_t buffer_pos_ = 0;
+
+  //! Length of written bytes (including buffered bytes)
+  uint64_t length_ = 0;
+};
+
+/** \brief Proxy of RmapSampleSet message whose samples are passed by function on serialization. */
+struct SampleSetStream
+{
+  //! Type of sampling space
+  int32_t type = 0;
+
+  //! Dimension of sample
+  size_t sample_dim = 0;
+
+  //! Number of samples
+  size_t sample_num = 0;
+
+  //! Min/max position of samples
+  std::vector<double> min;
+  std::vector<double> max;
+
+  //! Function to call sample function for each sample of given reachability
+  ForEachSampleFunc for_each_sample;
+
+  /** \brief Calculate serialized length of message in 64-bit to detect overflow of ROS message length. */
+  uint64_t serializedLength64() const
+  {
+    // Sample consists of float64[] position and bool is_reachable
+    uint64_t sample_length = 4 + 8 * static_cast<uint64_t>(sample_dim) + 1;
+    return 4 + 4 + static_cast<uint64_t>(sample_num) * sample_length + 2 * (4 + 8 * static_cast<uint64_t>(sample_dim));
+  }
+};
+
+/** \brief Fields of header of record in ROS bag. */
+using BagHeader = std::vector<std::pair<std::string, std::string>>;
+
+/** \brief Convert value to field value of header of record in ROS bag. */
+template<class T>
+std::string toHeaderValue(T value)
+{
+  return std::string(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/** \brief Convert time to field value of header of record in ROS bag. */
+std::string toHeaderValue(const ros::Time & time)
+{
+  return toHeaderValue(time.sec) + toHeaderValue(time.nsec);
+}
+
+/** \brief Calculate length of header of record in ROS bag. */
+uint32_t headerLength(const BagHeader & header)
+{
+  uint32_t len = 0;
+  for(const auto & field : header)
+  {
+    len += 4 + static_cast<uint32_t>(field.first.size() + 1 + field.second.size());
+  }
+  return len;
+}
+
+/** \brief Calculate length of record in ROS bag. */
+uint64_t recordLength(const BagHeader & header, uint64_t data_len)
+{
+  return 4 + headerLength(header) + 4 + data_len;
+}
+
+/** \brief Write bytes to stream. */
+void writeBytes(FileOStream & stream, const std::string & bytes)
+{
+  std::memcpy(stream.advance(static_cast<uint32_t>(bytes.size())), bytes.data(), bytes.size());
+}
+
+/** \brief Write header of record in ROS bag (also used for data of connection record). */
+void writeHeader(FileOStream & stream, const BagHeader & header)
+{
+  stream.next(headerLength(header));
+  for(const auto & field : header)
+  {
+    stream.next(static_cast<uint32_t>(field.first.size() + 1 + field.second.size()));
+    writeBytes(stream, field.first + "=" + field.second);
+  }
+}
+
+/** \brief Table of samples whose position hashes are shared by multiple samples. */
+struct DupSampleTable
+{
+  //! Sorted list of shared hashes
+  std::vector<uint64_t> hash_list;
+
+  //! List of distinct positions of each shared hash (same order as hash_list)
+  std::vector<std::vector<std::vector<double>>> position_list;
+
+  //! Whether the sample of each distinct position is already written (same structure as position_list)
+  std::vector<std::vector<bool>> written_flag_list;
+
+  /** \brief Get index of hash in hash_list (-1 if hash is not shared). */
+  int hashIdx(uint64_t hash) const
+  {
+    auto iter = std::lower_bound(hash_list.begin(), hash_list.end(), hash);
+    return (iter != hash_list.end() && *iter == hash) ? static_cast<int>(iter - hash_list.begin()) : -1;
+  }
+};
+} // namespace
+
+namespace ros
+{
+namespace serialization
+{
+/** \brief Serializer which writes the same byte sequence as RmapSampleSet message. */
+template<>
+struct Serializer<SampleSetStream>
+{
+  template<typename Stream>
+  inline static void write(Stream & stream, const SampleSetStream & m)
+  {
+    stream.next(m.type);
+    stream.next(static_cast<uint32_t>(m.sample_num));
+
+    // Since libsvm considers the first class to be positive, write the reachable samples first
+    size_t serialized_num = 0;
+    uint32_t position_len = static_cast<uint32_t>(8 * m.sample_dim);
+    for(bool reachability : {true, false})
+    {
+      m.for_each_sample(reachability, [&](const double * position) {
+        stream.next(static_cast<uint32_t>(m.sample_dim));
+        std::memcpy(stream.advance(position_len), position, position_len);
+        stream.next(static_cast<uint8_t>(reachability));
+        serialized_num++;
+      });
+    }
+    if(serialized_num != m.sample_num)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>(
+          "[dumpSampleSetStream] Number of serialized samples is inconsistent: {} != {}", serialized_num,
+          m.sample_num);
+    }
+
+    stream.next(m.min);
+    stream.next(m.max);
+  }
+
+  inline static uint32_t serializedLength(const SampleSetStream & m)
+  {
+    // Overflow is checked in dumpSampleSetStream()
+    return static_cast<uint32_t>(m.serializedLength64());
+  }
+};
+} // namespace serialization
+} // namespace ros
+
+void DiffRmap::dumpSampleSetStream(const std::string & bag_path,
+                                   int type,
+                                   size_t sample_dim,
+                                   size_t sample_num,
+                                   const std::vector<double> & min,
+                                   const std::vector<double> & max,
+                                   const ForEachSampleFunc & for_each_sample)
+{
+  if(min.size() != sample_dim || max.size() != sample_dim)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[dumpSampleSetStream] Dimension of min/max is inconsistent: {}, {} != {}", min.size(), max.size(),
+        sample_dim);
+  }
+
+  SampleSetStream sample_set;
+  sample_set.type = type;
+  sample_set.sample_dim = sample_dim;
+  sample_set.sample_num = sample_num;
+  sample_set.min = min;
+  sample_set.max = max;
+  sample_set.for_each_sample = for_each_sample;
+
+  // Make headers of records in the same way as rosbag (see http://wiki.ros.org/Bags/Format/2.0)
+  // The bag consists of one chunk which contains one connection and one message
+  const std::string topic = "/rmap_sample_set";
+  const ros::Time time_now = ros::Time::now();
+  const uint32_t conn_id = 0;
+  const BagHeader conn_header = {
+      {"op", toHeaderValue<uint8_t>(0x07)}, {"conn", toHeaderValue(conn_id)}, {"topic", topic}};
+  const BagHeader conn_data = {
+      {"topic", topic},
+      {"type", ros::message_traits::DataType<differentiable_rmap::RmapSampleSet>::value()},
+      {"md5sum", ros::message_traits::MD5Sum<differentiable_rmap::RmapSampleSet>::value()},
+      {"message_definition", ros::message_traits::Definition<differentiable_rmap::RmapSampleSet>::value()}};
+  const BagHeader msg_header = {
+      {"op", toHeaderValue<uint8_t>(0x02)}, {"conn", toHeaderValue(conn_id)}, {"time", toHeaderValue(time_now)}};
+  const uint64_t conn_record_len = recordLength(conn_header, headerLength(conn_data));
+  const uint64_t chunk_data_len = conn_record_len + recordLength(msg_header, sample_set.serializedLength64());
+
+  // Check length of ROS message, which is limited to 32-bit together with the chunk containing it
+  if(chunk_data_len > std::numeric_limits<uint32_t>::max())
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>(
+        "[dumpSampleSetStream] Sample set is too large for one ROS message: {} bytes ({} samples).",
+        sample_set.serializedLength64(), sample_num);
+  }
+
+  const BagHeader chunk_header = {{"op", toHeaderValue<uint8_t>(0x05)},
+                                  {"compression", "none"},
+                                  {"size", toHeaderValue(static_cast<uint32_t>(chunk_data_len))}};
+  const BagHeader index_header = {{"op", toHeaderValue<uint8_t>(0x04)},
+                                  {"ver", toHeaderValue<uint32_t>(1)},
+                                  {"conn", toHeaderValue(conn_id)},
+                                  {"count", toHeaderValue<uint32_t>(1)}};
+  const uint32_t index_data_len = 12;
+
+  // File header record is padded to 4096 bytes so that rosbag can overwrite it in place
+  const std::string version_str = "#ROSBAG V2.0\n";
+  const uint32_t file_header_len = 4096;
+  const uint64_t chunk_pos = version_str.size() + 4 + file_header_len + 4;
+  const uint64_t index_pos =
+      chunk_pos + recordLength(chunk_header, chunk_data_len) + recordLength(index_header, index_data_len);
+  const BagHeader file_header = {{"op", toHeaderValue<uint8_t>(0x03)},
+                                 {"index_pos", toHeaderValue(index_pos)},
+                                 {"conn_count", toHeaderValue<uint32_t>(1)},
+                                 {"chunk_count", toHeaderValue<uint32_t>(1)}};
+  const BagHeader chunk_info_header = {{"op", toHeaderValue<uint8_t>(0x06)},
+                                       {"ver", toHeaderValue<uint32_t>(1)},
+                                       {"chunk_pos", toHeaderValue(chunk_pos)},
+                                       {"start_time", toHeaderValue(time_now)},
+                                       {"end_time", toHeaderValue(time_now)},
+                                       {"count", toHeaderValue<uint32_t>(1)}};
+  const uint64_t bag_len = index_pos + conn_record_len + recordLength(chunk_info_header, 8);
+
+  // Write to temporary file and rename it
+  std::string tmp_bag_path = bag_path + ".tmp";
+  try
+  {
+    std::ofstream ofs(tmp_bag_path, std::ios::binary | std::ios::trunc);
+    if(!ofs)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>("[dumpSampleSetStream] Failed to open {}", tmp_bag_path);
+    }
+    FileOStream stream(ofs);
+
+    // Version and file header
+    writeBytes(stream, version_str);
+    writeHeader(stream, file_header);
+    uint32_t padding_len = file_header_len - headerLength(file_header);
+    stream.next(padding_len);
+    writeBytes(stream, std::string(padding_len, ' '));
+
+    // Chunk, whose message is serialized while the samples are passed
+    writeHeader(stream, chunk_header);
+    stream.next(static_cast<uint32_t>(chunk_data_len));
+    writeHeader(stream, conn_header);
+    writeHeader(stream, conn_data);
+    writeHeader(stream, msg_header);
+    stream.next(ros::serialization::serializationLength(sample_set));
+    stream.next(sample_set);
+
+    // Index of chunk, whose offset is the position of message record in chunk
+    writeHeader(stream, index_header);
+    stream.next(index_data_len);
+    stream.next(time_now.sec);
+    stream.next(time_now.nsec);
+    stream.next(static_cast<uint32_t>(conn_record_len));
+
+    // Connection and chunk info
+    writeHeader(stream, conn_header);
+    writeHeader(stream, conn_data);
+    writeHeader(stream, chunk_info_header);
+    stream.next(static_cast<uint32_t>(8));
+    stream.next(conn_id);
+    stream.next(static_cast<uint32_t>(1));
+
+    stream.flush();
+    if(stream.length() != bag_len)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>("[dumpSampleSetStream] Length of bag is inconsistent: {} != {}",
+                                                       stream.length(), bag_len);
+    }
+    ofs.close();
+    if(!ofs)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>("[dumpSampleSetStream] Failed to write {}", tmp_bag_path);
+    }
+  }
+  catch(...)
+  {
+    std::remove(tmp_bag_path.c_str());
+    throw;
+  }
+  if(std::rename(tmp_bag_path.c_str(), bag_path.c_str()) != 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[dumpSampleSetStream] Failed to rename {} to {}", tmp_bag_path,
+                                                     bag_path);
+  }
+}
+
+size_t DiffRmap::mergeSampleSet(const std::vector<std::string> & input_bag_path_list,
+                                const std::string & output_bag_path,
+                                bool dedup,
+                                size_t hash_num_per_pass)
+{
+  if(input_bag_path_list.empty())
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[mergeSampleSet] Input file list is empty.");
+  }
+  if(dedup && hash_num_per_pass == 0)
+  {
+    mc_rtc::log::error_and_throw<std::runtime_error>("[mergeSampleSet] hash_num_per_pass must be positive.");
+  }
+
+  // Number of reachable and unreachable samples of each input file (same order as input_bag_path_list)
+  std::vector<std::array<size_t, 2>> input_sample_num_list(input_bag_path_list.size(), {0, 0});
+
+  // Call function for sample set message of each input file
+  // If reachability is non-negative, input files without samples of this reachability are skipped
+  auto forEachInput = [&](int reachability,
+                          const std::function<void(const differentiable_rmap::RmapSampleSet &)> & func) {
+    for(size_t i = 0; i < input_bag_path_list.size(); i++)
+    {
+      if(reachability >= 0 && input_sample_num_list[i][reachability] == 0)
+      {
+        continue;
+      }
+      func(*loadBag<differentiable_rmap::RmapSampleSet>(input_bag_path_list[i]));
+    }
+  };
+
+  // Check inputs and calculate min/max samples
+  // Hashes are collected in this pass unless their number exceeds hash_num_per_pass
+  int32_t type = 0;
+  size_t sample_dim = 0;
+  std::vector<double> min;
+  std::vector<double> max;
+  size_t input_sample_num = 0;
+  std::vector<uint64_t> hash_list;
+  bool hash_overflow = false;
+  for(size_t i = 0; i < input_bag_path_list.size(); i++)
+  {
+    ROS_INFO_STREAM("Load sample set from " << input_bag_path_list[i]);
+    differentiable_rmap::RmapSampleSet::ConstPtr input_msg =
+        loadBag<differentiable_rmap::RmapSampleSet>(input_bag_path_list[i]);
+
+    if(i == 0)
+    {
+      type = input_msg->type;
+    }
+    else if(input_msg->type != type)
+    {
+      mc_rtc::log::error_and_throw<std::runtime_error>("[mergeSampleSet] Sample type is not consistent: {} != {}",
+                                                       input_msg->type, type);
+    }
+
+    for(const auto & sample_msg : input_msg->samples)
+    {
+      if(sample_dim == 0)
+      {
+        sample_dim = sample_msg.position.size();
+        min.assign(sample_dim, 1e10);
+        max.assign(sample_dim, -1e10);
+      }
+      else if(sample_msg.position.size() != sample_dim)
+      {
+        mc_rtc::log::error_and_throw<std::runtime_error>(
+            "[mergeSampleSet] Sample dimension is not consistent: {} != {}", sample_msg.position.size(), sample_dim);
+      }
+
+      for(size_t j = 0; j < sample_dim; j++)
+      {
+        min[j] = std::min(min[j], sample_msg.position[j]);
+        max[j] = std::max(max[j], sample_msg.position[j]);
+      }
+      if(dedup && !hash_overflow)
+      {
+        if(hash_list.size() < hash_num_per_pass)
+        {
+          hash_list.push_back(calcPositionHash(sample_msg.position));
+        }
+        else
+        {
+          hash_overflow = true;
+          std::vector<uint64_t>().swap(hash_list);
+        }
+      }
+      input_sample_num_list[i][sample_msg.is_reachable ? 1 : 0]++;
+      input_sample_num++;
+    }
+  }
+
+  // Remove duplicated samples
+  size_t sample_num = input_sample_num;
+  DupSampleTable dup_table;
+  if(dedup)
+  {
+    // Get hashes shared by multiple samples
+    // If hashes are not collected in the first pass, they are collected for each partition of hash values
+    size_t partition_num = hash_overflow ? (input_sample_num + hash_num_per_pass - 1) / hash_num_per_pass : 1;
+    size_t unique_hash_num = 0;
+    for(size_t partition_idx = 0; partition_idx < partition_num; partition_idx++)
+    {
+      if(hash_overflow)
+      {
+        forEachInput(-1, [&](const differentiable_rmap::RmapSampleSet & input_msg) {
+          for(const auto & sample_msg : input_msg.samples)
+          {
+            uint64_t hash = calcPositionHash(sample_msg.position);
+            if(hash % partition_num == partition_idx)
+            {
+              hash_list.push_back(hash);
+            }
+          }
+        });
+      }
+
+      std::sort(hash_list.begin(), hash_list.end());
+      for(size_t i = 0; i < hash_list.size();)
+      {
+        size_t j = i;
+        while(j < hash_list.size() && hash_list[j] == hash_list[i])
+        {
+          j++;
+        }
+        if(j - i > 1)
+        {
+          dup_table.hash_list.push_back(hash_list[i]);
+        }
+        else
+        {
+          unique_hash_num++;
+        }
+        i = j;
+      }
+      std::vector<uint64_t>().swap(hash_list);
+    }
+    std::sort(dup_table.hash_list.begin(), dup_table.hash_list.end());
+
+    // Collect distinct positions of shared hashes so that the samples whose hashes collide are not removed
+    dup_table.position_list.resize(dup_table.hash_list.size());
+    if(!dup_table.hash_list.empty())
+    {
+      forEachInput(-1, [&](const differentiable_rmap::RmapSampleSet & input_msg) {
+        for(const auto & sample_msg : input_msg.samples)
+        {
+          int dup_hash_idx = dup_table.hashIdx(calcPositionHash(sample_msg.position));
+          if(dup_hash_idx < 0)
+          {
+            continue;
+          }
+          auto & position_list = dup_table.position_list[dup_hash_idx];
+          if(std::find(position_list.begin(), position_list.end(), sample_msg.position) == position_list.end())
+          {
+            position_list.push_back(sample_msg.position);
+          }
+        }
+      });
+    }
+
+    sample_num = unique_hash_num;
+    dup_table.written_flag_list.resize(dup_table.position_list.size());
+    for(size_t i = 0; i < dup_table.position_list.size(); i++)
+    {
+      sample_num += dup_table.position_list[i].size();
+      dup_table.written_flag_list[i].assign(dup_table.position_list[i].size(), false);
+    }
+  }
+
+  // Dump to ROS bag while reading input files
+  dumpSampleSetStream(
+      output_bag_path, type, sample_dim, sample_num, min, max,
+      [&](bool reachability, const std::function<void(const double *)> & func) {
+        forEachInput(reachability ? 1 : 0, [&](const differentiable_rmap::RmapSampleSet & input_msg) {
+          for(const auto & sample_msg : input_msg.samples)
+          {
+            if(static_cast<bool>(sample_msg.is_reachable) != reachability)
+            {
+              continue;
+            }
+            if(dedup)
+            {
+              // Positions are compared only when the hash is shared by multiple samples
+              int dup_hash_idx = dup_table.hashIdx(calcPositionHash(sample_msg.position));
+              if(dup_hash_idx >= 0)
+              {
+                const auto & position_list = dup_table.position_list[dup_hash_idx];
+                auto position_iter = std::find(position_list.begin(), position_list.end(), sample_msg.position);
+                if(position_iter == position_list.end())
+                {
+                  mc_rtc::log::error_and_throw<std::runtime_error>(
+                      "[mergeSampleSet] Sample position is not found. Input files may be modified.");
+                }
+                size_t position_idx = position_iter - position_list.begin();
+                if(dup_table.written_flag_list[dup_hash_idx][position_idx])
+                {
+                  continue;
+                }
+                dup_table.written_flag_list[dup_hash_idx][position_idx] = true;
+              }
+            }
+            func(sample_msg.position.data());
+          }
+        });
+      });
+  ROS_INFO_STREAM("Dump merged sample set to " << output_bag_path << " (" << sample_num << " samples, "
+                                               << input_sample_num - sample_num << " duplicates removed)");
+
+  return sample_num;
+}
@@ -0,0 +1,98 @@
+/* Author: Masaki Murooka */
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <differentiable_rmap/SVMUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Compare computation time of fused relative SVM value and vel gradients with chain of small-matrix functions.
+
+    SVM prediction is replaced with a dummy function so that only the calculation around it is measured.
+*/
+template<SamplingSpace SamplingSpaceType>
+void benchRelSVMValueAndVelGrad(int sample_num, int loop_num)
+{
+  using InputType = Input<SamplingSpaceType>;
+  using VelType = Vel<SamplingSpaceType>;
+
+  std::vector<Sample<SamplingSpaceType>> pre_sample_list(sample_num);
+  std::vector<Sample<SamplingSpaceType>> suc_sample_list(sample_num);
+  for(int i = 0; i < sample_num; i++)
+  {
+    pre_sample_list[i] = poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>());
+    suc_sample_list[i] = poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>());
+  }
+
+  auto dummy_svm_func = [](InputType & input_grad, const InputType & input) {
+    input_grad = input;
+    return input.squaredNorm() / 2;
+  };
+
+  // Chain of small-matrix functions, which is used in planning before fusion
+  VelType pre_vel_grad;
+  VelType suc_vel_grad;
+  double value_sum = 0;
+  auto start_time = std::chrono::system_clock::now();
+  for(int loop_idx = 0; loop_idx < loop_num; loop_idx++)
+  {
+    for(int i = 0; i < sample_num; i++)
+    {
+      const Sample<SamplingSpaceType> & rel_sample =
+          relSample<SamplingSpaceType>(pre_sample_list[i], suc_sample_list[i]);
+      InputType input_grad;
+      value_sum += dummy_svm_func(input_grad, sampleToInput<SamplingSpaceType>(rel_sample));
+      const Sample<SamplingSpaceType> & svm_grad = inputToSampleMat<SamplingSpaceType>(rel_sample) * input_grad;
+      pre_vel_grad =
+          sampleToVelMat<SamplingSpaceType>(pre_sample_list[i])
+          * relSampleToSampleMat<SamplingSpaceType>(pre_sample_list[i], suc_sample_list[i], false).transpose()
+          * svm_grad;
+      suc_vel_grad =
+          sampleToVelMat<SamplingSpaceType>(suc_sample_list[i])
+          * relSampleToSampleMat<SamplingSpaceType>(pre_sample_list[i], suc_sample_list[i], true).transpose()
+          * svm_grad;
+      value_sum += pre_vel_grad.sum() + suc_vel_grad.sum();
+    }
+  }
+  double chain_duration =
+      std::chrono::duration<double, std::micro>(std::chrono::system_clock::now() - start_time).count();
+
+  // Fused calculation
+  start_time = std::chrono::system_clock::now();
+  for(int loop_idx = 0; loop_idx < loop_num; loop_idx++)
+  {
+    for(int i = 0; i < sample_num; i++)
+    {
+      value_sum += calcRelSVMValueAndVelGrad<SamplingSpaceType>(pre_vel_grad, suc_vel_grad, pre_sample_list[i],
+                                                                suc_sample_list[i], dummy_svm_func);
+      value_sum += pre_vel_grad.sum() + suc_vel_grad.sum();
+    }
+  }
+  double fused_duration =
+      std::chrono::duration<double, std::micro>(std::chrono::system_clock::now() - start_time).count();
+
+  // Checksum is printed so that the calculation is not optimized out
+  std::cout << "[benchRelSVMValueAndVelGrad] " << std::to_string(SamplingSpaceType) << ": chain "
+            << 1e3 * chain_duration / (loop_num * sample_num) << " [ns], fused "
+            << 1e3 * fused_duration / (loop_num * sample_num) << " [ns] (checksum " << value_sum << ")" << std::endl;
+}
+} // namespace
+
+int main()
+{
+  int sample_num = 1000;
+  int loop_num = 100;
+
+  benchRelSVMValueAndVelGrad<SamplingSpace::R2>(sample_num, loop_num);
+  benchRelSVMValueAndVelGrad<SamplingSpace::SO2>(sample_num, loop_num);
+  benchRelSVMValueAndVelGrad<SamplingSpace::SE2>(sample_num, loop_num);
+  benchRelSVMValueAndVelGrad<SamplingSpace::R3>(sample_num, loop_num);
+  benchRelSVMValueAndVelGrad<SamplingSpace::SO3>(sample_num, loop_num);
+  benchRelSVMValueAndVelGrad<SamplingSpace::SE3>(sample_num, loop_num);
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <differentiable_rmap/CapabilityMapUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Whether SE3 sample is reachable (reachable if z-axis points downward within the sphere of radius 1). */
+bool isReachableSample(const Sample<SamplingSpace::SE3> & sample)
+{
+  const Eigen::Quaterniond quat(sample[6], sample[3], sample[4], sample[5]);
+  return sample.head<3>().norm() < 1.0 && (quat * Eigen::Vector3d::UnitZ()).z() < 0;
+}
+
+/** \brief Make capability map message. */
+differentiable_rmap::RmapCapabilityMap makeCapabilityMapMsg(int thread_num)
+{
+  differentiable_rmap::RmapCapabilityMap capability_map_msg;
+  capability_map_msg.divide_nums = {10, 10, 10};
+  capability_map_msg.min = {-1.5, -1.5, -1.5};
+  capability_map_msg.max = {1.5, 1.5, 1.5};
+  capability_map_msg.direction_num = 40;
+  capability_map_msg.roll_num = 4;
+  calcCapabilityMap(capability_map_msg, isReachableSample, thread_num);
+  return capability_map_msg;
+}
+} // namespace
+
+TEST(TestCapabilityMapUtils, OrientationList)
+{
+  int direction_num = 100;
+  int roll_num = 6;
+  const std::vector<Sample<SamplingSpace::SO3>> & orientation_list =
+      makeCapabilityOrientationList(direction_num, roll_num);
+  ASSERT_EQ(orientation_list.size(), direction_num * roll_num);
+
+  // Approach directions are distributed on both hemispheres equally
+  int upward_num = 0;
+  for(const auto & orientation : orientation_list)
+  {
+    EXPECT_NEAR(orientation.norm(), 1.0, 1e-10);
+    const Eigen::Quaterniond quat(orientation.w(), orientation.x(), orientation.y(), orientation.z());
+    if((quat * Eigen::Vector3d::UnitZ()).z() > 0)
+    {
+      upward_num++;
+    }
+  }
+  EXPECT_EQ(upward_num, orientation_list.size() / 2);
+
+  // Orientation list is deterministic
+  EXPECT_EQ(makeCapabilityOrientationList(direction_num, roll_num), orientation_list);
+}
+
+TEST(TestCapabilityMapUtils, CapabilityMap)
+{
+  const differentiable_rmap::RmapCapabilityMap & capability_map_msg = makeCapabilityMapMsg(4);
+  CapabilityMap capability_map(capability_map_msg);
+
+  // Result does not depend on the number of threads
+  const differentiable_rmap::RmapCapabilityMap & capability_map_msg_single = makeCapabilityMapMsg(1);
+  EXPECT_EQ(capability_map_msg.reachable_ratios, capability_map_msg_single.reachable_ratios);
+  EXPECT_EQ(capability_map_msg.masks, capability_map_msg_single.masks);
+
+  // Half of orientations are reachable inside the sphere, and none outside
+  EXPECT_DOUBLE_EQ(capability_map.reachableRatio(Eigen::Vector3d(0.3, 0.0, -0.3)), 0.5);
+  EXPECT_DOUBLE_EQ(capability_map.reachableRatio(Eigen::Vector3d(1.2, 1.2, 0.0)), 0.0);
+  EXPECT_EQ(capability_map.gridIdx(Eigen::Vector3d(2.0, 0.0, 0.0)), -1);
+  EXPECT_DOUBLE_EQ(capability_map.reachableRatio(Eigen::Vector3d(2.0, 0.0, 0.0)), 0.0);
+
+  // Bitmask is consistent with reachability of discretized orientations
+  const Eigen::Vector3d pos(0.0, 0.3, 0.0);
+  int orientation_idx = 0;
+  for(const auto & orientation : capability_map.orientationList())
+  {
+    Sample<SamplingSpace::SE3> sample;
+    sample << pos, orientation;
+    EXPECT_EQ(capability_map.isReachable(pos, orientation_idx), isReachableSample(sample));
+    EXPECT_EQ(capability_map.nearestOrientationIdx(orientation), orientation_idx);
+    EXPECT_EQ(capability_map.isReachable(sample), isReachableSample(sample));
+    orientation_idx++;
+  }
+  EXPECT_FALSE(capability_map.isReachable(pos, orientation_idx));
+
+  // Inconsistent message is rejected
+  differentiable_rmap::RmapCapabilityMap invalid_msg = capability_map_msg;
+  invalid_msg.masks.pop_back();
+  EXPECT_THROW(CapabilityMap{invalid_msg}, std::runtime_error);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
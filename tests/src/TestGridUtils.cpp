@@ -45,6 +45,23 @@ TEST(TestGridUtils, IdxsRatios)
   }
 }
 
+TEST(TestGridUtils, GridIdx)
+{
+  int grid_dim = 5;
+  Eigen::VectorXi divide_nums = Eigen::VectorXi(grid_dim);
+  divide_nums << 12, 0, 5, 1, 3;
+
+  int total_grid_num = (divide_nums.array() + 1).prod();
+  Eigen::VectorXi divide_idxs(grid_dim);
+  for(int grid_idx = 0; grid_idx < total_grid_num; grid_idx++)
+  {
+    // Convert grid_idx -> divide_idxs -> restored_grid_idx, and check consistency
+    gridIdxToDivideIdxs(divide_idxs, grid_idx, divide_nums);
+    EXPECT_TRUE(((divide_idxs.array() >= 0).all() && (divide_idxs.array() <= divide_nums.array()).all()));
+    EXPECT_EQ(calcGridIdx(divide_idxs, divide_nums), grid_idx);
+  }
+}
+
 template<SamplingSpace SamplingSpaceType>
 void testGridPos()
 {
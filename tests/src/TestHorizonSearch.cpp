@@ -0,0 +1,127 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <differentiable_rmap/HorizonSearch.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Planning whose target error converges to zero only if the horizon is not less than min_feasible_horizon. */
+class MockPlanning
+{
+public:
+  MockPlanning(int horizon, int min_feasible_horizon) : horizon_(horizon), min_feasible_horizon_(min_feasible_horizon)
+  {
+  }
+
+  void setup()
+  {
+    iter_ = 0;
+  }
+
+  void runOnce(bool publish)
+  {
+    iter_++;
+  }
+
+  double ineqViolation() const
+  {
+    return 0.0;
+  }
+
+  double targetError() const
+  {
+    return 0.1 * std::max(0, min_feasible_horizon_ - horizon_) + std::pow(0.99, iter_);
+  }
+
+protected:
+  int horizon_ = 0;
+  int min_feasible_horizon_ = 0;
+  int iter_ = 0;
+};
+
+int searchMockPlanning(int min_feasible_horizon, HorizonSearchConfiguration config)
+{
+  const HorizonSearchResult & result = searchMinHorizon<MockPlanning>(
+      [&](int horizon) { return std::make_shared<MockPlanning>(horizon, min_feasible_horizon); }, config);
+
+  // Check consistency of candidate results
+  int prev_horizon = -1;
+  for(const auto & candidate_result : result.candidate_result_list)
+  {
+    EXPECT_LT(prev_horizon, candidate_result.horizon);
+    EXPECT_LE(candidate_result.iter_num, config.max_iter_num);
+    if(candidate_result.feasible)
+    {
+      EXPECT_GE(candidate_result.horizon, min_feasible_horizon);
+      EXPECT_LE(candidate_result.target_error, config.target_error_thre);
+    }
+    else if(!candidate_result.aborted)
+    {
+      // Infeasible candidates must be stopped before max_iter_num because their error stalls
+      EXPECT_LT(candidate_result.horizon, min_feasible_horizon);
+      EXPECT_LT(candidate_result.iter_num, config.max_iter_num);
+    }
+    prev_horizon = candidate_result.horizon;
+  }
+
+  return result.horizon;
+}
+} // namespace
+
+TEST(TestHorizonSearch, SearchMinHorizon)
+{
+  for(bool bisection : {false, true})
+  {
+    for(int thread_num : {1, 3, 8})
+    {
+      HorizonSearchConfiguration config;
+      config.bisection = bisection;
+      config.thread_num = thread_num;
+
+      config.min_horizon = 1;
+      config.max_horizon = 10;
+      config.horizon_stride = 1;
+      EXPECT_EQ(searchMockPlanning(5, config), 5);
+      EXPECT_EQ(searchMockPlanning(1, config), 1);
+      EXPECT_EQ(searchMockPlanning(10, config), 10);
+      EXPECT_EQ(searchMockPlanning(11, config), -1);
+
+      config.min_horizon = 2;
+      config.max_horizon = 10;
+      config.horizon_stride = 2;
+      EXPECT_EQ(searchMockPlanning(5, config), 6);
+    }
+  }
+}
+
+TEST(TestHorizonSearch, InvalidConfiguration)
+{
+  auto create_func = [](int horizon) { return std::make_shared<MockPlanning>(horizon, 1); };
+
+  HorizonSearchConfiguration config;
+  config.horizon_stride = 0;
+  EXPECT_THROW(searchMinHorizon<MockPlanning>(create_func, config), std::runtime_error);
+
+  config = HorizonSearchConfiguration();
+  config.check_interval = 0;
+  EXPECT_THROW(searchMinHorizon<MockPlanning>(create_func, config), std::runtime_error);
+
+  config = HorizonSearchConfiguration();
+  config.min_iter_num = -1;
+  EXPECT_THROW(searchMinHorizon<MockPlanning>(create_func, config), std::runtime_error);
+
+  config = HorizonSearchConfiguration();
+  config.min_iter_num = config.max_iter_num + 1;
+  EXPECT_THROW(searchMinHorizon<MockPlanning>(create_func, config), std::runtime_error);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
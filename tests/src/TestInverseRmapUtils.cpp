@@ -0,0 +1,154 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <differentiable_rmap/InverseRmapUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+/** \brief Reachability value of relative SE2 sample (reachable in the front half of annulus). */
+double calcReachabilityValue(const Sample<SamplingSpace::SE2> & rel_sample)
+{
+  if(rel_sample.x() < 0)
+  {
+    return -1.0;
+  }
+  return 0.2 - std::abs(rel_sample.head<2>().norm() - 0.6);
+}
+
+/** \brief Relative SE2 sample of suc_sample in the frame of pre_sample (same as relSample() in SVMUtils.h). */
+Sample<SamplingSpace::SE2> calcRelSample(const Sample<SamplingSpace::SE2> & pre_sample,
+                                         const Sample<SamplingSpace::SE2> & suc_sample)
+{
+  Sample<SamplingSpace::SE2> rel_sample;
+  rel_sample.head<2>() = Eigen::Rotation2Dd(-pre_sample.z()) * (suc_sample.head<2>() - pre_sample.head<2>());
+  rel_sample.z() = std::remainder(suc_sample.z() - pre_sample.z(), 2 * M_PI);
+  return rel_sample;
+}
+
+/** \brief Make grid set of reachability map by calcReachabilityValue(). */
+differentiable_rmap::RmapGridSet makeGridSet()
+{
+  differentiable_rmap::RmapGridSet grid_set_msg;
+  grid_set_msg.type = static_cast<int>(SamplingSpace::SE2);
+  grid_set_msg.divide_nums = {40, 40, 16};
+  grid_set_msg.min = {-1.0, -1.0, -M_PI};
+  grid_set_msg.max = {1.0, 1.0, M_PI};
+
+  GridIdxs<SamplingSpace::SE2> divide_nums(grid_set_msg.divide_nums.data());
+  GridPos<SamplingSpace::SE2> grid_pos_min(grid_set_msg.min.data());
+  GridPos<SamplingSpace::SE2> grid_pos_max(grid_set_msg.max.data());
+  loopGrid<SamplingSpace::SE2>(divide_nums, grid_pos_min, grid_pos_max - grid_pos_min,
+                               [&](int grid_idx, const GridPos<SamplingSpace::SE2> & grid_pos) {
+                                 grid_set_msg.values.push_back(
+                                     calcReachabilityValue(gridPosToSample<SamplingSpace::SE2>(grid_pos)));
+                               });
+  return grid_set_msg;
+}
+} // namespace
+
+TEST(TestInverseRmapUtils, InvertSample)
+{
+  for(int i = 0; i < 100; i++)
+  {
+    Sample<SamplingSpace::SE2> sample_se2 = Sample<SamplingSpace::SE2>::Random();
+    EXPECT_LT(
+        (invertSample<SamplingSpace::SE2>(invertSample<SamplingSpace::SE2>(sample_se2)) - sample_se2).norm(),
+        1e-10);
+    EXPECT_LT((calcRelSample(sample_se2, Sample<SamplingSpace::SE2>::Zero())
+               - invertSample<SamplingSpace::SE2>(sample_se2))
+                  .norm(),
+              1e-10);
+
+    Sample<SamplingSpace::R3> sample_r3 = Sample<SamplingSpace::R3>::Random();
+    EXPECT_LT((invertSample<SamplingSpace::R3>(sample_r3) + sample_r3).norm(), 1e-10);
+
+    Sample<SamplingSpace::SE3> sample_se3 = poseToSample<SamplingSpace::SE3>(
+        sva::PTransformd(Eigen::Quaterniond::UnitRandom().toRotationMatrix(), Eigen::Vector3d::Random()));
+    const Sample<SamplingSpace::SE3> & inv_inv_sample_se3 =
+        invertSample<SamplingSpace::SE3>(invertSample<SamplingSpace::SE3>(sample_se3));
+    EXPECT_LT((inv_inv_sample_se3.head<3>() - sample_se3.head<3>()).norm(), 1e-10);
+    EXPECT_NEAR(std::abs(inv_inv_sample_se3.tail<4>().dot(sample_se3.tail<4>())), 1.0, 1e-10);
+  }
+}
+
+TEST(TestInverseRmapUtils, InvertGridSet)
+{
+  const differentiable_rmap::RmapGridSet & grid_set_msg = makeGridSet();
+  differentiable_rmap::RmapGridSet inv_grid_set_msg;
+  invertGridSet<SamplingSpace::SE2>(inv_grid_set_msg, grid_set_msg, 0.0);
+
+  EXPECT_EQ(inv_grid_set_msg.type, grid_set_msg.type);
+  EXPECT_EQ(inv_grid_set_msg.values.size(), grid_set_msg.values.size());
+
+  // Inverse of reachable region is within the disk whose radius is the outer radius of annulus
+  for(int i = 0; i < 2; i++)
+  {
+    EXPECT_GE(inv_grid_set_msg.min[i], -0.8 - 1e-10);
+    EXPECT_LE(inv_grid_set_msg.max[i], 0.8 + 1e-10);
+  }
+
+  // Value of inverse reachability map is the reachability value of inverse sample (up to discretization error)
+  GridIdxs<SamplingSpace::SE2> divide_nums(inv_grid_set_msg.divide_nums.data());
+  GridPos<SamplingSpace::SE2> grid_pos_min(inv_grid_set_msg.min.data());
+  GridPos<SamplingSpace::SE2> grid_pos_max(inv_grid_set_msg.max.data());
+  int reachable_num = 0;
+  loopGrid<SamplingSpace::SE2>(
+      divide_nums, grid_pos_min, grid_pos_max - grid_pos_min,
+      [&](int grid_idx, const GridPos<SamplingSpace::SE2> & grid_pos) {
+        double value = inv_grid_set_msg.values[grid_idx];
+        const Sample<SamplingSpace::SE2> & rel_sample =
+            invertSample<SamplingSpace::SE2>(gridPosToSample<SamplingSpace::SE2>(grid_pos));
+        // Skip the vertices near the discontinuity of reachability value and out of range of reachability map
+        if(std::abs(rel_sample.x()) > 0.1 && rel_sample.head<2>().cwiseAbs().maxCoeff() < 1.0)
+        {
+          EXPECT_NEAR(value, calcReachabilityValue(rel_sample), 0.1);
+        }
+        if(value > 0)
+        {
+          reachable_num++;
+        }
+      });
+  EXPECT_GT(reachable_num, 0);
+}
+
+TEST(TestInverseRmapUtils, VotePlacement)
+{
+  const differentiable_rmap::RmapGridSet & grid_set_msg = makeGridSet();
+  differentiable_rmap::RmapGridSet inv_grid_set_msg;
+  invertGridSet<SamplingSpace::SE2>(inv_grid_set_msg, grid_set_msg, 0.0);
+
+  std::vector<Sample<SamplingSpace::SE2>> target_sample_list = {Sample<SamplingSpace::SE2>(2.0, 1.0, 0.5),
+                                                                Sample<SamplingSpace::SE2>(2.2, 1.3, 0.3),
+                                                                Sample<SamplingSpace::SE2>(1.8, 1.4, 0.8)};
+  int candidate_num = 5;
+  const std::vector<PlacementCandidate<SamplingSpace::SE2>> & candidate_list =
+      votePlacement<SamplingSpace::SE2>(inv_grid_set_msg, target_sample_list, 0.0, candidate_num);
+
+  ASSERT_EQ(candidate_list.size(), candidate_num);
+  for(size_t i = 0; i < candidate_list.size(); i++)
+  {
+    const auto & candidate = candidate_list[i];
+    if(i > 0)
+    {
+      const auto & pre_candidate = candidate_list[i - 1];
+      EXPECT_TRUE(pre_candidate.vote_num > candidate.vote_num
+                  || (pre_candidate.vote_num == candidate.vote_num && pre_candidate.score >= candidate.score));
+    }
+
+    // All targets are reachable from the best candidates (up to discretization error)
+    EXPECT_EQ(candidate.vote_num, target_sample_list.size());
+    for(const auto & target_sample : target_sample_list)
+    {
+      EXPECT_GT(calcReachabilityValue(calcRelSample(candidate.sample, target_sample)), -0.1);
+    }
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
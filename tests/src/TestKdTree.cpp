@@ -0,0 +1,70 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include <differentiable_rmap/KdTree.h>
+
+using namespace DiffRmap;
+
+template<int N>
+void testKnnSearch()
+{
+  srand(1);
+
+  KdTree<N> kd_tree;
+  std::vector<Eigen::Matrix<double, N, 1>> point_list(1000);
+  for(auto & point : point_list)
+  {
+    point.setRandom();
+    kd_tree.insert(point);
+  }
+  EXPECT_EQ(kd_tree.size(), point_list.size());
+
+  int test_num = 100;
+  size_t K = 5;
+  for(int i = 0; i < test_num; i++)
+  {
+    Eigen::Matrix<double, N, 1> query_point = Eigen::Matrix<double, N, 1>::Random();
+
+    // Search nearest points by brute force
+    std::vector<std::pair<double, size_t>> dist_idx_list(point_list.size());
+    for(size_t j = 0; j < point_list.size(); j++)
+    {
+      dist_idx_list[j] = std::make_pair((point_list[j] - query_point).squaredNorm(), j);
+    }
+    std::sort(dist_idx_list.begin(), dist_idx_list.end());
+
+    // Check that KD-tree returns the same nearest points in the same order
+    const std::vector<size_t> & idx_list = kd_tree.knnSearch(query_point, K);
+    ASSERT_EQ(idx_list.size(), K);
+    for(size_t k = 0; k < K; k++)
+    {
+      EXPECT_EQ(idx_list[k], dist_idx_list[k].second);
+    }
+  }
+
+  // Check the case that the tree has less than K points
+  KdTree<N> small_kd_tree;
+  EXPECT_TRUE(small_kd_tree.knnSearch(Eigen::Matrix<double, N, 1>::Zero(), K).empty());
+  small_kd_tree.insert(point_list[0]);
+  small_kd_tree.insert(point_list[1]);
+  EXPECT_EQ(small_kd_tree.knnSearch(Eigen::Matrix<double, N, 1>::Zero(), K).size(), 2);
+}
+
+TEST(TestKdTree, KnnSearch3)
+{
+  testKnnSearch<3>();
+}
+
+TEST(TestKdTree, KnnSearch12)
+{
+  testKnnSearch<12>();
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+#include <RBDyn/FK.h>
+#include <RBDyn/MultiBodyGraph.h>
+
+#include <differentiable_rmap/KinematicChain.h>
+
+using namespace DiffRmap;
+
+sva::PTransformd getRandomTransform()
+{
+  return sva::PTransformd(Eigen::Quaterniond::UnitRandom(), Eigen::Vector3d::Random());
+}
+
+TEST(TestKinematicChain, CalcPose)
+{
+  // Make robot with branch
+  //   b0 -(j1)- b1 -(j2)- b2 -(j3)- b3 -(j4)- b4 -(j5)- b5
+  //              `-(j6)- b6
+  rbd::MultiBodyGraph mbg;
+  for(int i = 0; i <= 6; i++)
+  {
+    mbg.addBody(rbd::Body(1.0, Eigen::Vector3d::Zero(), Eigen::Matrix3d::Identity(), "b" + std::to_string(i)));
+  }
+  mbg.addJoint(rbd::Joint(rbd::Joint::Rev, Eigen::Vector3d::UnitZ(), true, "j1"));
+  mbg.addJoint(rbd::Joint(rbd::Joint::Fixed, Eigen::Vector3d::UnitZ(), true, "j2"));
+  mbg.addJoint(rbd::Joint(rbd::Joint::Prism, Eigen::Vector3d(1.0, 2.0, 3.0).normalized(), true, "j3"));
+  mbg.addJoint(rbd::Joint(rbd::Joint::Rev, Eigen::Vector3d(-1.0, 0.5, 2.0).normalized(), false, "j4"));
+  mbg.addJoint(rbd::Joint(rbd::Joint::Rev, Eigen::Vector3d::UnitX(), true, "j5"));
+  mbg.addJoint(rbd::Joint(rbd::Joint::Rev, Eigen::Vector3d::UnitY(), true, "j6"));
+  for(const auto & link : std::vector<std::array<std::string, 3>>{{"b0", "b1", "j1"},
+                                                                   {"b1", "b2", "j2"},
+                                                                   {"b2", "b3", "j3"},
+                                                                   {"b3", "b4", "j4"},
+                                                                   {"b4", "b5", "j5"},
+                                                                   {"b1", "b6", "j6"}})
+  {
+    mbg.linkBodies(link[0], getRandomTransform(), link[1], sva::PTransformd::Identity(), link[2]);
+  }
+  rbd::MultiBody mb = mbg.makeMultiBody("b0", true, getRandomTransform());
+  rbd::MultiBodyConfig mbc(mb);
+  mbc.zero(mb);
+
+  // j5 is not joint of interest, so its position is folded into chain
+  mbc.q[mb.jointIndexByName("j5")][0] = 0.3;
+
+  // j6 is not on the path from root to body, so it is ignored
+  std::vector<std::string> joint_name_list = {"j4", "j6", "j1", "j3"};
+  sva::PTransformd tip_offset = getRandomTransform();
+  KinematicChain kinematic_chain(mb, mbc, "b5", joint_name_list, tip_offset);
+  EXPECT_EQ(kinematic_chain.chainJointNum(), 3);
+
+  int batch_size = 100;
+  JointPosBatch joint_pos_batch = JointPosBatch::Random(joint_name_list.size(), batch_size);
+  std::vector<sva::PTransformd> pose_list;
+  kinematic_chain.calcPoseBatch(pose_list, joint_pos_batch);
+  ASSERT_EQ(static_cast<int>(pose_list.size()), batch_size);
+  for(int i = 0; i < batch_size; i++)
+  {
+    for(size_t j = 0; j < joint_name_list.size(); j++)
+    {
+      mbc.q[mb.jointIndexByName(joint_name_list[j])][0] = joint_pos_batch(j, i);
+    }
+    rbd::forwardKinematics(mb, mbc);
+    const sva::PTransformd & gt_pose = tip_offset * mbc.bodyPosW[mb.bodyIndexByName("b5")];
+
+    const sva::PTransformd & pose = kinematic_chain.calcPose(joint_pos_batch.col(i));
+    EXPECT_LT((pose.rotation() - gt_pose.rotation()).norm(), 1e-10);
+    EXPECT_LT((pose.translation() - gt_pose.translation()).norm(), 1e-10);
+
+    EXPECT_LT((pose_list[i].rotation() - gt_pose.rotation()).norm(), 1e-10);
+    EXPECT_LT((pose_list[i].translation() - gt_pose.translation()).norm(), 1e-10);
+  }
+
+  // Chain without joints of interest is constant
+  KinematicChain fixed_kinematic_chain(mb, mbc, "b2", {"j6"});
+  EXPECT_EQ(fixed_kinematic_chain.chainJointNum(), 0);
+  fixed_kinematic_chain.calcPoseBatch(pose_list, JointPosBatch::Random(1, batch_size));
+  for(int i = 0; i < batch_size; i++)
+  {
+    EXPECT_LT((pose_list[i].rotation() - mbc.bodyPosW[mb.bodyIndexByName("b2")].rotation()).norm(), 1e-10);
+    EXPECT_LT((pose_list[i].translation() - mbc.bodyPosW[mb.bodyIndexByName("b2")].translation()).norm(), 1e-10);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,201 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <optmotiongen/Utils/QpUtils.h>
+
+#include <differentiable_rmap/MallocUtils.h>
+#include <differentiable_rmap/QpUtils.h>
+
+using namespace DiffRmap;
+
+template<int N>
+void testSolveBoxHalfspaceQp()
+{
+  srand(1);
+
+  using VecType = Eigen::Matrix<double, N, 1>;
+
+  OmgCore::QpCoeff qp_coeff;
+  qp_coeff.setup(N, 0, 1);
+  std::shared_ptr<OmgCore::QpSolver> qp_solver = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+
+  int test_num = 1000;
+  int active_num = 0;
+  for(int i = 0; i < test_num; i++)
+  {
+    // Same structure as QP in RmapPlanning::runOnce()
+    VecType obj_diag = VecType::Constant(1.0 + std::abs(Eigen::Matrix<double, 1, 1>::Random()[0]));
+    VecType obj_vec = VecType::Random();
+    VecType ineq_row = VecType::Random();
+    VecType x_min = -0.1 * (VecType::Random().array().abs() + 0.1).matrix();
+    VecType x_max = 0.1 * (VecType::Random().array().abs() + 0.1).matrix();
+
+    // Make inequality feasible in the box
+    double ineq_row_min = (ineq_row.array() > 0).select(x_min.array(), x_max.array()).matrix().dot(ineq_row);
+    double ineq_val = ineq_row_min + std::abs(Eigen::Matrix<double, 1, 1>::Random()[0]);
+
+    qp_coeff.obj_mat_.diagonal() = obj_diag;
+    qp_coeff.obj_vec_ = obj_vec;
+    qp_coeff.ineq_mat_ = ineq_row.transpose();
+    qp_coeff.ineq_vec_ << ineq_val;
+    qp_coeff.x_min_ = x_min;
+    qp_coeff.x_max_ = x_max;
+    const Eigen::VectorXd & x_jrlqp = qp_solver->solve(qp_coeff);
+
+    VecType x;
+    {
+      // Check that the solver does not allocate on the heap (effective only if ENABLE_NO_MALLOC_CHECK is ON)
+      ScopedMallocAllowed malloc_allowed(false);
+      x = solveBoxHalfspaceQp<N>(obj_diag, obj_vec, ineq_row, ineq_val, x_min, x_max);
+    }
+    EXPECT_LT((x - x_jrlqp).norm(), 1e-6) << "x: " << x.transpose() << std::endl
+                                          << "x_jrlqp: " << x_jrlqp.transpose() << std::endl;
+    EXPECT_LE(ineq_row.dot(x), ineq_val + 1e-10);
+    EXPECT_TRUE((x.array() >= x_min.array()).all() && (x.array() <= x_max.array()).all());
+
+    // Check dynamic-size version
+    EXPECT_LT((solveBoxHalfspaceQp<Eigen::Dynamic>(obj_diag, obj_vec, ineq_row, ineq_val, x_min, x_max) - x).norm(),
+              1e-10);
+
+    if(std::abs(ineq_row.dot(x) - ineq_val) < 1e-10)
+    {
+      active_num++;
+    }
+  }
+
+  // Check that both active and inactive cases are tested
+  EXPECT_GT(active_num, 0);
+  EXPECT_LT(active_num, test_num);
+}
+
+TEST(TestQpUtils, SolveBoxHalfspaceQpR2)
+{
+  testSolveBoxHalfspaceQp<2>();
+}
+
+TEST(TestQpUtils, SolveBoxHalfspaceQpSO2)
+{
+  testSolveBoxHalfspaceQp<1>();
+}
+
+TEST(TestQpUtils, SolveBoxHalfspaceQpSE2)
+{
+  testSolveBoxHalfspaceQp<3>();
+}
+
+TEST(TestQpUtils, SolveBoxHalfspaceQpSE3)
+{
+  testSolveBoxHalfspaceQp<6>();
+}
+
+TEST(TestQpUtils, SolveBoxHalfspaceQpInfeasible)
+{
+  Eigen::Vector2d obj_diag(1.0, 1.0);
+  Eigen::Vector2d obj_vec(1.0, -1.0);
+  Eigen::Vector2d ineq_row(1.0, 0.0);
+  Eigen::Vector2d x_min(-0.1, -0.1);
+  Eigen::Vector2d x_max(0.1, 0.1);
+
+  // Inequality x[0] <= -1 cannot be satisfied in the box
+  const Eigen::Vector2d & x = solveBoxHalfspaceQp<2>(obj_diag, obj_vec, ineq_row, -1.0, x_min, x_max);
+  EXPECT_DOUBLE_EQ(x[0], -0.1);
+  EXPECT_DOUBLE_EQ(x[1], 0.1);
+}
+
+template<int CoupledDim, int BlockDim>
+void testArrowQpSolver(int block_num)
+{
+  srand(1);
+
+  int var_dim = CoupledDim + block_num * BlockDim;
+  double x_limit = 0.005;
+
+  // Setup QP with the same structure as RmapPlanningPlacement::runOnce()
+  OmgCore::QpCoeff qp_coeff;
+  qp_coeff.setup(var_dim + block_num, 0, block_num);
+  qp_coeff.x_min_.head(var_dim).setConstant(-x_limit);
+  qp_coeff.x_max_.head(var_dim).setConstant(x_limit);
+  qp_coeff.x_min_.tail(block_num).setConstant(-1e10);
+  qp_coeff.x_max_.tail(block_num).setConstant(1e10);
+  std::shared_ptr<OmgCore::QpSolver> qp_solver = OmgCore::allocateQpSolver(OmgCore::QpSolverType::JRLQP);
+
+  ArrowQpSolver<CoupledDim, BlockDim> arrow_qp_solver;
+  arrow_qp_solver.setup(block_num);
+  arrow_qp_solver.x_min_.setConstant(-x_limit);
+  arrow_qp_solver.x_max_.setConstant(x_limit);
+
+  int test_num = 20;
+  for(int i = 0; i < test_num; i++)
+  {
+    Eigen::VectorXd obj_vec(var_dim);
+    obj_vec.head(CoupledDim).setRandom();
+    obj_vec.head(CoupledDim) *= 1e-4;
+    obj_vec.tail(var_dim - CoupledDim).setRandom();
+    obj_vec.tail(var_dim - CoupledDim) *= 1e-2;
+    Eigen::VectorXd obj_diag(var_dim);
+    obj_diag.head(CoupledDim).setConstant(1e-3);
+    obj_diag.tail(var_dim - CoupledDim).setConstant(1.0);
+    obj_diag.array() += obj_vec.squaredNorm() + 1e-6;
+    double ineq_weight = 1e6;
+
+    qp_coeff.obj_mat_.setZero();
+    qp_coeff.obj_mat_.diagonal() << obj_diag, Eigen::VectorXd::Constant(block_num, ineq_weight);
+    qp_coeff.obj_vec_ << obj_vec, Eigen::VectorXd::Zero(block_num);
+    qp_coeff.ineq_mat_.setZero();
+    qp_coeff.ineq_vec_.setRandom();
+    qp_coeff.ineq_vec_ *= 1e-2;
+    for(int j = 0; j < block_num; j++)
+    {
+      qp_coeff.ineq_mat_.block(j, 0, 1, CoupledDim).setRandom();
+      qp_coeff.ineq_mat_.block(j, CoupledDim + j * BlockDim, 1, BlockDim).setRandom();
+      qp_coeff.ineq_mat_(j, var_dim + j) = -1;
+    }
+    const Eigen::VectorXd & x_jrlqp = qp_solver->solve(qp_coeff);
+    EXPECT_FALSE(qp_solver->solve_failed_);
+
+    arrow_qp_solver.obj_diag_ = obj_diag;
+    arrow_qp_solver.obj_vec_ = obj_vec;
+    arrow_qp_solver.ineq_weight_ = ineq_weight;
+    for(int j = 0; j < block_num; j++)
+    {
+      arrow_qp_solver.coupled_ineq_mat_.col(j) = qp_coeff.ineq_mat_.block(j, 0, 1, CoupledDim).transpose();
+      arrow_qp_solver.block_ineq_mat_.col(j) =
+          qp_coeff.ineq_mat_.block(j, CoupledDim + j * BlockDim, 1, BlockDim).transpose();
+    }
+    arrow_qp_solver.ineq_vec_ = qp_coeff.ineq_vec_;
+    bool solve_succeeded;
+    {
+      // Check that the solver does not allocate on the heap (effective only if ENABLE_NO_MALLOC_CHECK is ON)
+      ScopedMallocAllowed malloc_allowed(false);
+      solve_succeeded = arrow_qp_solver.solve();
+    }
+    EXPECT_TRUE(solve_succeeded);
+
+    EXPECT_LT((arrow_qp_solver.x_ - x_jrlqp.head(var_dim)).norm(), 1e-6)
+        << "x: " << arrow_qp_solver.x_.transpose() << std::endl
+        << "x_jrlqp: " << x_jrlqp.head(var_dim).transpose() << std::endl;
+    EXPECT_LT((arrow_qp_solver.ineq_error_ - x_jrlqp.tail(block_num)).norm(), 1e-6);
+  }
+}
+
+TEST(TestQpUtils, ArrowQpSolverR2)
+{
+  testArrowQpSolver<2, 2>(10);
+}
+
+TEST(TestQpUtils, ArrowQpSolverSE2)
+{
+  testArrowQpSolver<3, 3>(20);
+}
+
+TEST(TestQpUtils, ArrowQpSolverSE3)
+{
+  testArrowQpSolver<6, 6>(20);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,73 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include <differentiable_rmap/RealtimeUtils.h>
+
+using namespace DiffRmap;
+
+TEST(TestRealtimeUtils, LatencyHistogram)
+{
+  LatencyHistogram hist;
+  hist.setup(10.0, 10);
+  EXPECT_EQ(hist.count(), 0);
+  EXPECT_EQ(hist.max(), 0.0);
+  EXPECT_EQ(hist.percentile(0.5), 0.0);
+
+  // Add samples 0.5, 1.5, ..., 99.5 [us] and two outliers
+  for(int i = 0; i < 100; i++)
+  {
+    hist.add(i + 0.5);
+  }
+  hist.add(1000.0);
+  hist.add(-1.0);
+
+  EXPECT_EQ(hist.count(), 102);
+  EXPECT_EQ(hist.min(), -1.0);
+  EXPECT_EQ(hist.max(), 1000.0);
+  EXPECT_NEAR(hist.mean(), (5000.0 + 1000.0 - 1.0) / 102, 1e-10);
+  EXPECT_EQ(hist.percentile(0.5), 50.0);
+  EXPECT_EQ(hist.percentile(1.0), 100.0);
+  EXPECT_FALSE(hist.dump("test").empty());
+
+  hist.clear();
+  EXPECT_EQ(hist.count(), 0);
+  EXPECT_EQ(hist.mean(), 0.0);
+}
+
+TEST(TestRealtimeUtils, RealtimeLoop)
+{
+  // Use default scheduling policy because SCHED_FIFO requires privilege
+  RealtimeConfiguration config;
+  config.priority = 0;
+  config.prefault_stack_size = 64 * 1024;
+  config.histogram_bin_width = 100.0;
+  config.histogram_bin_num = 100;
+
+  RealtimeLoop realtime_loop(config, 1000.0);
+  std::atomic<int> last_loop_idx(-1);
+  bool loop_idx_consistent = true;
+  realtime_loop.start([&](int loop_idx) {
+    loop_idx_consistent &= (loop_idx == last_loop_idx + 1);
+    last_loop_idx = loop_idx;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  realtime_loop.stop();
+
+  EXPECT_TRUE(loop_idx_consistent);
+  EXPECT_GT(last_loop_idx, 0);
+  EXPECT_EQ(realtime_loop.jitterHistogram().count(), last_loop_idx + 1);
+  EXPECT_EQ(realtime_loop.computeHistogram().count(), last_loop_idx + 1);
+  EXPECT_GE(realtime_loop.jitterHistogram().min(), 0.0);
+
+  // Number of iterations cannot be more than the number of elapsed periods
+  EXPECT_LE(last_loop_idx + 1, 200 + 10);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -4,10 +4,13 @@
 
 #include <differentiable_rmap/RmapSampling.h>
 #include <differentiable_rmap/RmapSamplingIK.h>
+#include <differentiable_rmap/RosUtils.h>
 
 using namespace DiffRmap;
 
-void testGenerateSample(bool use_ik)
+std::string testGenerateSample(bool use_ik,
+                               const mc_rtc::Configuration & additional_config = mc_rtc::Configuration(),
+                               const std::string & bag_suffix = "")
 {
   ros::NodeHandle nh;
   ros::NodeHandle pnh("~");
@@ -39,15 +42,19 @@ void testGenerateSample(bool use_ik)
     rmap_sampling = createRmapSampling(sampling_space, rb, body_name, joint_name_list);
   }
 
+  mc_rtc::Configuration mc_rtc_config;
   if(pnh.hasParam("config_path"))
   {
     std::string config_path;
     pnh.getParam("config_path", config_path);
-    rmap_sampling->configure(mc_rtc::Configuration(config_path));
+    mc_rtc_config.load(config_path);
   }
+  mc_rtc_config.load(additional_config);
+  rmap_sampling->configure(mc_rtc_config);
 
   std::string bag_path = "/tmp/rmap_sample_set.bag";
   pnh.param<std::string>("bag_path", bag_path, bag_path);
+  bag_path = bag_path.substr(0, bag_path.rfind(".bag")) + bag_suffix + ".bag";
 
   int sample_num = 10000;
   pnh.param<int>("sample_num", sample_num, sample_num);
@@ -56,6 +63,8 @@ void testGenerateSample(bool use_ik)
   pnh.param<double>("sleep_rate", sleep_rate, sleep_rate);
 
   rmap_sampling->run(bag_path, sample_num, sleep_rate);
+
+  return bag_path;
 }
 
 TEST(TestRmapSampling, GenerateSampleR2FK)
@@ -68,6 +77,35 @@ TEST(TestRmapSampling, GenerateSampleR2IK)
   testGenerateSample(true);
 }
 
+TEST(TestRmapSampling, GenerateSampleR2FKJointGridSweep)
+{
+  // Result of joint grid sweep does not depend on the number of threads
+  std::vector<differentiable_rmap::RmapSampleSet::ConstPtr> sample_set_msg_list;
+  for(int thread_num : {1, 3})
+  {
+    mc_rtc::Configuration additional_config;
+    additional_config.add("joint_grid_sweep", true);
+    additional_config.add("joint_pos_step", 10.0);
+    additional_config.add("thread_num", thread_num);
+    std::string bag_path = testGenerateSample(false, additional_config, "_sweep" + std::to_string(thread_num));
+    sample_set_msg_list.push_back(loadBag<differentiable_rmap::RmapSampleSet>(bag_path));
+  }
+
+  ASSERT_GT(sample_set_msg_list[0]->samples.size(), 0u);
+  ASSERT_EQ(sample_set_msg_list[0]->samples.size(), sample_set_msg_list[1]->samples.size());
+  for(size_t i = 0; i < sample_set_msg_list[0]->samples.size(); i++)
+  {
+    EXPECT_EQ(sample_set_msg_list[0]->samples[i].position, sample_set_msg_list[1]->samples[i].position);
+  }
+}
+
+TEST(TestRmapSampling, GenerateSampleR2IKJointGridSweep)
+{
+  mc_rtc::Configuration additional_config;
+  additional_config.add("joint_grid_sweep", true);
+  EXPECT_THROW(testGenerateSample(true, additional_config, "_sweep_ik"), std::runtime_error);
+}
+
 int main(int argc, char ** argv)
 {
   // Setup ROS
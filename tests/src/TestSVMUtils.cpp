@@ -351,6 +351,52 @@ TEST(TestSVMUtils, MidSampleSE3)
   testMidSample<SamplingSpace::SE3>();
 }
 
+template<SamplingSpace SamplingSpaceType>
+void testExtrapolateSample()
+{
+  int test_num = 1000;
+  for(int i = 0; i < test_num; i++)
+  {
+    sva::PTransformd pose1 = getRandomPose<SamplingSpaceType>();
+    sva::PTransformd pose2 = getRandomPose<SamplingSpaceType>();
+    Sample<SamplingSpaceType> sample1 = poseToSample<SamplingSpaceType>(pose1);
+    Sample<SamplingSpaceType> sample2 = poseToSample<SamplingSpaceType>(pose2);
+
+    sva::PTransformd pose3 =
+        sampleToPose<SamplingSpaceType>(extrapolateSample<SamplingSpaceType>(sample1, sample2));
+    sva::PTransformd rel_pose1 = pose2 * pose1.inv();
+    sva::PTransformd rel_pose2 = pose3 * pose2.inv();
+
+    EXPECT_TRUE((rel_pose1.rotation() - rel_pose2.rotation()).norm() < 1e-8);
+    EXPECT_TRUE((rel_pose1.translation() - rel_pose2.translation()).norm() < 1e-8);
+  }
+}
+
+TEST(TestSVMUtils, ExtrapolateSampleR2)
+{
+  testExtrapolateSample<SamplingSpace::R2>();
+}
+TEST(TestSVMUtils, ExtrapolateSampleSO2)
+{
+  testExtrapolateSample<SamplingSpace::SO2>();
+}
+TEST(TestSVMUtils, ExtrapolateSampleSE2)
+{
+  testExtrapolateSample<SamplingSpace::SE2>();
+}
+TEST(TestSVMUtils, ExtrapolateSampleR3)
+{
+  testExtrapolateSample<SamplingSpace::R3>();
+}
+TEST(TestSVMUtils, ExtrapolateSampleSO3)
+{
+  testExtrapolateSample<SamplingSpace::SO3>();
+}
+TEST(TestSVMUtils, ExtrapolateSampleSE3)
+{
+  testExtrapolateSample<SamplingSpace::SE3>();
+}
+
 template<SamplingSpace SamplingSpaceType>
 void testRelSampleToSampleMat()
 {
@@ -426,6 +472,319 @@ TEST(TestSVMUtils, RelSampleToSampleMatSE3)
   testRelSampleToSampleMat<SamplingSpace::SE3>();
 }
 
+template<SamplingSpace SamplingSpaceType>
+void testSVMSurrogate()
+{
+  using InputType = Input<SamplingSpaceType>;
+
+  // Make SVM model with random support vectors
+  int sv_num = 50;
+  double rho = 0.3;
+  svm_model svm_mo = {};
+  svm_mo.param.svm_type = ONE_CLASS;
+  svm_mo.param.kernel_type = RBF;
+  svm_mo.param.gamma = 5.0;
+  svm_mo.rho = &rho;
+  Eigen::VectorXd svm_coeff_vec = Eigen::VectorXd::Random(sv_num);
+  Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> svm_sv_mat(inputDim<SamplingSpaceType>(),
+                                                                                 sv_num);
+  for(int i = 0; i < sv_num; i++)
+  {
+    svm_sv_mat.col(i) =
+        sampleToInput<SamplingSpaceType>(poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>()));
+  }
+  double hessian_bound = calcSVMHessianBound(svm_mo.param, svm_coeff_vec);
+
+  int test_num = 1000;
+  for(int i = 0; i < test_num; i++)
+  {
+    Sample<SamplingSpaceType> sample = poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>());
+
+    SVMSurrogate<SamplingSpaceType> surrogate;
+    surrogate.valid = true;
+    surrogate.input = sampleToInput<SamplingSpaceType>(sample);
+    surrogate.value = calcSVMValueAndInputGrad<SamplingSpaceType>(surrogate.input_grad, surrogate.input, svm_mo.param,
+                                                                  &svm_mo, svm_coeff_vec, svm_sv_mat);
+
+    // Check consistency with calcSVMValue() and calcSVMGrad()
+    EXPECT_TRUE(std::fabs(surrogate.value
+                          - calcSVMValue<SamplingSpaceType>(sample, svm_mo.param, &svm_mo, svm_coeff_vec, svm_sv_mat))
+                < 1e-10);
+    EXPECT_TRUE((inputToSampleMat<SamplingSpaceType>(sample) * surrogate.input_grad
+                 - calcSVMGrad<SamplingSpaceType>(sample, svm_mo.param, &svm_mo, svm_coeff_vec, svm_sv_mat))
+                    .norm()
+                < 1e-10);
+
+    // Check error bound of surrogate value
+    InputType new_input = surrogate.input + 0.1 * InputType::Random();
+    InputType new_input_grad;
+    double new_value = calcSVMValueAndInputGrad<SamplingSpaceType>(new_input_grad, new_input, svm_mo.param, &svm_mo,
+                                                                   svm_coeff_vec, svm_sv_mat);
+    double error_bound = 0.5 * hessian_bound * (new_input - surrogate.input).squaredNorm();
+    EXPECT_TRUE(std::fabs(surrogate.calcValue(new_input) - new_value) <= error_bound + 1e-10);
+    EXPECT_TRUE(surrogate.isTrusted(new_input, hessian_bound, error_bound + 1e-10, 1.0));
+    EXPECT_FALSE(surrogate.isTrusted(new_input, hessian_bound, 0.5 * error_bound, 1.0));
+    EXPECT_FALSE(surrogate.isTrusted(new_input, hessian_bound, error_bound + 1e-10,
+                                     0.5 * (new_input - surrogate.input).norm()));
+  }
+}
+
+TEST(TestSVMUtils, SVMSurrogateR2)
+{
+  testSVMSurrogate<SamplingSpace::R2>();
+}
+TEST(TestSVMUtils, SVMSurrogateSE2)
+{
+  testSVMSurrogate<SamplingSpace::SE2>();
+}
+TEST(TestSVMUtils, SVMSurrogateR3)
+{
+  testSVMSurrogate<SamplingSpace::R3>();
+}
+TEST(TestSVMUtils, SVMSurrogateSE3)
+{
+  testSVMSurrogate<SamplingSpace::SE3>();
+}
+
+template<SamplingSpace SamplingSpaceType>
+void testYawSymmetricSVM()
+{
+  using InputType = Input<SamplingSpaceType>;
+
+  // Make SVM model with random support vectors in canonical input space
+  int sv_num = 50;
+  double rho = 0.3;
+  svm_model svm_mo = {};
+  svm_mo.param.svm_type = ONE_CLASS;
+  svm_mo.param.kernel_type = RBF;
+  svm_mo.param.gamma = 5.0;
+  svm_mo.rho = &rho;
+  Eigen::VectorXd svm_coeff_vec = Eigen::VectorXd::Random(sv_num);
+  Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> svm_sv_mat(inputDim<SamplingSpaceType>(),
+                                                                                 sv_num);
+  for(int i = 0; i < sv_num; i++)
+  {
+    svm_sv_mat.col(i) = sampleToInput<SamplingSpaceType>(
+        canonicalizeSampleYaw<SamplingSpaceType>(poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>())));
+  }
+
+  int test_num = 1000;
+  for(int i = 0; i < test_num; i++)
+  {
+    sva::PTransformd pose = getRandomPose<SamplingSpaceType>();
+    Sample<SamplingSpaceType> sample = poseToSample<SamplingSpaceType>(pose);
+    InputType input = sampleToInput<SamplingSpaceType>(sample);
+
+    // Check invariance to rotation around z-axis
+    double value =
+        calcSVMValue<SamplingSpaceType>(sample, svm_mo.param, &svm_mo, svm_coeff_vec, svm_sv_mat, true);
+    double angle = M_PI * Eigen::Matrix<double, 1, 1>::Random()[0];
+    Sample<SamplingSpaceType> rotated_sample =
+        poseToSample<SamplingSpaceType>(pose * sva::PTransformd(sva::RotZ(angle)));
+    EXPECT_TRUE(std::fabs(value
+                          - calcSVMValue<SamplingSpaceType>(rotated_sample, svm_mo.param, &svm_mo, svm_coeff_vec,
+                                                            svm_sv_mat, true))
+                < 1e-10);
+
+    // Check consistency of gradients with calcSVMGrad()
+    InputType input_grad;
+    EXPECT_TRUE(std::fabs(value
+                          - calcSVMValueAndInputGrad<SamplingSpaceType>(input_grad, input, svm_mo.param, &svm_mo,
+                                                                        svm_coeff_vec, svm_sv_mat, true))
+                < 1e-10);
+    EXPECT_TRUE((inputToSampleMat<SamplingSpaceType>(sample) * input_grad
+                 - calcSVMGrad<SamplingSpaceType>(sample, svm_mo.param, &svm_mo, svm_coeff_vec, svm_sv_mat, true))
+                    .norm()
+                < 1e-10);
+
+    // Check gradient w.r.t. input with numerical differentiation
+    double eps = 1e-6;
+    InputType input_grad_numerical;
+    InputType dummy_input_grad;
+    for(int j = 0; j < inputDim<SamplingSpaceType>(); j++)
+    {
+      InputType input_plus = input + eps * InputType::Unit(j);
+      InputType input_minus = input - eps * InputType::Unit(j);
+      input_grad_numerical[j] = (calcSVMValueAndInputGrad<SamplingSpaceType>(dummy_input_grad, input_plus,
+                                                                             svm_mo.param, &svm_mo, svm_coeff_vec,
+                                                                             svm_sv_mat, true)
+                                 - calcSVMValueAndInputGrad<SamplingSpaceType>(dummy_input_grad, input_minus,
+                                                                               svm_mo.param, &svm_mo, svm_coeff_vec,
+                                                                               svm_sv_mat, true))
+                                / (2 * eps);
+    }
+    EXPECT_TRUE((input_grad - input_grad_numerical).norm() < 1e-5 * std::max(1.0, input_grad.norm()));
+  }
+}
+
+TEST(TestSVMUtils, YawSymmetricSVMR3)
+{
+  testYawSymmetricSVM<SamplingSpace::R3>();
+}
+TEST(TestSVMUtils, YawSymmetricSVMSE3)
+{
+  testYawSymmetricSVM<SamplingSpace::SE3>();
+}
+
+template<SamplingSpace SamplingSpaceType>
+void testRelSVMValueAndVelGrad()
+{
+  using InputType = Input<SamplingSpaceType>;
+  using VelType = Vel<SamplingSpaceType>;
+
+  // Make SVM model with random support vectors
+  int sv_num = 50;
+  double rho = 0.3;
+  svm_model svm_mo = {};
+  svm_mo.param.svm_type = ONE_CLASS;
+  svm_mo.param.kernel_type = RBF;
+  svm_mo.param.gamma = 5.0;
+  svm_mo.rho = &rho;
+  Eigen::VectorXd svm_coeff_vec = Eigen::VectorXd::Random(sv_num);
+  Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> svm_sv_mat(inputDim<SamplingSpaceType>(),
+                                                                                 sv_num);
+  for(int i = 0; i < sv_num; i++)
+  {
+    svm_sv_mat.col(i) =
+        sampleToInput<SamplingSpaceType>(poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>()));
+  }
+  auto svm_func = [&](InputType & input_grad, const InputType & input) {
+    return calcSVMValueAndInputGrad<SamplingSpaceType>(input_grad, input, svm_mo.param, &svm_mo, svm_coeff_vec,
+                                                       svm_sv_mat);
+  };
+
+  // Chain of small-matrix functions, which is used in planning before fusion
+  auto calc_chain = [&](VelType & pre_vel_grad, VelType & suc_vel_grad, const Sample<SamplingSpaceType> & pre_sample,
+                        const Sample<SamplingSpaceType> & suc_sample) {
+    const Sample<SamplingSpaceType> & rel_sample = relSample<SamplingSpaceType>(pre_sample, suc_sample);
+    InputType input_grad;
+    double value = svm_func(input_grad, sampleToInput<SamplingSpaceType>(rel_sample));
+    const Sample<SamplingSpaceType> & svm_grad = inputToSampleMat<SamplingSpaceType>(rel_sample) * input_grad;
+    pre_vel_grad = sampleToVelMat<SamplingSpaceType>(pre_sample)
+                   * relSampleToSampleMat<SamplingSpaceType>(pre_sample, suc_sample, false).transpose() * svm_grad;
+    suc_vel_grad = sampleToVelMat<SamplingSpaceType>(suc_sample)
+                   * relSampleToSampleMat<SamplingSpaceType>(pre_sample, suc_sample, true).transpose() * svm_grad;
+    return value;
+  };
+
+  int test_num = 1000;
+  for(int i = 0; i < test_num; i++)
+  {
+    const Sample<SamplingSpaceType> & pre_sample = poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>());
+    const Sample<SamplingSpaceType> & suc_sample = poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>());
+
+    VelType pre_vel_grad_chain;
+    VelType suc_vel_grad_chain;
+    double value_chain = calc_chain(pre_vel_grad_chain, suc_vel_grad_chain, pre_sample, suc_sample);
+    VelType pre_vel_grad;
+    VelType suc_vel_grad;
+    double value =
+        calcRelSVMValueAndVelGrad<SamplingSpaceType>(pre_vel_grad, suc_vel_grad, pre_sample, suc_sample, svm_func);
+
+    EXPECT_LT(std::fabs(value - value_chain), 1e-10);
+    EXPECT_LT((pre_vel_grad - pre_vel_grad_chain).norm(), 1e-8);
+    EXPECT_LT((suc_vel_grad - suc_vel_grad_chain).norm(), 1e-8);
+  }
+}
+
+TEST(TestSVMUtils, RelSVMValueAndVelGradR2)
+{
+  testRelSVMValueAndVelGrad<SamplingSpace::R2>();
+}
+TEST(TestSVMUtils, RelSVMValueAndVelGradSO2)
+{
+  testRelSVMValueAndVelGrad<SamplingSpace::SO2>();
+}
+TEST(TestSVMUtils, RelSVMValueAndVelGradSE2)
+{
+  testRelSVMValueAndVelGrad<SamplingSpace::SE2>();
+}
+TEST(TestSVMUtils, RelSVMValueAndVelGradR3)
+{
+  testRelSVMValueAndVelGrad<SamplingSpace::R3>();
+}
+TEST(TestSVMUtils, RelSVMValueAndVelGradSO3)
+{
+  testRelSVMValueAndVelGrad<SamplingSpace::SO3>();
+}
+TEST(TestSVMUtils, RelSVMValueAndVelGradSE3)
+{
+  testRelSVMValueAndVelGrad<SamplingSpace::SE3>();
+}
+
+template<SamplingSpace SamplingSpaceType>
+void testSVMBatch(bool yaw_symmetric)
+{
+  // Make SVM model with random support vectors
+  int sv_num = 50;
+  double rho = 0.3;
+  svm_model svm_mo = {};
+  svm_mo.param.svm_type = ONE_CLASS;
+  svm_mo.param.kernel_type = RBF;
+  svm_mo.param.gamma = 5.0;
+  svm_mo.rho = &rho;
+  Eigen::VectorXd svm_coeff_vec = Eigen::VectorXd::Random(sv_num);
+  Eigen::Matrix<double, inputDim<SamplingSpaceType>(), Eigen::Dynamic> svm_sv_mat(inputDim<SamplingSpaceType>(),
+                                                                                 sv_num);
+  for(int i = 0; i < sv_num; i++)
+  {
+    svm_sv_mat.col(i) =
+        sampleToInput<SamplingSpaceType>(poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>()));
+  }
+
+  // Use the number of samples not divisible by the chunk size
+  int test_num = 1000;
+  SampleColumns<SamplingSpaceType> samples(sampleDim<SamplingSpaceType>(), test_num);
+  for(int i = 0; i < test_num; i++)
+  {
+    samples.col(i) = poseToSample<SamplingSpaceType>(getRandomPose<SamplingSpaceType>());
+  }
+
+  for(int thread_num : {1, 4})
+  {
+    Eigen::VectorXd values(test_num);
+    SampleColumns<SamplingSpaceType> grads(sampleDim<SamplingSpaceType>(), test_num);
+    calcSVMValueBatch<SamplingSpaceType>(values, samples, svm_mo.param, &svm_mo, svm_coeff_vec, svm_sv_mat,
+                                         yaw_symmetric, thread_num);
+    calcSVMGradBatch<SamplingSpaceType>(grads, samples, svm_mo.param, &svm_mo, svm_coeff_vec, svm_sv_mat,
+                                        yaw_symmetric, thread_num);
+    for(int i = 0; i < test_num; i++)
+    {
+      EXPECT_EQ(values[i], calcSVMValue<SamplingSpaceType>(samples.col(i), svm_mo.param, &svm_mo, svm_coeff_vec,
+                                                           svm_sv_mat, yaw_symmetric));
+      EXPECT_EQ(grads.col(i), calcSVMGrad<SamplingSpaceType>(samples.col(i), svm_mo.param, &svm_mo, svm_coeff_vec,
+                                                             svm_sv_mat, yaw_symmetric));
+    }
+  }
+
+  // Check error of size mismatch
+  Eigen::VectorXd values(test_num - 1);
+  EXPECT_THROW(calcSVMValueBatch<SamplingSpaceType>(values, samples, svm_mo.param, &svm_mo, svm_coeff_vec,
+                                                    svm_sv_mat, yaw_symmetric),
+               std::runtime_error);
+}
+
+TEST(TestSVMUtils, SVMBatchR2)
+{
+  testSVMBatch<SamplingSpace::R2>(false);
+}
+TEST(TestSVMUtils, SVMBatchSE2)
+{
+  testSVMBatch<SamplingSpace::SE2>(false);
+}
+TEST(TestSVMUtils, SVMBatchR3)
+{
+  testSVMBatch<SamplingSpace::R3>(false);
+}
+TEST(TestSVMUtils, SVMBatchSE3)
+{
+  testSVMBatch<SamplingSpace::SE3>(false);
+}
+TEST(TestSVMUtils, SVMBatchSE3YawSymmetric)
+{
+  testSVMBatch<SamplingSpace::SE3>(true);
+}
+
 int main(int argc, char ** argv)
 {
   ros::init(argc, argv, "test_svm_utils");
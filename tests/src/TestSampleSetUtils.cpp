@@ -0,0 +1,108 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <differentiable_rmap/RmapSampleSet.h>
+
+#include <differentiable_rmap/RosUtils.h>
+#include <differentiable_rmap/SampleSetUtils.h>
+
+using namespace DiffRmap;
+
+namespace
+{
+void dumpSampleSet(const std::string & bag_path,
+                   const std::vector<std::pair<Eigen::Vector2d, bool>> & sample_list,
+                   bool set_min_max)
+{
+  differentiable_rmap::RmapSampleSet sample_set_msg;
+  sample_set_msg.type = static_cast<size_t>(SamplingSpace::R2);
+  for(const auto & sample : sample_list)
+  {
+    differentiable_rmap::RmapSample sample_msg;
+    sample_msg.position = {sample.first.x(), sample.first.y()};
+    sample_msg.is_reachable = sample.second;
+    sample_set_msg.samples.push_back(sample_msg);
+  }
+  if(set_min_max)
+  {
+    // Dummy values which should be ignored
+    sample_set_msg.min = {0.0, 0.0};
+    sample_set_msg.max = {0.0, 0.0};
+  }
+
+  rosbag::Bag bag(bag_path, rosbag::bagmode::Write);
+  bag.write("/rmap_sample_set", ros::Time::now(), sample_set_msg);
+}
+} // namespace
+
+TEST(TestSampleSetUtils, MergeSampleSet)
+{
+  std::vector<std::string> input_bag_path_list = {"/tmp/TestSampleSetUtils_input0.bag",
+                                                  "/tmp/TestSampleSetUtils_input1.bag"};
+  std::string output_bag_path = "/tmp/TestSampleSetUtils_output.bag";
+
+  dumpSampleSet(input_bag_path_list[0],
+                {{Eigen::Vector2d(1.0, 2.0), true},
+                 {Eigen::Vector2d(-3.0, 0.5), false},
+                 {Eigen::Vector2d(0.0, 0.0), true}},
+                true);
+  // The first sample is duplicated in the other file with different reachability
+  // The last sample is duplicated in the same file
+  dumpSampleSet(input_bag_path_list[1],
+                {{Eigen::Vector2d(-3.0, 0.5), true},
+                 {Eigen::Vector2d(2.0, -4.0), false},
+                 {Eigen::Vector2d(-0.0, 0.0), true},
+                 {Eigen::Vector2d(0.5, 5.0), false},
+                 {Eigen::Vector2d(0.5, 5.0), false}},
+                false);
+
+  for(bool dedup : {true, false})
+  {
+    // Hashes are partitioned if hash_num_per_pass is less than the number of samples
+    for(size_t hash_num_per_pass : std::vector<size_t>{16777216, 2})
+    {
+      size_t sample_num = mergeSampleSet(input_bag_path_list, output_bag_path, dedup, hash_num_per_pass);
+      differentiable_rmap::RmapSampleSet::ConstPtr merged_msg =
+          loadBag<differentiable_rmap::RmapSampleSet>(output_bag_path);
+
+      EXPECT_EQ(merged_msg->type, static_cast<int>(SamplingSpace::R2));
+      EXPECT_EQ(merged_msg->samples.size(), sample_num);
+      EXPECT_EQ(sample_num, dedup ? 5u : 8u);
+
+      // Check reachable-first ordering
+      size_t reachable_num = 0;
+      for(const auto & sample_msg : merged_msg->samples)
+      {
+        if(!sample_msg.is_reachable)
+        {
+          break;
+        }
+        reachable_num++;
+      }
+      EXPECT_EQ(reachable_num, dedup ? 3u : 4u);
+      for(size_t i = reachable_num; i < merged_msg->samples.size(); i++)
+      {
+        EXPECT_FALSE(merged_msg->samples[i].is_reachable);
+      }
+      if(dedup)
+      {
+        // Reachable one is kept for the sample duplicated with different reachability
+        EXPECT_EQ(merged_msg->samples[1].position, std::vector<double>({0.0, 0.0}));
+        EXPECT_EQ(merged_msg->samples[2].position, std::vector<double>({-3.0, 0.5}));
+      }
+
+      // Check min/max
+      EXPECT_EQ(merged_msg->min, std::vector<double>({-3.0, -4.0}));
+      EXPECT_EQ(merged_msg->max, std::vector<double>({2.0, 5.0}));
+    }
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  // ros::Time::now() is called in writing bag
+  ros::Time::init();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,109 @@
+/* Author: Masaki Murooka */
+
+#include <gtest/gtest.h>
+
+#include <differentiable_rmap/SVMUtils.h>
+#include <differentiable_rmap/SamplingBatchUtils.h>
+
+using namespace DiffRmap;
+
+template<SamplingSpace SamplingSpaceType>
+void testSamplingBatch()
+{
+  int sample_num = 1000;
+
+  std::vector<sva::PTransformd> pre_pose_list(sample_num);
+  std::vector<sva::PTransformd> suc_pose_list(sample_num);
+  for(int i = 0; i < sample_num; i++)
+  {
+    pre_pose_list[i] = getRandomPose<SamplingSpaceType>();
+    suc_pose_list[i] = getRandomPose<SamplingSpaceType>();
+  }
+
+  // poseToSampleBatch
+  SampleBatch<SamplingSpaceType> pre_sample_batch;
+  SampleBatch<SamplingSpaceType> suc_sample_batch;
+  poseToSampleBatch<SamplingSpaceType>(pre_sample_batch, pre_pose_list);
+  poseToSampleBatch<SamplingSpaceType>(suc_sample_batch, suc_pose_list);
+  ASSERT_EQ(pre_sample_batch.cols(), sample_num);
+  for(int i = 0; i < sample_num; i++)
+  {
+    EXPECT_LT((pre_sample_batch.col(i) - poseToSample<SamplingSpaceType>(pre_pose_list[i])).norm(), 1e-10);
+  }
+
+  // sampleToInputBatch
+  InputBatch<SamplingSpaceType> input_batch;
+  sampleToInputBatch<SamplingSpaceType>(input_batch, pre_sample_batch);
+  ASSERT_EQ(input_batch.cols(), sample_num);
+  for(int i = 0; i < sample_num; i++)
+  {
+    const Sample<SamplingSpaceType> & sample = pre_sample_batch.col(i);
+    EXPECT_LT((input_batch.col(i) - sampleToInput<SamplingSpaceType>(sample)).norm(), 1e-10);
+  }
+
+  // relSampleBatch
+  SampleBatch<SamplingSpaceType> rel_sample_batch;
+  relSampleBatch<SamplingSpaceType>(rel_sample_batch, pre_sample_batch, suc_sample_batch);
+  ASSERT_EQ(rel_sample_batch.cols(), sample_num);
+  for(int i = 0; i < sample_num; i++)
+  {
+    const Sample<SamplingSpaceType> & pre_sample = pre_sample_batch.col(i);
+    const Sample<SamplingSpaceType> & suc_sample = suc_sample_batch.col(i);
+    EXPECT_LT((rel_sample_batch.col(i) - relSample<SamplingSpaceType>(pre_sample, suc_sample)).norm(), 1e-10);
+  }
+
+  // integrateVelToSampleBatch
+  VelBatch<SamplingSpaceType> vel_batch = VelBatch<SamplingSpaceType>::Random(velDim<SamplingSpaceType>(), sample_num);
+  vel_batch.col(0).setZero();
+  SampleBatch<SamplingSpaceType> integrated_sample_batch = pre_sample_batch;
+  integrateVelToSampleBatch<SamplingSpaceType>(integrated_sample_batch, vel_batch);
+  for(int i = 0; i < sample_num; i++)
+  {
+    Sample<SamplingSpaceType> sample = pre_sample_batch.col(i);
+    integrateVelToSample<SamplingSpaceType>(sample, vel_batch.col(i));
+    EXPECT_LT((integrated_sample_batch.col(i) - sample).norm(), 1e-10);
+  }
+
+  // gridPosToSampleBatch
+  GridPosBatch<SamplingSpaceType> grid_pos_batch =
+      M_PI * GridPosBatch<SamplingSpaceType>::Random(gridDim<SamplingSpaceType>(), sample_num);
+  SampleBatch<SamplingSpaceType> grid_sample_batch;
+  gridPosToSampleBatch<SamplingSpaceType>(grid_sample_batch, grid_pos_batch);
+  ASSERT_EQ(grid_sample_batch.cols(), sample_num);
+  for(int i = 0; i < sample_num; i++)
+  {
+    const GridPos<SamplingSpaceType> & grid_pos = grid_pos_batch.col(i);
+    EXPECT_LT((grid_sample_batch.col(i) - gridPosToSample<SamplingSpaceType>(grid_pos)).norm(), 1e-10);
+  }
+}
+
+TEST(TestSamplingBatchUtils, SamplingBatchR2)
+{
+  testSamplingBatch<SamplingSpace::R2>();
+}
+TEST(TestSamplingBatchUtils, SamplingBatchSO2)
+{
+  testSamplingBatch<SamplingSpace::SO2>();
+}
+TEST(TestSamplingBatchUtils, SamplingBatchSE2)
+{
+  testSamplingBatch<SamplingSpace::SE2>();
+}
+TEST(TestSamplingBatchUtils, SamplingBatchR3)
+{
+  testSamplingBatch<SamplingSpace::R3>();
+}
+TEST(TestSamplingBatchUtils, SamplingBatchSO3)
+{
+  testSamplingBatch<SamplingSpace::SO3>();
+}
+TEST(TestSamplingBatchUtils, SamplingBatchSE3)
+{
+  testSamplingBatch<SamplingSpace::SE3>();
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
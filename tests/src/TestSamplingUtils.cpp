@@ -256,6 +256,43 @@ TEST(TestSamplingUtils, SampleErrorSE3)
   testSampleError<SamplingSpace::SE3>();
 }
 
+template<SamplingSpace SamplingSpaceType>
+void testCanonicalizeYaw()
+{
+  int test_num = 1000;
+  for(int i = 0; i < test_num; i++)
+  {
+    sva::PTransformd pose = getRandomPose<SamplingSpaceType>();
+    Sample<SamplingSpaceType> sample = poseToSample<SamplingSpaceType>(pose);
+    Sample<SamplingSpaceType> canonical_sample = canonicalizeSampleYaw<SamplingSpaceType>(sample);
+    Input<SamplingSpaceType> canonical_input =
+        canonicalizeInputYaw<SamplingSpaceType>(sampleToInput<SamplingSpaceType>(sample));
+
+    // Canonical position is on the xz-plane with nonnegative x
+    EXPECT_TRUE(std::fabs(canonical_sample.y()) < 1e-10);
+    EXPECT_TRUE(canonical_sample.x() >= 0);
+
+    // Canonicalization of input is equivalent to that of sample
+    EXPECT_TRUE((sampleToInput<SamplingSpaceType>(canonical_sample) - canonical_input).norm() < 1e-10);
+
+    // Canonical input is invariant to rotation around z-axis
+    double angle = M_PI * Eigen::Matrix<double, 1, 1>::Random()[0];
+    sva::PTransformd rotated_pose = pose * sva::PTransformd(sva::RotZ(angle));
+    Input<SamplingSpaceType> rotated_canonical_input = canonicalizeInputYaw<SamplingSpaceType>(
+        sampleToInput<SamplingSpaceType>(poseToSample<SamplingSpaceType>(rotated_pose)));
+    EXPECT_TRUE((rotated_canonical_input - canonical_input).norm() < 1e-10);
+  }
+}
+
+TEST(TestSamplingUtils, CanonicalizeYawR3)
+{
+  testCanonicalizeYaw<SamplingSpace::R3>();
+}
+TEST(TestSamplingUtils, CanonicalizeYawSE3)
+{
+  testCanonicalizeYaw<SamplingSpace::SE3>();
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);